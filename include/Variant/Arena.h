@@ -0,0 +1,71 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Bump allocated memory for the nodes of short lived documents.
+ */
+#ifndef VARIANT_ARENA_H
+#define VARIANT_ARENA_H
+#pragma once
+#include <stddef.h>
+
+namespace libvariant {
+
+	namespace Internal { class ArenaImpl; }
+
+	/**
+	 * A handle to memory that Variant storage can be bump allocated from,
+	 * e.g. by passing it to Deserialize. The memory is given back all at
+	 * once when the last handle is gone, so the Variants allocated from it,
+	 * and any that share a value with them, must be destructed or assigned
+	 * to first. Copy what needs to outlive the arena with Variant::Copy
+	 * outside of an ArenaScope.
+	 *
+	 * An arena must only be in use for allocation on one thread at a time.
+	 */
+	class Arena {
+	public:
+		/// block_size is how much memory is requested from the system at a time.
+		explicit Arena(size_t block_size = 64 * 1024);
+		Arena(const Arena &o);
+		~Arena();
+		Arena &operator=(const Arena &o);
+
+		/// Return the number of bytes allocated from the arena so far.
+		size_t BytesUsed() const;
+
+	private:
+		Internal::ArenaImpl *impl;
+		friend class ArenaScope;
+	};
+
+	/**
+	 * While an ArenaScope exists, storage for Variants created on the
+	 * current thread is allocated from its arena. Scopes nest.
+	 */
+	class ArenaScope {
+	public:
+		explicit ArenaScope(const Arena &arena);
+		~ArenaScope();
+	private:
+		ArenaScope(const ArenaScope &);
+		ArenaScope &operator=(const ArenaScope &);
+		Internal::ArenaImpl *arena;
+		Internal::ArenaImpl *previous;
+	};
+}
+#endif
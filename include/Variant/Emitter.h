@@ -55,6 +55,15 @@ namespace libvariant {
 		virtual void Emit(uintmax_t v) = 0;
 		virtual void Emit(double v) = 0;
 		virtual void Emit(ConstBlobPtr b) = 0;
+		/// Emit a whole list of numbers. This does BeginList, Emit of each
+		/// element and EndList unless the emitter can do better.
+		virtual void EmitList(const intmax_t *v, unsigned len);
+		virtual void EmitList(const uintmax_t *v, unsigned len);
+		virtual void EmitList(const double *v, unsigned len);
+		/// Emit a list or map given as len bytes of JSON text by copying
+		/// the text. Return false if the emitter can not do that, which is
+		/// the default.
+		virtual bool EmitJSON(const char *text, unsigned len);
 
 		virtual void Flush() = 0;
 		virtual void Close() = 0;
@@ -99,6 +108,14 @@ namespace libvariant {
 		Emitter &Emit(uintmax_t v);
 		Emitter &Emit(double v);
 		Emitter &Emit(ConstBlobPtr b);
+		/// Emit a list of len numbers, the same as BeginList(len), Emit of
+		/// each element and EndList().
+		Emitter &EmitList(const intmax_t *v, unsigned len);
+		Emitter &EmitList(const uintmax_t *v, unsigned len);
+		Emitter &EmitList(const double *v, unsigned len);
+		/// Copy the JSON text of a list or map to the output if the emitter
+		/// supports it, return false otherwise.
+		bool EmitJSON(const char *text, unsigned len);
 
 		void Flush();
 		void Close();
@@ -140,6 +157,19 @@ namespace libvariant {
 		e.EndMap();
 		return e;
 	}
+	/// Hash maps are emitted in key order so that the output is deterministic
+	template<typename T, typename H>
+	inline Emitter &operator<<(Emitter &e, const HashMap<std::string, T, H> &v) {
+		std::vector<const typename HashMap<std::string, T, H>::value_type*> entries;
+		SortedEntries(v, entries);
+		e.BeginMap(v.size());
+		for (unsigned i = 0; i < entries.size(); ++i) {
+			e.Emit(entries[i]->first);
+			e << entries[i]->second;
+		}
+		e.EndMap();
+		return e;
+	}
 	inline Emitter &operator<<(Emitter &e, bool v) { e.Emit(v); return e; }
 	inline Emitter &operator<<(Emitter &e, char v) { e.Emit(intmax_t(v)); return e; }
 	inline Emitter &operator<<(Emitter &e, short v) { e.Emit(intmax_t(v)); return e; }
@@ -0,0 +1,384 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief An open addressing hash table with a std::map like interface.
+ *
+ * Used as Variant::Map when libvariant is built with LIBVARIANT_HASH_MAP.
+ */
+#ifndef VARIANT_HASHMAP_H
+#define VARIANT_HASHMAP_H
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <string.h>
+
+namespace libvariant {
+
+	/// Default hash functor for HashMap, specialized for the key types used.
+	template<typename K>
+	struct HashMapHash;
+
+	template<>
+	struct HashMapHash<std::string> {
+		size_t operator()(const std::string &key) const { return (*this)(key.data(), key.size()); }
+		size_t operator()(const char *key, size_t len) const {
+			// FNV-1a
+			size_t hash = size_t(2166136261u);
+			for (size_t i = 0; i < len; ++i) {
+				hash = (hash ^ (unsigned char)key[i]) * size_t(16777619u);
+			}
+			return hash;
+		}
+	};
+
+	/**
+	 * A hash table using linear probing over an array of (hash, node) slots.
+	 * Entries are allocated individually so their addresses are stable like
+	 * in std::map, and they are linked in insertion order for iteration.
+	 * Use SortedEntries when a deterministic key order is required.
+	 */
+	template<typename K, typename V, typename H = HashMapHash<K> >
+	class HashMap {
+	public:
+		typedef K key_type;
+		typedef V mapped_type;
+		typedef std::pair<const K, V> value_type;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		typedef value_type &reference;
+		typedef const value_type &const_reference;
+		typedef value_type *pointer;
+		typedef const value_type *const_pointer;
+
+	private:
+		struct Link {
+			Link *prev;
+			Link *next;
+		};
+
+		struct Node : public Link {
+			Node(const value_type &v, size_t h) : value(v), hash(h) {}
+			value_type value;
+			size_t hash;
+		};
+
+		struct Slot {
+			Slot() : hash(0), node(0) {}
+			size_t hash;
+			Node *node;
+		};
+
+		template<typename Ref, typename Ptr>
+		class Iterator {
+		public:
+			typedef std::bidirectional_iterator_tag iterator_category;
+			typedef typename HashMap::value_type value_type;
+			typedef ptrdiff_t difference_type;
+			typedef Ref reference;
+			typedef Ptr pointer;
+
+			Iterator() : link(0) {}
+			// Allows iterator to const_iterator conversion
+			Iterator(const Iterator<value_type&, value_type*> &o) : link(o.link) {}
+
+			Ref operator*() const { return static_cast<Node*>(link)->value; }
+			Ptr operator->() const { return &static_cast<Node*>(link)->value; }
+			Iterator &operator++() { link = link->next; return *this; }
+			Iterator operator++(int) { Iterator copy = *this; link = link->next; return copy; }
+			Iterator &operator--() { link = link->prev; return *this; }
+			Iterator operator--(int) { Iterator copy = *this; link = link->prev; return copy; }
+			bool operator==(const Iterator &o) const { return link == o.link; }
+			bool operator!=(const Iterator &o) const { return link != o.link; }
+		private:
+			explicit Iterator(Link *l) : link(l) {}
+			Link *link;
+			friend class HashMap;
+			template<typename R, typename P> friend class Iterator;
+		};
+
+	public:
+		typedef Iterator<value_type&, value_type*> iterator;
+		typedef Iterator<const value_type&, const value_type*> const_iterator;
+
+		HashMap() : num_entries(0) { Reset(); }
+
+		HashMap(const HashMap &o) : num_entries(0) {
+			Reset();
+			insert(o.begin(), o.end());
+		}
+
+		template<typename InputIterator>
+		HashMap(InputIterator b, InputIterator e) : num_entries(0) {
+			Reset();
+			insert(b, e);
+		}
+
+		~HashMap() { FreeNodes(); }
+
+		HashMap &operator=(const HashMap &o) {
+			if (this != &o) {
+				HashMap copy(o);
+				swap(copy);
+			}
+			return *this;
+		}
+
+		iterator begin() { return iterator(head.next); }
+		const_iterator begin() const { return const_iterator(head.next); }
+		iterator end() { return iterator(&head); }
+		const_iterator end() const { return const_iterator(const_cast<Link*>(&head)); }
+
+		size_type size() const { return num_entries; }
+		bool empty() const { return num_entries == 0; }
+
+		void clear() {
+			FreeNodes();
+			Reset();
+			std::vector<Slot>().swap(slots);
+		}
+
+		iterator find(const K &key) {
+			Slot *slot = Lookup(key, hasher(key));
+			return slot ? iterator(slot->node) : end();
+		}
+
+		const_iterator find(const K &key) const {
+			const Slot *slot = const_cast<HashMap*>(this)->Lookup(key, hasher(key));
+			return slot ? const_iterator(slot->node) : end();
+		}
+
+		/// find for when the hash of key is already known
+		iterator find(const K &key, size_t hash) {
+			Slot *slot = Lookup(key, hash);
+			return slot ? iterator(slot->node) : end();
+		}
+
+		const_iterator find(const K &key, size_t hash) const {
+			const Slot *slot = const_cast<HashMap*>(this)->Lookup(key, hash);
+			return slot ? const_iterator(slot->node) : end();
+		}
+
+		/// find for a string key given as the len characters at key, so no
+		/// K has to be made for the lookup
+		iterator find(const char *key, size_t len, size_t hash) {
+			Slot *slot = LookupChars(key, len, hash);
+			return slot ? iterator(slot->node) : end();
+		}
+
+		const_iterator find(const char *key, size_t len, size_t hash) const {
+			const Slot *slot = const_cast<HashMap*>(this)->LookupChars(key, len, hash);
+			return slot ? const_iterator(slot->node) : end();
+		}
+
+		size_type count(const K &key) const { return find(key) == end() ? 0 : 1; }
+
+		std::pair<iterator, bool> insert(const value_type &v) {
+			size_t hash = hasher(v.first);
+			Slot *slot = Lookup(v.first, hash);
+			if (slot) { return std::make_pair(iterator(slot->node), false); }
+			return std::make_pair(iterator(Insert(v, hash)), true);
+		}
+
+		template<typename InputIterator>
+		void insert(InputIterator b, InputIterator e) {
+			for (; b != e; ++b) { insert(value_type(b->first, b->second)); }
+		}
+
+		V &operator[](const K &key) {
+			size_t hash = hasher(key);
+			Slot *slot = Lookup(key, hash);
+			if (slot) { return slot->node->value.second; }
+			return Insert(value_type(key, V()), hash)->value.second;
+		}
+
+		size_type erase(const K &key) {
+			Slot *slot = Lookup(key, hasher(key));
+			if (!slot) { return 0; }
+			Erase(slot);
+			return 1;
+		}
+
+		void erase(iterator i) {
+			Node *node = static_cast<Node*>(i.link);
+			Erase(Lookup(node->value.first, node->hash));
+		}
+
+		void swap(HashMap &o) {
+			std::swap(num_entries, o.num_entries);
+			slots.swap(o.slots);
+			std::swap(head, o.head);
+			Relink();
+			o.Relink();
+		}
+
+		/// Equal if the maps have the same keys mapping to equal values,
+		/// regardless of order.
+		bool operator==(const HashMap &o) const {
+			if (num_entries != o.num_entries) { return false; }
+			for (const_iterator i(begin()), e(end()); i != e; ++i) {
+				const_iterator j = o.find(i->first);
+				if (j == o.end() || !(j->second == i->second)) { return false; }
+			}
+			return true;
+		}
+
+		bool operator!=(const HashMap &o) const { return !(*this == o); }
+
+	private:
+		void Reset() {
+			head.prev = &head;
+			head.next = &head;
+			num_entries = 0;
+		}
+
+		/// Fix the links to the head after it has been moved
+		void Relink() {
+			if (num_entries == 0) {
+				head.prev = &head;
+				head.next = &head;
+			} else {
+				head.next->prev = &head;
+				head.prev->next = &head;
+			}
+		}
+
+		void FreeNodes() {
+			Link *link = head.next;
+			while (link != &head) {
+				Link *next = link->next;
+				delete static_cast<Node*>(link);
+				link = next;
+			}
+		}
+
+		Slot *Lookup(const K &key, size_t hash) {
+			if (slots.empty()) { return 0; }
+			size_t mask = slots.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask) {
+				Slot &slot = slots[i];
+				if (!slot.node) { return 0; }
+				if (slot.hash == hash && slot.node->value.first == key) { return &slot; }
+			}
+		}
+
+		Slot *LookupChars(const char *key, size_t len, size_t hash) {
+			if (slots.empty()) { return 0; }
+			size_t mask = slots.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask) {
+				Slot &slot = slots[i];
+				if (!slot.node) { return 0; }
+				if (slot.hash == hash && slot.node->value.first.size() == len
+						&& memcmp(slot.node->value.first.data(), key, len) == 0) {
+					return &slot;
+				}
+			}
+		}
+
+		Node *Insert(const value_type &v, size_t hash) {
+			// Keep the load factor at or below 3/4
+			if ((num_entries + 1) * 4 > slots.size() * 3) {
+				Rehash(slots.empty() ? 8 : slots.size() * 2);
+			}
+			Node *node = new Node(v, hash);
+			Place(node);
+			node->prev = head.prev;
+			node->next = &head;
+			head.prev->next = node;
+			head.prev = node;
+			++num_entries;
+			return node;
+		}
+
+		void Place(Node *node) {
+			size_t mask = slots.size() - 1;
+			size_t i = node->hash & mask;
+			while (slots[i].node) { i = (i + 1) & mask; }
+			slots[i].hash = node->hash;
+			slots[i].node = node;
+		}
+
+		void Rehash(size_t capacity) {
+			std::vector<Slot>(capacity).swap(slots);
+			for (Link *link = head.next; link != &head; link = link->next) {
+				Place(static_cast<Node*>(link));
+			}
+		}
+
+		void Erase(Slot *slot) {
+			Node *node = slot->node;
+			node->prev->next = node->next;
+			node->next->prev = node->prev;
+			delete node;
+			--num_entries;
+			// Backward shift deletion so that no tombstones are needed
+			size_t mask = slots.size() - 1;
+			size_t hole = slot - &slots[0];
+			for (size_t i = (hole + 1) & mask; slots[i].node; i = (i + 1) & mask) {
+				size_t ideal = slots[i].hash & mask;
+				// Move the entry if the hole is between its ideal slot and i
+				if (((i - ideal) & mask) >= ((i - hole) & mask)) {
+					slots[hole] = slots[i];
+					hole = i;
+				}
+			}
+			slots[hole] = Slot();
+		}
+
+		size_t num_entries;
+		std::vector<Slot> slots;
+		Link head;
+		H hasher;
+	};
+
+	/// Orders pointers to map entries by key.
+	template<typename T>
+	struct EntryKeyLess {
+		bool operator()(const T *lhs, const T *rhs) const { return lhs->first < rhs->first; }
+	};
+
+	/// Fill out with pointers to the entries of m ordered by key.
+	template<typename K, typename V, typename H>
+	void SortedEntries(const HashMap<K, V, H> &m,
+			std::vector<const typename HashMap<K, V, H>::value_type*> &out) {
+		out.clear();
+		out.reserve(m.size());
+		for (typename HashMap<K, V, H>::const_iterator i(m.begin()), e(m.end()); i != e; ++i) {
+			out.push_back(&*i);
+		}
+		std::sort(out.begin(), out.end(), EntryKeyLess<typename HashMap<K, V, H>::value_type>());
+	}
+
+	/// std::map is already ordered, provided so callers need not care
+	/// which implementation Variant::Map is.
+	template<typename K, typename V>
+	void SortedEntries(const std::map<K, V> &m,
+			std::vector<const typename std::map<K, V>::value_type*> &out) {
+		out.clear();
+		out.reserve(m.size());
+		for (typename std::map<K, V>::const_iterator i(m.begin()), e(m.end()); i != e; ++i) {
+			out.push_back(&*i);
+		}
+	}
+}
+
+#endif
@@ -149,6 +149,9 @@ namespace libvariant {
 	Parser CreateParser(shared_ptr<ParserInput> i, SerializeType type);
 	Parser CreateParserGuess(shared_ptr<ParserInput> i);
 	Parser JSONParser(shared_ptr<ParserInput> i);
+	/// The JSON parser built on the JSON_parser tokenizer that JSONParser
+	/// used to be, for comparison.
+	Parser LegacyJSONParser(shared_ptr<ParserInput> i);
 	Parser YAMLParser(shared_ptr<ParserInput> i);
 	Parser XMLPLISTParser(shared_ptr<ParserInput> i);
 	Parser BundleHdrParser(shared_ptr<ParserInput> i);
@@ -40,6 +40,11 @@ namespace libvariant {
 		// Tell the input that the parser is done with len bytes from the last
 		// GetPtr
 		virtual void Release(unsigned len) = 0;
+
+		// Whether the first GetPtr gives all of the data, and what it points
+		// to stays put until the input goes away, as for data in memory or
+		// a mapped file. A parser can then look over all of it first.
+		virtual bool InMemory() const;
 	};
 
 	class ParserStreamInput : public ParserInput {
@@ -62,6 +67,7 @@ namespace libvariant {
 		ParserMemoryInput(const void *ptr, unsigned len);
 		virtual const void *GetPtr(unsigned &len);
 		virtual void Release(unsigned len);
+		virtual bool InMemory() const;
 	protected:
 		const void *data_ptr;
 		unsigned data_len;
@@ -73,6 +79,7 @@ namespace libvariant {
 		ParserStringInput(const std::string &str);
 		virtual const void *GetPtr(unsigned &len);
 		virtual void Release(unsigned len);
+		virtual bool InMemory() const;
 	protected:
 		const std::string val;
 		unsigned offset;
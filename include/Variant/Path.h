@@ -23,7 +23,10 @@
 #pragma once
 #include <deque>
 #include <string>
+#include <vector>
 #include <Variant/Exceptions.h>
+#include <Variant/HashMap.h>
+#include <Variant/SharedPtr.h>
 namespace libvariant {
 
 	// A simple xpath like path functionality for Variant
@@ -65,9 +68,9 @@ namespace libvariant {
 	class PathElement {
 	public:
 		enum Type_t { INDEX, KEY };
-		PathElement(const std::string &k) : type(KEY), key(k) {}
-		PathElement(const char *k) : type(KEY), key(k) {}
-		PathElement(unsigned i) : type(INDEX), index(i) {}
+		PathElement(const std::string &k) : type(KEY), index(0), key(k), hash(HashMapHash<std::string>()(key)) {}
+		PathElement(const char *k) : type(KEY), index(0), key(k), hash(HashMapHash<std::string>()(key)) {}
+		PathElement(unsigned i) : type(INDEX), index(i), hash(0) {}
 
 		bool IsNumber() const { return type == INDEX; }
 		unsigned AsUnsigned() const {
@@ -79,21 +82,293 @@ namespace libvariant {
 			if (type != KEY) throw BadPathError("Variant path element is not a key");
 			return key;
 		}
+		/// The hash of the key as Variant::Map computes it
+		size_t KeyHash() const { return hash; }
 	private:
 		Type_t type;
 		unsigned index;
 		std::string key;
+		size_t hash;
 	};
 
 	typedef std::deque<PathElement> Path;
 
+	/**
+	 * A path that has been parsed once to be used many times. The elements
+	 * are kept contiguously and copies share them, so it is cheap to keep
+	 * CompiledPaths around and pass them by value.
+	 */
+	class CompiledPath {
+	public:
+		typedef const PathElement *const_iterator;
+
+		/// The empty path, which is the identity
+		CompiledPath() {}
+		explicit CompiledPath(const std::string &path);
+		explicit CompiledPath(const char *path);
+		explicit CompiledPath(const Path &path);
+
+		const_iterator begin() const { return elements ? &(*elements)[0] : 0; }
+		const_iterator end() const { return elements ? begin() + elements->size() : 0; }
+		unsigned size() const { return elements ? elements->size() : 0; }
+		bool empty() const { return size() == 0; }
+		const PathElement &operator[](unsigned i) const { return (*elements)[i]; }
+
+		bool operator==(const CompiledPath &o) const;
+		bool operator!=(const CompiledPath &o) const { return !(*this == o); }
+	private:
+		void Init(const Path &path);
+		shared_ptr<const std::vector<PathElement> > elements;
+	};
+
 	//!
 	// Parse the path string into path tokens.
 	void ParsePath(Path &parsed_path, const std::string &path);
 	Path ParsePath(const std::string &path);
 
+	/**
+	 * Return the compiled path for path. Recently used paths are kept in a
+	 * cache so that looking up the same paths again and again by string
+	 * does not parse them each time.
+	 */
+	CompiledPath CompilePath(const std::string &path);
+
+	/// An element of a StaticPath, a key is the length characters at
+	/// offset in the characters of the path.
+	struct StaticPathElement {
+		bool is_key;
+		unsigned index;
+		unsigned offset;
+		unsigned length;
+		size_t hash;
+	};
+
+	/**
+	 * Iterates over the elements of a StaticPath. It also acts as the
+	 * element it is at, with the same accessors as PathElement.
+	 */
+	class StaticPathIterator {
+	public:
+		StaticPathIterator(const StaticPathElement *e, const char *c) : elem(e), chars(c) {}
+
+		bool IsNumber() const { return !elem->is_key; }
+		unsigned AsUnsigned() const {
+			if (elem->is_key) throw BadPathError("Variant path element is not a number");
+			return elem->index;
+		}
+		bool IsString() const { return elem->is_key; }
+		std::string AsString() const {
+			if (!elem->is_key) throw BadPathError("Variant path element is not a key");
+			return std::string(KeyData(), elem->length);
+		}
+		const char *KeyData() const { return chars + elem->offset; }
+		unsigned KeyLength() const { return elem->length; }
+		size_t KeyHash() const { return elem->hash; }
+
+		const StaticPathIterator &operator*() const { return *this; }
+		const StaticPathIterator *operator->() const { return this; }
+		StaticPathIterator &operator++() { ++elem; return *this; }
+		StaticPathIterator operator+(unsigned n) const { return StaticPathIterator(elem + n, chars); }
+		bool operator==(const StaticPathIterator &o) const { return elem == o.elem; }
+		bool operator!=(const StaticPathIterator &o) const { return elem != o.elem; }
+	private:
+		const StaticPathElement *elem;
+		const char *chars;
+	};
+
+	/// What the Variant path functions take of a StaticPath.
+	struct StaticPathView {
+		StaticPathIterator begin() const { return StaticPathIterator(elements, chars); }
+		StaticPathIterator end() const { return StaticPathIterator(elements + size, chars); }
+
+		const StaticPathElement *elements;
+		unsigned size;
+		const char *chars;
+	};
+
 	//! Take the set of path tokens and turn it into a path string
 	std::string PathString(const Path &path);
+	std::string PathString(const CompiledPath &path);
+	std::string PathString(const StaticPathView &path);
+
+#if __cplusplus >= 201402L
+	namespace Internal {
+
+		constexpr bool IsPathSpace(char c) {
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+		}
+
+		/// The index in the len characters at s, which must be a number.
+		constexpr unsigned ParseStaticPathIndex(const char *s, unsigned len) {
+			unsigned i = 0;
+			while (i < len && IsPathSpace(s[i])) { ++i; }
+			if (i == len) { throw BadPathError("Error parsing Variant path: an index is not a number."); }
+			unsigned index = 0;
+			for (; i < len; ++i) {
+				if (s[i] < '0' || s[i] > '9') {
+					throw BadPathError("Error parsing Variant path: an index is not a number.");
+				}
+				unsigned digit = s[i] - '0';
+				if (index > (~0u - digit) / 10) {
+					throw BadPathError("Error parsing Variant path: an index is too large.");
+				}
+				index = index * 10 + digit;
+			}
+			return index;
+		}
+
+		/// Add the key in chars from offset to length to elements, unless
+		/// only counting.
+		constexpr void AddStaticPathKey(bool store, StaticPathElement *elements, unsigned n,
+				const char *chars, unsigned offset, unsigned length)
+		{
+			if (!store) { return; }
+			// The same hash as HashMapHash<std::string>
+			size_t hash = size_t(2166136261u);
+			for (unsigned i = offset; i < offset + length; ++i) {
+				hash = (hash ^ (unsigned char)chars[i]) * size_t(16777619u);
+			}
+			elements[n] = StaticPathElement{true, 0, offset, length, hash};
+		}
+
+		/**
+		 * ParsePath at compile time. The len characters of path are parsed
+		 * into elements and the characters of the keys into chars, or only
+		 * counted unless store. Returns the number of elements.
+		 *
+		 * It is stricter than ParsePath, an unclosed index or a trailing
+		 * escape are errors.
+		 */
+		constexpr unsigned ParseStaticPath(const char *path, unsigned len, bool store,
+				StaticPathElement *elements, char *chars)
+		{
+			enum { NONE, KEY, INDEX } state = NONE;
+			bool escape = false;
+			unsigned n = 0, num_chars = 0, frag = 0, index_start = 0;
+			for (unsigned i = 0; i < len; ++i) {
+				char c = path[i];
+				if (escape) {
+					if (store) { chars[num_chars] = c; }
+					++num_chars;
+					escape = false;
+				} else if (state == INDEX) {
+					if (c == ']') {
+						unsigned index = ParseStaticPathIndex(path + index_start, i - index_start);
+						if (store) { elements[n] = StaticPathElement{false, index, 0, 0, 0}; }
+						++n;
+						state = NONE;
+					}
+				} else if (state == KEY) {
+					switch (c) {
+					case '/':
+						AddStaticPathKey(store, elements, n++, chars, frag, num_chars - frag);
+						frag = num_chars;
+						break;
+					case '[':
+						AddStaticPathKey(store, elements, n++, chars, frag, num_chars - frag);
+						frag = num_chars;
+						state = INDEX;
+						index_start = i + 1;
+						break;
+					case '\\':
+						escape = true;
+						break;
+					default:
+						if (store) { chars[num_chars] = c; }
+						++num_chars;
+						break;
+					}
+				} else {
+					switch (c) {
+					case '/':
+						state = KEY;
+						break;
+					case '[':
+						state = INDEX;
+						index_start = i + 1;
+						break;
+					default:
+						state = KEY;
+						if (store) { chars[num_chars] = c; }
+						++num_chars;
+						break;
+					}
+				}
+			}
+			if (escape) { throw BadPathError("Error parsing Variant path: it ends in an escape."); }
+			if (state == INDEX) { throw BadPathError("Error parsing Variant path: an index is not closed."); }
+			if (num_chars > frag) { AddStaticPathKey(store, elements, n++, chars, frag, num_chars - frag); }
+			return n;
+		}
+	}
+
+	/**
+	 * A path parsed at compile time, see VARIANT_PATH. N is the number of
+	 * elements and L the length of the path string, which bounds the
+	 * characters of the keys.
+	 */
+	template<unsigned N, unsigned L>
+	class StaticPath {
+	public:
+		constexpr StaticPath(const char (&path)[L]) : elements(), chars() {
+			// Assigned one by one, gcc does not take the value
+			// initialization as initializing them in a constant expression
+			for (unsigned i = 0; i <= N; ++i) { elements[i] = StaticPathElement{false, 0, 0, 0, 0}; }
+			for (unsigned i = 0; i < L; ++i) { chars[i] = 0; }
+			Internal::ParseStaticPath(path, L - 1, true, elements, chars);
+		}
+
+		constexpr unsigned size() const { return N; }
+
+		operator StaticPathView() const {
+			StaticPathView view = { elements, N, chars };
+			return view;
+		}
+	private:
+		// One more so that the empty path has an array
+		StaticPathElement elements[N + 1];
+		char chars[L];
+	};
+
+	namespace Internal {
+		template<unsigned L>
+		constexpr unsigned StaticPathSize(const char (&path)[L]) {
+			return ParseStaticPath(path, L - 1, false, 0, 0);
+		}
+	}
+
+/**
+ * Parse the string literal path at compile time, a malformed path is a
+ * compile error. Declare the result constexpr to be sure nothing is left
+ * to do at run time:
+ *
+ *   static constexpr auto kValue = VARIANT_PATH("/config/items[2]/value");
+ *   v.GetPath(kValue);
+ */
+#define VARIANT_PATH(path) \
+	(::libvariant::StaticPath< ::libvariant::Internal::StaticPathSize(path), sizeof(path)>(path))
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+	namespace Internal {
+		/// A string literal as a template argument
+		template<unsigned L>
+		struct PathLiteral {
+			constexpr PathLiteral(const char (&s)[L]) : chars() {
+				for (unsigned i = 0; i < L; ++i) { chars[i] = s[i]; }
+			}
+			char chars[L];
+		};
+	}
+
+	namespace PathLiterals {
+		/// "/a/b[2]/c"_vpath is the same as VARIANT_PATH("/a/b[2]/c")
+		template<Internal::PathLiteral path>
+		constexpr auto operator""_vpath() {
+			return StaticPath<Internal::StaticPathSize(path.chars), sizeof(path.chars)>(path.chars);
+		}
+	}
+#endif
+#endif
 
 }
 #endif
@@ -0,0 +1,135 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Parsing with a handler chosen at compile time.
+ */
+#ifndef VARIANT_SAX_H
+#define VARIANT_SAX_H
+#pragma once
+#include <Variant/Parser.h>
+#include <Variant/ParserInput.h>
+#include <Variant/Blob.h>
+#include <Variant/SharedPtr.h>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace libvariant {
+
+	/**
+	 * The calls ParseJSON makes, derive from it and hide the ones of
+	 * interest. ParseJSON is a template over the handler so these are not
+	 * virtual and the calls inline. There are no anchors or tags, which
+	 * JSON does not have. A map calls Key before each value. The
+	 * characters passed to Key and String are only good for the call.
+	 *
+	 * A handler may throw to stop the parse, the exception is passed on
+	 * by ParseJSON.
+	 */
+	struct SAXHandler {
+		void Null() {}
+		void Bool(bool b) {}
+		void Int(intmax_t i) {}
+		void Unsigned(uintmax_t u) {}
+		void Float(double f) {}
+		void String(const char *s, size_t len) {}
+		void Blob(BlobPtr b) {}
+		void BeginList() {}
+		void EndList() {}
+		void BeginMap() {}
+		void Key(const char *s, size_t len) {}
+		void EndMap() {}
+	};
+
+	namespace Internal {
+
+		enum SAXEvent_t {
+			SAX_NULL,
+			SAX_BOOL,
+			SAX_INT,
+			SAX_UNSIGNED,
+			SAX_FLOAT,
+			SAX_STRING,
+			SAX_KEY,
+			SAX_BLOB,
+			SAX_BEGIN_LIST,
+			SAX_END_LIST,
+			SAX_BEGIN_MAP,
+			SAX_END_MAP
+		};
+
+		/// One event from the tokenizer
+		struct SAXEvent {
+			SAXEvent_t type;
+			union {
+				bool b;
+				intmax_t i;
+				uintmax_t u;
+				double f;
+				struct {
+					const char *str;
+					size_t len;
+				} s;
+			};
+			BlobPtr blob;
+		};
+
+		/// Hands an event to the handler it was made for
+		typedef void (*SAXSink)(void *handler, const SAXEvent &event);
+
+		template<typename Handler>
+		void SAXDispatch(void *ctx, const SAXEvent &event) {
+			Handler &handler = *static_cast<Handler*>(ctx);
+			switch (event.type) {
+			case SAX_NULL: handler.Null(); break;
+			case SAX_BOOL: handler.Bool(event.b); break;
+			case SAX_INT: handler.Int(event.i); break;
+			case SAX_UNSIGNED: handler.Unsigned(event.u); break;
+			case SAX_FLOAT: handler.Float(event.f); break;
+			case SAX_STRING: handler.String(event.s.str, event.s.len); break;
+			case SAX_KEY: handler.Key(event.s.str, event.s.len); break;
+			case SAX_BLOB: handler.Blob(event.blob); break;
+			case SAX_BEGIN_LIST: handler.BeginList(); break;
+			case SAX_END_LIST: handler.EndList(); break;
+			case SAX_BEGIN_MAP: handler.BeginMap(); break;
+			case SAX_END_MAP: handler.EndMap(); break;
+			}
+		}
+
+		/// Run the JSON in input through the tokenizer handing each event
+		/// to sink, throw on a syntax error.
+		void ParseJSONEvents(shared_ptr<ParserInput> input, SAXSink sink, void *handler);
+	}
+
+	/**
+	 * Parse the JSON document in input calling handler for each part of it,
+	 * see SAXHandler. Unlike a Parser there is no action stack and nothing
+	 * virtual between the tokenizer and the handler. Throws on a syntax
+	 * error.
+	 */
+	template<typename Handler>
+	void ParseJSON(shared_ptr<ParserInput> input, Handler &handler) {
+		Internal::ParseJSONEvents(input, &Internal::SAXDispatch<Handler>, &handler);
+	}
+
+	template<typename Handler>
+	void ParseJSON(const std::string &str, Handler &handler) {
+		ParseJSON(CreateParserInput(str), handler);
+	}
+}
+#endif
@@ -25,10 +25,13 @@
 #ifndef VARIANT_VARIANT_H
 #define VARIANT_VARIANT_H
 #pragma once
+#include <Variant/Config.h>
+#include <Variant/Arena.h>
 #include <Variant/Blob.h>
 #include <Variant/SharedPtr.h>
 #include <Variant/Exceptions.h>
 #include <Variant/VariantInternal.h>
+#include <Variant/HashMap.h>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -36,9 +39,35 @@
 #include <map>
 #include <iterator>
 #include <complex>
+#include <string.h>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace libvariant {
 
+	/**
+	 * The characters of a map key, what the key functions of Variant take.
+	 * It is made from a std::string or a C string without copying, so
+	 * looking up v["key"] makes no std::string. It only points at the
+	 * characters, which must outlive it.
+	 */
+	class KeyRef {
+	public:
+		KeyRef(const char *s) : chars(s), len(strlen(s)) {}
+		KeyRef(const char *s, size_t l) : chars(s), len(l) {}
+		KeyRef(const std::string &s) : chars(s.data()), len(s.size()) {}
+#if __cplusplus >= 201703L
+		KeyRef(std::string_view s) : chars(s.data()), len(s.size()) {}
+#endif
+		const char *data() const { return chars; }
+		size_t size() const { return len; }
+		std::string str() const { return std::string(chars, len); }
+	private:
+		const char *chars;
+		size_t len;
+	};
+
 	/** \brief The Variant class.
 	 * This is a variant type inspired by types from several different
 	 * scripting languages.
@@ -89,13 +118,20 @@ namespace libvariant {
 		typedef VariantRefImpl<Variant> VariantRef;
 
 		typedef std::vector<Variant> List;
+#ifdef LIBVARIANT_HASH_MAP
+		typedef HashMap<std::string, Variant> Map;
+#else
 		typedef std::map<std::string, Variant> Map;
+#endif
 
 		typedef Map::iterator MapIterator;
 		typedef Map::const_iterator ConstMapIterator;
 		typedef List::iterator ListIterator;
 		typedef List::const_iterator ConstListIterator;
 
+		/// Callback for ForEach, key is null for list elements.
+		typedef void (*ForEachFunc)(const std::string *key, const Variant &value, void *ctx);
+
 		Variant() {}
 		Variant(VariantDefines::Type_t type) { Assign(type); }
 		Variant(bool v) { Assign(v); }
@@ -115,8 +151,13 @@ namespace libvariant {
 		Variant(const char *v) { Assign(v); }
 		Variant(const Variant &v) { Assign(v); }
 		Variant(const VariantRefImpl<Variant> &v) { Assign(v); }
+#if __cplusplus >= 201103L
+		/// Takes the value of v, leaving it null.
+		Variant(Variant &&v) noexcept { Assign(static_cast<Variant&&>(v)); }
+#endif
 
-		/// Construct a list from a std::vector.
+		/// Construct a list from a std::vector. Vectors of double, intmax_t
+		/// and uintmax_t make a packed list, see PackedData.
 		template<typename T>
 		Variant(const std::vector<T> &v) { Assign(v); }
 
@@ -127,6 +168,9 @@ namespace libvariant {
 		~Variant();
 
 		Variant &operator=(const Variant &o) { Assign(o); return *this; }
+#if __cplusplus >= 201103L
+		Variant &operator=(Variant &&o) { Assign(static_cast<Variant&&>(o)); return *this; }
+#endif
 
 		Variant &operator=(VariantDefines::Type_t v) { Assign(v); return *this; }
 		Variant &operator=(bool v) { Assign(v); return *this; }
@@ -149,14 +193,27 @@ namespace libvariant {
 
 		// Type query functions
 
-		Type_t GetType() const; ///< Return the type of this Variant
+		/// Return the type of this Variant. Only references and proxies
+		/// have to look up what they refer to.
+		Type_t GetType() const {
+			if (kind < Internal::RefKind) { return Internal::KindType(kind); }
+			return GetReferredType();
+		}
 
 		bool IsNull() const { return NullType == GetType(); }
 		bool IsBool() const { return BoolType == GetType(); }
-		bool IsTrue() const { return (BoolType == GetType()) && AsBool(); }
-		bool IsFalse() const { return (BoolType == GetType()) && !AsBool(); }
-		bool IsNumber() const
-	   	{ return IntegerType == GetType() || UnsignedType == GetType() || FloatType == GetType(); }
+		bool IsTrue() const {
+			if (kind == Internal::BoolKind) { return b; }
+			return (BoolType == GetType()) && AsBool();
+		}
+		bool IsFalse() const {
+			if (kind == Internal::BoolKind) { return !b; }
+			return (BoolType == GetType()) && !AsBool();
+		}
+		bool IsNumber() const {
+			Type_t type = GetType();
+			return IntegerType == type || UnsignedType == type || FloatType == type;
+		}
 		bool IsInt() const { return IntegerType == GetType(); }
 		bool IsUnsigned() const { return UnsignedType == GetType(); }
 		bool IsFloat() const { return FloatType == GetType(); }
@@ -182,6 +239,18 @@ namespace libvariant {
 		template<typename T>
 		T As() const;
 
+		/// \brief Versions of the As functions that never throw. Convert the
+		/// value into out and return true, or return false and leave out
+		/// alone if it does not convert, for example a string that is not a
+		/// number, a container or a proxy for a path that does not exist.
+		bool TryAsBool(bool &out) const;
+		bool TryAsLongDouble(long double &out) const;
+		bool TryAsUnsigned(uintmax_t &out) const;
+		bool TryAsInt(intmax_t &out) const;
+		bool TryAsString(std::string &out) const;
+		template<typename T>
+		bool TryAs(T &out) const;
+
 		/// \brief If the type is string, list, map or blob returns its size,
 		/// otherwise throws an exception
 		unsigned Size() const;
@@ -194,6 +263,12 @@ namespace libvariant {
 		/// set type to NullType
 		void Clear();
 
+		/// \brief If the type is list call func on each element in order, if
+		/// map call func on each entry in key order, if null do nothing,
+		/// otherwise throw.  Unlike AsList and AsMap this never has to build
+		/// the std containers for small lists and maps.
+		void ForEach(ForEachFunc func, void *ctx) const;
+
 		// List specific accessors
 		List &AsList();
 		const List &AsList() const;
@@ -211,6 +286,12 @@ namespace libvariant {
 		Variant Get(unsigned i) const; //< Return the element at index i or throw
 		Variant Get(unsigned i, Variant def) const; //< Return the element at index i or return def
 		Variant &Set(unsigned i, Variant v); //< Set the element at index i to v
+		/// \brief Return the element at index i or null if there is none or
+		/// this is not a list. Unlike At no reference is made, the pointer
+		/// is good until the list is changed. The non const version unshares
+		/// a copied list as writes through the pointer would.
+		Variant *Find(unsigned i);
+		const Variant *Find(unsigned i) const;
 		/// \brief Only valid when of type ListType Returns *this, so you can
 		/// do Variant().Append(v1).Append(v2)...
 		Variant &Append(Variant value);
@@ -226,6 +307,23 @@ namespace libvariant {
 		/// throw if not a list
 		void Erase(unsigned i);
 
+		/// \brief If this is a packed list return its elements, otherwise
+		/// return 0. A list of more than a few numbers that all have the same
+		/// type can be held packed, as a plain array of intmax_t, uintmax_t or
+		/// double for IntegerType, UnsignedType and FloatType. The parsers
+		/// produce packed lists and so does assigning a std::vector of one of
+		/// those. It still behaves like any other list, the elements are
+		/// turned into Variants when a reference to one is needed. The
+		/// pointer is valid until the list is written to.
+		const void *PackedData(Type_t &type, unsigned &size) const;
+
+		/// \brief Sort the list in the order of Compare. Returns *this.
+		/// Elements that compare equal, like 1 and 1.0, may change places.
+		Variant &Sort();
+		/// \brief Sort the list keeping equal elements in the order they
+		/// were in. Returns *this.
+		Variant &StableSort();
+
 		// Map specific accessors
 		Map &AsMap();
 		const Map &AsMap() const;
@@ -237,25 +335,32 @@ namespace libvariant {
 		{ return AsMap().end(); }
 		ConstMapIterator MapEnd() const ///< Equivalent to AsMap().end()
 		{ return AsMap().end(); }
-		VariantRef At(const std::string &s); // Return a proxy/reference to the element at key s
-		VariantRef At(const std::string &s, Variant def); //< Sets to def if doesn't exist and return a reference to it
-		const Variant &At(const std::string &s) const;
+		VariantRef At(KeyRef s); // Return a proxy/reference to the element at key s
+		VariantRef At(KeyRef s, Variant def); //< Sets to def if doesn't exist and return a reference to it
+		const Variant &At(KeyRef s) const;
 
 		/// \brief If s in *this: return this->At(s); else throw;
-		Variant Get(const std::string &s) const;
+		Variant Get(KeyRef s) const;
 		/// \brief If s in *this: return this->At(s); else return def
 		///  Only works if type is map
-		Variant Get(const std::string &s, Variant def) const;
+		Variant Get(KeyRef s, Variant def) const;
 
 		/// \brief Set the key s to v
 		// returns *this
-		Variant &Set(const std::string &s, Variant v);
+		Variant &Set(KeyRef s, Variant v);
+
+		/// \brief Return the value at key s or null if there is none or
+		/// this is not a map. Unlike At no reference is made, the pointer
+		/// is good until the map is changed. The non const version unshares
+		/// a copied map as writes through the pointer would.
+		Variant *Find(KeyRef s);
+		const Variant *Find(KeyRef s) const;
 
 		/// \brief If map return true if s is a key in the map, if list then convert
 		/// s to an unsigned and the above Contains, otherwise throw
-		bool Contains(const std::string &s) const;
+		bool Contains(KeyRef s) const;
 		/// \brief Erase a key in a map, throws if type is not MapType
-		void Erase(const std::string &key);
+		void Erase(KeyRef key);
 
 		VariantRef operator[](int i) { return At(i); }
 		const Variant &operator[](int i) const { return At(i); }
@@ -263,65 +368,110 @@ namespace libvariant {
 		VariantRef operator[](unsigned i) { return At(i); }
 		const Variant &operator[](unsigned i) const { return At(i); }
 
-		VariantRef operator[](const std::string &s) { return At(s); }
-		const Variant &operator[](const std::string &s) const { return At(s); }
+		VariantRef operator[](KeyRef s) { return At(s); }
+		const Variant &operator[](KeyRef s) const { return At(s); }
 
 		// Path related accessors
 		// These are the same as the non-path functions but take a path instead.
+		// The string versions use CompilePath, use a CompiledPath directly
+		// for a path that is looked up often. A VARIANT_PATH literal is
+		// parsed at compile time and converts to a StaticPathView, only the
+		// functions that do not keep the path take one.
 		VariantRef AtPath(const Path &path);
-		VariantRef AtPath(const std::string &path) { return AtPath(ParsePath(path)); }
+		VariantRef AtPath(const CompiledPath &path);
+		VariantRef AtPath(const std::string &path) { return AtPath(CompilePath(path)); }
 		VariantRef AtPath(const Path &path, Variant def);
-		VariantRef AtPath(const std::string &path, Variant def) { return AtPath(ParsePath(path), def); }
+		VariantRef AtPath(const CompiledPath &path, Variant def);
+		VariantRef AtPath(const std::string &path, Variant def) { return AtPath(CompilePath(path), def); }
 		const Variant &AtPath(const Path &path) const;
-		const Variant &AtPath(const std::string &path) const { return AtPath(ParsePath(path)); }
+		const Variant &AtPath(const CompiledPath &path) const;
+		const Variant &AtPath(const std::string &path) const { return AtPath(CompilePath(path)); }
+		const Variant &AtPath(const StaticPathView &path) const;
 
 		/// \brief Like Variant::Get but it takes a path instead.
 		Variant GetPath(const Path &path) const;
-		Variant GetPath(const std::string &path) const { return GetPath(ParsePath(path)); }
+		Variant GetPath(const CompiledPath &path) const;
+		Variant GetPath(const std::string &path) const { return GetPath(CompilePath(path)); }
+		Variant GetPath(const StaticPathView &path) const;
 		/// \brief Like Variant::Get but it takes a path instead.  The path is
 		/// very like xpath, /key[index]/key/key. See Variant/Path.h
 		Variant GetPath(const Path &path, Variant def) const;
-		Variant GetPath(const std::string &path, Variant def) const { return GetPath(ParsePath(path), def); }
+		Variant GetPath(const CompiledPath &path, Variant def) const;
+		Variant GetPath(const std::string &path, Variant def) const { return GetPath(CompilePath(path), def); }
+		Variant GetPath(const StaticPathView &path, Variant def) const;
 
 		/// \brief Set the value at the path, creating elements if they do not
 		/// exist.  throws if an intermediate path element exists but is not a
 		/// map or list.  returns *this
 		Variant &SetPath(const Path &path, Variant val);
-		Variant &SetPath(const std::string &path, Variant val) { return SetPath(ParsePath(path), val); }
+		Variant &SetPath(const CompiledPath &path, Variant val);
+		Variant &SetPath(const std::string &path, Variant val) { return SetPath(CompilePath(path), val); }
+		Variant &SetPath(const StaticPathView &path, Variant val);
 
 		/// \brief Erase a value at a path, if remove_empty is false only erase the very end
 		/// otherwise erase empty lists and maps in the path. returns *this
 		Variant &ErasePath(const Path &path, bool remove_empty=false);
+		Variant &ErasePath(const CompiledPath &path, bool remove_empty=false);
 		Variant &ErasePath(const std::string &path, bool remove_empty=false)
-	   	{ return ErasePath(ParsePath(path), remove_empty); }
+	   	{ return ErasePath(CompilePath(path), remove_empty); }
+		Variant &ErasePath(const StaticPathView &path, bool remove_empty=false);
 
 		/// \brief Tester functions for paths, returns true if path is valid and exists.
 		bool HasPath(const Path &path) const;
-		bool HasPath(const std::string &path) const { return HasPath(ParsePath(path)); }
+		bool HasPath(const CompiledPath &path) const;
+		bool HasPath(const std::string &path) const { return HasPath(CompilePath(path)); }
+		bool HasPath(const StaticPathView &path) const;
+
+		/// \brief Return the value at path or null if there is none, like
+		/// Find for a path.
+		const Variant *FindPath(const Path &path) const;
+		const Variant *FindPath(const CompiledPath &path) const;
+		const Variant *FindPath(const std::string &path) const { return FindPath(CompilePath(path)); }
+		const Variant *FindPath(const StaticPathView &path) const;
+
+		/// \brief Look the value up once and TryAs it into out. Returns false
+		/// if there is no such value or it does not convert, never throws.
+		template<typename T>
+		bool TryGet(KeyRef s, T &out) const;
+		template<typename T>
+		bool TryGet(unsigned i, T &out) const;
+		template<typename T>
+		bool TryGetPath(const Path &path, T &out) const;
+		template<typename T>
+		bool TryGetPath(const CompiledPath &path, T &out) const;
+		template<typename T>
+		bool TryGetPath(const std::string &path, T &out) const
+		{ return TryGetPath(CompilePath(path), out); }
+		template<typename T>
+		bool TryGetPath(const StaticPathView &path, T &out) const;
 
 		/// \brief Just like Variant::Get except a reference to the value to
 		/// set is passed in and Variant does the casting.
 		template<typename T>
-		void GetInto(T &lvalue, const std::string &s) const;
+		void GetInto(T &lvalue, KeyRef s) const;
 
 		/// \brief An into version of GetPath
 		template<typename T>
 		void GetPathInto(T &lvalue, const Path &path) const;
 		template<typename T>
+		void GetPathInto(T &lvalue, const CompiledPath &path) const;
+		template<typename T>
 		void GetPathInto(T &lvalue, const std::string &path) const
-		{ GetPathInto(lvalue, ParsePath(path)); }
+		{ GetPathInto(lvalue, CompilePath(path)); }
 
 		/// \brief Just like Variant::Get except a reference to the value to
 		/// set is passed in and Variant does the casting.
 		template<typename T>
-		void GetInto(T &lvalue, const std::string &s, const T &def) const;
+		void GetInto(T &lvalue, KeyRef s, const T &def) const;
 
 		/// \brief An into version of GetPath
 		template<typename T>
 		void GetPathInto(T &lvalue, const Path &path, const T &def) const;
 		template<typename T>
+		void GetPathInto(T &lvalue, const CompiledPath &path, const T &def) const;
+		template<typename T>
 		void GetPathInto(T &lvalue, const std::string &path, const T &def) const
-		{ GetPathInto(lvalue, ParsePath(path), def); }
+		{ GetPathInto(lvalue, CompilePath(path), def); }
 
 		/// \brief This type and other type must be MapType.
 		///  for (k, v) in other: this[k] = v
@@ -331,10 +481,12 @@ namespace libvariant {
 		///  Returns -1 if we are less than other
 		///  0 if we are equal
 		///  1 if we are greater than
-		///  This function always returns 1 if Comparable returns false
-		///  This compare is not completely consistent
-		///  i.e. it can be such that two Variants are
-		///  both < and > (ex map and list types)
+		///  This is a total order over all values. Numbers compare by value
+		///  whatever their type, with NaN equal to NaN and less than every
+		///  other number. Lists compare element by element and maps by
+		///  their (key, value) pairs in key order, like the std containers.
+		///  Values that are not Comparable are ordered by type: null, bool,
+		///  number, string, list, map, blob.
 		int Compare(const Variant &other) const;
 
 		/// \brief Return true if this and other are comparable. Two types are
@@ -342,6 +494,15 @@ namespace libvariant {
 		/// number types.
 		bool Comparable(const Variant &other) const;
 
+		/// \brief Return a hash of the value and everything under it.
+		/// Variants that compare equal hash the same, including numbers of
+		/// different types with the same value. The hash of a container is
+		/// cached while it is part of a Snapshot and not written to, unless
+		/// something in it could be written to around it: a live VariantRef
+		/// to an element, or any pointer or reference to one from Find,
+		/// AsList or AsMap.
+		size_t Hash() const;
+
 		void Incr();
 		void Decr();
 		void Add(const Variant &o);
@@ -367,6 +528,26 @@ namespace libvariant {
 
 		VariantRef Ref(); //< Return a new VariantRef to this Variant
 		Variant Copy() const; //< Return a copy of this Variant
+		/**
+		 * Return a Variant that shares this one's storage with copy on write
+		 * semantics. Containers in the tree are only cloned when they are
+		 * written to while shared, so neither side sees the other's changes.
+		 * This also applies to Variants already sharing the tree and to plain
+		 * assignment from either tree afterwards.
+		 * References and iterators into the tree obtained before the snapshot
+		 * must not be used to modify it.
+		 */
+		Variant Snapshot() const;
+		/**
+		 * Turn interning of map keys on or off for the whole process. While
+		 * on, keys added to small maps, including by the parsers, are stored
+		 * once in a process wide table that is never freed, so documents
+		 * sharing key names share the key storage and equal keys compare by
+		 * pointer. Only enable it when the set of key names is bounded.
+		 * Set it before other threads start using Variants.
+		 */
+		static void InternKeys(bool enable);
+		static bool InternKeys();
 		Variant &Resolve(); //< Return *this or return the Variant this is a reference to
 		const Variant &Resolve() const;
 		/// Return *this or Variant referenced to if exists, otherwise create it with def.
@@ -376,6 +557,12 @@ namespace libvariant {
 
 		/// Make this equal other.
 		void Assign(const Variant &other);
+#if __cplusplus >= 201103L
+		/// Make this equal other by taking its value, which leaves other
+		/// null. If other is a reference or is referred to it is shared as
+		/// with Assign(const Variant &) instead.
+		void Assign(Variant &&other);
+#endif
 
 		void Assign(VariantDefines::Type_t type);
 		void Assign(bool v);
@@ -390,12 +577,23 @@ namespace libvariant {
 		void Assign(BlobPtr b);
 		void Assign(const std::string &v);
 		void Assign(const char *v);
+		/// Make this the string of the len characters at v, which need not
+		/// end in a nul.
+		void Assign(const char *v, size_t len);
+		/// Make this the string of the len characters at v without copying
+		/// them. owner keeps them there, unchanged, for as long as this or
+		/// any Variant it is assigned to holds them. Copying the string
+		/// copies the characters.
+		void Assign(const char *v, size_t len, ConstBlobPtr owner);
 
 		template<typename T>
 		void Assign(const std::vector<T> &v) {
 			Assign(VariantDefines::ListType);
 			AsList().assign(v.begin(), v.end());
 		}
+		void Assign(const std::vector<double> &v);
+		void Assign(const std::vector<intmax_t> &v);
+		void Assign(const std::vector<uintmax_t> &v);
 
 		template<typename T>
 		void Assign(const std::map<std::string, T> &v) {
@@ -406,11 +604,17 @@ namespace libvariant {
 	protected:
 		Variant(const RefTag &, const Variant &o);
 		Variant(const RefTag &, Variant &o, Path::const_iterator b, Path::const_iterator e);
+		Variant(const RefTag &, Variant &o, CompiledPath::const_iterator b, CompiledPath::const_iterator e);
 		/// Reassing this reference, only available through the VariantRef interface.
 		/// The regular Assign makes what this is refering to equal the new value, this
 		/// function makes this reference refer to the new value.
 		void ReassignRef(const Variant &o);
+		/// GetType for a reference or proxy
+		Type_t GetReferredType() const;
 		friend class Internal::VTable;
+		/// Looks at the node directly, see Variant/Visit.h
+		template<typename Visitor>
+		friend void Visit(Visitor &visitor, const Variant &v);
 	};
 
 	typedef VariantRefImpl<Variant> VariantRef;
@@ -422,6 +626,11 @@ namespace libvariant {
 	inline bool operator<=(const Variant &lhs, const Variant &rhs) { return lhs.Compare(rhs) <= 0; }
 	inline bool operator>=(const Variant &lhs, const Variant &rhs) { return lhs.Compare(rhs) >= 0; }
 
+	/// Hash functor for using Variants as keys in hash containers.
+	struct VariantHash {
+		size_t operator()(const Variant &v) const { return v.Hash(); }
+	};
+
 	inline Variant operator+(const Variant &lhs, const Variant &rhs) {
 		Variant ret = lhs;
 		return ret += rhs;
@@ -477,6 +686,45 @@ namespace libvariant {
 	template<> inline long double VariantCaster<long double>::Cast(const Variant &v) { return v.AsLongDouble(); }
 	template<> inline std::string VariantCaster<std::string>::Cast(const Variant &v) { return v.AsString(); }
 
+	/// Copies the elements of a packed list straight into a std::vector of
+	/// numbers, returns false if v is not packed.
+	template<typename T>
+	struct PackedCaster {
+		static bool Cast(const Variant &v, std::vector<T> &out) { return false; }
+	};
+
+	template<typename T>
+	inline bool CastPacked(const Variant &v, std::vector<T> &out) {
+		Variant::Type_t type;
+		unsigned size;
+		const void *data = v.PackedData(type, size);
+		if (!data) { return false; }
+		switch (type) {
+		case Variant::IntegerType:
+			out.assign(static_cast<const intmax_t*>(data), static_cast<const intmax_t*>(data) + size);
+			break;
+		case Variant::UnsignedType:
+			out.assign(static_cast<const uintmax_t*>(data), static_cast<const uintmax_t*>(data) + size);
+			break;
+		default:
+			out.assign(static_cast<const double*>(data), static_cast<const double*>(data) + size);
+			break;
+		}
+		return true;
+	}
+
+	template<> inline bool PackedCaster<short>::Cast(const Variant &v, std::vector<short> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<unsigned short>::Cast(const Variant &v, std::vector<unsigned short> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<int>::Cast(const Variant &v, std::vector<int> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<unsigned>::Cast(const Variant &v, std::vector<unsigned> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<long>::Cast(const Variant &v, std::vector<long> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<unsigned long>::Cast(const Variant &v, std::vector<unsigned long> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<long long>::Cast(const Variant &v, std::vector<long long> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<unsigned long long>::Cast(const Variant &v, std::vector<unsigned long long> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<float>::Cast(const Variant &v, std::vector<float> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<double>::Cast(const Variant &v, std::vector<double> &out) { return CastPacked(v, out); }
+	template<> inline bool PackedCaster<long double>::Cast(const Variant &v, std::vector<long double> &out) { return CastPacked(v, out); }
+
 	// Allow things like variant_cast< std::vector<int> >(v) to work
 	template<typename T>
 	struct VariantCaster< std::vector<T> > {
@@ -486,6 +734,7 @@ namespace libvariant {
 	template<typename T>
 	inline std::vector<T> VariantCaster< std::vector<T> >::Cast(const Variant &v) {
 		std::vector<T> ret;
+		if (PackedCaster<T>::Cast(v, ret)) { return ret; }
 		for (Variant::ConstListIterator i(v.ListBegin()), e(v.ListEnd()); i != e; ++i) {
 			ret.push_back( variant_cast<T>( *i ) );
 		}
@@ -539,13 +788,129 @@ namespace libvariant {
 		throw UnableToConvertError(v.GetType(), "std::complex<T>");
 	}
 
+	/// The non throwing counterpart of VariantCaster used by TryAs. The
+	/// default converts with variant_cast and turns an exception into false.
+	template<typename T>
+	struct VariantTryCaster {
+		static bool Cast(const Variant &v, T &out) {
+			try {
+				out = variant_cast<T>(v);
+				return true;
+			} catch (const std::exception &) {
+				return false;
+			}
+		}
+	};
+
+	template<typename T>
+	inline bool variant_try_cast(const Variant &v, T &out) { return VariantTryCaster<T>::Cast(v, out); }
+
+	/// Casts by way of one of the TryAs functions
+	template<typename T, typename From, bool (Variant::*Fn)(From &) const>
+	struct VariantTryCastVia {
+		static bool Cast(const Variant &v, T &out) {
+			From val;
+			if (!(v.*Fn)(val)) { return false; }
+			out = (T)val;
+			return true;
+		}
+	};
+
+	template<> struct VariantTryCaster<bool> : VariantTryCastVia<bool, bool, &Variant::TryAsBool> {};
+	template<> struct VariantTryCaster<char> : VariantTryCastVia<char, intmax_t, &Variant::TryAsInt> {};
+	template<> struct VariantTryCaster<unsigned char> : VariantTryCastVia<unsigned char, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<signed char> : VariantTryCastVia<signed char, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<short> : VariantTryCastVia<short, intmax_t, &Variant::TryAsInt> {};
+	template<> struct VariantTryCaster<unsigned short> : VariantTryCastVia<unsigned short, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<int> : VariantTryCastVia<int, intmax_t, &Variant::TryAsInt> {};
+	template<> struct VariantTryCaster<unsigned> : VariantTryCastVia<unsigned, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<long> : VariantTryCastVia<long, intmax_t, &Variant::TryAsInt> {};
+	template<> struct VariantTryCaster<unsigned long> : VariantTryCastVia<unsigned long, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<long long> : VariantTryCastVia<long long, intmax_t, &Variant::TryAsInt> {};
+	template<> struct VariantTryCaster<unsigned long long> : VariantTryCastVia<unsigned long long, uintmax_t, &Variant::TryAsUnsigned> {};
+	template<> struct VariantTryCaster<float> : VariantTryCastVia<float, long double, &Variant::TryAsLongDouble> {};
+	template<> struct VariantTryCaster<double> : VariantTryCastVia<double, long double, &Variant::TryAsLongDouble> {};
+	template<> struct VariantTryCaster<long double> : VariantTryCastVia<long double, long double, &Variant::TryAsLongDouble> {};
+
+	template<> struct VariantTryCaster<std::string> {
+		static bool Cast(const Variant &v, std::string &out) { return v.TryAsString(out); }
+	};
+
+	template<> struct VariantTryCaster<Variant> {
+		static bool Cast(const Variant &v, Variant &out) { out = v; return true; }
+	};
+
+	template<typename T>
+	struct VariantTryCaster< std::vector<T> > {
+		static bool Cast(const Variant &v, std::vector<T> &out) {
+			if (!v.IsList()) { return false; }
+			std::vector<T> ret;
+			if (!PackedCaster<T>::Cast(v, ret)) {
+				ret.reserve(v.Size());
+				for (Variant::ConstListIterator i(v.ListBegin()), e(v.ListEnd()); i != e; ++i) {
+					T val;
+					if (!variant_try_cast(*i, val)) { return false; }
+					ret.push_back(val);
+				}
+			}
+			out.swap(ret);
+			return true;
+		}
+	};
+
+	template<typename T>
+	struct VariantTryCaster< std::map<std::string, T> > {
+		static bool Cast(const Variant &v, std::map<std::string, T> &out) {
+			if (!v.IsMap()) { return false; }
+			std::map<std::string, T> ret;
+			for (Variant::ConstMapIterator i(v.MapBegin()), e(v.MapEnd()); i != e; ++i) {
+				if (!variant_try_cast(i->second, ret[i->first])) { return false; }
+			}
+			out.swap(ret);
+			return true;
+		}
+	};
+
 	/// @}
 
 	template<typename T>
 	T Variant::As() const { return variant_cast<T>(*this); }
 
 	template<typename T>
-	void Variant::GetInto(T &lvalue, const std::string &s) const {
+	bool Variant::TryAs(T &out) const { return variant_try_cast(*this, out); }
+
+	template<typename T>
+	bool Variant::TryGet(KeyRef s, T &out) const {
+		const Variant *v = Find(s);
+		return v && v->TryAs(out);
+	}
+
+	template<typename T>
+	bool Variant::TryGet(unsigned i, T &out) const {
+		const Variant *v = Find(i);
+		return v && v->TryAs(out);
+	}
+
+	template<typename T>
+	bool Variant::TryGetPath(const Path &p, T &out) const {
+		const Variant *v = FindPath(p);
+		return v && v->TryAs(out);
+	}
+
+	template<typename T>
+	bool Variant::TryGetPath(const CompiledPath &p, T &out) const {
+		const Variant *v = FindPath(p);
+		return v && v->TryAs(out);
+	}
+
+	template<typename T>
+	bool Variant::TryGetPath(const StaticPathView &p, T &out) const {
+		const Variant *v = FindPath(p);
+		return v && v->TryAs(out);
+	}
+
+	template<typename T>
+	void Variant::GetInto(T &lvalue, KeyRef s) const {
 		lvalue = variant_cast<T>(Get(s));
 	}
 
@@ -555,9 +920,17 @@ namespace libvariant {
 	}
 
 	template<typename T>
-	void Variant::GetInto(T &lvalue, const std::string &s, const T &def) const {
-		if (Contains(s)) { lvalue = variant_cast<T>(Get(s)); }
-		else { lvalue = def; }
+	void Variant::GetPathInto(T &lvalue, const CompiledPath &p) const {
+		lvalue = variant_cast<T>(GetPath(p));
+	}
+
+	template<typename T>
+	void Variant::GetInto(T &lvalue, KeyRef s, const T &def) const {
+		const Variant *v = Find(s);
+		if (v) { lvalue = variant_cast<T>(*v); }
+		else if (Exists()) { lvalue = def; }
+		// A proxy for a path that does not exist throws like Get
+		else { GetInto(lvalue, s); }
 	}
 
 	template<typename T>
@@ -565,9 +938,17 @@ namespace libvariant {
 		lvalue = variant_cast<T>(GetPath(p, def));
 	}
 
+	template<typename T>
+	void Variant::GetPathInto(T &lvalue, const CompiledPath &p, const T &def) const {
+		lvalue = variant_cast<T>(GetPath(p, def));
+	}
+
 	class Parser;
 	/// \brief Takes a parser and produces a Variant from it.
 	Variant ParseVariant(Parser &p);
+	/// \brief Same as ParseVariant(p) but with the storage of the result
+	/// allocated from arena.
+	Variant ParseVariant(Parser &p, const Arena &arena);
 
 	class Emitter;
 	/// Takes a Variant and Emitter and emits the Variant.
@@ -630,20 +1011,20 @@ namespace libvariant {
 	// a streambuf* (usually acquired through iostream.rdbuf()).
 	
 	/// \brief Serialize a Variant to a string using format type.
-	std::string Serialize(Variant v, SerializeType type, Variant params = Variant::NullType);
+	std::string Serialize(const Variant &v, SerializeType type, const Variant &params = Variant::NullType);
 	/// \brief Serialize a Variant to a file using format type.
-	void Serialize(const std::string &filename, Variant v, SerializeType type,
-		   	Variant params = Variant::NullType);
+	void Serialize(const std::string &filename, const Variant &v, SerializeType type,
+		   	const Variant &params = Variant::NullType);
 	/// \brief Serialize a Variant to a FILE pointer using format type.
-	void Serialize(FILE *f, Variant v, SerializeType type,
-		   	Variant params = Variant::NullType);
+	void Serialize(FILE *f, const Variant &v, SerializeType type,
+		   	const Variant &params = Variant::NullType);
 	/// \brief Serialize a Variant to a streambuf* (iostrem.rdbuf()) using format type.
-	void Serialize(std::streambuf *sb, Variant v, SerializeType type,
-			Variant params = Variant::NullType);
+	void Serialize(std::streambuf *sb, const Variant &v, SerializeType type,
+			const Variant &params = Variant::NullType);
 	/// \brief Serialize a Variant to a memory buffer of length len, using format type
 	//and return how many bytes produced.
-	unsigned Serialize(void *ptr, unsigned len, Variant v, SerializeType type,
-		   	Variant params = Variant::NullType);
+	unsigned Serialize(void *ptr, unsigned len, const Variant &v, SerializeType type,
+		   	const Variant &params = Variant::NullType);
 
 	// The basic deserializing functions
 
@@ -660,6 +1041,19 @@ namespace libvariant {
 	/// \brief Deserialize from a streambuf to a Variant in format type
 	Variant DeserializeFile(std::streambuf *sb, SerializeType type);
 
+	/// \defgroup deserialize_arena Deserialize into an arena
+	/// Same as the functions above, but the storage of the result is
+	/// allocated from arena.  For documents that are parsed and thrown away
+	/// at a high rate.
+	/// @{
+	Variant Deserialize(const std::string &str, SerializeType type, const Arena &arena);
+	Variant Deserialize(const char *str, SerializeType type, const Arena &arena);
+	Variant Deserialize(const void *ptr, unsigned len, SerializeType type, const Arena &arena);
+	Variant DeserializeFile(const char *filename, SerializeType type, const Arena &arena);
+	Variant DeserializeFile(FILE *f, SerializeType type, const Arena &arena);
+	Variant DeserializeFile(std::streambuf *sb, SerializeType type, const Arena &arena);
+	/// @}
+
 	/// \defgroup deserialize_guess Guess format
 	/// These functions attempt to guess the type of the input.  The guessing
 	/// function only looks at the first non-whitespace character to make the
@@ -689,26 +1083,48 @@ namespace libvariant {
 	LoadAllIterator DeserializeAllFile(std::streambuf *sb, SerializeType type);
 	/// @}
 
+	/// \defgroup deserialize_lazy Deserialize JSON lazily
+	/// Only the top level of the JSON document is parsed. The lists and
+	/// maps below it are parsed one level at a time when they are first
+	/// looked into, and the ones never looked into are serialized back to
+	/// JSON by copying their original text. The input is copied, errors in a
+	/// nested list or map are only thrown when it is parsed.
+	/// @{
+	Variant DeserializeLazy(const std::string &str);
+	Variant DeserializeLazy(const char *str);
+	Variant DeserializeLazy(const void *ptr, unsigned len);
+	/// @}
+
+	/// \defgroup deserialize_borrowed Deserialize without copying strings
+	/// The strings in the result that needed no unescaping point into
+	/// text instead of holding a copy, and keep it alive until the last of
+	/// them goes. text must not change meanwhile. Only parsers that hand
+	/// over strings where they are in the input can do this, which is the
+	/// JSON one, the others copy as Deserialize does.
+	/// @{
+	Variant DeserializeBorrowed(ConstBlobPtr text, SerializeType type);
+	/// @}
+
 
 	// Serialize and Deserializing JSON
 	//
-	inline std::string SerializeJSON(Variant v, bool pretty=false) {
+	inline std::string SerializeJSON(const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		return Serialize(v, SERIALIZE_JSON, param);
 	}
-	inline void SerializeJSON(const std::string &filename, Variant v, bool pretty=false) {
+	inline void SerializeJSON(const std::string &filename, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(filename, v, SERIALIZE_JSON, param);
 	}
-	inline void SerializeJSON(FILE *f, Variant v, bool pretty=false) {
+	inline void SerializeJSON(FILE *f, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(f, v, SERIALIZE_JSON, param);
 	}
-	inline void SerializeJSON(std::streambuf *sb, Variant v, bool pretty=false) {
+	inline void SerializeJSON(std::streambuf *sb, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(sb, v, SERIALIZE_JSON, param);
 	}
-	inline unsigned SerializeJSON(void *ptr, unsigned len, Variant v, bool pretty=false) {
+	inline unsigned SerializeJSON(void *ptr, unsigned len, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		return Serialize(ptr, len, v, SERIALIZE_JSON, param);
 	}
@@ -718,14 +1134,15 @@ namespace libvariant {
 	inline Variant DeserializeJSONFile(const char *filename) { return DeserializeFile(filename, SERIALIZE_JSON); }
 	inline Variant DeserializeJSONFile(FILE *f) { return DeserializeFile(f, SERIALIZE_JSON); }
 	inline Variant DeserializeJSONFile(std::streambuf *sb) { return DeserializeFile(sb, SERIALIZE_JSON); }
+	inline Variant DeserializeJSONBorrowed(ConstBlobPtr text) { return DeserializeBorrowed(text, SERIALIZE_JSON); }
 
 	//Serialize and Deserialize YAML
 	//
-	inline std::string SerializeYAML(Variant v) { return Serialize(v, SERIALIZE_YAML); }
-	inline void SerializeYAML(const std::string &filename, Variant v) { Serialize(filename, v, SERIALIZE_YAML); }
-	inline void SerializeYAML(FILE *f, Variant v) { Serialize(f, v, SERIALIZE_YAML); }
-	inline void SerializeYAML(std::streambuf *sb, Variant v) { Serialize(sb, v, SERIALIZE_YAML); }
-	inline unsigned SerializeYAML(void *ptr, unsigned len, Variant v) { return Serialize(ptr, len, v, SERIALIZE_YAML); }
+	inline std::string SerializeYAML(const Variant &v) { return Serialize(v, SERIALIZE_YAML); }
+	inline void SerializeYAML(const std::string &filename, const Variant &v) { Serialize(filename, v, SERIALIZE_YAML); }
+	inline void SerializeYAML(FILE *f, const Variant &v) { Serialize(f, v, SERIALIZE_YAML); }
+	inline void SerializeYAML(std::streambuf *sb, const Variant &v) { Serialize(sb, v, SERIALIZE_YAML); }
+	inline unsigned SerializeYAML(void *ptr, unsigned len, const Variant &v) { return Serialize(ptr, len, v, SERIALIZE_YAML); }
 
 	inline Variant DeserializeYAML(const std::string &str) { return Deserialize(str, SERIALIZE_YAML); }
 	inline Variant DeserializeYAML(const char *str) { return Deserialize(str, SERIALIZE_YAML); }
@@ -743,23 +1160,23 @@ namespace libvariant {
 
 	//Serialize and Deserialize XML plist
 	//
-	inline std::string SerializeXMLPLIST(Variant v, bool pretty=false) {
+	inline std::string SerializeXMLPLIST(const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		return Serialize(v, SERIALIZE_XMLPLIST, param);
 	}
-	inline void SerializeXMLPLIST(const std::string &filename, Variant v, bool pretty=false) {
+	inline void SerializeXMLPLIST(const std::string &filename, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(filename, v, SERIALIZE_XMLPLIST, param);
 	}
-	inline void SerializeXMLPLIST(FILE *f, Variant v, bool pretty=false) {
+	inline void SerializeXMLPLIST(FILE *f, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(f, v, SERIALIZE_XMLPLIST, param);
 	}
-	inline void SerializeXMLPLIST(std::streambuf *sb, Variant v, bool pretty=false) {
+	inline void SerializeXMLPLIST(std::streambuf *sb, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		Serialize(sb, v, SERIALIZE_XMLPLIST, param);
 	}
-	inline unsigned SerializeXMLPLIST(void *ptr, unsigned len, Variant v, bool pretty=false) {
+	inline unsigned SerializeXMLPLIST(void *ptr, unsigned len, const Variant &v, bool pretty=false) {
 		Variant param = Variant::MapType; param["pretty"] = pretty;
 		return Serialize(ptr, len, v, SERIALIZE_XMLPLIST, param);
 	}
@@ -779,23 +1196,23 @@ namespace libvariant {
 	// Note that these do not add a null byte to the end.
 	// Use SerializeBundle for that.
 
-	inline std::string SerializeBundleHdr(Variant v) {
+	inline std::string SerializeBundleHdr(const Variant &v) {
 		Variant param = Variant::MapType;
 		return Serialize(v, SERIALIZE_BUNDLEHDR, param);
 	}
-	inline void SerializeBundleHdr(const std::string &filename, Variant v) {
+	inline void SerializeBundleHdr(const std::string &filename, const Variant &v) {
 		Variant param = Variant::MapType;
 		Serialize(filename, v, SERIALIZE_BUNDLEHDR, param);
 	}
-	inline void SerializeBundleHdr(FILE *f, Variant v) {
+	inline void SerializeBundleHdr(FILE *f, const Variant &v) {
 		Variant param = Variant::MapType;
 		Serialize(f, v, SERIALIZE_BUNDLEHDR, param);
 	}
-	inline void SerializeBundleHdr(std::streambuf *sb, Variant v) {
+	inline void SerializeBundleHdr(std::streambuf *sb, const Variant &v) {
 		Variant param = Variant::MapType;
 		Serialize(sb, v, SERIALIZE_BUNDLEHDR, param);
 	}
-	inline unsigned SerializeBundleHdr(void *ptr, unsigned len, Variant v) {
+	inline unsigned SerializeBundleHdr(void *ptr, unsigned len, const Variant &v) {
 		Variant param = Variant::MapType;
 		return Serialize(ptr, len, v, SERIALIZE_BUNDLEHDR, param);
 	}
@@ -20,7 +20,6 @@
  */
 #ifndef VARIANT_BASE_H
 #define VARIANT_BASE_H
-#include <Variant/SharedPtr.h>
 #include <Variant/Blob.h>
 #include <Variant/Path.h>
 #include <Variant/VariantDefines.h>
@@ -47,6 +46,10 @@ namespace libvariant {
 			: Base(RefTag(), o, path.begin(), path.end()) {}
 		VariantRefImpl(Variant &o, Path::const_iterator b, Path::const_iterator e)
 			: Base(RefTag(), o, b, e) {}
+		VariantRefImpl(Variant &o, const CompiledPath &path)
+			: Base(RefTag(), o, path.begin(), path.end()) {}
+		VariantRefImpl(Variant &o, CompiledPath::const_iterator b, CompiledPath::const_iterator e)
+			: Base(RefTag(), o, b, e) {}
 		VariantRefImpl(const VariantRefImpl<Base> &o)
 			: Base(RefTag(), o) {}
 
@@ -64,28 +67,85 @@ namespace libvariant {
 
 		class VTable;
 		struct Storage;
-		struct MapStorage;
-		struct ListStorage;
-		struct ProxyStorage;
 		struct RefData;
+		struct InternedString;
+
+		/// Which VTable implements a node. Only the null kind has a fixed
+		/// value, the rest are private to the implementation.
+		enum Kind_t {
+			NullKind = 0, // Explicitly defined as 0
+			BoolKind,
+			IntegerKind,
+			UnsignedKind,
+			FloatKind,
+			LongFloatKind,
+			StringKind,
+			ShortStringKind,
+			InternedStringKind,
+			ListKind,
+			MapKind,
+			BlobKind,
+			RefKind,
+			ProxyKind,
+			NumKinds
+		};
+
+		/// The type of the value in a node of kind, which must be less than
+		/// RefKind. References and proxies have the type of what they
+		/// refer to.
+		inline VariantDefines::Type_t KindType(unsigned char kind) {
+			static const unsigned char types[RefKind] = {
+				VariantDefines::NullType,
+				VariantDefines::BoolType,
+				VariantDefines::IntegerType,
+				VariantDefines::UnsignedType,
+				VariantDefines::FloatType,
+				VariantDefines::FloatType,
+				VariantDefines::StringType,
+				VariantDefines::StringType,
+				VariantDefines::StringType,
+				VariantDefines::ListType,
+				VariantDefines::MapType,
+				VariantDefines::BlobType
+			};
+			return VariantDefines::Type_t(types[kind]);
+		}
+
+		enum Flags_t {
+			/// Set on a RefKind node that holds the value it was given
+			/// before being referenced, it invalidates the references on
+			/// destruction.
+			HasRefData = 0x01,
+			/// Set on the value kept in a RefData
+			InBox = 0x02
+		};
 
+		/**
+		 * The representation of a single Variant node. A kind tag selects the
+		 * VTable and the payload is either an inline scalar or a pointer to
+		 * reference counted storage. This keeps a node at 16 bytes on 64 bit
+		 * platforms.
+		 *
+		 * Short strings are kept in the node itself, their characters start
+		 * at small_chars and run on into the payload union. Interned strings
+		 * point at an entry of the process wide intern table.
+		 */
 		struct Data {
-			Data();
-			const VTable *vtable;
+			Data() : kind(NullKind), flags(0), small_len(0), i(0) {}
+			unsigned char kind;
+			unsigned char flags;
+			unsigned char small_len;
+			char small_chars[sizeof(uintmax_t) - 3];
 			union {
 				bool b;
-				long double f;
+				double f;
 				intmax_t i;
 				uintmax_t u;
-				std::string *s;
-				MapStorage *m;
-				ListStorage *l;
-				BlobPtr *blob;
-				Data *ref;
-				ProxyStorage *proxy;
+				Storage *storage;
+				RefData *ref;
+				const InternedString *interned;
+				char small_tail[sizeof(uintmax_t)];
 			};
-			shared_ptr<RefData> ref_data;
-			shared_ptr<Storage> storage;
 		};
 	}
 
@@ -0,0 +1,190 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Traversal of a Variant with a visitor chosen at compile time.
+ */
+#ifndef VARIANT_VISIT_H
+#define VARIANT_VISIT_H
+#pragma once
+#include <Variant/Variant.h>
+#include <vector>
+#include <stddef.h>
+
+namespace libvariant {
+
+	/**
+	 * The calls Visit makes, derive from it and hide the ones of interest.
+	 * Visit is a template over the visitor so these are not virtual and
+	 * the calls inline.
+	 *
+	 * BeginList and BeginMap get the container itself and return false to
+	 * skip its elements and the matching End call, for example to handle
+	 * it some other way. A map calls Key before each value.
+	 *
+	 * The visitor must not change the Variant it visits.
+	 */
+	struct VariantVisitor {
+		void Null() {}
+		void Bool(bool b) {}
+		void Int(intmax_t i) {}
+		void Unsigned(uintmax_t u) {}
+		void Float(double f) {}
+		void String(const char *s, size_t len) {}
+		void Blob(ConstBlobPtr b) {}
+		bool BeginList(const Variant &list) { return true; }
+		void EndList() {}
+		bool BeginMap(const Variant &map) { return true; }
+		void Key(const char *s, size_t len) {}
+		void EndMap() {}
+	};
+
+	namespace Internal {
+
+		/// The elements of a list or map laid out for Visit.
+		struct VisitContainer {
+			VisitContainer() : items(0), keys(0), size(0), map(0), packed(0), packed_type(VariantDefines::NullType) {}
+			/// The list elements or small map values
+			const Variant *items;
+			/// The keys of a small map
+			const Variant *keys;
+			unsigned size;
+			/// Set instead for a map too big to be small
+			const Variant::Map *map;
+			/// Set instead for a packed list
+			const void *packed;
+			VariantDefines::Type_t packed_type;
+		};
+
+		/// What a reference or proxy refers to
+		const Data *VisitResolve(const Data *that);
+		/// The characters of a string that is not kept in the node
+		const char *VisitString(const Data *that, size_t &len);
+		void VisitList(const Data *that, VisitContainer &container);
+		void VisitMap(const Data *that, VisitContainer &container);
+
+		inline const char *VisitChars(const Data *that, size_t &len) {
+			if (that->kind == ShortStringKind) {
+				// The characters run on from small_chars into the payload
+				len = that->small_len;
+				return reinterpret_cast<const char*>(that) + offsetof(Data, small_chars);
+			}
+			return VisitString(that, len);
+		}
+
+		template<typename Visitor>
+		void VisitPacked(Visitor &visitor, const VisitContainer &container) {
+			switch (container.packed_type) {
+			case VariantDefines::IntegerType:
+				for (unsigned i = 0; i < container.size; ++i)
+				{ visitor.Int(static_cast<const intmax_t*>(container.packed)[i]); }
+				break;
+			case VariantDefines::UnsignedType:
+				for (unsigned i = 0; i < container.size; ++i)
+				{ visitor.Unsigned(static_cast<const uintmax_t*>(container.packed)[i]); }
+				break;
+			default:
+				for (unsigned i = 0; i < container.size; ++i)
+				{ visitor.Float(static_cast<const double*>(container.packed)[i]); }
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Walk v depth first calling visitor for each node. The scalars kept in
+	 * the node itself are handed over without a virtual call, see
+	 * VariantVisitor for the calls.
+	 */
+	template<typename Visitor>
+	void Visit(Visitor &visitor, const Variant &v) {
+		const Internal::Data *that = &static_cast<const Internal::Data&>(v);
+		while (true) {
+			switch (that->kind) {
+			case Internal::NullKind:
+				visitor.Null();
+				return;
+			case Internal::BoolKind:
+				visitor.Bool(that->b);
+				return;
+			case Internal::IntegerKind:
+				visitor.Int(that->i);
+				return;
+			case Internal::UnsignedKind:
+				visitor.Unsigned(that->u);
+				return;
+			case Internal::FloatKind:
+				visitor.Float(that->f);
+				return;
+			case Internal::ShortStringKind:
+			case Internal::StringKind:
+			case Internal::InternedStringKind:
+				{
+					size_t len;
+					const char *s = Internal::VisitChars(that, len);
+					visitor.String(s, len);
+				}
+				return;
+			case Internal::ListKind:
+				if (visitor.BeginList(v)) {
+					Internal::VisitContainer list;
+					Internal::VisitList(that, list);
+					if (list.packed) {
+						Internal::VisitPacked(visitor, list);
+					} else {
+						for (unsigned i = 0; i < list.size; ++i) { Visit(visitor, list.items[i]); }
+					}
+					visitor.EndList();
+				}
+				return;
+			case Internal::MapKind:
+				if (visitor.BeginMap(v)) {
+					Internal::VisitContainer map;
+					Internal::VisitMap(that, map);
+					if (map.map) {
+						std::vector<const Variant::Map::value_type*> entries;
+						SortedEntries(*map.map, entries);
+						for (unsigned i = 0; i < entries.size(); ++i) {
+							visitor.Key(entries[i]->first.data(), entries[i]->first.size());
+							Visit(visitor, entries[i]->second);
+						}
+					} else {
+						for (unsigned i = 0; i < map.size; ++i) {
+							size_t len;
+							const char *s = Internal::VisitChars(&static_cast<const Internal::Data&>(map.keys[i]), len);
+							visitor.Key(s, len);
+							Visit(visitor, map.items[i]);
+						}
+					}
+					visitor.EndMap();
+				}
+				return;
+			case Internal::LongFloatKind:
+				visitor.Float(v.AsDouble());
+				return;
+			case Internal::BlobKind:
+				visitor.Blob(v.AsBlob());
+				return;
+			default:
+				// A reference or proxy, visit what it refers to
+				that = Internal::VisitResolve(that);
+				break;
+			}
+		}
+	}
+}
+#endif
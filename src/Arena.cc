@@ -0,0 +1,90 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief 
+ */
+#include <Variant/Arena.h>
+#include "ArenaImpl.h"
+#include <new>
+
+#if defined(__GXX_EXPERIMENTAL_CXX0X) || __cplusplus >= 201103L
+#define VARIANT_THREAD_LOCAL thread_local
+#else
+#define VARIANT_THREAD_LOCAL __thread
+#endif
+
+namespace libvariant {
+	namespace Internal {
+
+		static VARIANT_THREAD_LOCAL ArenaImpl *current_arena = 0;
+
+		ArenaImpl *CurrentArena() { return current_arena; }
+
+		// Keeps the allocations aligned for any type
+		static const size_t arena_align = 16;
+
+		ArenaImpl::ArenaImpl(size_t block_size_)
+			: refcount(1), block_size(block_size_), cur(0), end(0), last(0), bytes_used(0)
+		{}
+
+		ArenaImpl::~ArenaImpl() {
+			for (unsigned i = 0; i < blocks.size(); ++i) { ::operator delete(blocks[i]); }
+		}
+
+		void *ArenaImpl::Allocate(size_t len) {
+			size_t need = (len + arena_align - 1) & ~(arena_align - 1);
+			if (size_t(end - cur) < need) {
+				size_t size = need > block_size ? need : block_size;
+				char *block = static_cast<char*>(::operator new(size));
+				blocks.push_back(block);
+				cur = block;
+				end = block + size;
+			}
+			char *p = cur;
+			cur += need;
+			bytes_used += need;
+			last = p;
+			return p;
+		}
+	}
+
+	Arena::Arena(size_t block_size) : impl(new Internal::ArenaImpl(block_size)) {}
+
+	Arena::Arena(const Arena &o) : impl(o.impl) { impl->Retain(); }
+
+	Arena::~Arena() { impl->Release(); }
+
+	Arena &Arena::operator=(const Arena &o) {
+		o.impl->Retain();
+		impl->Release();
+		impl = o.impl;
+		return *this;
+	}
+
+	size_t Arena::BytesUsed() const { return impl->BytesUsed(); }
+
+	ArenaScope::ArenaScope(const Arena &a) : arena(a.impl), previous(Internal::current_arena) {
+		arena->Retain();
+		Internal::current_arena = arena;
+	}
+
+	ArenaScope::~ArenaScope() {
+		Internal::current_arena = previous;
+		arena->Release();
+	}
+}
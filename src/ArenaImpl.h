@@ -0,0 +1,68 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief The bump allocator behind Arena.
+ */
+#ifndef VARIANT_ARENAIMPL_H
+#define VARIANT_ARENAIMPL_H
+#pragma once
+#include "Atomic.h"
+#include <vector>
+#include <stddef.h>
+
+namespace libvariant {
+	namespace Internal {
+
+		/**
+		 * Hands out memory from large blocks, which are all freed together
+		 * once the last handle is released. Nothing is kept per allocation.
+		 */
+		class ArenaImpl {
+		public:
+			explicit ArenaImpl(size_t block_size);
+			~ArenaImpl();
+
+			/// Return len bytes aligned for any type.
+			void *Allocate(size_t len);
+
+			/// Return if p is the most recent allocation.
+			bool IsLast(void *p) const { return p == last; }
+
+			size_t BytesUsed() const { return bytes_used; }
+
+			void Retain() { refcount.Increment(); }
+			void Release() { if (refcount.Decrement() == 0) { delete this; } }
+
+		private:
+			ArenaImpl(const ArenaImpl &);
+			ArenaImpl &operator=(const ArenaImpl &);
+
+			AtomicCount refcount;
+			size_t block_size;
+			char *cur;
+			char *end;
+			void *last;
+			size_t bytes_used;
+			std::vector<char*> blocks;
+		};
+
+		/// Return the arena storage is allocated from on this thread or null.
+		ArenaImpl *CurrentArena();
+	}
+}
+#endif
@@ -778,8 +778,9 @@ namespace libvariant {
 		o.GetInto(mutually_exclusive, "mutually exclusive", mutually_exclusive);
 		o.GetInto(advanced, "advanced", false);
 		if (advanced) { impl->have_advanced = true; }
-		if (o.Contains("members") && o["members"].IsList()) {
-			for (Variant::ListIterator i(o["members"].ListBegin()), e(o["members"].ListEnd());
+		const Variant *members = o.Find("members");
+		if (members && members->IsList()) {
+			for (Variant::ConstListIterator i(members->ListBegin()), e(members->ListEnd());
 					i != e; ++i)
 			{
 				Add(impl->At(i->AsString()));
@@ -976,8 +977,9 @@ namespace libvariant {
 				}
 				if (o.action == ARGACTION_COUNT) { o.result = 0u; }
 				// Handle environment variables
-				if (o.opt.Contains("env")) {
-					const char *env = getenv(o.opt["env"].AsString().c_str());
+				const Variant *envname = o.opt.Find("env");
+				if (envname) {
+					const char *env = getenv(envname->AsString().c_str());
 					if (env) { o.HandleOption(env); }
 				}
 			}
@@ -1180,26 +1182,28 @@ namespace libvariant {
 
 	void ArgParseImpl::MergeDescription(Variant desc) {
 		if (!desc.IsMap()) { return; }
-		if (desc.Contains("options") && desc["options"].IsMap()) {
-			Variant opts = desc["options"];
-			for (Variant::MapIterator i(opts.MapBegin()), e(opts.MapEnd());
+		const Variant *opts = desc.Find("options");
+		if (opts && opts->IsMap()) {
+			for (Variant::ConstMapIterator i(opts->MapBegin()), e(opts->MapEnd());
 					i != e; ++i)
 			{
 				Variant o = i->second;
 				std::string keypath = i->first;
 				int shortOpt = 0;
-				if (o.Contains("shortOption")) {
-					shortOpt = o.Get("shortOption").AsString()[0];
+				const Variant *shortOption = o.Find("shortOption");
+				if (shortOption) {
+					shortOpt = shortOption->AsString()[0];
 				}
-				std::string longOpt = o.Get("longOption", "").AsString();
-				std::string helptxt = o.Get("description", "").AsString();
-				ArgParseAction action = ArgParseActionFromStr(o.Get("action", "store").AsString());
-				AddOption(keypath, shortOpt, longOpt, helptxt, action)->Init(o);
+				std::string longOpt, helptxt, action = "store";
+				o.GetInto(longOpt, "longOption", longOpt);
+				o.GetInto(helptxt, "description", helptxt);
+				o.GetInto(action, "action", action);
+				AddOption(keypath, shortOpt, longOpt, helptxt, ArgParseActionFromStr(action))->Init(o);
 			}
 		}
-		if (desc.Contains("groups") && desc["groups"].IsMap()) {
-			Variant grps = desc["groups"];
-			for (Variant::MapIterator i(grps.MapBegin()), e(grps.MapEnd());
+		const Variant *grps = desc.Find("groups");
+		if (grps && grps->IsMap()) {
+			for (Variant::ConstMapIterator i(grps->MapBegin()), e(grps->MapEnd());
 					i != e; ++i)
 			{
 				Variant g = i->second;
@@ -1207,17 +1211,18 @@ namespace libvariant {
 				GetGroup(name)->Init(g);
 			}
 		}
-		if (desc.Contains("arguments") && desc["arguments"].IsList()) {
-			Variant args = desc["arguments"];
-			for (Variant::ListIterator i(args.ListBegin()), e(args.ListEnd());
+		const Variant *args = desc.Find("arguments");
+		if (args && args->IsList()) {
+			for (Variant::ConstListIterator i(args->ListBegin()), e(args->ListEnd());
 					i != e; ++i)
 			{
 				Variant o = *i;
-				if (!o.Contains("keypath")) { continue; }
-				std::string keypath = o.Get("keypath").AsString();
-				std::string helptxt = o.Get("description", "").AsString();
-				ArgParseAction action = ArgParseActionFromStr(o.Get("action", "store").AsString());
-				AddArgument(keypath, helptxt, action)->Init(o);
+				const Variant *path = o.Find("keypath");
+				if (!path) { continue; }
+				std::string keypath = path->AsString(), helptxt, action = "store";
+				o.GetInto(helptxt, "description", helptxt);
+				o.GetInto(action, "action", action);
+				AddArgument(keypath, helptxt, ArgParseActionFromStr(action))->Init(o);
 			}
 		}
 	}
@@ -1393,59 +1398,68 @@ namespace libvariant {
 
 		switch (val.GetType()) {
 		case Variant::StringType:
-			if (opt.Contains("minLength") && val.Size() < opt["minLength"]) {
-				std::ostringstream oss;
-				oss << "Error parsing arguments\n" << OptName(this) << " is too short: " << val.Size()
-					<< " chars, minimum " << opt["minLength"].AsUnsigned();
-				throw std::runtime_error(oss.str());
-			}
-			if (opt.Contains("maxLength") && val.Size() > opt["maxLength"]) {
-				std::ostringstream oss;
-				oss << "Error parsing arguments\n" << OptName(this) << " is too long: " << val.Size()
-					<< " chars, maximum " << opt["maxLength"].AsUnsigned();
-				throw std::runtime_error(oss.str());
-			}
-			if (opt.Contains("pattern")) {
-				std::string pat = opt["pattern"].AsString();
-				regex_t reg;
-				memset(&reg, 0, sizeof(regex_t));
-				int err;
-				if ((err = regcomp(&reg, pat.c_str(), REG_EXTENDED | REG_NOSUB))) {
-					std::vector<char> buffer(8192);
-					regerror(err, &reg, &buffer[0], buffer.size());
+			{
+				const Variant *length = opt.Find("minLength");
+				if (length && val.Size() < length->AsUnsigned()) {
 					std::ostringstream oss;
-					oss << "Error parsing arguments\n";
-					oss << "Failed to compile pattern regex \"" << pat << "\" with error: "
-						<< &buffer[0];
+					oss << "Error parsing arguments\n" << OptName(this) << " is too short: " << val.Size()
+						<< " chars, minimum " << length->AsUnsigned();
 					throw std::runtime_error(oss.str());
 				}
-				if (regexec(&reg, val.AsString().c_str(), 0, 0, 0) != 0) {
-					regfree(&reg);
+				length = opt.Find("maxLength");
+				if (length && val.Size() > length->AsUnsigned()) {
 					std::ostringstream oss;
-					oss << "Error parsing arguments\n";
-					oss << OptName(this) << " failed to match pattern \""
-						<< pat << "\"";
+					oss << "Error parsing arguments\n" << OptName(this) << " is too long: " << val.Size()
+						<< " chars, maximum " << length->AsUnsigned();
 					throw std::runtime_error(oss.str());
 				}
-				regfree(&reg);
+				const Variant *pattern = opt.Find("pattern");
+				if (pattern) {
+					std::string pat = pattern->AsString();
+					regex_t reg;
+					memset(&reg, 0, sizeof(regex_t));
+					int err;
+					if ((err = regcomp(&reg, pat.c_str(), REG_EXTENDED | REG_NOSUB))) {
+						std::vector<char> buffer(8192);
+						regerror(err, &reg, &buffer[0], buffer.size());
+						std::ostringstream oss;
+						oss << "Error parsing arguments\n";
+						oss << "Failed to compile pattern regex \"" << pat << "\" with error: "
+							<< &buffer[0];
+						throw std::runtime_error(oss.str());
+					}
+					if (regexec(&reg, val.AsString().c_str(), 0, 0, 0) != 0) {
+						regfree(&reg);
+						std::ostringstream oss;
+						oss << "Error parsing arguments\n";
+						oss << OptName(this) << " failed to match pattern \""
+							<< pat << "\"";
+						throw std::runtime_error(oss.str());
+					}
+					regfree(&reg);
+				}
 			}
 			break;
 		case Variant::IntegerType: case Variant::UnsignedType: case Variant::FloatType:
-			if (opt.Contains("minimum") && val < opt["minimum"]) {
-				std::ostringstream oss;
-				oss << "Error parsing arguments\n" << OptName(this) << " is too small: ";
-				SerializeJSON(oss.rdbuf(), val);
-				oss << ", minimum ";
-				SerializeJSON(oss.rdbuf(), opt["minimum"]);
-				throw std::runtime_error(oss.str());
-			}
-			if (opt.Contains("maximum") && val > opt["maximum"]) {
-				std::ostringstream oss;
-				oss << "Error parsing arguments\n" << OptName(this) << " is too large: ";
-				SerializeJSON(oss.rdbuf(), val);
-				oss << ", maximum ";
-				SerializeJSON(oss.rdbuf(), opt["maximum"]);
-				throw std::runtime_error(oss.str());
+			{
+				const Variant *limit = opt.Find("minimum");
+				if (limit && val < *limit) {
+					std::ostringstream oss;
+					oss << "Error parsing arguments\n" << OptName(this) << " is too small: ";
+					SerializeJSON(oss.rdbuf(), val);
+					oss << ", minimum ";
+					SerializeJSON(oss.rdbuf(), *limit);
+					throw std::runtime_error(oss.str());
+				}
+				limit = opt.Find("maximum");
+				if (limit && val > *limit) {
+					std::ostringstream oss;
+					oss << "Error parsing arguments\n" << OptName(this) << " is too large: ";
+					SerializeJSON(oss.rdbuf(), val);
+					oss << ", maximum ";
+					SerializeJSON(oss.rdbuf(), *limit);
+					throw std::runtime_error(oss.str());
+				}
 			}
 			break;
 		default:
@@ -1596,8 +1610,9 @@ namespace libvariant {
 	}
 
 	void ArgParseOptImpl::Init(Variant o) {
-		if (o.Contains("type")) {
-			type = (Variant::Type_t)ParseType(o["type"]);
+		const Variant *t = o.Find("type");
+		if (t) {
+			type = (Variant::Type_t)ParseType(*t);
 		}
 		o.GetInto(required, "required", required);
 		o.GetInto(advanced, "advanced", false);
@@ -1648,21 +1663,23 @@ namespace libvariant {
 		}
 		if (!result.IsNull()) {
 			if (action == ARGACTION_APPEND) {
-				if (opt.Contains("maxArgs") && opt["maxArgs"] != 0) {
-					if (opt["maxArgs"] < result.Size()) {
+				const Variant *args = opt.Find("maxArgs");
+				if (args && args->AsUnsigned() != 0) {
+					if (args->AsUnsigned() < result.Size()) {
 						std::ostringstream oss;
 						oss << "Error parsing arguments\n";
 						oss << "More than maximum arguments specified for " << OptName(this) << ", ";
-						oss << result.Size() << " options, maximum: " << opt["maxArgs"].AsUnsigned();
+						oss << result.Size() << " options, maximum: " << args->AsUnsigned();
 						throw std::runtime_error(oss.str());
 					}
 				}
-				if (opt.Contains("minArgs")) {
-					if (opt["minArgs"] > result.Size()) {
+				args = opt.Find("minArgs");
+				if (args) {
+					if (args->AsUnsigned() > result.Size()) {
 						std::ostringstream oss;
 						oss << "Error parsing arguments\n";
 						oss << "Less than minimum arguments specified for " << OptName(this) << ", ";
-						oss << result.Size() << " options, minimum: " << opt["minArgs"].AsUnsigned();
+						oss << result.Size() << " options, minimum: " << args->AsUnsigned();
 						throw std::runtime_error(oss.str());
 					}
 				}
@@ -0,0 +1,126 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Minimal atomic counter and mutex used by the Variant internals.
+ */
+#ifndef VARIANT_ATOMIC_H
+#define VARIANT_ATOMIC_H
+#pragma once
+
+#if defined(__GXX_EXPERIMENTAL_CXX0X) || __cplusplus >= 201103L
+// The C++11 implementation is available
+#include <atomic>
+#include <mutex>
+namespace libvariant {
+
+	class AtomicCount {
+	public:
+		explicit AtomicCount(unsigned v) : count(v) {}
+		unsigned Increment() { return ++count; }
+		unsigned Decrement() { return --count; }
+		unsigned Get() const { return count.load(std::memory_order_acquire); }
+	private:
+		std::atomic<unsigned> count;
+	};
+
+	/// A pointer one thread may clear while others check it
+	template<typename T>
+	class AtomicPointer {
+	public:
+		explicit AtomicPointer(T *v) : ptr(v) {}
+		T *Load() const { return ptr.load(std::memory_order_acquire); }
+		void Store(T *v) { ptr.store(v, std::memory_order_release); }
+	private:
+		std::atomic<T*> ptr;
+	};
+
+	class Mutex {
+	public:
+		void Lock() { mutex.lock(); }
+		void Unlock() { mutex.unlock(); }
+	private:
+		std::mutex mutex;
+	};
+}
+
+#elif defined(__GNUC__)
+// Use the gcc builtins and pthreads
+#include <pthread.h>
+namespace libvariant {
+
+	class AtomicCount {
+	public:
+		explicit AtomicCount(unsigned v) : count(v) {}
+		unsigned Increment() { return __sync_add_and_fetch(&count, 1); }
+		unsigned Decrement() { return __sync_sub_and_fetch(&count, 1); }
+		unsigned Get() const { return __sync_fetch_and_add(const_cast<unsigned*>(&count), 0); }
+	private:
+		volatile unsigned count;
+	};
+
+	template<typename T>
+	class AtomicPointer {
+	public:
+		explicit AtomicPointer(T *v) : ptr(v) {}
+		T *Load() const {
+			T *v = ptr;
+			__sync_synchronize();
+			return v;
+		}
+		void Store(T *v) {
+			__sync_synchronize();
+			ptr = v;
+		}
+	private:
+		T *volatile ptr;
+	};
+
+	class Mutex {
+	public:
+		Mutex() { pthread_mutex_init(&mutex, 0); }
+		~Mutex() { pthread_mutex_destroy(&mutex); }
+		void Lock() { pthread_mutex_lock(&mutex); }
+		void Unlock() { pthread_mutex_unlock(&mutex); }
+	private:
+		Mutex(const Mutex &);
+		Mutex &operator=(const Mutex &);
+		pthread_mutex_t mutex;
+	};
+}
+
+#else
+
+#error libvariant requires an atomic counter implementation
+
+#endif
+
+namespace libvariant {
+
+	/// Scoped lock for Mutex
+	class MutexLock {
+	public:
+		explicit MutexLock(Mutex &m) : mutex(m) { mutex.Lock(); }
+		~MutexLock() { mutex.Unlock(); }
+	private:
+		MutexLock(const MutexLock &);
+		MutexLock &operator=(const MutexLock &);
+		Mutex &mutex;
+	};
+}
+
+#endif
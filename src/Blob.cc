@@ -116,6 +116,11 @@ namespace libvariant {
 				++j;
 			}
 		}
+		// Equal up to the end of the shorter one
+		unsigned our_len = GetTotalLength();
+		unsigned oth_len = other->GetTotalLength();
+		if (our_len < oth_len) { return -1; }
+		if (our_len > oth_len) { return 1; }
 		return 0;
 	}
 }
@@ -3,6 +3,7 @@
  * \brief 
  */
 #include "BundleHdrEmitter.h"
+#include "Numbers.h"
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -92,21 +93,18 @@ namespace libvariant {
 	}
 
 	void BundleHdrEmitterImpl::Emit(intmax_t v) {
-		std::ostringstream oss;
-		oss << v;
-		Value(oss.str().c_str(), oss.str().length());
+		char buf[INTEGER_CHARS];
+		Value(buf, FormatInt(v, buf));
 	}
 
 	void BundleHdrEmitterImpl::Emit(uintmax_t v) {
-		std::ostringstream oss;
-		oss << v;
-		Value(oss.str().c_str(), oss.str().length());
+		char buf[INTEGER_CHARS];
+		Value(buf, FormatUnsigned(v, buf));
 	}
 
 	void BundleHdrEmitterImpl::Emit(double v) {
-		std::ostringstream oss;
-		oss << std::setprecision(numeric_precision) << std::showpoint << v;
-		Value(oss.str().c_str(), oss.str().length());
+		char buf[FLOAT_CHARS];
+		Value(buf, FormatFloat(v, numeric_precision, true, buf));
 	}
 
 	void BundleHdrEmitterImpl::Emit(ConstBlobPtr b) {
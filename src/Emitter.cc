@@ -43,6 +43,21 @@ namespace libvariant {
 		}
 	}
 
+	template<typename T>
+	static void EmitEachElement(EmitterImpl *impl, const T *v, unsigned len) {
+		impl->BeginList(len);
+		for (unsigned i = 0; i < len; ++i) { impl->Emit(v[i]); }
+		impl->EndList();
+	}
+
+	void EmitterImpl::EmitList(const intmax_t *v, unsigned len) { EmitEachElement(this, v, len); }
+
+	void EmitterImpl::EmitList(const uintmax_t *v, unsigned len) { EmitEachElement(this, v, len); }
+
+	void EmitterImpl::EmitList(const double *v, unsigned len) { EmitEachElement(this, v, len); }
+
+	bool EmitterImpl::EmitJSON(const char *text, unsigned len) { return false; }
+
 	Emitter::Emitter() {}
 
 	Emitter::Emitter(shared_ptr<EmitterImpl> i)
@@ -126,6 +141,25 @@ namespace libvariant {
 		return *this;
 	}
 
+	Emitter &Emitter::EmitList(const intmax_t *v, unsigned len) {
+		impl->EmitList(v, len);
+		return *this;
+	}
+
+	Emitter &Emitter::EmitList(const uintmax_t *v, unsigned len) {
+		impl->EmitList(v, len);
+		return *this;
+	}
+
+	Emitter &Emitter::EmitList(const double *v, unsigned len) {
+		impl->EmitList(v, len);
+		return *this;
+	}
+
+	bool Emitter::EmitJSON(const char *text, unsigned len) {
+		return impl->EmitJSON(text, len);
+	}
+
 	void Emitter::Flush() {
 		impl->Flush();
 	}
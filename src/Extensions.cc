@@ -24,6 +24,7 @@
 #include <Variant/Variant.h>
 #include <Variant/Extensions.h>
 #include <Variant/Path.h>
+#include <Variant/Visit.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <set>
@@ -118,47 +119,92 @@ namespace libvariant {
 		return expand;
 	}
 
-	void FlattenPathTo( VariantRef flat, const Variant &var, Variant params, string prefix ) {
-		switch ( var.GetType() ) {
-		case Variant::ListType:
-			if ( (!params["noSimpleLists"].AsBool()) && SimpleList(var) ) {
-				if( prefix.size() ) {
-					flat[prefix] = var.Copy();
-				} else {
-					flat = var.Copy();
-				}
-			} else {
-				for( unsigned i=0; i < var.Size(); ++i ) {
-					stringstream tmp;
-					if ( prefix.size() ) {
-						tmp << prefix;
-					}
-					tmp << params["indexPrefix"].AsString();
-					tmp << i;
-					tmp << params["indexSuffix"].AsString();
-					FlattenPathTo( flat, var[i], params, tmp.str() );
-				}
+	/// Sets a flat path in flat for every leaf it visits, see FlattenPathTo
+	class FlattenVisitor : public VariantVisitor {
+	public:
+		FlattenVisitor( VariantRef flat, Variant params, const string &prefix )
+			: flat( flat ),
+			simple_lists( !params["noSimpleLists"].AsBool() ),
+			index_prefix( params["indexPrefix"].AsString() ),
+			index_suffix( params["indexSuffix"].AsString() ),
+			path_delimiter( params["pathDelimiter"].AsString() ),
+			path_prefix( params["pathPrefix"].AsString() ),
+			path( prefix )
+		{}
+
+		void Null() { NextElement(); Leaf( Variant() ); }
+		void Bool( bool b ) { NextElement(); Leaf( b ); }
+		void Int( intmax_t i ) { NextElement(); Leaf( i ); }
+		void Unsigned( uintmax_t u ) { NextElement(); Leaf( u ); }
+		void Float( double f ) { NextElement(); Leaf( f ); }
+		void String( const char *s, size_t len ) { NextElement(); Leaf( string( s, len ) ); }
+		void Blob( ConstBlobPtr b ) { NextElement(); Leaf( b->Copy() ); }
+
+		bool BeginList( const Variant &var ) {
+			NextElement();
+			if ( simple_lists && SimpleList( var ) ) {
+				Leaf( var.Copy() );
+				return false;
 			}
-			break;
-		case Variant::MapType:
-			for( Variant::ConstMapIterator i(var.MapBegin()), e(var.MapEnd()); i != e; ++i ) {
-				stringstream tmp;
-				if ( prefix.size() ) {
-					tmp << prefix + params["pathDelimiter"].AsString();
-				} else {
-					tmp << params["pathPrefix"].AsString();
-				}
-				tmp << i->first;
-				FlattenPathTo( flat, i->second, params, tmp.str());
+			frames.push_back( Frame( path, true ) );
+			return true;
+		}
+		void EndList() { frames.pop_back(); }
+
+		bool BeginMap( const Variant &var ) {
+			NextElement();
+			frames.push_back( Frame( path, false ) );
+			return true;
+		}
+		void Key( const char *s, size_t len ) {
+			const Frame &frame = frames.back();
+			if ( frame.prefix.size() ) {
+				path = frame.prefix + path_delimiter;
+			} else {
+				path = path_prefix;
 			}
-			break;
-		default:
-			if( prefix.size() ) {
-				flat[ prefix ] = var.Copy();
+			path.append( s, len );
+		}
+		void EndMap() { frames.pop_back(); }
+	private:
+		struct Frame {
+			Frame( const string &p, bool l ) : prefix( p ), list( l ), index( 0 ) {}
+			string prefix;
+			bool list;
+			unsigned index;
+		};
+
+		/// Set path for the next element of a list, a map sets it in Key
+		void NextElement() {
+			if ( frames.empty() || !frames.back().list ) { return; }
+			Frame &frame = frames.back();
+			stringstream tmp;
+			tmp << frame.prefix << index_prefix << frame.index++ << index_suffix;
+			path = tmp.str();
+		}
+
+		void Leaf( Variant value ) {
+			if ( path.size() ) {
+				flat[ path ] = value;
 			} else {
-				flat = var.Copy();
+				flat = value;
 			}
 		}
+
+		VariantRef flat;
+		bool simple_lists;
+		string index_prefix;
+		string index_suffix;
+		string path_delimiter;
+		string path_prefix;
+		/// The flat path of the value being visited
+		string path;
+		vector<Frame> frames;
+	};
+
+	void FlattenPathTo( VariantRef flat, const Variant &var, Variant params, string prefix ) {
+		FlattenVisitor visitor( flat, params, prefix );
+		Visit( visitor, var );
 	}
 
 	/// The current version of this funtion is fairly simple and cannot fully
@@ -233,22 +279,24 @@ namespace libvariant {
 				DBPRINT(i->first << endl);
 
 				// Replace and continue
-				if ( !base.Contains(i->first) ) {
+				const Variant *b = base.Find(i->first);
+				if ( !b ) {
 					diff[i->first] = i->second.Copy();
 					continue;
 				}
 
 				// Recurse into map
-				if ( base[i->first] != i->second ) {
+				if ( *b != i->second ) {
 					diff[i->first] = Variant::MapType;
 					DBPRINT("recurse for " << i->first << endl);
-					RDiff( diff[i->first], base[i->first], compare[i->first] );
+					RDiff( diff[i->first], *b, i->second );
 				}
 
 				// If map diff became null or an empty map, remove - TODO: should this be an option?
-				if ( diff.Contains(i->first) ) {
-					if ( (diff[ i->first ].GetType() == Variant::NullType) ||
-						(diff[ i->first ].GetType() == Variant::MapType && diff[ i->first ].Size() == 0) ) {
+				const Variant *d = diff.Find(i->first);
+				if ( d ) {
+					if ( (d->GetType() == Variant::NullType) ||
+						(d->GetType() == Variant::MapType && d->Size() == 0) ) {
 							diff.Erase(i->first);
 						}
 				}
@@ -268,7 +316,7 @@ namespace libvariant {
 		case Variant::MapType:
 			if ( !base.Exists() || base.IsMap() ) {
 				for ( Variant::ConstMapIterator i(update.MapBegin()), e(update.MapEnd()); i != e; ++i ) {
-					RUpdate(base.At( i->first, Variant::MapType ), update[ i->first ]);
+					RUpdate(base.At( i->first, Variant::MapType ), i->second);
 				}
 				break;
 			}
@@ -3,11 +3,10 @@
  * \brief 
  */
 #include "GuessScalar.h"
+#include "Numbers.h"
 #include <stdlib.h>
 #include <regex.h>
-#include <errno.h>
 #include <limits>
-#include <limits.h>
 #include <string.h>
 
 namespace libvariant {
@@ -79,25 +78,28 @@ namespace libvariant {
 			} else if (match[MATCH_FALSE].rm_so != -1) {
 				action->Scalar(p, false, anchor, tag);
 			} else if (match[MATCH_INT10].rm_so != -1) {
-				long long val;
-				val = strtoll(&value[match[MATCH_INT10].rm_so], 0, 10);
-				if (val == LLONG_MAX && errno == ERANGE) {
-					unsigned long long v;
-					v = strtoull(&value[match[MATCH_INT10].rm_so], 0, 10);
-					action->Scalar(p, uintmax_t(v), anchor, tag);
+				const char *b = &value[match[MATCH_INT10].rm_so];
+				const char *e = &value[match[MATCH_INT10].rm_eo];
+				intmax_t val;
+				if (ParseInt(b, e, val) == NUMBER_RANGE && val > 0) {
+					// Too large for an int, may still fit an unsigned
+					uintmax_t v;
+					ParseUnsigned(b, e, v);
+					action->Scalar(p, v, anchor, tag);
 				} else {
-					action->Scalar(p, intmax_t(val), anchor, tag);
+					action->Scalar(p, val, anchor, tag);
 				}
 			} else if (match[MATCH_INT8].rm_so != -1) {
-				unsigned long long val;
-				val = strtoull(&value[match[MATCH_INT8].rm_so], 0, 8);
-				action->Scalar(p, uintmax_t(val), anchor, tag);
+				uintmax_t val;
+				ParseUnsigned(&value[match[MATCH_INT8].rm_so], &value[match[MATCH_INT8].rm_eo], val, 0, 8);
+				action->Scalar(p, val, anchor, tag);
 			} else if (match[MATCH_INT16].rm_so != -1) {
-				unsigned long long val;
-				val = strtoull(&value[match[MATCH_INT16].rm_so], 0, 16);
-				action->Scalar(p, uintmax_t(val), anchor, tag);
+				uintmax_t val;
+				ParseUnsigned(&value[match[MATCH_INT16].rm_so], &value[match[MATCH_INT16].rm_eo], val, 0, 16);
+				action->Scalar(p, val, anchor, tag);
 			} else if (match[MATCH_FLOAT].rm_so != -1) {
-				double val = strtod(&value[match[MATCH_FLOAT].rm_so], 0);
+				double val;
+				ParseFloat(&value[match[MATCH_FLOAT].rm_so], &value[match[MATCH_FLOAT].rm_eo], val);
 				action->Scalar(p, val, anchor, tag);
 			} else if (match[MATCH_INF].rm_so != -1) {
 				double val = std::numeric_limits<double>::infinity();
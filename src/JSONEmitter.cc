@@ -27,6 +27,7 @@
 #include <cmath>
 #include "Base64.h"
 #include "BlobMagic.h"
+#include "Numbers.h"
 
 using namespace std;
 
@@ -109,30 +110,27 @@ namespace libvariant {
 
 	void JSONEmitterImpl::Emit(intmax_t v) {
 		CheckSeparator();
-		std::ostringstream oss;
-		oss << v;
-		EmitRaw(oss.str().c_str(), oss.str().length());
+		char buf[INTEGER_CHARS];
+		EmitRaw(buf, FormatInt(v, buf));
 	}
 
 	void JSONEmitterImpl::Emit(uintmax_t v) {
 		CheckSeparator();
-		std::ostringstream oss;
-		oss << v;
-		EmitRaw(oss.str().c_str(), oss.str().length());
+		char buf[INTEGER_CHARS];
+		EmitRaw(buf, FormatUnsigned(v, buf));
 	}
 
 	void JSONEmitterImpl::Emit(double v) {
 		CheckSeparator();
-		std::ostringstream oss;
 		if (strict && (std::isnan(v) || std::isinf(v))) {
 			throw std::runtime_error("JSONEmitter: The JSON specification does not permit"
 					" numeric types that cannot be represented as a series of digits.");
 		} else if (std::isnan(v) || std::isinf(v)) {
-			oss << "null";
+			EmitRaw("null");
 		} else {
-			oss << std::setprecision(numeric_precision) << std::showpoint << v;
+			char buf[FLOAT_CHARS];
+			EmitRaw(buf, FormatFloat(v, numeric_precision, true, buf));
 		}
-		EmitRaw(oss.str().c_str(), oss.str().length());
 	}
 
 	void JSONEmitterImpl::Emit(ConstBlobPtr b) {
@@ -149,6 +147,35 @@ namespace libvariant {
 		EmitRaw("\"");
 	}
 
+	// The elements are written without going through the virtual Emit
+
+	void JSONEmitterImpl::EmitList(const intmax_t *v, unsigned len) {
+		BeginList(len);
+		for (unsigned i = 0; i < len; ++i) { JSONEmitterImpl::Emit(v[i]); }
+		EndList();
+	}
+
+	void JSONEmitterImpl::EmitList(const uintmax_t *v, unsigned len) {
+		BeginList(len);
+		for (unsigned i = 0; i < len; ++i) { JSONEmitterImpl::Emit(v[i]); }
+		EndList();
+	}
+
+	void JSONEmitterImpl::EmitList(const double *v, unsigned len) {
+		BeginList(len);
+		for (unsigned i = 0; i < len; ++i) { JSONEmitterImpl::Emit(v[i]); }
+		EndList();
+	}
+
+	// Copying the text would break the indentation
+	bool JSONEmitterImpl::EmitJSON(const char *text, unsigned len) {
+		if (pretty) { return false; }
+		CheckSeparator();
+		EmitRaw(text, len);
+		Flush();
+		return true;
+	}
+
 	void JSONEmitterImpl::Flush() {
 		if (buffer_len > 0) {
 			unsigned num_written = 0;
@@ -75,6 +75,10 @@ namespace libvariant {
 		virtual void Emit(uintmax_t v);
 		virtual void Emit(double v);
 		virtual void Emit(ConstBlobPtr b);
+		virtual void EmitList(const intmax_t *v, unsigned len);
+		virtual void EmitList(const uintmax_t *v, unsigned len);
+		virtual void EmitList(const double *v, unsigned len);
+		virtual bool EmitJSON(const char *text, unsigned len);
 
 		virtual void Flush();
 		virtual void Close();
@@ -0,0 +1,300 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ *
+ * Each 64 byte block is turned into one bit per byte for each kind of
+ * character of interest, with SSE2 or AVX2 compares where the CPU has them.
+ * The rest is done on those 64 bit words: which quotes are escaped, which
+ * bytes are in strings, and where the numbers and literals start. State
+ * carried from block to block lets escapes and strings cross blocks.
+ */
+#include "JSONIndex.h"
+#include <stdexcept>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_INDEX_X86
+#include <immintrin.h>
+#define JSON_INDEX_TARGET(t) __attribute__((target(t)))
+#endif
+
+namespace libvariant {
+
+	/// A bit per byte of a block for each kind of character
+	struct JSONClasses {
+		/// Brackets, colons and commas
+		uint64_t op;
+		uint64_t space;
+		uint64_t quote;
+		uint64_t backslash;
+		/// Bytes below 0x20
+		uint64_t control;
+		uint64_t slash;
+	};
+
+	static inline unsigned LowestBit(uint64_t w) {
+#ifdef __GNUC__
+		return __builtin_ctzll(w);
+#else
+		unsigned n = 0;
+		while (!(w & 1)) { w >>= 1; ++n; }
+		return n;
+#endif
+	}
+
+	/// Each bit of the result is the xor of it and all lower bits of x
+	static inline uint64_t PrefixXor(uint64_t x) {
+		x ^= x << 1;
+		x ^= x << 2;
+		x ^= x << 4;
+		x ^= x << 8;
+		x ^= x << 16;
+		x ^= x << 32;
+		return x;
+	}
+
+	/// What one block leaves for the next
+	struct JSONIndexState {
+		JSONIndexState() : escaped(0), in_string(0), after_token(1), errors(0) {}
+
+		/// The bytes backslashes escape, adding one to an odd run of
+		/// backslashes carries into the byte after it, an even one does not
+		uint64_t Escaped(uint64_t backslash) {
+			const uint64_t even = 0x5555555555555555ull;
+			backslash &= ~escaped;
+			uint64_t follows = (backslash << 1) | escaped;
+			uint64_t odd_starts = backslash & ~even & ~follows;
+			uint64_t sum = odd_starts + backslash;
+			escaped = (sum < odd_starts ? 1 : 0);
+			return (even ^ (sum << 1)) & follows;
+		}
+
+		void Block(const JSONClasses &c, unsigned offset, std::vector<unsigned> &index, size_t &count) {
+			uint64_t quote = c.quote & ~Escaped(c.backslash);
+			// From an opening quote up to the closing one
+			uint64_t string = PrefixXor(quote) ^ in_string;
+			in_string = uint64_t(int64_t(string) >> 63);
+			errors |= (c.control & string) | (c.slash & ~string);
+			uint64_t ends = c.op | c.space | c.quote;
+			uint64_t starts = ~ends & ~string & ((ends << 1) | after_token);
+			after_token = ends >> 63;
+			uint64_t found = (c.op & ~string) | quote | starts;
+
+			if (index.size() < count + 64) { index.resize(2 * index.size() + 64); }
+			unsigned *out = &index[count];
+			while (found) {
+				*out++ = offset + LowestBit(found);
+				found &= found - 1;
+			}
+			count = out - &index[0];
+		}
+
+		uint64_t escaped;
+		/// All ones if the next block starts in a string
+		uint64_t in_string;
+		/// Whether the last byte could not be part of a number or literal
+		uint64_t after_token;
+		uint64_t errors;
+	};
+
+	static void ClassifyScalar(const char *p, JSONClasses &c) {
+		memset(&c, 0, sizeof(c));
+		for (unsigned i = 0; i < 64; ++i) {
+			uint64_t bit = uint64_t(1) << i;
+			unsigned char ch = p[i];
+			switch (ch) {
+			case '{': case '}': case '[': case ']': case ':': case ',':
+				c.op |= bit;
+				break;
+			case ' ':
+				c.space |= bit;
+				break;
+			case '\t': case '\n': case '\r':
+				c.space |= bit;
+				c.control |= bit;
+				break;
+			case '"':
+				c.quote |= bit;
+				break;
+			case '\\':
+				c.backslash |= bit;
+				break;
+			case '/':
+				c.slash |= bit;
+				break;
+			default:
+				if (ch < 0x20) { c.control |= bit; }
+				break;
+			}
+		}
+	}
+
+	typedef void (*JSONIndexBlocks)(const char *b, const char *e, unsigned offset,
+			JSONIndexState &state, std::vector<unsigned> &index, size_t &count);
+
+	/// Index the whole blocks in b to e, offset is where b is in the text
+	static void IndexScalar(const char *b, const char *e, unsigned offset,
+			JSONIndexState &state, std::vector<unsigned> &index, size_t &count) {
+		JSONClasses c;
+		for (; e - b >= 64; b += 64, offset += 64) {
+			ClassifyScalar(b, c);
+			state.Block(c, offset, index, count);
+		}
+	}
+
+#ifdef JSON_INDEX_X86
+	JSON_INDEX_TARGET("sse2")
+	static inline void ClassifySSE2(const char *p, JSONClasses &c) {
+		memset(&c, 0, sizeof(c));
+		for (unsigned i = 0; i < 4; ++i) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+			// Setting 0x20 makes [ into { and ] into }
+			__m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			__m128i op = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+					_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+			__m128i space = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+					_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+			__m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+			unsigned shift = 16 * i;
+			c.op |= uint64_t(unsigned(_mm_movemask_epi8(op))) << shift;
+			c.space |= uint64_t(unsigned(_mm_movemask_epi8(space))) << shift;
+			c.quote |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))) << shift;
+			c.backslash |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))))) << shift;
+			c.control |= uint64_t(unsigned(_mm_movemask_epi8(control))) << shift;
+			c.slash |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))))) << shift;
+		}
+	}
+
+	JSON_INDEX_TARGET("sse2")
+	static void IndexSSE2(const char *b, const char *e, unsigned offset,
+			JSONIndexState &state, std::vector<unsigned> &index, size_t &count) {
+		JSONClasses c;
+		for (; e - b >= 64; b += 64, offset += 64) {
+			ClassifySSE2(b, c);
+			state.Block(c, offset, index, count);
+		}
+	}
+
+	/**
+	 * AVX2 can look the low four bits of each byte up in a table, so each
+	 * of white space and brackets, colons and commas takes one compare. A
+	 * table entry only matches the bytes whose low bits pick it.
+	 */
+	JSON_INDEX_TARGET("avx2")
+	static inline void ClassifyAVX2(const char *p, JSONClasses &c) {
+		const __m256i space_table = _mm256_setr_epi8(
+				' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100,
+				' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100);
+		const __m256i op_table = _mm256_setr_epi8(
+				0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0,
+				0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0);
+		memset(&c, 0, sizeof(c));
+		for (unsigned i = 0; i < 2; ++i) {
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+			__m256i space = _mm256_cmpeq_epi8(v, _mm256_shuffle_epi8(space_table, v));
+			__m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+			// Setting 0x20 makes [ into { and ] into }, and control
+			// characters into the rest
+			__m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+			__m256i op = _mm256_andnot_si256(control, _mm256_cmpeq_epi8(folded, _mm256_shuffle_epi8(op_table, v)));
+			unsigned shift = 32 * i;
+			c.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << shift;
+			c.space |= uint64_t(uint32_t(_mm256_movemask_epi8(space))) << shift;
+			c.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << shift;
+			c.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << shift;
+			c.control |= uint64_t(uint32_t(_mm256_movemask_epi8(control))) << shift;
+			c.slash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))))) << shift;
+		}
+	}
+
+	JSON_INDEX_TARGET("avx2")
+	static void IndexAVX2(const char *b, const char *e, unsigned offset,
+			JSONIndexState &state, std::vector<unsigned> &index, size_t &count) {
+		JSONClasses c;
+		for (; e - b >= 64; b += 64, offset += 64) {
+			ClassifyAVX2(b, c);
+			state.Block(c, offset, index, count);
+		}
+	}
+#endif
+
+	bool JSONIndexSupported(JSONIndexKernel_t kernel) {
+		switch (kernel) {
+		case JSON_INDEX_BEST:
+		case JSON_INDEX_SCALAR:
+			return true;
+#ifdef JSON_INDEX_X86
+		case JSON_INDEX_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case JSON_INDEX_AVX2:
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+		}
+	}
+
+	static JSONIndexBlocks BestKernel() {
+#ifdef JSON_INDEX_X86
+		if (JSONIndexSupported(JSON_INDEX_AVX2)) { return IndexAVX2; }
+		if (JSONIndexSupported(JSON_INDEX_SSE2)) { return IndexSSE2; }
+#endif
+		return IndexScalar;
+	}
+
+	static JSONIndexBlocks GetKernel(JSONIndexKernel_t kernel) {
+		if (!JSONIndexSupported(kernel)) {
+			throw std::runtime_error("IndexJSON: The kernel is not supported here");
+		}
+		switch (kernel) {
+		case JSON_INDEX_BEST:
+			{
+				static const JSONIndexBlocks best = BestKernel();
+				return best;
+			}
+#ifdef JSON_INDEX_X86
+		case JSON_INDEX_SSE2:
+			return IndexSSE2;
+		case JSON_INDEX_AVX2:
+			return IndexAVX2;
+#endif
+		default:
+			return IndexScalar;
+		}
+	}
+
+	bool IndexJSON(const char *b, const char *e, std::vector<unsigned> &index, JSONIndexKernel_t kernel) {
+		JSONIndexBlocks blocks = GetKernel(kernel);
+		JSONIndexState state;
+		size_t count = 0;
+		unsigned whole = (e - b) & ~63u;
+		blocks(b, b + whole, 0, state, index, count);
+		if (b + whole != e) {
+			// Spaces change nothing after the end
+			char last[64];
+			memset(last, ' ', sizeof(last));
+			memcpy(last, b + whole, e - b - whole);
+			blocks(last, last + sizeof(last), whole, state, index, count);
+		}
+		index.resize(count);
+		return !state.in_string && !state.errors;
+	}
+}
@@ -0,0 +1,53 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief The positions in a JSON text a parser has to look at, found 64
+ * bytes at a time.
+ */
+#ifndef VARIANT_JSONINDEX_H
+#define VARIANT_JSONINDEX_H
+#pragma once
+#include <vector>
+
+namespace libvariant {
+
+	/// The ways of classifying the text, the best one the CPU has is used
+	enum JSONIndexKernel_t {
+		JSON_INDEX_BEST,
+		JSON_INDEX_SCALAR,
+		JSON_INDEX_SSE2,
+		JSON_INDEX_AVX2
+	};
+
+	/// Whether this build and CPU can use kernel
+	bool JSONIndexSupported(JSONIndexKernel_t kernel);
+
+	/**
+	 * Find the offset from b of each bracket, colon and comma outside a
+	 * string, of both quotes of each string, and of the first character of
+	 * each number and literal, in order.
+	 *
+	 * Returns false, with index unspecified, if the text has a comment, a
+	 * control character in a string or a string that does not end. These
+	 * are left to a parser that looks at every byte, which can say where
+	 * the error is. Anything else wrong is found by following the index.
+	 */
+	bool IndexJSON(const char *b, const char *e, std::vector<unsigned> &index,
+			JSONIndexKernel_t kernel = JSON_INDEX_BEST);
+}
+#endif
@@ -22,6 +22,74 @@
 
 namespace libvariant {
 
+	void JSONStringEvent(const char *str, size_t len, Internal::SAXEvent &event) {
+		if (len >= MAGIC_BLOB_LENGTH && memcmp(str, MAGIC_BLOB_TAG, MAGIC_BLOB_LENGTH) == 0) {
+			void *ptr = 0;
+			if (posix_memalign(&ptr, 64, Base64DecodeSize(len)) != 0) {
+				throw std::bad_alloc();
+			}
+			unsigned blob_len = Base64Decode(ptr, str + MAGIC_BLOB_LENGTH, len - MAGIC_BLOB_LENGTH);
+			event.type = Internal::SAX_BLOB;
+			event.blob = Blob::CreateFree(ptr, blob_len);
+		} else {
+			event.type = Internal::SAX_STRING;
+			event.s.str = str;
+			event.s.len = len;
+		}
+	}
+
+	/// Make the event for a tokenizer callback, false if there is none
+	static bool MakeEvent(int type, const struct JSON_value_struct* value, Internal::SAXEvent &event) {
+		switch(type) {
+		case JSON_T_ARRAY_BEGIN:
+			event.type = Internal::SAX_BEGIN_LIST;
+			break;
+		case JSON_T_ARRAY_END:
+			event.type = Internal::SAX_END_LIST;
+			break;
+		case JSON_T_OBJECT_BEGIN:
+			event.type = Internal::SAX_BEGIN_MAP;
+			break;
+		case JSON_T_OBJECT_END:
+			event.type = Internal::SAX_END_MAP;
+			break;
+		case JSON_T_INTEGER:
+			event.type = Internal::SAX_INT;
+			event.i = value->vu.integer_value;
+			break;
+		case JSON_T_UNSIGNED:
+			event.type = Internal::SAX_UNSIGNED;
+			event.u = value->vu.unsigned_value;
+			break;
+		case JSON_T_FLOAT:
+			event.type = Internal::SAX_FLOAT;
+			event.f = value->vu.float_value;
+			break;
+		case JSON_T_NULL:
+			event.type = Internal::SAX_NULL;
+			break;
+		case JSON_T_TRUE:
+			event.type = Internal::SAX_BOOL;
+			event.b = true;
+			break;
+		case JSON_T_FALSE:
+			event.type = Internal::SAX_BOOL;
+			event.b = false;
+			break;
+		case JSON_T_KEY:
+			event.type = Internal::SAX_KEY;
+			event.s.str = value->vu.str.value;
+			event.s.len = value->vu.str.length;
+			break;
+		case JSON_T_STRING:
+			JSONStringEvent(value->vu.str.value, value->vu.str.length, event);
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+
 	int JSONParserImpl::StaticCallback(void *ctx, int type, const struct JSON_value_struct* value) {
 		JSONParserImpl *impl = (JSONParserImpl*)ctx;
 		if (impl->status == S_BEGIN) {
@@ -30,62 +98,15 @@ namespace libvariant {
 		// If an exception is thrown from here, the parser will be in an
 		// inconsistent state. So, set our state to error.
 		try {
-			switch(type) {
-			case JSON_T_ARRAY_BEGIN:    
+			Internal::SAXEvent event;
+			if (!MakeEvent(type, value, event)) { return true; }
+			if (event.type == Internal::SAX_BEGIN_LIST || event.type == Internal::SAX_BEGIN_MAP) {
 				++impl->depth;
-				impl->TopAction()->BeginList(impl, -1, 0, 0);
-				break;
-			case JSON_T_ARRAY_END:
+			} else if (event.type == Internal::SAX_END_LIST || event.type == Internal::SAX_END_MAP) {
 				--impl->depth;
-				impl->TopAction()->EndList(impl);
-				break;
-			case JSON_T_OBJECT_BEGIN:
-				++impl->depth;
-				impl->TopAction()->BeginMap(impl, -1, 0, 0);
-				break;
-			case JSON_T_OBJECT_END:
-				--impl->depth;
-				impl->TopAction()->EndMap(impl);
-				break;
-			case JSON_T_INTEGER:
-				impl->TopAction()->Scalar(impl, intmax_t(value->vu.integer_value), 0, 0);
-				break;
-			case JSON_T_UNSIGNED:
-				impl->TopAction()->Scalar(impl, uintmax_t(value->vu.unsigned_value), 0, 0);
-				break;
-			case JSON_T_FLOAT:
-				impl->TopAction()->Scalar(impl, value->vu.float_value, 0, 0);
-				break;
-			case JSON_T_NULL:
-				impl->TopAction()->Null(impl, 0, 0);
-				break;
-			case JSON_T_TRUE:
-				impl->TopAction()->Scalar(impl, true, 0, 0);
-				break;
-			case JSON_T_FALSE:
-				impl->TopAction()->Scalar(impl, false, 0, 0);
-				break;
-			case JSON_T_KEY:
-				impl->TopAction()->Scalar(impl, value->vu.str.value, value->vu.str.length, 0, 0);
-				break;
-			case JSON_T_STRING:
-				if (value->vu.str.length >= MAGIC_BLOB_LENGTH &&
-						memcmp(value->vu.str.value, MAGIC_BLOB_TAG, MAGIC_BLOB_LENGTH) == 0) {
-					void *ptr = 0;
-					if (posix_memalign(&ptr, 64, Base64DecodeSize(value->vu.str.length)) != 0) {
-						throw std::bad_alloc();
-					}
-					unsigned len = Base64Decode(ptr, value->vu.str.value+MAGIC_BLOB_LENGTH,
-							value->vu.str.length-MAGIC_BLOB_LENGTH);
-					BlobPtr blob = Blob::CreateFree(ptr, len);
-					impl->TopAction()->Scalar(impl, blob, 0, 0);
-				} else {
-					impl->TopAction()->Scalar(impl, value->vu.str.value, value->vu.str.length, 0, 0);
-				}
-				break;
-			default:
-				break;
 			}
+			ParserActionsHandler handler(impl);
+			Internal::SAXDispatch<ParserActionsHandler>(&handler, event);
 		} catch (...) {
 			impl->status = S_ERROR;
 			throw;
@@ -100,6 +121,8 @@ namespace libvariant {
 		column(0),
 		charcount(0),
 		depth(0),
+		skip_depth(0),
+		skip_state(SKIP_VALUE),
 		input(i)
 	{
 			AllocParser();
@@ -118,6 +141,8 @@ namespace libvariant {
 		column = 0;
 		charcount = 0;
 		depth = 0;
+		skip_depth = 0;
+		skip_state = SKIP_VALUE;
 		AllocParser();
 	}
 
@@ -143,6 +168,10 @@ namespace libvariant {
 				return;
 			}
 			while ( c != end && ( status == S_OK || status == S_BEGIN) && !action_stack.empty() ) {
+				if (skip_depth > 0) {
+					c = Skip(c, end);
+					if (c == end) { break; }
+				}
 				++charcount;
 				if (*c == '\n') {
 					column = 0;
@@ -162,6 +191,64 @@ namespace libvariant {
 		}
 	}
 
+	void JSONParserImpl::SkipContainer() {
+		skip_depth = 1;
+		skip_state = SKIP_VALUE;
+	}
+
+	const unsigned char *JSONParserImpl::Skip(const unsigned char *c, const unsigned char *end) {
+		for (; c != end; ++c) {
+			switch (skip_state) {
+			case SKIP_SLASH:
+				if (*c == '/') {
+					skip_state = SKIP_LINE_COMMENT;
+					break;
+				} else if (*c == '*') {
+					skip_state = SKIP_BLOCK_COMMENT;
+					break;
+				}
+				// Not a comment, the parser will find the error later
+				skip_state = SKIP_VALUE;
+				// fall through
+			case SKIP_VALUE:
+				switch (*c) {
+				case '"': skip_state = SKIP_STRING; break;
+				case '/': skip_state = SKIP_SLASH; break;
+				case '[': case '{': ++skip_depth; break;
+				case ']': case '}':
+					// The close bracket is left for the parser
+					if (--skip_depth == 0) { return c; }
+					break;
+				default: break;
+				}
+				break;
+			case SKIP_STRING:
+				if (*c == '\\') { skip_state = SKIP_ESCAPE; }
+				else if (*c == '"') { skip_state = SKIP_VALUE; }
+				break;
+			case SKIP_ESCAPE:
+				skip_state = SKIP_STRING;
+				break;
+			case SKIP_LINE_COMMENT:
+				if (*c == '\n') { skip_state = SKIP_VALUE; }
+				break;
+			case SKIP_BLOCK_COMMENT:
+				if (*c == '*') { skip_state = SKIP_BLOCK_STAR; }
+				break;
+			case SKIP_BLOCK_STAR:
+				if (*c == '/') { skip_state = SKIP_VALUE; }
+				else if (*c != '*') { skip_state = SKIP_BLOCK_COMMENT; }
+				break;
+			}
+			++charcount;
+			if (*c == '\n') {
+				column = 0;
+				++line;
+			} else { ++column; }
+		}
+		return c;
+	}
+
 	int JSONParserImpl::Run() {
 		while (!action_stack.empty()) {
 			switch (status) {
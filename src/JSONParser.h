@@ -31,11 +31,40 @@
 #include <stdlib.h>
 #include <string.h>
 #include <Variant/Parser.h>
+#include <Variant/SAX.h>
 #include <Variant/ParserInput.h>
 #include <Variant/SharedPtr.h>
 
 
 namespace libvariant {
+
+	/**
+	 * Passes the events on to the actions on top of the stack of p, the
+	 * virtual interface is an adapter on top of the SAX one.
+	 */
+	class ParserActionsHandler : public SAXHandler {
+	public:
+		ParserActionsHandler(ParserImpl *p_) : p(p_) {}
+		void Null() { p->TopAction()->Null(p, 0, 0); }
+		void Bool(bool b) { p->TopAction()->Scalar(p, b, 0, 0); }
+		void Int(intmax_t i) { p->TopAction()->Scalar(p, i, 0, 0); }
+		void Unsigned(uintmax_t u) { p->TopAction()->Scalar(p, u, 0, 0); }
+		void Float(double f) { p->TopAction()->Scalar(p, f, 0, 0); }
+		void String(const char *s, size_t len) { p->TopAction()->Scalar(p, s, len, 0, 0); }
+		void Blob(BlobPtr b) { p->TopAction()->Scalar(p, b, 0, 0); }
+		void BeginList() { p->TopAction()->BeginList(p, -1, 0, 0); }
+		void EndList() { p->TopAction()->EndList(p); }
+		void BeginMap() { p->TopAction()->BeginMap(p, -1, 0, 0); }
+		void Key(const char *s, size_t len) { p->TopAction()->Scalar(p, s, len, 0, 0); }
+		void EndMap() { p->TopAction()->EndMap(p); }
+	private:
+		ParserImpl *p;
+	};
+
+	/// Make the event for a string value, which is a blob if it starts
+	/// with the magic blob tag.
+	void JSONStringEvent(const char *str, size_t len, Internal::SAXEvent &event);
+
 	/**
 	 * A class that encapsulates the JSON_parser with the Parser interface
 	 */
@@ -65,6 +94,13 @@ namespace libvariant {
 		unsigned GetLine() const;
 		unsigned GetColumn() const;
 		unsigned GetByteCount() const;
+		/**
+		 * Called from a BeginMap or BeginList callback to not parse the
+		 * contents of that container. The input is only scanned for the
+		 * matching close bracket, which is then parsed as if the container
+		 * were empty. Nothing inside is checked for errors.
+		 */
+		void SkipContainer();
 		/**
 		 * Resets the parser to the state it was in when just constructed.
 		 */
@@ -77,12 +113,29 @@ namespace libvariant {
 
 		static int StaticCallback(void *ctx, int type, const struct JSON_value_struct* value);
 
+		/// Scan c through the contents of a skipped container, return the
+		/// position of its close bracket or end.
+		const unsigned char *Skip(const unsigned char *c, const unsigned char *end);
+
+		enum SkipState_t {
+			SKIP_VALUE,
+			SKIP_STRING,
+			SKIP_ESCAPE,
+			SKIP_SLASH,
+			SKIP_LINE_COMMENT,
+			SKIP_BLOCK_COMMENT,
+			SKIP_BLOCK_STAR
+		};
+
 		JSON_parser_struct *parser;
 		Status_t status;
 		unsigned line;
 		unsigned column;
 		unsigned charcount;
 		unsigned depth;
+		/// Open brackets of the container being skipped, 0 when not skipping
+		unsigned skip_depth;
+		SkipState_t skip_state;
 		shared_ptr<ParserInput> input;
 		std::string errorstr;
 	};
@@ -0,0 +1,612 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ */
+#include "JSONReader.h"
+#include "JSONParser.h"
+#include "JSONIndex.h"
+#include "Numbers.h"
+#include <stdexcept>
+#include <sstream>
+#include <string.h>
+#include <stdint.h>
+
+namespace libvariant {
+
+	static const uint64_t ONES = 0x0101010101010101ull;
+	static const uint64_t HIGHS = 0x8080808080808080ull;
+
+	static inline uint64_t Load(const char *p) {
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		return w;
+	}
+
+	/// The high bit of each byte of w that is zero, and maybe of some
+	/// that follow one
+	static inline uint64_t ZeroBytes(uint64_t w) { return (w - ONES) & ~w & HIGHS; }
+
+	/// Whether any byte of w ends or escapes a string or is a control
+	/// character, which cannot be in one
+	static inline bool StringSpecial(uint64_t w) {
+		return (ZeroBytes(w ^ (ONES * '"')) | ZeroBytes(w ^ (ONES * '\\')) | ((w - ONES * 0x20) & ~w & HIGHS)) != 0;
+	}
+
+	/// The characters that end a number or a literal
+	static inline bool Delimiter(char c) {
+		switch (c) {
+		case ' ': case '\t': case '\n': case '\r':
+		case ',': case ']': case '}': case '/':
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool ParseHex4(const char *p, const char *e, unsigned &value) {
+		if (e - p < 4) { return false; }
+		value = 0;
+		for (unsigned i = 0; i < 4; ++i) {
+			char c = p[i];
+			value <<= 4;
+			if (c >= '0' && c <= '9') { value |= c - '0'; }
+			else if (c >= 'a' && c <= 'f') { value |= c - 'a' + 10; }
+			else if (c >= 'A' && c <= 'F') { value |= c - 'A' + 10; }
+			else { return false; }
+		}
+		return true;
+	}
+
+	static void AppendUTF8(std::string &out, unsigned c) {
+		if (c < 0x80) {
+			out += char(c);
+		} else if (c < 0x800) {
+			out += char(0xC0 | (c >> 6));
+			out += char(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			out += char(0xE0 | (c >> 12));
+			out += char(0x80 | ((c >> 6) & 0x3F));
+			out += char(0x80 | (c & 0x3F));
+		} else {
+			out += char(0xF0 | (c >> 18));
+			out += char(0x80 | ((c >> 12) & 0x3F));
+			out += char(0x80 | ((c >> 6) & 0x3F));
+			out += char(0x80 | (c & 0x3F));
+		}
+	}
+
+	/// Check b to e is a JSON number, return whether it is a float
+	static bool CheckNumber(const char *b, const char *e, bool &is_float) {
+		const char *p = b;
+		if (p != e && *p == '-') { ++p; }
+		if (p == e) { return false; }
+		if (*p == '0') {
+			++p;
+		} else if (*p >= '1' && *p <= '9') {
+			while (p != e && *p >= '0' && *p <= '9') { ++p; }
+		} else {
+			return false;
+		}
+		is_float = false;
+		if (p != e && *p == '.') {
+			// JSON_parser took a point without digits after it, so do we
+			++p;
+			is_float = true;
+			while (p != e && *p >= '0' && *p <= '9') { ++p; }
+		}
+		if (p != e && (*p == 'e' || *p == 'E')) {
+			++p;
+			is_float = true;
+			if (p != e && (*p == '+' || *p == '-')) { ++p; }
+			if (p == e || *p < '0' || *p > '9') { return false; }
+			while (p != e && *p >= '0' && *p <= '9') { ++p; }
+		}
+		return p == e;
+	}
+
+	JSONReader::JSONReader(Internal::SAXSink s, void *h)
+		: sink(s), handler(h)
+	{
+		Reset();
+	}
+
+	void JSONReader::Reset() {
+		stack.clear();
+		expect = EXPECT_DOCUMENT;
+		partial = PARTIAL_NONE;
+		partial_key = false;
+		partial_has_escape = false;
+		partial_escape = false;
+		comment_star = false;
+		stopped = false;
+		consumed = 0;
+		begin = 0;
+		line = 1;
+		line_start = 0;
+		text = 0;
+		next = 0;
+	}
+
+	const char *JSONReader::Read(const char *b, const char *e) {
+		stopped = false;
+		begin = b;
+		const char *p = b;
+		if (text) {
+			p = ReadIndexed(p, e);
+			consumed += p - b;
+			return p;
+		}
+		if (p != e && partial != PARTIAL_NONE) { p = Resume(p, e); }
+		while (p != e && !stopped && expect != EXPECT_DONE && partial == PARTIAL_NONE) {
+			p = SkipSpace(p, e);
+			if (p == e) { break; }
+			p = Token(p, e);
+		}
+		consumed += p - b;
+		return p;
+	}
+
+	bool JSONReader::Index(const char *b, const char *e) {
+		if (text) { return true; }
+		if (consumed != 0 || expect != EXPECT_DOCUMENT || partial != PARTIAL_NONE) { return false; }
+		if (!IndexJSON(b, e, index)) { return false; }
+		text = b;
+		next = 0;
+		return true;
+	}
+
+	const char *JSONReader::ReadIndexed(const char *p, const char *e) {
+		while (next != index.size() && !stopped && expect != EXPECT_DONE) {
+			// Only a number or literal at the very end is left partial,
+			// which Finish finds
+			p = Token(text + index[next++], e);
+		}
+		// What is left after the last token is white space
+		if (next == index.size() && !stopped && expect != EXPECT_DONE) { return e; }
+		return p;
+	}
+
+	void JSONReader::Finish() {
+		begin = 0;
+		if (!Done()) { Error(0); }
+	}
+
+	const char *JSONReader::Resume(const char *p, const char *e) {
+		switch (partial) {
+		case PARTIAL_STRING:
+			{
+				const char *q = FindQuote(p, e);
+				token.append(p, q);
+				if (q == e) { return e; }
+				partial = PARTIAL_NONE;
+				EmitString(token.data(), token.data() + token.size(), partial_key, partial_has_escape, q);
+				return q + 1;
+			}
+		case PARTIAL_SCALAR:
+			{
+				const char *q = p;
+				while (q != e && !Delimiter(*q)) { ++q; }
+				token.append(p, q);
+				if (q == e) { return e; }
+				partial = PARTIAL_NONE;
+				EmitScalar(token.data(), token.data() + token.size(), q);
+				return q;
+			}
+		case PARTIAL_SLASH:
+			if (*p != '*') { Error(p); }
+			comment_star = false;
+			return SkipComment(p + 1, e);
+		case PARTIAL_COMMENT:
+			return SkipComment(p, e);
+		default:
+			return p;
+		}
+	}
+
+	const char *JSONReader::SkipSpace(const char *p, const char *e) {
+		while (p != e) {
+			switch (*p) {
+			case ' ':
+				// Indentation comes in runs
+				if (e - p >= 8 && Load(p) == ONES * ' ') { p += 8; }
+				else { ++p; }
+				break;
+			case '\n':
+				++line;
+				++p;
+				line_start = consumed + (p - begin);
+				break;
+			case '\t':
+			case '\r':
+				++p;
+				break;
+			case '/':
+				if (e - p < 2) {
+					partial = PARTIAL_SLASH;
+					return e;
+				}
+				// Point after the slash, as when it ends a buffer
+				if (p[1] != '*') { Error(p + 1); }
+				comment_star = false;
+				p = SkipComment(p + 2, e);
+				if (partial != PARTIAL_NONE) { return e; }
+				break;
+			default:
+				return p;
+			}
+		}
+		return p;
+	}
+
+	const char *JSONReader::SkipComment(const char *p, const char *e) {
+		for (; p != e; ++p) {
+			if (comment_star && *p == '/') {
+				partial = PARTIAL_NONE;
+				return p + 1;
+			}
+			comment_star = (*p == '*');
+			if (*p == '\n') {
+				++line;
+				line_start = consumed + (p - begin) + 1;
+			}
+		}
+		partial = PARTIAL_COMMENT;
+		return e;
+	}
+
+	const char *JSONReader::Token(const char *p, const char *e) {
+		switch (expect) {
+		case EXPECT_DOCUMENT:
+			if (*p != '{' && *p != '[') { Error(p); }
+			return Value(p, e);
+		case EXPECT_VALUE_OR_END:
+			if (*p == ']') { return End(p); }
+			return Value(p, e);
+		case EXPECT_VALUE:
+			return Value(p, e);
+		case EXPECT_KEY_OR_END:
+			if (*p == '}') { return End(p); }
+			// fall through
+		case EXPECT_KEY:
+			if (*p != '"') { Error(p); }
+			return String(p, e, true);
+		case EXPECT_COLON:
+			if (*p != ':') { Error(p); }
+			expect = EXPECT_VALUE;
+			return p + 1;
+		case EXPECT_COMMA_OR_END:
+			if (*p == ',') {
+				expect = (stack.back() == '{' ? EXPECT_KEY : EXPECT_VALUE);
+				return p + 1;
+			}
+			return End(p);
+		default:
+			Error(p);
+			return e;
+		}
+	}
+
+	const char *JSONReader::Value(const char *p, const char *e) {
+		switch (*p) {
+		case '{':
+			stack.push_back('{');
+			expect = EXPECT_KEY_OR_END;
+			Emit(Internal::SAX_BEGIN_MAP);
+			return p + 1;
+		case '[':
+			stack.push_back('[');
+			expect = EXPECT_VALUE_OR_END;
+			Emit(Internal::SAX_BEGIN_LIST);
+			return p + 1;
+		case '"':
+			return String(p, e, false);
+		case 't': case 'f': case 'n': case '-':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			return Scalar(p, e);
+		default:
+			Error(p);
+			return e;
+		}
+	}
+
+	const char *JSONReader::End(const char *p) {
+		char open = (*p == '}' ? '{' : (*p == ']' ? '[' : 0));
+		if (!open || stack.empty() || stack.back() != open) { Error(p); }
+		stack.pop_back();
+		AfterValue();
+		Emit(open == '{' ? Internal::SAX_END_MAP : Internal::SAX_END_LIST);
+		return p + 1;
+	}
+
+	const char *JSONReader::String(const char *p, const char *e, bool key) {
+		partial_has_escape = false;
+		partial_escape = false;
+		if (text) {
+			// The closing quote is next in the index
+			const char *q = text + index[next++];
+			bool escaped = (memchr(p + 1, '\\', q - p - 1) != 0);
+			EmitString(p + 1, q, key, escaped, q);
+			return q + 1;
+		}
+		const char *q = FindQuote(p + 1, e);
+		if (q == e) {
+			partial = PARTIAL_STRING;
+			partial_key = key;
+			token.assign(p + 1, e);
+			return e;
+		}
+		EmitString(p + 1, q, key, partial_has_escape, q);
+		return q + 1;
+	}
+
+	const char *JSONReader::FindQuote(const char *p, const char *e) {
+		if (partial_escape) {
+			// The character escaped at the end of the last buffer, it is
+			// checked when unescaping
+			if (p == e) { return e; }
+			partial_escape = false;
+			++p;
+		}
+		while (true) {
+			while (e - p >= 8 && !StringSpecial(Load(p))) { p += 8; }
+			if (p == e) { return e; }
+			unsigned char c = *p;
+			if (c == '"') {
+				return p;
+			} else if (c == '\\') {
+				partial_has_escape = true;
+				if (e - p < 2) {
+					partial_escape = true;
+					return e;
+				}
+				p += 2;
+			} else if (c < 0x20) {
+				Error(p);
+			} else {
+				++p;
+			}
+		}
+	}
+
+	void JSONReader::EmitString(const char *b, const char *e, bool key, bool escaped, const char *where) {
+		if (escaped) {
+			unescaped.clear();
+			while (b != e) {
+				const char *slash = static_cast<const char*>(memchr(b, '\\', e - b));
+				if (!slash) {
+					unescaped.append(b, e);
+					break;
+				}
+				unescaped.append(b, slash);
+				b = slash + 2;
+				switch (slash[1]) {
+				case '"': unescaped += '"'; break;
+				case '\\': unescaped += '\\'; break;
+				case '/': unescaped += '/'; break;
+				case 'b': unescaped += '\b'; break;
+				case 'f': unescaped += '\f'; break;
+				case 'n': unescaped += '\n'; break;
+				case 'r': unescaped += '\r'; break;
+				case 't': unescaped += '\t'; break;
+				case 'u':
+					{
+						unsigned c = 0, low = 0;
+						if (!ParseHex4(b, e, c)) { Error(where); }
+						b += 4;
+						if ((c & 0xFC00) == 0xD800) {
+							if (e - b < 6 || b[0] != '\\' || b[1] != 'u' || !ParseHex4(b + 2, e, low)
+									|| (low & 0xFC00) != 0xDC00) {
+								Error(where);
+							}
+							b += 6;
+							c = (((c & 0x3FF) << 10) | (low & 0x3FF)) + 0x10000;
+						} else if ((c & 0xFC00) == 0xDC00) {
+							Error(where);
+						}
+						AppendUTF8(unescaped, c);
+					}
+					break;
+				default:
+					Error(where);
+				}
+			}
+			b = unescaped.data();
+			e = b + unescaped.size();
+		}
+		Internal::SAXEvent event;
+		if (key) {
+			expect = EXPECT_COLON;
+			event.type = Internal::SAX_KEY;
+			event.s.str = b;
+			event.s.len = e - b;
+		} else {
+			AfterValue();
+			JSONStringEvent(b, e - b, event);
+		}
+		Emit(event);
+	}
+
+	const char *JSONReader::Scalar(const char *p, const char *e) {
+		const char *q = p;
+		while (q != e && !Delimiter(*q)) { ++q; }
+		if (q == e) {
+			partial = PARTIAL_SCALAR;
+			token.assign(p, e);
+			return e;
+		}
+		EmitScalar(p, q, q);
+		return q;
+	}
+
+	void JSONReader::EmitScalar(const char *b, const char *e, const char *where) {
+		Internal::SAXEvent event;
+		size_t len = e - b;
+		switch (*b) {
+		case 't':
+			if (len != 4 || memcmp(b, "true", 4) != 0) { Error(where); }
+			event.type = Internal::SAX_BOOL;
+			event.b = true;
+			break;
+		case 'f':
+			if (len != 5 || memcmp(b, "false", 5) != 0) { Error(where); }
+			event.type = Internal::SAX_BOOL;
+			event.b = false;
+			break;
+		case 'n':
+			if (len != 4 || memcmp(b, "null", 4) != 0) { Error(where); }
+			event.type = Internal::SAX_NULL;
+			break;
+		default:
+			{
+				bool is_float = false;
+				if (!CheckNumber(b, e, is_float)) { Error(where); }
+				// Out of range numbers are clamped as sscanf and strtod did
+				if (is_float) {
+					event.type = Internal::SAX_FLOAT;
+					ParseFloat(b, e, event.f);
+				} else if (*b == '-') {
+					event.type = Internal::SAX_INT;
+					ParseInt(b, e, event.i);
+				} else {
+					event.type = Internal::SAX_UNSIGNED;
+					ParseUnsigned(b, e, event.u);
+				}
+			}
+			break;
+		}
+		AfterValue();
+		Emit(event);
+	}
+
+	void JSONReader::Emit(Internal::SAXEvent_t type) {
+		Internal::SAXEvent event;
+		event.type = type;
+		Emit(event);
+	}
+
+	void JSONReader::Error(const char *p) {
+		unsigned position = consumed + (p && begin ? p - begin : 0);
+		if (text) { CountLines(position); }
+		std::ostringstream oss;
+		oss << "JSONParser: An error occurred on line " << line << " column " << position - line_start + 1;
+		throw std::runtime_error(oss.str());
+	}
+
+	/// Reading from the index skips the white space that counts the lines
+	void JSONReader::CountLines(unsigned position) {
+		line = 1;
+		line_start = 0;
+		const char *c = text;
+		const char *end = text + position;
+		while ((c = static_cast<const char*>(memchr(c, '\n', end - c))) != 0) {
+			++c;
+			++line;
+			line_start = c - text;
+		}
+	}
+
+	JSONReaderImpl::JSONReaderImpl(shared_ptr<ParserInput> i)
+		: reader(Sink, this),
+		status(S_START),
+		input(i)
+	{}
+
+	void JSONReaderImpl::Sink(void *ctx, const Internal::SAXEvent &event) {
+		JSONReaderImpl *impl = static_cast<JSONReaderImpl*>(ctx);
+		if (impl->status == S_BEGIN) {
+			impl->status = S_OK;
+		}
+		ParserActionsHandler handler(impl);
+		Internal::SAXDispatch<ParserActionsHandler>(&handler, event);
+		// Whoever took the actions off the stack wants the rest left
+		if (impl->action_stack.empty()) { impl->reader.Stop(); }
+	}
+
+	void JSONReaderImpl::Parse() {
+		while ((status == S_OK || status == S_BEGIN) && !action_stack.empty()) {
+			unsigned len = 0;
+			const char *ptr = static_cast<const char*>(input->GetPtr(len));
+			if (len == 0 || !ptr) {
+				reader.Finish();
+				status = S_END;
+				return;
+			}
+			if (input->InMemory()) { reader.Index(ptr, ptr + len); }
+			const char *end = reader.Read(ptr, ptr + len);
+			input->Release(end - ptr);
+			if (reader.Done()) { status = S_END; }
+		}
+	}
+
+	int JSONReaderImpl::Run() {
+		while (!action_stack.empty()) {
+			switch (status) {
+			case S_START:
+				TopAction()->BeginDocument(this);
+				status = S_BEGIN;
+				return 0;
+			case S_BEGIN:
+			case S_OK:
+				try {
+					Parse();
+				} catch (const std::exception &e) {
+					status = S_ERROR;
+					errorstr = e.what();
+					throw;
+				}
+				break;
+			case S_ERROR:
+				throw std::runtime_error(errorstr);
+			case S_END:
+				status = S_DONE;
+				TopAction()->EndDocument(this);
+				return 1;
+			case S_DONE:
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	bool JSONReaderImpl::Done() const { return status == S_DONE; }
+	bool JSONReaderImpl::Error() const { return status == S_ERROR; }
+	bool JSONReaderImpl::Ok() const { return status == S_OK; }
+	std::string JSONReaderImpl::ErrorStr() const { return errorstr; }
+
+	void JSONReaderImpl::Reset() {
+		reader.Reset();
+		status = S_START;
+		errorstr.clear();
+	}
+
+	void Internal::ParseJSONEvents(shared_ptr<ParserInput> input, SAXSink sink, void *handler) {
+		JSONReader reader(sink, handler);
+		while (!reader.Done()) {
+			unsigned len = 0;
+			const char *ptr = static_cast<const char*>(input->GetPtr(len));
+			if (len == 0 || !ptr) {
+				reader.Finish();
+				break;
+			}
+			if (input->InMemory()) { reader.Index(ptr, ptr + len); }
+			const char *end = reader.Read(ptr, ptr + len);
+			input->Release(end - ptr);
+		}
+	}
+}
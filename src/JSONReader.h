@@ -0,0 +1,171 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief A JSON tokenizer that works on whole buffers at a time.
+ */
+#ifndef VARIANT_JSONREADER_H
+#define VARIANT_JSONREADER_H
+#pragma once
+#include <Variant/Parser.h>
+#include <Variant/ParserInput.h>
+#include <Variant/SAX.h>
+#include <Variant/SharedPtr.h>
+#include <string>
+#include <vector>
+
+namespace libvariant {
+
+	/**
+	 * Turns JSON text into SAX events. The text is handed over a buffer at
+	 * a time with Read: white space and strings are scanned several bytes
+	 * at a time, strings without escapes and numbers are used where they
+	 * are in the buffer, and a token cut by the end of a buffer is kept
+	 * until the next one completes it.
+	 *
+	 * Like the JSON_parser it replaces, a document must be a list or map,
+	 * and C style block comments may go wherever white space can.
+	 */
+	class JSONReader {
+	public:
+		JSONReader(Internal::SAXSink sink, void *handler);
+
+		/**
+		 * Tokenize [b, e), passing each event to the sink. Returns how far
+		 * it got, which is e unless the document ended or Stop was called
+		 * from the sink. Throws on a syntax error.
+		 */
+		const char *Read(const char *b, const char *e);
+		/**
+		 * Before the first Read, when [b, e) is all of the text and stays
+		 * put, find where its tokens are with IndexJSON so Read can go
+		 * straight from one to the next. Returns false if the text has
+		 * what IndexJSON leaves alone, Read then looks at every byte.
+		 */
+		bool Index(const char *b, const char *e);
+		/// There is no more text, throws unless the document is complete.
+		void Finish();
+		/// The document is complete
+		bool Done() const { return expect == EXPECT_DONE; }
+		/// Called from the sink to make Read return after this event
+		void Stop() { stopped = true; }
+		void Reset();
+
+		unsigned GetLine() const { return line; }
+		unsigned GetByteCount() const { return consumed; }
+	private:
+		enum Expect_t {
+			EXPECT_DOCUMENT,
+			EXPECT_VALUE,
+			EXPECT_VALUE_OR_END,
+			EXPECT_KEY,
+			EXPECT_KEY_OR_END,
+			EXPECT_COLON,
+			EXPECT_COMMA_OR_END,
+			EXPECT_DONE
+		};
+
+		/// What the end of the last buffer cut short
+		enum Partial_t {
+			PARTIAL_NONE,
+			PARTIAL_STRING,
+			PARTIAL_SCALAR,
+			PARTIAL_SLASH,
+			PARTIAL_COMMENT
+		};
+
+		const char *Resume(const char *p, const char *e);
+		const char *ReadIndexed(const char *p, const char *e);
+		const char *SkipSpace(const char *p, const char *e);
+		const char *SkipComment(const char *p, const char *e);
+		const char *Token(const char *p, const char *e);
+		const char *Value(const char *p, const char *e);
+		const char *End(const char *p);
+		const char *String(const char *p, const char *e, bool key);
+		const char *FindQuote(const char *p, const char *e);
+		void EmitString(const char *b, const char *e, bool key, bool escaped, const char *where);
+		const char *Scalar(const char *p, const char *e);
+		void EmitScalar(const char *b, const char *e, const char *where);
+		void AfterValue() { expect = (stack.empty() ? EXPECT_DONE : EXPECT_COMMA_OR_END); }
+		void Emit(Internal::SAXEvent &event) { sink(handler, event); }
+		void Emit(Internal::SAXEvent_t type);
+		void Error(const char *p);
+		void CountLines(unsigned position);
+
+		Internal::SAXSink sink;
+		void *handler;
+		/// The open brackets
+		std::vector<char> stack;
+		Expect_t expect;
+		Partial_t partial;
+		/// For a partial string, whether it is a key, whether it has an
+		/// escape, and whether it ends in the middle of one
+		bool partial_key;
+		bool partial_has_escape;
+		bool partial_escape;
+		/// For a partial comment, whether it ends with a star
+		bool comment_star;
+		/// The text of a partial token, or the unescaped characters of a string
+		std::string token;
+		std::string unescaped;
+		bool stopped;
+		/// The text before the current buffer and where it starts
+		unsigned consumed;
+		const char *begin;
+		unsigned line;
+		/// The byte count at the start of the line
+		unsigned line_start;
+		/// The text given to Index, the offsets in it of the tokens and
+		/// which one is next
+		const char *text;
+		std::vector<unsigned> index;
+		size_t next;
+	};
+
+	/// The Parser for JSON, see JSONReader.
+	class JSONReaderImpl : public ParserImpl {
+	public:
+		enum Status_t {
+			S_START,
+			S_BEGIN,
+			S_OK,
+			S_ERROR,
+			S_END,
+			S_DONE
+		};
+		JSONReaderImpl(shared_ptr<ParserInput> i);
+
+		virtual int Run();
+		virtual bool Done() const;
+		virtual bool Error() const;
+		virtual bool Ok() const;
+		virtual std::string ErrorStr() const;
+		virtual void Reset();
+	private:
+		void Parse();
+		static void Sink(void *ctx, const Internal::SAXEvent &event);
+
+		JSONReader reader;
+		Status_t status;
+		shared_ptr<ParserInput> input;
+		std::string errorstr;
+	};
+}
+#endif
@@ -123,6 +123,30 @@ namespace libvariant {
 		}
 	}
 
+	void MsgPackEmitterImpl::EmitList(const intmax_t *v, unsigned len) {
+		if (buffer) { EmitterImpl::EmitList(v, len); }
+		else {
+			msgpack_pack_array(&packer, len);
+			for (unsigned i = 0; i < len; ++i) { msgpack_pack_int64(&packer, v[i]); }
+		}
+	}
+
+	void MsgPackEmitterImpl::EmitList(const uintmax_t *v, unsigned len) {
+		if (buffer) { EmitterImpl::EmitList(v, len); }
+		else {
+			msgpack_pack_array(&packer, len);
+			for (unsigned i = 0; i < len; ++i) { msgpack_pack_uint64(&packer, v[i]); }
+		}
+	}
+
+	void MsgPackEmitterImpl::EmitList(const double *v, unsigned len) {
+		if (buffer) { EmitterImpl::EmitList(v, len); }
+		else {
+			msgpack_pack_array(&packer, len);
+			for (unsigned i = 0; i < len; ++i) { msgpack_pack_double(&packer, v[i]); }
+		}
+	}
+
 	void MsgPackEmitterImpl::Flush() {
 		output->Flush();
 	}
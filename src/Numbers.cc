@@ -0,0 +1,389 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Locale independent conversions between numbers and text.
+ */
+#include "Numbers.h"
+#include <limits>
+#include <string>
+#include <errno.h>
+#include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+// Defined by <charconv> when it converts floating point numbers too
+#ifdef __cpp_lib_to_chars
+#define VARIANT_HAVE_CHARCONV 1
+#endif
+
+namespace libvariant {
+
+	namespace {
+
+		inline unsigned DigitValue(char c) {
+			if (c >= '0' && c <= '9') { return c - '0'; }
+			if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+			if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+			return 16;
+		}
+
+		inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+		/// Parse an optional sign, advancing b past it.
+		inline bool ParseSign(const char *&b, const char *e) {
+			if (b != e && (*b == '+' || *b == '-')) { return *b++ == '-'; }
+			return false;
+		}
+
+		/// Accumulate the digits at b, advancing b past them.
+		NumberStatus ParseMagnitude(const char *&b, const char *e, unsigned base, uintmax_t &value) {
+			const uintmax_t max = std::numeric_limits<uintmax_t>::max();
+			const uintmax_t limit = max / base;
+			const unsigned last = unsigned(max % base);
+			const char *start = b;
+			bool overflow = false;
+			value = 0;
+			for (; b != e; ++b) {
+				unsigned digit = DigitValue(*b);
+				if (digit >= base) { break; }
+				if (value < limit || (value == limit && digit <= last)) {
+					value = value * base + digit;
+				} else {
+					overflow = true;
+				}
+			}
+			if (b == start) { return NUMBER_INVALID; }
+			if (overflow) {
+				value = max;
+				return NUMBER_RANGE;
+			}
+			return NUMBER_OK;
+		}
+
+		/// The end of the float at the start of [b, e), 0 if there is none.
+		const char *ScanFloat(const char *b, const char *e) {
+			const char *c = b;
+			ParseSign(c, e);
+			const char *start = c;
+			while (c != e && IsDigit(*c)) { ++c; }
+			unsigned count = c - start;
+			if (c != e && *c == '.') {
+				start = ++c;
+				while (c != e && IsDigit(*c)) { ++c; }
+				count += c - start;
+			}
+			if (count == 0) { return 0; }
+			if (c != e && (*c == 'e' || *c == 'E')) {
+				const char *x = c + 1;
+				ParseSign(x, e);
+				start = x;
+				while (x != e && IsDigit(*x)) { ++x; }
+				// A dangling exponent is not part of the number
+				if (x != start) { c = x; }
+			}
+			return c;
+		}
+
+		inline double StrToFloat(const char *s, double*) { return strtod(s, 0); }
+		inline long double StrToFloat(const char *s, long double*) { return strtold(s, 0); }
+
+		/// Parse the float in [b, e) with strtod, which wants the decimal
+		/// point of the current locale.
+		template<typename T>
+		NumberStatus LocaleParseFloat(const char *b, const char *e, T &value) {
+			const char *point = localeconv()->decimal_point;
+			size_t point_len = strlen(point);
+			char local[128];
+			std::string large;
+			char *buf = local;
+			size_t len = (e - b) * point_len + 1;
+			if (len > sizeof(local)) {
+				large.resize(len);
+				buf = &large[0];
+			}
+			char *o = buf;
+			for (; b != e; ++b) {
+				if (*b == '.') {
+					memcpy(o, point, point_len);
+					o += point_len;
+				} else {
+					*o++ = *b;
+				}
+			}
+			*o = 0;
+			errno = 0;
+			value = StrToFloat(buf, static_cast<T*>(0));
+			// Only overflow and underflow to zero count, not denormals
+			if (errno == ERANGE && (value == 0 || value > std::numeric_limits<T>::max()
+						|| value < -std::numeric_limits<T>::max())) {
+				return NUMBER_RANGE;
+			}
+			return NUMBER_OK;
+		}
+
+#ifndef VARIANT_HAVE_CHARCONV
+		/// Exact in double when the digits fit in the mantissa and the
+		/// power of ten does too (Clinger's fast path).
+		bool FastParseFloat(const char *b, const char *e, double &value) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+			static const double powers[] = {
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+			bool negative = ParseSign(b, e);
+			uint64_t mantissa = 0;
+			int exponent = 0;
+			unsigned digits = 0;
+			bool fraction = false;
+			for (; b != e; ++b) {
+				if (*b == '.') {
+					fraction = true;
+					continue;
+				}
+				if (!IsDigit(*b)) { break; }
+				if (mantissa != 0 || *b != '0') {
+					if (++digits > 15) { return false; }
+				}
+				mantissa = mantissa * 10 + (*b - '0');
+				if (fraction) { --exponent; }
+			}
+			if (b != e) {
+				// The exponent
+				++b;
+				bool negative_exp = ParseSign(b, e);
+				int x = 0;
+				for (; b != e; ++b) {
+					if (x > 1000) { return false; }
+					x = x * 10 + (*b - '0');
+				}
+				exponent += negative_exp ? -x : x;
+			}
+			if (exponent < -22 || exponent > 22) { return false; }
+			value = double(mantissa);
+			if (exponent < 0) { value /= powers[-exponent]; }
+			else { value *= powers[exponent]; }
+			if (negative) { value = -value; }
+			return true;
+#else
+			return false;
+#endif
+		}
+#endif
+
+		template<typename T>
+		NumberStatus ParseFloatImpl(const char *b, const char *e, T &value, const char **end) {
+			const char *last = ScanFloat(b, e);
+			if (end) { *end = last ? last : b; }
+			if (!last) { return NUMBER_INVALID; }
+#ifdef VARIANT_HAVE_CHARCONV
+			const char *start = (*b == '+' ? b + 1 : b);
+			std::from_chars_result res = std::from_chars(start, last, value, std::chars_format::general);
+			if (res.ec == std::errc()) { return NUMBER_OK; }
+			// Out of range, strtod clamps the value
+			LocaleParseFloat(b, last, value);
+			return NUMBER_RANGE;
+#else
+			return LocaleParseFloat(b, last, value);
+#endif
+		}
+
+		/// Write the first precision significant digits of v, which is
+		/// finite and not negative, correctly rounded to digits and return
+		/// its decimal exponent.
+		int FloatDigits(long double v, unsigned precision, char *digits) {
+			char buf[2 * FLOAT_CHARS];
+			const char *e;
+#ifdef VARIANT_HAVE_CHARCONV
+			std::to_chars_result res;
+			double d = static_cast<double>(v);
+			if (d == v) {
+				res = std::to_chars(buf, buf + sizeof(buf), d, std::chars_format::scientific, precision - 1);
+			} else {
+				res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::scientific, precision - 1);
+			}
+			e = res.ptr;
+#else
+			// The digits and exponent are the same in every locale
+			int len = snprintf(buf, sizeof(buf), "%.*Le", int(precision - 1), v);
+			e = buf + len;
+#endif
+			const char *c = buf;
+			for (unsigned count = 0; c != e && *c != 'e'; ++c) {
+				if (IsDigit(*c) && count < precision) { digits[count++] = *c; }
+			}
+			int exponent = 0;
+			if (c != e) {
+				++c;
+				bool negative = ParseSign(c, e);
+				for (; c != e; ++c) { exponent = exponent * 10 + (*c - '0'); }
+				if (negative) { exponent = -exponent; }
+			}
+			return exponent;
+		}
+
+		const char digit_pairs[] =
+			"0001020304050607080910111213141516171819"
+			"2021222324252627282930313233343536373839"
+			"4041424344454647484950515253545556575859"
+			"6061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+	}
+
+	NumberStatus ParseInt(const char *b, const char *e, intmax_t &value,
+			const char **end, unsigned base) {
+		const char *c = b;
+		bool negative = ParseSign(c, e);
+		uintmax_t magnitude = 0;
+		NumberStatus status = ParseMagnitude(c, e, base, magnitude);
+		if (end) { *end = (status == NUMBER_INVALID ? b : c); }
+		if (status == NUMBER_INVALID) { return status; }
+		const uintmax_t max = uintmax_t(std::numeric_limits<intmax_t>::max());
+		if (negative) {
+			if (status == NUMBER_RANGE || magnitude > max + 1) {
+				value = std::numeric_limits<intmax_t>::min();
+				return NUMBER_RANGE;
+			}
+			value = magnitude == max + 1 ? std::numeric_limits<intmax_t>::min() : -intmax_t(magnitude);
+		} else {
+			if (status == NUMBER_RANGE || magnitude > max) {
+				value = std::numeric_limits<intmax_t>::max();
+				return NUMBER_RANGE;
+			}
+			value = intmax_t(magnitude);
+		}
+		return NUMBER_OK;
+	}
+
+	NumberStatus ParseUnsigned(const char *b, const char *e, uintmax_t &value,
+			const char **end, unsigned base) {
+		const char *c = b;
+		bool negative = ParseSign(c, e);
+		NumberStatus status = ParseMagnitude(c, e, base, value);
+		if (end) { *end = (status == NUMBER_INVALID ? b : c); }
+		if (status == NUMBER_OK && negative) { value = -value; }
+		return status;
+	}
+
+	NumberStatus ParseFloat(const char *b, const char *e, double &value, const char **end) {
+#ifndef VARIANT_HAVE_CHARCONV
+		const char *last = ScanFloat(b, e);
+		if (last && FastParseFloat(b, last, value)) {
+			if (end) { *end = last; }
+			return NUMBER_OK;
+		}
+#endif
+		return ParseFloatImpl(b, e, value, end);
+	}
+
+	NumberStatus ParseFloat(const char *b, const char *e, long double &value, const char **end) {
+		return ParseFloatImpl(b, e, value, end);
+	}
+
+	unsigned FormatUnsigned(uintmax_t v, char *buf) {
+		char tmp[INTEGER_CHARS];
+		char *p = tmp + sizeof(tmp);
+		// Two digits at a time
+		while (v >= 100) {
+			unsigned i = unsigned(v % 100) * 2;
+			v /= 100;
+			*--p = digit_pairs[i + 1];
+			*--p = digit_pairs[i];
+		}
+		if (v >= 10) {
+			unsigned i = unsigned(v) * 2;
+			*--p = digit_pairs[i + 1];
+			*--p = digit_pairs[i];
+		} else {
+			*--p = char('0' + v);
+		}
+		unsigned len = tmp + sizeof(tmp) - p;
+		memcpy(buf, p, len);
+		return len;
+	}
+
+	unsigned FormatInt(intmax_t v, char *buf) {
+		if (v < 0) {
+			*buf = '-';
+			return 1 + FormatUnsigned(-uintmax_t(v), buf + 1);
+		}
+		return FormatUnsigned(uintmax_t(v), buf);
+	}
+
+	unsigned FormatFloat(long double v, unsigned precision, bool showpoint, char *buf) {
+		char *o = buf;
+		if (signbit(v)) {
+			*o++ = '-';
+			v = -v;
+		}
+		if (v != v) {
+			memcpy(o, "nan", 3);
+			return o + 3 - buf;
+		}
+		if (v > std::numeric_limits<long double>::max()) {
+			memcpy(o, "inf", 3);
+			return o + 3 - buf;
+		}
+		if (precision == 0) { precision = 1; }
+		if (precision > MAX_FLOAT_PRECISION) { precision = MAX_FLOAT_PRECISION; }
+		char digits[MAX_FLOAT_PRECISION];
+		int exponent = FloatDigits(v, precision, digits);
+		if (exponent < -4 || exponent >= int(precision)) {
+			// Scientific, d.ddde+XX
+			unsigned count = precision;
+			if (!showpoint) {
+				while (count > 1 && digits[count - 1] == '0') { --count; }
+			}
+			*o++ = digits[0];
+			if (count > 1 || showpoint) { *o++ = '.'; }
+			memcpy(o, digits + 1, count - 1);
+			o += count - 1;
+			*o++ = 'e';
+			*o++ = (exponent < 0 ? '-' : '+');
+			unsigned x = unsigned(exponent < 0 ? -exponent : exponent);
+			if (x < 10) { *o++ = '0'; }
+			o += FormatUnsigned(x, o);
+		} else {
+			// Fixed, the digits before the point are all significant
+			unsigned whole = (exponent >= 0 ? exponent + 1 : 0);
+			unsigned count = precision;
+			if (!showpoint) {
+				while (count > whole && count > 1 && digits[count - 1] == '0') { --count; }
+			}
+			if (whole) {
+				memcpy(o, digits, whole);
+				o += whole;
+			} else {
+				*o++ = '0';
+			}
+			if (count > whole || showpoint) { *o++ = '.'; }
+			for (int i = exponent + 1; i < 0; ++i) { *o++ = '0'; }
+			memcpy(o, digits + whole, count - whole);
+			o += count - whole;
+		}
+		return o - buf;
+	}
+}
@@ -0,0 +1,85 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Locale independent conversions between numbers and text.
+ *
+ * In the style of std::from_chars and std::to_chars: nothing is allocated,
+ * the text is always in the C locale, and floats are correctly rounded.
+ */
+#ifndef VARIANT_NUMBERS_H
+#define VARIANT_NUMBERS_H
+#pragma once
+#include <stdint.h>
+
+namespace libvariant {
+
+	enum NumberStatus {
+		NUMBER_OK,
+		/// The text does not start with a number
+		NUMBER_INVALID,
+		/// The number does not fit, the value is clamped like strtol does
+		NUMBER_RANGE
+	};
+
+	enum {
+		/// Enough room for anything FormatInt or FormatUnsigned writes
+		INTEGER_CHARS = 24,
+		/// FormatFloat writes at most this many significant digits
+		MAX_FLOAT_PRECISION = 64,
+		/// Enough room for anything FormatFloat writes
+		FLOAT_CHARS = MAX_FLOAT_PRECISION + 16
+	};
+
+	/**
+	 * Parse an optionally signed integer in base (2 to 16, without a prefix)
+	 * from the start of [b, e). Leading white space is not skipped. If end is
+	 * given it is set past the last character used.
+	 */
+	NumberStatus ParseInt(const char *b, const char *e, intmax_t &value,
+			const char **end = 0, unsigned base = 10);
+	/// Like ParseInt, a minus sign negates the value like strtoull does.
+	NumberStatus ParseUnsigned(const char *b, const char *e, uintmax_t &value,
+			const char **end = 0, unsigned base = 10);
+	/**
+	 * Parse a decimal float, [+-]digits[.digits][(e|E)[+-]digits], from the
+	 * start of [b, e). A value too large or too small is clamped to
+	 * infinity or zero like strtod does and NUMBER_RANGE returned.
+	 */
+	NumberStatus ParseFloat(const char *b, const char *e, double &value, const char **end = 0);
+	NumberStatus ParseFloat(const char *b, const char *e, long double &value, const char **end = 0);
+
+	/// Write v in decimal to buf, which must hold INTEGER_CHARS. Returns the
+	/// number of characters written, no terminator is added.
+	unsigned FormatInt(intmax_t v, char *buf);
+	unsigned FormatUnsigned(uintmax_t v, char *buf);
+	/**
+	 * Write v to buf like printf("%.*Lg") or, with showpoint, "%#.*Lg" does
+	 * in the C locale, which is also what a std::ostream with setprecision
+	 * and showpoint writes. The precision is limited to
+	 * MAX_FLOAT_PRECISION and buf must hold FLOAT_CHARS.
+	 */
+	unsigned FormatFloat(long double v, unsigned precision, bool showpoint, char *buf);
+
+	/// Skip the white space at the start of [b, e) like the stream
+	/// extraction operators do.
+	inline const char *SkipSpace(const char *b, const char *e) {
+		while (b != e && (*b == ' ' || (*b >= '\t' && *b <= '\r'))) { ++b; }
+		return b;
+	}
+}
+#endif
@@ -23,6 +23,7 @@
 #include <Variant/ParserInput.h>
 #include <stdexcept>
 #include "JSONParser.h"
+#include "JSONReader.h"
 #ifdef ENABLE_YAML
 #include "YAMLParser.h"
 #endif
@@ -94,6 +95,9 @@ namespace libvariant {
 	}
 
 	Parser JSONParser(shared_ptr<ParserInput> i) {
+		return Parser(shared_ptr<ParserImpl>(new JSONReaderImpl(i)));
+	}
+	Parser LegacyJSONParser(shared_ptr<ParserInput> i) {
 		return Parser(shared_ptr<ParserImpl>(new JSONParserImpl(i)));
 	}
 	Parser YAMLParser(shared_ptr<ParserInput> i) {
@@ -33,6 +33,8 @@ namespace libvariant {
 
 	ParserInput::~ParserInput() {}
 
+	bool ParserInput::InMemory() const { return false; }
+
 	//----------------------------------------------------------------------
 	// ParserStreamInput
 
@@ -110,6 +112,32 @@ namespace libvariant {
 		offset += len;
 	}
 
+	bool ParserMemoryInput::InMemory() const { return true; }
+
+	//----------------------------------------------------------------------
+	// ParserStringInput
+
+	ParserStringInput::ParserStringInput(const std::string &str)
+		: val(str), offset(0) {}
+
+	const void *ParserStringInput::GetPtr(unsigned &len) {
+		if (offset > val.size()) {
+			throw std::length_error("Parser input buffer underflow.");
+		}
+		len = val.size() - offset;
+		if (len > 0) {
+			return val.data() + offset;
+		} else {
+			return 0;
+		}
+	}
+
+	void ParserStringInput::Release(unsigned len) {
+		offset += len;
+	}
+
+	bool ParserStringInput::InMemory() const { return true; }
+
 	//----------------------------------------------------------------------
 	// ParserFileInput
 	
@@ -3,6 +3,9 @@
  * \brief 
  */
 #include <Variant/Path.h>
+#include "Numbers.h"
+#include "Atomic.h"
+#include <list>
 #include <sstream>
 
 namespace libvariant {
@@ -20,9 +23,9 @@ namespace libvariant {
 				escape = false;
 			} else if (index) {
 				if (*c == ']') {
-					std::istringstream iss(frag);
-					unsigned long long i = 0;
-					if (!(iss >> i)) {
+					const char *b = frag.data(), *fe = b + frag.size();
+					uintmax_t i = 0;
+					if (ParseUnsigned(SkipSpace(b, fe), fe, i) != NUMBER_OK) {
 						throw std::runtime_error("Error parsing Variant path: \"" + frag + "\" is not a number.");
 					}
 					parsed_path.push_back(i);
@@ -78,10 +81,94 @@ namespace libvariant {
 		return parsed_path;
 	}
 
-	std::string PathString(const Path &path) {
-		if (path.empty()) { return "/"; }
+	CompiledPath::CompiledPath(const std::string &path) {
+		Init(ParsePath(path));
+	}
+
+	CompiledPath::CompiledPath(const char *path) {
+		Init(ParsePath(path));
+	}
+
+	CompiledPath::CompiledPath(const Path &path) {
+		Init(path);
+	}
+
+	void CompiledPath::Init(const Path &path) {
+		if (!path.empty()) {
+			elements.reset(new std::vector<PathElement>(path.begin(), path.end()));
+		}
+	}
+
+	bool CompiledPath::operator==(const CompiledPath &o) const {
+		if (elements == o.elements) { return true; }
+		if (size() != o.size()) { return false; }
+		for (const_iterator i(begin()), j(o.begin()), e(end()); i != e; ++i, ++j) {
+			if (i->IsString() != j->IsString()) { return false; }
+			if (i->IsString()) {
+				if (i->KeyHash() != j->KeyHash() || i->AsString() != j->AsString()) { return false; }
+			} else if (i->AsUnsigned() != j->AsUnsigned()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * The most recently used compiled paths by their string. The cache is
+	 * split into shards by the hash of the string to keep lock contention
+	 * down, each shard forgets its least recently used path when full.
+	 */
+	class PathCache {
+	public:
+		CompiledPath Get(const std::string &path) {
+			size_t hash = HashMapHash<std::string>()(path);
+			Shard &shard = shards[hash % NUM_SHARDS];
+			{
+				MutexLock lock(shard.mutex);
+				Index::iterator entry = shard.index.find(path, hash);
+				if (entry != shard.index.end()) {
+					shard.lru.splice(shard.lru.begin(), shard.lru, entry->second);
+					return entry->second->second;
+				}
+			}
+			// Parse without holding the lock
+			CompiledPath compiled(path);
+			MutexLock lock(shard.mutex);
+			if (shard.index.find(path, hash) == shard.index.end()) {
+				if (shard.lru.size() >= SHARD_CAPACITY) {
+					shard.index.erase(shard.lru.back().first);
+					shard.lru.pop_back();
+				}
+				shard.lru.push_front(std::make_pair(path, compiled));
+				shard.index[path] = shard.lru.begin();
+			}
+			return compiled;
+		}
+
+	private:
+		enum { NUM_SHARDS = 16, SHARD_CAPACITY = 32 };
+		typedef std::list< std::pair<std::string, CompiledPath> > LRUList;
+		typedef HashMap<std::string, LRUList::iterator> Index;
+		struct Shard {
+			Mutex mutex;
+			/// Most recently used first
+			LRUList lru;
+			Index index;
+		};
+		Shard shards[NUM_SHARDS];
+	};
+
+	CompiledPath CompilePath(const std::string &path) {
+		// Never destroyed so that it can still be used at exit
+		static PathCache *cache = new PathCache;
+		return cache->Get(path);
+	}
+
+	template<typename Iter>
+	static std::string PathString(Iter b, Iter e) {
+		if (b == e) { return "/"; }
 		std::ostringstream oss;
-		for (Path::const_iterator i(path.begin()), e(path.end()); i != e; ++i) {
+		for (Iter i(b); i != e; ++i) {
 			if (i->IsString()) {
 				std::string fragment = i->AsString();
 				oss << "/";
@@ -113,4 +200,16 @@ namespace libvariant {
 		return oss.str();
 	}
 
+	std::string PathString(const Path &path) {
+		return PathString(path.begin(), path.end());
+	}
+
+	std::string PathString(const CompiledPath &path) {
+		return PathString(path.begin(), path.end());
+	}
+
+	std::string PathString(const StaticPathView &path) {
+		return PathString(path.begin(), path.end());
+	}
+
 }
@@ -35,6 +35,11 @@ namespace libvariant {
 			state.e.EmitNull();
 			return;
 		}
+		// Nothing to change below here
+		if (!on_len_path && !on_data_path) {
+			state.e << v;
+			return;
+		}
 
 		bool output_len = false;
 		unsigned index = 0;
@@ -129,6 +134,21 @@ namespace libvariant {
 		}
 	}
 
+	static void PayloadPaths(Path &dpath, Path &lpath, SerializeType type, const Variant &params) {
+		std::string data_path, length_path;
+		if (type == SERIALIZE_BUNDLEHDR) {
+			data_path = VARIANT_BUNDLE_PAYLOAD_DATA_PATH;
+			length_path = VARIANT_BUNDLE_PAYLOAD_LENGTH_PATH;
+		} else {
+			data_path = VARIANT_PAYLOAD_DATA_PATH;
+			length_path = VARIANT_PAYLOAD_LENGTH_PATH;
+		}
+		params.GetInto(data_path, "data_path", data_path);
+		params.GetInto(length_path, "length_path", length_path);
+		ParsePath(dpath, data_path);
+		ParsePath(lpath, length_path);
+	}
+
 	void SerializeWithPayload(shared_ptr<EmitterOutput> out, Variant v, SerializeType type, Variant params)
 	{
 		if (!v.IsMap()) {
@@ -137,25 +157,22 @@ namespace libvariant {
 
 		Path dpath;
 		Path lpath;
-		if (type == SERIALIZE_BUNDLEHDR) {
-			ParsePath(dpath, params.Get("data_path", VARIANT_BUNDLE_PAYLOAD_DATA_PATH).AsString());
-			ParsePath(lpath, params.Get("length_path", VARIANT_BUNDLE_PAYLOAD_LENGTH_PATH).AsString());
-		} else {
-			ParsePath(dpath, params.Get("data_path", VARIANT_PAYLOAD_DATA_PATH).AsString());
-			ParsePath(lpath, params.Get("length_path", VARIANT_PAYLOAD_LENGTH_PATH).AsString());
-		}
-		bool ignore_payload = params.Get("ignore_payload", false).AsBool();
+		PayloadPaths(dpath, lpath, type, params);
+		bool ignore_payload;
+		params.GetInto(ignore_payload, "ignore_payload", false);
 		uintmax_t payload_length = 0;
 
-		bool payload_exists = v.HasPath(dpath);
-		BlobPtr blob;
+		const Variant *payload = v.FindPath(dpath);
+		bool payload_exists = payload != 0;
+		ConstBlobPtr blob;
 		if (payload_exists) {
-			blob = v.GetPath(dpath).AsBlob();
+			blob = payload->AsBlob();
 			payload_length = blob->GetTotalLength();
 		} else if (ignore_payload) {
-			payload_length = v.GetPath(lpath, 0).AsUnsigned();
+			const Variant *length = v.FindPath(lpath);
+			if (length) { payload_length = length->AsUnsigned(); }
 		}
-		payload_length = params.Get("payload_length", payload_length).AsUnsigned();
+		params.GetInto(payload_length, "payload_length", payload_length);
 
 
 		Emitter emitter = CreateEmitter(out, type, params);
@@ -233,13 +250,7 @@ namespace libvariant {
 	{
 		Path dpath;
 		Path lpath;
-		if (type == SERIALIZE_BUNDLEHDR) {
-			ParsePath(dpath, params.Get("data_path", VARIANT_BUNDLE_PAYLOAD_DATA_PATH).AsString());
-			ParsePath(lpath, params.Get("length_path", VARIANT_BUNDLE_PAYLOAD_LENGTH_PATH).AsString());
-		} else {
-			ParsePath(dpath, params.Get("data_path", VARIANT_PAYLOAD_DATA_PATH).AsString());
-			ParsePath(lpath, params.Get("length_path", VARIANT_PAYLOAD_LENGTH_PATH).AsString());
-		}
+		PayloadPaths(dpath, lpath, type, params);
 
 		shared_ptr<ParserInput> input(new ProxyInput(in));
 		Parser parser = CreateParser(input, type);
@@ -261,7 +272,12 @@ namespace libvariant {
 			} else { loop = false; }
 		}
 
-		uintmax_t payload_length = ret.GetPath(lpath, 0u).AsUnsigned();
+		uintmax_t payload_length = 0;
+		const Variant *length = ret.FindPath(lpath);
+		if (length && !length->TryAs(payload_length)) {
+			throw std::runtime_error("libvariant: Error parsing payload, "
+					"the payload length is not a number");
+		}
 
 		if (payload_length > 0) {
 			// Note: make a copy when be_safe is true, otherwise just
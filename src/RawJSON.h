@@ -0,0 +1,60 @@
+//=============================================================================
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \author John Bridgman
+ * \brief Lists and maps that are kept as JSON text until they are used.
+ *
+ * DeserializeLazy only parses the top level of a document. Each list or
+ * map below it is a node that remembers where its text is, and is parsed
+ * one level at a time when something looks inside of it.
+ */
+#ifndef VARIANT_RAWJSON_H
+#define VARIANT_RAWJSON_H
+#pragma once
+#include <Variant/Variant.h>
+#include <string>
+
+namespace libvariant {
+	namespace Internal {
+
+		/// The text of a list or map in a document.
+		struct RawJSON {
+			RawJSON() : offset(0), length(0) {}
+			RawJSON(shared_ptr<const std::string> d, unsigned o, unsigned l)
+				: document(d), offset(o), length(l) {}
+			const char *Text() const { return document->data() + offset; }
+
+			shared_ptr<const std::string> document;
+			unsigned offset;
+			unsigned length;
+		};
+
+		/// Return a list or map node that is parsed from raw on first use.
+		Variant LazyJSON(const RawJSON &raw);
+
+		/// Parse one level of raw, the lists and maps in it stay lazy.
+		Variant ParseRawJSON(const RawJSON &raw);
+
+		/**
+		 * If v is a list or map that has not been parsed yet, copy where its
+		 * JSON is to raw and return true. The copy keeps the text alive
+		 * when another thread parses v.
+		 */
+		bool GetRawJSON(const Variant &v, RawJSON &raw);
+	}
+}
+#endif
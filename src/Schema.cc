@@ -25,6 +25,7 @@
 #include <Variant/Schema.h>
 #include <Variant/Path.h>
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <regex.h>
@@ -110,14 +111,15 @@ namespace libvariant {
 		SchemaContext &ctx;
 	};
 
-	void SchemaValidate(SchemaContext &ctx, Variant schema, Variant data);
+	void SchemaValidate(SchemaContext &ctx, const Variant &schema, const Variant &data);
 
-	void ValidateNot(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("not")) { return; }
+	void ValidateNot(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *nt = schema.Find("not");
+		if (!nt) { return; }
 		AutoSchemaPath spath(ctx, "not");
 		SchemaContext notctx(ctx);
 		try {
-			SchemaValidate(notctx, schema["not"], data);
+			SchemaValidate(notctx, *nt, data);
 		} catch (const StopValidation &) {
 			return;
 		}
@@ -125,10 +127,11 @@ namespace libvariant {
 		ctx.AddError("Data matches schema from \"not\"");
 	}
 
-	void ValidateOneOf(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("oneOf")) { return; }
+	void ValidateOneOf(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *oneof = schema.Find("oneOf");
+		if (!oneof) { return; }
 		AutoSchemaPath spath(ctx, "oneOf");
-		if (!schema["oneOf"].IsList()) {
+		if (!oneof->IsList()) {
 			ctx.AddSchemaError("\"oneOf\" must be a list of schemas");
 			return;
 		}
@@ -137,7 +140,7 @@ namespace libvariant {
 		unsigned num_validates = 0;
 		unsigned index = 0;
 		unsigned validIndex = 0;
-		for (Variant::ListIterator i(schema["oneOf"].ListBegin()), e(schema["oneOf"].ListEnd());
+		for (Variant::ConstListIterator i(oneof->ListBegin()), e(oneof->ListEnd());
 				i != e; ++i, ++index)
 		{
 			SchemaContext subctx(ctx);
@@ -161,17 +164,18 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateAnyOf(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("anyOf")) { return; }
+	void ValidateAnyOf(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *anyof = schema.Find("anyOf");
+		if (!anyof) { return; }
 		AutoSchemaPath spath(ctx, "anyOf");
-		if (!schema["anyOf"].IsList()) {
+		if (!anyof->IsList()) {
 			ctx.AddSchemaError("\"anyOf\" must be a list of schemas");
 			return;
 		}
 		ValidationError error("Data does not match any schema from \"anyOf\"",
 			   	ctx.data_path, ctx.schema_path);
 		unsigned index = 0;
-		for (Variant::ListIterator i(schema["anyOf"].ListBegin()), e(schema["anyOf"].ListEnd());
+		for (Variant::ConstListIterator i(anyof->ListBegin()), e(anyof->ListEnd());
 				i != e; ++i, ++index)
 		{
 			SchemaContext subctx(ctx);
@@ -185,15 +189,16 @@ namespace libvariant {
 		ctx.AddError(error);
 	}
 
-	void ValidateAllOf(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("allOf")) { return; }
+	void ValidateAllOf(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *allof = schema.Find("allOf");
+		if (!allof) { return; }
 		AutoSchemaPath spath(ctx, "allOf");
-		if (!schema["allOf"].IsList()) {
+		if (!allof->IsList()) {
 			ctx.AddSchemaError("\"allOf\" must be a list of schemas");
 			return;
 		}
 		unsigned index = 0;
-		for (Variant::ListIterator i(schema["allOf"].ListBegin()), e(schema["allOf"].ListEnd());
+		for (Variant::ConstListIterator i(allof->ListBegin()), e(allof->ListEnd());
 				i != e; ++i, ++index)
 		{
 			AutoSchemaPath spath(ctx, index);
@@ -201,38 +206,43 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateCombinations(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateCombinations(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		ValidateAllOf(ctx, schema, data);
 		ValidateAnyOf(ctx, schema, data);
 		ValidateOneOf(ctx, schema, data);
 		ValidateNot(ctx, schema, data);
 	}
 
-	void ValidateObjectDependenciesHelper(SchemaContext &ctx, const std::string &dep, Variant data) {
-		if (!data.Contains(dep)) {
+	void ValidateObjectDependenciesHelper(SchemaContext &ctx, const std::string &dep, const Variant &data) {
+		if (!data.Find(dep)) {
 			std::ostringstream oss;
 			oss << "Dependency failed - key must exist: " << dep;
 			ctx.AddError(oss.str());
 		}
 	}
 
-	void ValidateObjectDependencies(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("dependencies")) {
-			Variant deps = schema["dependencies"];
+	void ValidateObjectDependencies(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *deps = schema.Find("dependencies");
+		if (deps) {
 			AutoSchemaPath spath(ctx, "dependencies");
-			if (!deps.IsMap()) {
+			if (!deps->IsMap()) {
 				ctx.AddSchemaError("Schema key \"dependencies\" must be an object.");
 				return;
 			}
-			for (Variant::MapIterator i(deps.MapBegin()), e(deps.MapEnd()); i != e; ++i) {
-				if (data.Contains(i->first)) {
+			for (Variant::ConstMapIterator i(deps->MapBegin()), e(deps->MapEnd()); i != e; ++i) {
+				if (data.Find(i->first)) {
 					AutoSchemaPath spath(ctx, i->first);
 					if (i->second.IsString()) {
 						ValidateObjectDependenciesHelper(ctx, i->second.AsString(), data);
 					} else if (i->second.IsList()) {
 						for (unsigned j = 0; j < i->second.Size(); ++j) {
 							AutoSchemaPath spath(ctx, j);
-							ValidateObjectDependenciesHelper(ctx, i->second[j].AsString(), data);
+							std::string dep;
+							if (i->second.TryGet(j, dep)) {
+								ValidateObjectDependenciesHelper(ctx, dep, data);
+							} else {
+								ctx.AddSchemaError("Dependency keys must be strings.");
+							}
 						}
 					} else if (i->second.IsMap()) {
 						SchemaValidate(ctx, i->second, data);
@@ -268,8 +278,8 @@ namespace libvariant {
 		bool Test(const std::string &k) {
 			return regexec(&pattern, k.c_str(), 0, 0, 0) == 0;
 		}
-		Variant GetSchema() { return schema; }
-		std::string GetKey() { return key; }
+		const Variant &GetSchema() const { return schema; }
+		const std::string &GetKey() const { return key; }
 	private:
 		// Can't tell if it is safe to copy regex_t structures...
 		PatternProperty(const PatternProperty &);
@@ -278,14 +288,14 @@ namespace libvariant {
 		Variant schema;
 	};
 
-	void ValidateObjectProperties(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateObjectProperties(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		// Precompile because we always match against all of them for every key
 		std::vector< shared_ptr<PatternProperty> > patternProperties;
-		if (schema.Contains("patternProperties")) {
+		const Variant *patterns = schema.Find("patternProperties");
+		if (patterns) {
 			AutoSchemaPath spath(ctx, "patternProperties");
-			if (schema["patternProperties"].IsMap()) {
-				for (Variant::MapIterator i(schema["patternProperties"].MapBegin()),
-						e(schema["patternProperties"].MapEnd()); i != e; ++i)
+			if (patterns->IsMap()) {
+				for (Variant::ConstMapIterator i(patterns->MapBegin()), e(patterns->MapEnd()); i != e; ++i)
 				{
 					try {
 						patternProperties.push_back(
@@ -302,22 +312,24 @@ namespace libvariant {
 				ctx.AddSchemaError("\"patternProperties\" must be an object");
 			}
 		}
-		Variant properties = schema.Get("properties", Variant::MapType);
-		if (!properties.IsMap()) {
+		const Variant *properties = schema.Find("properties");
+		if (properties && !properties->IsMap()) {
 			ctx.AddSchemaError("\"properties\" must be an object");
-			properties = Variant::MapType;
+			properties = 0;
 		}
-		for (Variant::MapIterator i(data.MapBegin()), e(data.MapEnd());
+		const Variant *additionalProps = schema.Find("additionalProperties");
+		for (Variant::ConstMapIterator i(data.MapBegin()), e(data.MapEnd());
 				i != e; ++i)
 		{
 			bool matchFound = false;
 			AutoDataPath dpath(ctx, i->first);
 			// Validate against property declarations
-			if (properties.Contains(i->first)) {
+			const Variant *property = properties ? properties->Find(i->first) : 0;
+			if (property) {
 				AutoSchemaPath spath(ctx, "properties");
 				AutoSchemaPath spath2(ctx, i->first);
 				matchFound = true;
-				SchemaValidate(ctx, properties[i->first], i->second);
+				SchemaValidate(ctx, *property, i->second);
 			}
 			// Validate against all matching patternProperties declarations
 			for (unsigned j = 0; j < patternProperties.size(); ++j) {
@@ -330,36 +342,35 @@ namespace libvariant {
 			}
 			// If no match was found for either of the previous cases validate
 			// against additionalProperties
-			if (!matchFound && schema.Contains("additionalProperties")) {
-				Variant additionalProps = schema["additionalProperties"];
+			if (!matchFound && additionalProps) {
 				AutoSchemaPath spath(ctx, "additionalProperties");
-				if (additionalProps.IsBool()) {
-					if (!additionalProps.AsBool()) {
+				if (additionalProps->IsBool()) {
+					if (!additionalProps->AsBool()) {
 						ctx.AddError("Additional properties not allowed.");
 					}
 				} else {
-					SchemaValidate(ctx, additionalProps, i->second);
+					SchemaValidate(ctx, *additionalProps, i->second);
 				}
 			}
 		}
 	}
 
-	void ValidateObjectRequiredProperties(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("required")) {
+	void ValidateObjectRequiredProperties(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *required = schema.Find("required");
+		if (required) {
 			unsigned index = 0;
-			Variant required = schema["required"];
 			AutoSchemaPath spath(ctx, "required");
-			if (!required.IsList()) {
+			if (!required->IsList()) {
 				ctx.AddSchemaError("\"required\" must be a list of required keys");
 				return;
 			}
-			for (Variant::ListIterator i(required.ListBegin()), e(required.ListEnd());
+			for (Variant::ConstListIterator i(required->ListBegin()), e(required->ListEnd());
 					i != e; ++i, ++index)
 			{
 				AutoSchemaPath spath(ctx, index);
 				if (i->IsString()) {
 					std::string key = i->AsString();
-					if (!data.Contains(key)) {
+					if (!data.Find(key)) {
 						std::ostringstream oss;
 						oss << "Missing required property: " << key;
 						ctx.AddError(oss.str());
@@ -372,11 +383,12 @@ namespace libvariant {
 		// TODO: Add v3 compatibility by checking required keys in properties?
 	}
 
-	void ValidateObjectMinMaxProperties(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("minProperties")) {
+	void ValidateObjectMinMaxProperties(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *min_props = schema.Find("minProperties");
+		if (min_props) {
 			AutoSchemaPath spath(ctx, "minProperties");
-			if (schema["minProperties"].IsNumber()) {
-				uintmax_t minprops = schema["minProperties"].AsUnsigned();
+			if (min_props->IsNumber()) {
+				uintmax_t minprops = min_props->AsUnsigned();
 				if (data.Size() < minprops) {
 					std::ostringstream oss;
 					oss << "Too few properties defined (" << data.Size() << "), minimum " << minprops;
@@ -386,10 +398,11 @@ namespace libvariant {
 				ctx.AddSchemaError("\"minProperties\" must be a number");
 			}
 		}
-		if (schema.Contains("maxProperties")) {
+		const Variant *max_props = schema.Find("maxProperties");
+		if (max_props) {
 			AutoSchemaPath spath(ctx, "maxProperties");
-			if (schema["maxProperties"].IsNumber()) {
-				uintmax_t maxprops = schema["maxProperties"].AsUnsigned();
+			if (max_props->IsNumber()) {
+				uintmax_t maxprops = max_props->AsUnsigned();
 				if (data.Size() > maxprops) {
 					std::ostringstream oss;
 					oss << "Too many properties defined (" << data.Size() << "), maximum " << maxprops;
@@ -401,7 +414,7 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateObject(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateObject(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		if (!data.IsMap() || data.IsNull()) { return; }
 		ValidateObjectMinMaxProperties(ctx, schema, data);
 		ValidateObjectRequiredProperties(ctx, schema, data);
@@ -409,27 +422,28 @@ namespace libvariant {
 		ValidateObjectDependencies(ctx, schema, data);
 	}
 
-	void ValidateArrayItems(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("items")) { return; }
+	void ValidateArrayItems(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *items = schema.Find("items");
+		if (!items) { return; }
 		if (!data.IsList()) { return; }
-		if (schema["items"].IsList()) {
-			Variant items = schema["items"];
+		if (items->IsList()) {
+			const Variant *additional = schema.Find("additionalItems");
 			unsigned datalength = data.Size();
-			unsigned itemlength = items.Size();
+			unsigned itemlength = items->Size();
 			for (unsigned i(0); i < datalength; ++i) {
 				AutoDataPath dpath(ctx, i);
 				if (i < itemlength) {
 					AutoSchemaPath spath(ctx, "items");
 					AutoSchemaPath spath2(ctx, i);
-					SchemaValidate(ctx, items[i], data[i]);
-				} else if (schema.Contains("additionalItems")) {
+					SchemaValidate(ctx, (*items)[i], data[i]);
+				} else if (additional) {
 					AutoSchemaPath spath(ctx, "additionalItems");
-					if (schema["additionalItems"].IsBool()) {
-						if (!schema["additionalItems"].AsBool()) {
+					if (additional->IsBool()) {
+						if (!additional->AsBool()) {
 							ctx.AddError("Additional items not allowed");
 						}
 					} else {
-						SchemaValidate(ctx, schema["additionalItems"], data[i]);
+						SchemaValidate(ctx, *additional, data[i]);
 					}
 				}
 			}
@@ -438,36 +452,58 @@ namespace libvariant {
 			AutoSchemaPath spath(ctx, "items");
 			for (unsigned i(0); i < datalength; ++i) {
 				AutoDataPath dpath(ctx, i);
-				SchemaValidate(ctx, schema["items"], data[i]);
+				SchemaValidate(ctx, *items, data[i]);
 			}
 		}
 	}
 
-	void ValidateArrayUniqueItems(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("uniqueItems")) { return; }
+	/// Orders indices into a list by the items at them.
+	struct ItemIndexLess {
+		ItemIndexLess(const Variant &l) : list(l) {}
+		bool operator()(unsigned lhs, unsigned rhs) const { return list.At(lhs) < list.At(rhs); }
+		const Variant &list;
+	};
+
+	void ValidateArrayUniqueItems(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *unique = schema.Find("uniqueItems");
+		if (!unique) { return; }
 		AutoSchemaPath spath(ctx, "uniqueItems");
-		if (!schema["uniqueItems"].IsBool()) {
+		if (!unique->IsBool()) {
 			ctx.AddSchemaError("\"uniqueItems\" must be a boolean");
 			return;
 		}
-		if (!schema["uniqueItems"].AsBool()) { return; }
+		if (!unique->AsBool()) { return; }
 		unsigned length = data.Size();
-		for (unsigned i(0); i < length; ++i) {
-			for (unsigned j(i+1); j < length; ++j) {
-				if (data[i].Comparable(data[j]) && data[i] == data[j]) {
-					std::ostringstream oss;
-					oss << "Array items are not unique (indices " << i << " and " << j << ")";
-					ctx.AddError(oss.str());
+		// Sort the indices so that equal items end up next to each other,
+		// the stable sort keeps the indices of a run ascending.
+		std::vector<unsigned> order(length);
+		for (unsigned i(0); i < length; ++i) { order[i] = i; }
+		const Variant &items = data;
+		std::stable_sort(order.begin(), order.end(), ItemIndexLess(items));
+		std::vector<std::pair<unsigned, unsigned> > duplicates;
+		for (unsigned start(0), end(1); start < length; start = end++) {
+			while (end < length && items.At(order[start]) == items.At(order[end])) { ++end; }
+			for (unsigned i(start); i < end; ++i) {
+				for (unsigned j(i+1); j < end; ++j) {
+					duplicates.push_back(std::make_pair(order[i], order[j]));
 				}
 			}
 		}
+		std::sort(duplicates.begin(), duplicates.end());
+		for (unsigned i(0); i < duplicates.size(); ++i) {
+			std::ostringstream oss;
+			oss << "Array items are not unique (indices " << duplicates[i].first
+				<< " and " << duplicates[i].second << ")";
+			ctx.AddError(oss.str());
+		}
 	}
 
-	void ValidateArrayLength(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("minItems")) {
+	void ValidateArrayLength(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *min_items = schema.Find("minItems");
+		if (min_items) {
 			AutoSchemaPath spath(ctx, "minItems");
-			if (schema["minItems"].IsNumber()) {
-				uintmax_t minItems = schema["minItems"].AsUnsigned();
+			if (min_items->IsNumber()) {
+				uintmax_t minItems = min_items->AsUnsigned();
 				if (data.Size() < minItems) {
 					std::ostringstream oss;
 					oss << "Array is to short (" << data.Size() << "), minimum " << minItems;
@@ -477,10 +513,11 @@ namespace libvariant {
 				ctx.AddSchemaError("\"minItems\" must be a number");
 			}
 		}
-		if (schema.Contains("maxItems")) {
+		const Variant *max_items = schema.Find("maxItems");
+		if (max_items) {
 			AutoSchemaPath spath(ctx, "maxItems");
-			if (schema["maxItems"].IsNumber()) {
-				uintmax_t maxItems = schema["maxItems"].AsUnsigned();
+			if (max_items->IsNumber()) {
+				uintmax_t maxItems = max_items->AsUnsigned();
 				if (data.Size() > maxItems) {
 					std::ostringstream oss;
 					oss << "Array is to long (" << data.Size() << "), maximum " << maxItems;
@@ -492,18 +529,19 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateArray(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateArray(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		if (!data.IsList()) { return; }
 		ValidateArrayLength(ctx, schema, data);
 		ValidateArrayUniqueItems(ctx, schema, data);
 		ValidateArrayItems(ctx, schema, data);
 	}
 
-	void ValidateStringFormat(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("format")) { return; }
+	void ValidateStringFormat(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *fmt = schema.Find("format");
+		if (!fmt) { return; }
 		AutoSchemaPath spath(ctx, "format");
-		if (!schema["format"].IsString()) { return; }
-		std::string format = schema["format"].AsString();
+		if (!fmt->IsString()) { return; }
+		std::string format = fmt->AsString();
 		regex_t pattern;
 		memset(&pattern, 0, sizeof(regex_t));
 		std::string patternstr;
@@ -569,16 +607,17 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateStringPattern(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("pattern")) { return; }
+	void ValidateStringPattern(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *pat = schema.Find("pattern");
+		if (!pat) { return; }
 		AutoSchemaPath spath(ctx, "pattern");
-		if (!schema["pattern"].IsString()) {
+		if (!pat->IsString()) {
 			ctx.AddSchemaError("\"pattern\" must be a string");
 			return;
 		}
 		regex_t pattern;
 		memset(&pattern, 0, sizeof(regex_t));
-		std::string patternstr = schema["pattern"].AsString();
+		std::string patternstr = pat->AsString();
 		int err;
 		if ((err = regcomp(&pattern, patternstr.c_str(), REG_EXTENDED | REG_NOSUB))) {
 			std::vector<char> buffer(8192);
@@ -603,29 +642,31 @@ namespace libvariant {
 		regfree(&pattern);
 	}
 
-	void ValidateStringLength(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("minLength")) {
+	void ValidateStringLength(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *min_length = schema.Find("minLength");
+		if (min_length) {
 			AutoSchemaPath spath(ctx, "minLength");
-			if (schema["minLength"].IsNumber()) {
+			if (min_length->IsNumber()) {
 				// TODO: Get encoded length rather than byte length?
-				if (data.Size() < schema["minLength"].AsUnsigned()) {
+				if (data.Size() < min_length->AsUnsigned()) {
 					std::ostringstream oss;
 					oss << "String is too short (" << data.Size() << " chars), minimum "
-						<< schema["minLength"].AsUnsigned();
+						<< min_length->AsUnsigned();
 					ctx.AddError(oss.str());
 				}
 			} else {
 				ctx.AddSchemaError("\"minLength\" must be a number");
 			}
 		}
-		if (schema.Contains("maxLength")) {
+		const Variant *max_length = schema.Find("maxLength");
+		if (max_length) {
 			AutoSchemaPath spath(ctx, "maxLength");
-			if (schema["maxLength"].IsNumber()) {
+			if (max_length->IsNumber()) {
 				// TODO: Get encoded length rather than byte length?
-				if (data.Size() > schema["maxLength"].AsUnsigned()) {
+				if (data.Size() > max_length->AsUnsigned()) {
 					std::ostringstream oss;
 					oss << "String is too long (" << data.Size() << " chars), maximum "
-						<< schema["maxLength"].AsUnsigned();
+						<< max_length->AsUnsigned();
 					ctx.AddError(oss.str());
 				}
 			} else {
@@ -634,29 +675,33 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateString(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateString(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		if (!data.IsString()) { return; }
 		ValidateStringLength(ctx, schema, data);
 		ValidateStringPattern(ctx, schema, data);
 		ValidateStringFormat(ctx, schema, data);
 	}
 
-	void ValidateMinMax(SchemaContext &ctx, Variant schema, Variant data) {
-		if (schema.Contains("minimum")) {
-			if (schema["minimum"].IsNumber()) {
-				if (data < schema["minimum"]) {
+	void ValidateMinMax(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *minimum = schema.Find("minimum");
+		if (minimum) {
+			if (minimum->IsNumber()) {
+				if (data < *minimum) {
 					AutoSchemaPath spath(ctx, "minimum");
 					std::ostringstream oss;
 					oss << "Value " << data.AsString()
-						<< " is less than minimum " << schema["minimum"].AsString();
+						<< " is less than minimum " << minimum->AsString();
 					ctx.AddError(oss.str());
 				}
-				if (schema.Contains("exclusiveMinimum") && schema["exclusiveMinimum"].AsBool()
-						&& data == schema["minimum"]) {
+				const Variant *exclusiveMin = schema.Find("exclusiveMinimum");
+				if (exclusiveMin && !exclusiveMin->IsBool()) {
+					AutoSchemaPath spath(ctx, "exclusiveMinimum");
+					ctx.AddSchemaError("\"exclusiveMinimum\" must be a boolean");
+				} else if (exclusiveMin && exclusiveMin->AsBool() && data == *minimum) {
 					AutoSchemaPath spath(ctx, "exclusiveMinimum");
 					std::ostringstream oss;
 					oss << "Value " << data.AsString() << " is equal to exclusive minimum "
-						<< schema["minimum"].AsString();
+						<< minimum->AsString();
 					ctx.AddError(oss.str());
 				}
 			} else {
@@ -664,21 +709,25 @@ namespace libvariant {
 				ctx.AddSchemaError("\"minimum\" must be a number");
 			}
 		}
-		if (schema.Contains("maximum")) {
-			if (schema["maximum"].IsNumber()) {
-				if (data > schema["maximum"]) {
+		const Variant *maximum = schema.Find("maximum");
+		if (maximum) {
+			if (maximum->IsNumber()) {
+				if (data > *maximum) {
 					AutoSchemaPath spath(ctx, "maximum");
 					std::ostringstream oss;
 					oss << "Value " << data.AsString()
-						<< " is greater than maximum " << schema["maximum"].AsString();
+						<< " is greater than maximum " << maximum->AsString();
 					ctx.AddError(oss.str());
 				}
-				if (schema.Contains("exclusiveMaximum") && schema["exclusiveMaximum"].AsBool()
-						&& data == schema["maximum"]) {
+				const Variant *exclusiveMax = schema.Find("exclusiveMaximum");
+				if (exclusiveMax && !exclusiveMax->IsBool()) {
+					AutoSchemaPath spath(ctx, "exclusiveMaximum");
+					ctx.AddSchemaError("\"exclusiveMaximum\" must be a boolean");
+				} else if (exclusiveMax && exclusiveMax->AsBool() && data == *maximum) {
 					AutoSchemaPath spath(ctx, "exclusiveMaximum");
 					std::ostringstream oss;
 					oss << "Value " << data.AsString()
-						<< " is equal to exclusive maximum " << schema["maximum"].AsString();
+						<< " is equal to exclusive maximum " << maximum->AsString();
 					ctx.AddError(oss.str());
 				}
 			} else {
@@ -688,17 +737,16 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateMultipleOf(SchemaContext &ctx, Variant schema, Variant data) {
-		std::string multkey;
-		if (schema.Contains("multipleOf")) {
-			multkey = "multipleOf";
-		} else if (schema.Contains("divisibleBy")) {
+	void ValidateMultipleOf(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const char *multkey = "multipleOf";
+		const Variant *mult = schema.Find(multkey);
+		if (!mult) {
 			multkey = "divisibleBy";
-		} else {
-			return;
+			mult = schema.Find(multkey);
 		}
+		if (!mult) { return; }
 		AutoSchemaPath spath(ctx, multkey);
-		Variant multipleof = schema[multkey];
+		const Variant &multipleof = *mult;
 		if (!multipleof.IsNumber() || multipleof < 0) {
 			std::ostringstream oss;
 			oss << "\"" << multkey << "\" must be a positive number";
@@ -728,21 +776,21 @@ namespace libvariant {
 		}
 	}
 
-	void ValidateNumeric(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateNumeric(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		if (!data.IsNumber()) { return; }
 		ValidateMultipleOf(ctx, schema, data);
 		ValidateMinMax(ctx, schema, data);
 	}
 
-	void ValidateEnum(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("enum")) { return; }
-		Variant enm = schema["enum"];
+	void ValidateEnum(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *enm = schema.Find("enum");
+		if (!enm) { return; }
 		AutoSchemaPath spath(ctx, "enum");
-		if (!enm.IsList()) {
+		if (!enm->IsList()) {
 			ctx.AddSchemaError("\"enum\" must be an array");
 			return;
 		}
-		for (Variant::ListIterator i(enm.ListBegin()), e(enm.ListEnd()); i!=e; ++i) {
+		for (Variant::ConstListIterator i(enm->ListBegin()), e(enm->ListEnd()); i!=e; ++i) {
 			if (i->Comparable(data) && *i == data) { return; }
 		}
 		std::ostringstream oss;
@@ -751,16 +799,17 @@ namespace libvariant {
 		ctx.AddError(oss.str());
 	}
 
-	void ValidateType(SchemaContext &ctx, Variant schema, Variant data) {
-		if (!schema.Contains("type")) { return; }
+	void ValidateType(SchemaContext &ctx, const Variant &schema, const Variant &data) {
+		const Variant *type = schema.Find("type");
+		if (!type) { return; }
 		AutoSchemaPath spath(ctx, "type");
 		std::vector<Variant> allowed_types;
-		if (schema["type"].IsList()) {
-			allowed_types = schema["type"].AsList();
+		if (type->IsList()) {
+			allowed_types = type->AsList();
 		} else {
 			// TODO: v3 compatibility
-			// if (schema["type"] == "any") { return; }
-			allowed_types.push_back(schema["type"]);
+			// if (*type == "any") { return; }
+			allowed_types.push_back(*type);
 		}
 		std::ostringstream oss;
 		unsigned index = 0;
@@ -803,17 +852,18 @@ namespace libvariant {
 		ctx.AddError(oss.str());
 	}
 
-	void ValidateBasic(SchemaContext &ctx, Variant schema, Variant data) {
+	void ValidateBasic(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		ValidateType(ctx, schema, data);
 		ValidateEnum(ctx, schema, data);
 	}
 
-	void SchemaValidate(SchemaContext &ctx, Variant schema, Variant data) {
+	void SchemaValidate(SchemaContext &ctx, const Variant &schema, const Variant &data) {
 		AutoDepth depth(ctx);
 		// Empty schema always validates
 		if (!schema.IsMap()) { return; }
-		if (schema.Contains("$ref") && schema["$ref"].IsString()) {
-			SchemaValidate(ctx, ctx.loader->GetSchema(schema["$ref"].AsString()), data);
+		const Variant *ref = schema.Find("$ref");
+		if (ref && ref->IsString()) {
+			SchemaValidate(ctx, ctx.loader->GetSchema(ref->AsString()), data);
 		}
 		ValidateBasic(ctx, schema, data);
 		ValidateNumeric(ctx, schema, data);
@@ -840,45 +890,49 @@ namespace libvariant {
 		return ctx.result;
 	}
 
-	void AddSchemaDefaultsImpl(Variant schema, VariantRef data, SchemaLoader *loader);
+	void AddSchemaDefaultsImpl(const Variant &schema, VariantRef data, SchemaLoader *loader);
 
-	void AddSchemaListDefaultsImpl(VariantRef slist, VariantRef data, SchemaLoader *loader) {
-		if (slist.Exists() && slist.IsList()) {
-			for (Variant::ListIterator i(slist.ListBegin()), e(slist.ListEnd()); i != e; ++i) {
+	void AddSchemaListDefaultsImpl(const Variant *slist, VariantRef data, SchemaLoader *loader) {
+		if (slist && slist->IsList()) {
+			for (Variant::ConstListIterator i(slist->ListBegin()), e(slist->ListEnd()); i != e; ++i) {
 				AddSchemaDefaultsImpl(*i, data, loader);
 			}
 		}
 	}
 
-	void AddSchemaDefaultsImpl(Variant schema, VariantRef data, SchemaLoader *loader) {
+	void AddSchemaDefaultsImpl(const Variant &schema, VariantRef data, SchemaLoader *loader) {
 		if (!schema.IsMap()) { return; }
-		if (schema.Contains("$ref") && schema["$ref"].IsString()) {
-			AddSchemaDefaultsImpl(loader->GetSchema(schema["$ref"].AsString()), data, loader);
+		const Variant *ref = schema.Find("$ref");
+		if (ref && ref->IsString()) {
+			AddSchemaDefaultsImpl(loader->GetSchema(ref->AsString()), data, loader);
 		}
-		if (schema.Contains("default") && (!data.Exists() || data.IsNull())) {
-			data = schema["default"].Copy();
+		const Variant *def = schema.Find("default");
+		if (def && (!data.Exists() || data.IsNull())) {
+			data = def->Copy();
 			return;
 		}
-		if (schema.Contains("properties") && (!data.Exists() || data.IsMap())) {
-			for (Variant::MapIterator i(schema["properties"].MapBegin()), e(schema["properties"].MapEnd());
+		const Variant *properties = schema.Find("properties");
+		if (properties && (!data.Exists() || data.IsMap())) {
+			for (Variant::ConstMapIterator i(properties->MapBegin()), e(properties->MapEnd());
 					i != e; ++i)
 			{
 				AddSchemaDefaultsImpl(i->second, data.At(i->first), loader);
 			}
 		}
-		if (schema.Contains("items") && (!data.Exists() || data.IsList())) {
-			if (schema["items"].IsList()) {
-				for (unsigned i = 0; i < schema["items"].Size(); ++i)
+		const Variant *items = schema.Find("items");
+		if (items && (!data.Exists() || data.IsList())) {
+			if (items->IsList()) {
+				for (unsigned i = 0; i < items->Size(); ++i)
 				{
-					AddSchemaDefaultsImpl(schema["items"][i], data[i], loader);
+					AddSchemaDefaultsImpl((*items)[i], data[i], loader);
 				}
 			} else {
-				AddSchemaDefaultsImpl(schema["items"], data[0], loader);
+				AddSchemaDefaultsImpl(*items, data[0], loader);
 			}
 		}
-		AddSchemaListDefaultsImpl(schema["allOf"], data, loader);
-		AddSchemaListDefaultsImpl(schema["oneOf"], data, loader);
-		AddSchemaListDefaultsImpl(schema["anyOf"], data, loader);
+		AddSchemaListDefaultsImpl(schema.Find("allOf"), data, loader);
+		AddSchemaListDefaultsImpl(schema.Find("oneOf"), data, loader);
+		AddSchemaListDefaultsImpl(schema.Find("anyOf"), data, loader);
 	}
 
 	void AddSchemaDefaults(Variant schema, VariantRef data, SchemaLoader *loader) {
@@ -118,7 +118,7 @@ namespace libvariant {
 	}
 
 	Variant SchemaLoader::GetSchema(const std::string &uri) {
-		Variant::MapIterator iter = schemas.find(uri);
+		std::map<std::string, Variant>::iterator iter = schemas.find(uri);
 		if (iter != schemas.end()) {
 			return iter->second;
 		}
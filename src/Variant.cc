@@ -20,13 +20,20 @@
  * Variant implementation
  */
 #include <Variant/Variant.h>
+#include <Variant/Visit.h>
 #include "ParseBool.h"
+#include "Atomic.h"
+#include "ArenaImpl.h"
+#include "Numbers.h"
+#include "RawJSON.h"
 #include <sstream>
 #include <stdexcept>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <algorithm>
+#include <limits>
+#include <new>
 
 template<typename T>
 class my_modulus {
@@ -109,31 +116,311 @@ namespace libvariant {
 
 	namespace Internal {
 
+		//--------------------
+		// Storage
+		//--------------------
+
+		/// Base for everything a node keeps on the heap.  The reference
+		/// count is intrusive so that a node only needs a single pointer.
+		/// While an ArenaScope is active storage comes from its arena.
+		struct Storage {
+			Storage() : refcount(1), copy_on_write(false), dirty(false),
+				in_arena(CurrentArena() != 0) {}
+
+			virtual ~Storage() {}
+
+			static void *operator new(size_t len) {
+				ArenaImpl *arena = CurrentArena();
+				if (arena) { return arena->Allocate(len); }
+				return ::operator new(len);
+			}
+
+			static void operator delete(void *p) {
+				// Storage in an arena only gets here if its constructor
+				// threw, the memory goes back with the arena
+				ArenaImpl *arena = CurrentArena();
+				if (!arena || !arena->IsLast(p)) { ::operator delete(p); }
+			}
+
+			AtomicCount refcount;
+			/// Set by Variant::Snapshot, a container with this set is cloned
+			/// instead of written to while it is shared.
+			bool copy_on_write;
+			/// Set when a copy on write container has been written to, its
+			/// elements may not be marked copy on write yet.
+			bool dirty;
+			bool in_arena;
+		};
+
+		static inline Storage *Retain(Storage *s) {
+			s->refcount.Increment();
+			return s;
+		}
+
+		static inline void Release(Storage *s) {
+			if (s->refcount.Decrement() == 0) {
+				if (s->in_arena) {
+					// The memory goes back with the arena
+					s->~Storage();
+				} else {
+					delete s;
+				}
+			}
+		}
+
+		/// A copy of the text of a lazy list or map, 0 once it is parsed
+		static RawJSON *CopyRaw(const AtomicPointer<RawJSON> &raw);
+
+		/**
+		 * Shared by every reference to a node. Once a node is referenced its
+		 * value is moved into value and the node itself becomes a RefKind
+		 * node flagged with HasRefData that holds one count, so moving the
+		 * node moves the references along with it. Destructing the node
+		 * invalidates them.
+		 *
+		 * The mirrors of small containers instead point target at an item
+		 * that stays put for as long as the mirror is around.
+		 *
+		 * value is the first member of a standard layout struct so that
+		 * BoxOf can find the RefData a value flagged InBox is kept in.
+		 */
 		struct RefData {
-			RefData() : valid(true) {}
+			RefData() : value(), refcount(1), target(&value), valid(true) { value.flags = InBox; }
+			RefData(Data *t) : value(), refcount(1), target(t), valid(true) {}
+			Data value;
+			AtomicCount refcount;
+			Data *target;
 			bool valid;
 		};
 
-		struct Storage {
-			Storage() {}
+		static inline RefData *Retain(RefData *ref) {
+			ref->refcount.Increment();
+			return ref;
+		}
 
-			virtual ~Storage() {}
+		static inline void Release(RefData *ref) {
+			if (ref->refcount.Decrement() == 0) { delete ref; }
+		}
+
+		static inline RefData *BoxOf(Data *value)
+		{ return reinterpret_cast<RefData*>(value); }
 
+		/// Base of list and map storage. The hash of the tree is remembered
+		/// while the container is copy on write and has not been written to
+		/// since, and nothing can write to an element without going through
+		/// the container, as nothing in the tree can change then.
+		struct ContainerStorage : public Storage {
+			ContainerStorage() : hash(0), hash_cached(false), exposed(false) {}
+			size_t hash;
+			bool hash_cached;
+			/// Set once Find, AsList or AsMap has handed out a pointer or
+			/// reference to an element, it may still be written through.
+			bool exposed;
 		};
 
-		struct MapStorage : public Storage {
-			MapStorage(const Variant::Map &m) : map(m) {}
-			Variant::Map map;
+		/**
+		 * The elements of a list of numbers that all have the same type,
+		 * kept contiguously. Only the vector for type is used.
+		 */
+		struct PackedArray {
+			/// type is IntegerType, UnsignedType or FloatType
+			PackedArray(Variant::Type_t t) : type(t) {}
+
+			unsigned Size() const {
+				switch (type) {
+				case VariantDefines::IntegerType: return ints.size();
+				case VariantDefines::UnsignedType: return unsigneds.size();
+				default: return floats.size();
+				}
+			}
+
+			Variant Get(unsigned i) const {
+				switch (type) {
+				case VariantDefines::IntegerType: return Variant(ints[i]);
+				case VariantDefines::UnsignedType: return Variant(unsigneds[i]);
+				default: return Variant(floats[i]);
+				}
+			}
+
+			const void *Elements() const {
+				switch (type) {
+				case VariantDefines::IntegerType: return &ints[0];
+				case VariantDefines::UnsignedType: return &unsigneds[0];
+				default: return &floats[0];
+				}
+			}
+
+			Variant::Type_t type;
+			std::vector<intmax_t> ints;
+			std::vector<uintmax_t> unsigneds;
+			std::vector<double> floats;
 		};
 
-		struct ListStorage : public Storage {
-			ListStorage(const Variant::List &l) : list(l) {}
-			Variant::List list;
+		/**
+		 * Up to SmallCapacity elements are kept inline in items. The list
+		 * is moved into a std::vector when it grows past that or when
+		 * AsList() is called.
+		 *
+		 * A longer list of numbers of one type may instead be packed, then
+		 * the elements are only turned into Variants when the list is
+		 * written to or a reference to one is needed.
+		 *
+		 * A list from DeserializeLazy is empty with raw set until ListOf()
+		 * parses it.
+		 */
+		struct ListStorage : public ContainerStorage {
+			enum { SmallCapacity = 4 };
+
+			ListStorage() : list(0), mirror(0), packed(0), raw(0), small_size(0) {}
+
+			ListStorage(const ListStorage &o) : ContainerStorage(), list(0), mirror(0), packed(0), raw(CopyRaw(o.raw)), small_size(0) {
+				// A lazy list has nothing else to copy
+				if (raw.Load()) { return; }
+				if (o.list) { list = new Variant::List(*o.list); }
+				if (o.packed) { packed = new PackedArray(*o.packed); }
+				small_size = o.small_size;
+				std::copy(o.items, o.items + o.small_size, items);
+			}
+
+			~ListStorage() {
+				delete list;
+				delete mirror;
+				delete packed;
+				delete raw.Load();
+			}
+
+			unsigned Size() const {
+				if (packed) { return packed->Size(); }
+				return list ? list->size() : small_size;
+			}
+
+			/// Not for packed lists
+			Variant &At(unsigned i) { return list ? (*list)[i] : items[i]; }
+
+			/// Element i of any list, packed elements are built in scratch.
+			const Variant &Element(unsigned i, Variant &scratch) const {
+				if (packed) {
+					scratch = packed->Get(i);
+					return scratch;
+				}
+				return list ? (*list)[i] : items[i];
+			}
+
+			/// The elements once the list is no longer small, otherwise 0
+			Variant::List *list;
+			/// The list for AsList() const, it becomes the list on the next
+			/// write. For a small list it holds references to the items, so
+			/// that writes through pointers to them show, for a packed one
+			/// the unpacked elements.
+			Variant::List *mirror;
+			/// The elements while the list is packed, otherwise 0
+			PackedArray *packed;
+			/// The text of the list until it is parsed, otherwise 0. It is
+			/// cleared under GetRawMutex() while others may be reading.
+			AtomicPointer<RawJSON> raw;
+			unsigned small_size;
+			Variant items[SmallCapacity];
 		};
 
+		/**
+		 * Up to SmallCapacity entries are kept inline, sorted by key. The
+		 * entries are moved into a Variant::Map when it grows past that or
+		 * when AsMap() is called.
+		 *
+		 * Only storage made small has room for the inline entries, they
+		 * follow the struct in the same allocation. A map that starts out
+		 * big, or grows while nothing else holds its storage, goes without.
+		 *
+		 * A map from DeserializeLazy is empty with raw set until MapOf()
+		 * parses it.
+		 */
+		struct MapStorage : public ContainerStorage {
+			enum { SmallCapacity = 8 };
+
+			/// Storage with map set by the caller unless small
+			static MapStorage *New(bool small) {
+				if (!small) { return new MapStorage(0); }
+				void *p = operator new(sizeof(MapStorage) + 2 * SmallCapacity * sizeof(Variant));
+				Variant *entries = reinterpret_cast<Variant*>(static_cast<MapStorage*>(p) + 1);
+				for (unsigned i = 0; i < 2 * SmallCapacity; ++i) { ::new (entries + i) Variant; }
+				return ::new (p) MapStorage(entries);
+			}
+
+			/// A copy of o sharing its elements
+			static MapStorage *Clone(const MapStorage &o) {
+				RawJSON *raw = CopyRaw(o.raw);
+				MapStorage *storage = New(raw || !o.map);
+				if (raw) {
+					storage->raw.Store(raw);
+				} else if (o.map) {
+					storage->map = new Variant::Map(*o.map);
+				} else {
+					std::copy(o.keys, o.keys + o.small_size, storage->keys);
+					std::copy(o.values, o.values + o.small_size, storage->values);
+					storage->small_size = o.small_size;
+				}
+				return storage;
+			}
+
+			~MapStorage() {
+				delete map;
+				delete mirror;
+				delete raw.Load();
+				if (keys) {
+					for (unsigned i = 0; i < 2 * SmallCapacity; ++i) { keys[i].~Variant(); }
+				}
+			}
+
+			unsigned Size() const { return map ? map->size() : small_size; }
+
+			/// The entries once the map is no longer small, otherwise 0
+			Variant::Map *map;
+			/// The map for AsMap() const, it becomes the map on the next
+			/// write. It holds references to the small values, so that
+			/// writes through pointers to them show.
+			Variant::Map *mirror;
+			/// The text of the map until it is parsed, otherwise 0, like
+			/// ListStorage::raw.
+			AtomicPointer<RawJSON> raw;
+			unsigned small_size;
+			/// String Variants so that short keys are stored inline, 0 when
+			/// the storage was not made small
+			Variant *keys;
+			Variant *values;
+		private:
+			explicit MapStorage(Variant *entries)
+				: map(0), mirror(0), raw(0), small_size(0),
+				keys(entries), values(entries ? entries + SmallCapacity : 0) {}
+			MapStorage(const MapStorage &);
+			MapStorage &operator=(const MapStorage &);
+		};
+
+		/// The characters follow the struct in the same allocation, unless
+		/// they are borrowed.
 		struct StringStorage : public Storage {
-			StringStorage(const std::string &s) : str(s) {}
-			std::string str;
+			static StringStorage *New(const char *s, size_t len) {
+				void *p = operator new(sizeof(StringStorage) + len);
+				char *chars = reinterpret_cast<char*>(static_cast<StringStorage*>(p) + 1);
+				memcpy(chars, s, len);
+				return ::new (p) StringStorage(chars, len);
+			}
+			const char *Chars() const { return chars; }
+			const char *chars;
+			size_t length;
+		protected:
+			StringStorage(const char *s, size_t len) : chars(s), length(len) {}
+		};
+
+		/// A string left where it is in a buffer owner keeps alive
+		struct BorrowedStringStorage : public StringStorage {
+			BorrowedStringStorage(const char *s, size_t len, ConstBlobPtr o)
+				: StringStorage(s, len), owner(o) {}
+			ConstBlobPtr owner;
+		};
+
+		struct LongFloatStorage : public Storage {
+			LongFloatStorage(long double v) : f(v) {}
+			long double f;
 		};
 
 		struct BlobStorage : public Storage {
@@ -141,19 +428,189 @@ namespace libvariant {
 			BlobPtr blob;
 		};
 
-		struct RefStorage : public Storage {
-			shared_ptr<Storage> storage;
-		};
-
 		struct ProxyStorage : public Storage {
-			ProxyStorage(Data *ref_, Path::const_iterator b, Path::const_iterator e)
-				: ref(ref_), storage(ref_->storage), path(b, e)
-			{}
-			Data *ref;
-			shared_ptr<Storage> storage;
+			ProxyStorage(RefData *ref_, Path::const_iterator b, Path::const_iterator e)
+				: ref(ref_), storage(0), path(b, e)
+			{
+				Retain(ref);
+				// Keep what the root currently holds alive for as long as the proxy
+				if (HasStorage(ref->target)) { storage = Retain(ref->target->storage); }
+			}
+			~ProxyStorage() {
+				if (storage) { Release(storage); }
+				Release(ref);
+			}
+			static bool HasStorage(const Data *d) {
+				return d->kind == LongFloatKind || d->kind == StringKind || d->kind == ListKind
+					|| d->kind == MapKind || d->kind == BlobKind || d->kind == ProxyKind;
+			}
+			RefData *ref;
+			Storage *storage;
 			Path path;
 		};
 
+		static inline const StringStorage *StringOf(const Data *that)
+		{ return static_cast<const StringStorage*>(that->storage); }
+
+		/// Number of characters a ShortStringKind node can hold.
+		static const size_t SmallStringCapacity = sizeof(Data) - offsetof(Data, small_chars);
+
+		static inline char *SmallStringOf(Data *that)
+		{ return reinterpret_cast<char*>(that) + offsetof(Data, small_chars); }
+
+		static inline const char *SmallStringOf(const Data *that)
+		{ return reinterpret_cast<const char*>(that) + offsetof(Data, small_chars); }
+
+		static void ParseRaw(ListStorage *storage);
+		static void ParseRaw(MapStorage *storage);
+
+		/// The storage of a list or map without parsing it if it is lazy
+		static inline ListStorage *PeekListOf(const Data *that)
+		{ return static_cast<ListStorage*>(that->storage); }
+
+		static inline MapStorage *PeekMapOf(const Data *that)
+		{ return static_cast<MapStorage*>(that->storage); }
+
+		static inline ListStorage *ListOf(const Data *that) {
+			ListStorage *storage = PeekListOf(that);
+			if (storage->raw.Load()) { ParseRaw(storage); }
+			return storage;
+		}
+
+		static inline MapStorage *MapOf(const Data *that) {
+			MapStorage *storage = PeekMapOf(that);
+			if (storage->raw.Load()) { ParseRaw(storage); }
+			return storage;
+		}
+
+		static inline BlobPtr &BlobOf(const Data *that)
+		{ return static_cast<BlobStorage*>(that->storage)->blob; }
+
+		static inline ProxyStorage *ProxyOf(const Data *that)
+		{ return static_cast<ProxyStorage*>(that->storage); }
+
+		/// FNV-1a, pass the result back in as hash to continue over more
+		/// characters.
+		static inline size_t HashChars(const char *s, size_t len, size_t hash = size_t(2166136261u)) {
+			for (size_t i = 0; i < len; ++i) {
+				hash = (hash ^ (unsigned char)s[i]) * size_t(16777619u);
+			}
+			return hash;
+		}
+
+		/// Mix v into the hash h, the order matters.
+		static inline size_t HashCombine(size_t h, size_t v) {
+			return h ^ (v + size_t(0x9e3779b9u) + (h << 6) + (h >> 2));
+		}
+
+		/// Spread the bits of h, for hashes that are summed.
+		static inline size_t HashFinish(size_t h) {
+			h ^= h >> 16;
+			h *= size_t(0x85ebca6bu);
+			h ^= h >> 13;
+			h *= size_t(0xc2b2ae35u);
+			h ^= h >> 16;
+			return h;
+		}
+
+		/// An entry of the intern table, never freed.
+		struct InternedString {
+			InternedString(const char *s, size_t len, size_t h) : hash(h), str(s, len) {}
+			size_t hash;
+			std::string str;
+		};
+
+		/// A process wide set of strings, so that equal strings interned
+		/// share one InternedString and compare equal by pointer.
+		class InternTable {
+		public:
+			const InternedString *Intern(const char *s, size_t len) {
+				size_t hash = HashChars(s, len);
+				Shard &shard = shards[hash % NUM_SHARDS];
+				MutexLock lock(shard.mutex);
+				if ((shard.num_entries + 1) * 4 > shard.slots.size() * 3) { Grow(shard); }
+				size_t mask = shard.slots.size() - 1;
+				size_t i = (hash / NUM_SHARDS) & mask;
+				for (; shard.slots[i]; i = (i + 1) & mask) {
+					const InternedString *entry = shard.slots[i];
+					if (entry->hash == hash && entry->str.size() == len
+							&& memcmp(entry->str.data(), s, len) == 0) {
+						return entry;
+					}
+				}
+				++shard.num_entries;
+				return shard.slots[i] = new InternedString(s, len, hash);
+			}
+
+		private:
+			enum { NUM_SHARDS = 16 };
+			struct Shard {
+				Shard() : num_entries(0) {}
+				Mutex mutex;
+				size_t num_entries;
+				/// Open addressing with linear probing
+				std::vector<const InternedString*> slots;
+			};
+
+			static void Grow(Shard &shard) {
+				std::vector<const InternedString*> slots(shard.slots.empty() ? 64 : shard.slots.size() * 2);
+				size_t mask = slots.size() - 1;
+				for (size_t j = 0; j < shard.slots.size(); ++j) {
+					const InternedString *entry = shard.slots[j];
+					if (!entry) { continue; }
+					size_t i = (entry->hash / NUM_SHARDS) & mask;
+					while (slots[i]) { i = (i + 1) & mask; }
+					slots[i] = entry;
+				}
+				shard.slots.swap(slots);
+			}
+
+			Shard shards[NUM_SHARDS];
+		};
+
+		static InternTable &GetInternTable() {
+			// Never destroyed, the entries live for the whole process.
+			static InternTable *table = new InternTable;
+			return *table;
+		}
+
+		/// Set by Variant::InternKeys
+		static bool intern_keys = false;
+
+		/// Move the value and references of from into the null node to,
+		/// leaving from null. A value nothing refers to any more is taken
+		/// back out of its RefData.
+		static void MoveData(Data *to, Data *from) {
+			*to = *from;
+			if ((to->flags & HasRefData) && to->ref->refcount.Get() == 1) {
+				RefData *ref = to->ref;
+				*to = ref->value;
+				to->flags = 0;
+				ref->value.kind = NullKind;
+				ref->value.i = 0;
+				Release(ref);
+			}
+			from->kind = NullKind;
+			from->flags = 0;
+			from->i = 0;
+		}
+
+		/// Guards creating the mirrors of small containers for const access
+		/// and the cached hashes of containers.
+		static Mutex &GetMirrorMutex() {
+			static Mutex *mutex = new Mutex;
+			return *mutex;
+		}
+
+		/// Guards parsing the lists and maps from DeserializeLazy.
+		static Mutex &GetRawMutex() {
+			static Mutex *mutex = new Mutex;
+			return *mutex;
+		}
+
+		const VTable *const *KindVTables();
+
+		static inline const VTable *VT(const Data *that) { return KindVTables()[that->kind]; }
 
 		// Three ways to look up a value in a map or list:
 		// Get a reference/proxy -> GetRef
@@ -183,6 +640,7 @@ namespace libvariant {
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::List &AsList(Data *that) const;
 			virtual const Variant::List &AsListConst(const Data *that) const;
 			virtual bool ContainsIndex(const Data *that, unsigned i) const;
@@ -191,21 +649,29 @@ namespace libvariant {
 			virtual VariantRef GetRefIndex(Data *that, unsigned i, Variant *def) const;
 			virtual const Variant *GetConstIndex(const Data *that, unsigned i, bool checked) const;
 			virtual Variant *GetIndex(Data *that, unsigned i, bool checked) const;
-			virtual void SetIndex(Data *that, unsigned i, const Data *other) const;
+			virtual Variant *SlotIndex(Data *that, unsigned i) const;
+			virtual Variant *SlotBack(Data *that) const;
 			virtual Variant::Map &AsMap(Data *that) const;
 			virtual const Variant::Map &AsMapConst(const Data *that) const;
-			virtual bool ContainsKey(const Data *that, const std::string &s) const;
-			virtual void EraseKey(Data *that, const std::string &key) const;
-			virtual VariantRef GetRefKey(Data *that, const std::string &s, Variant *def) const;
-			virtual const Variant *GetConstKey(const Data *that, const std::string &s, bool checked) const;
-			virtual Variant *GetKey(Data *that, const std::string &s, bool checked) const;
-			virtual void SetKey(Data *that, const std::string &s, const Data *other) const;
-			VariantRef GetPathRef(Data *that, Path::const_iterator b, Path::const_iterator e, Variant *def) const;
-			const Variant *GetPathConst(const Data *that, Path::const_iterator b, Path::const_iterator e, bool checked) const;
-			void SetPath(Data *that, Path::const_iterator b, Path::const_iterator e, const Variant *other) const;
-			void ErasePath(Data *that, Path::const_iterator b, Path::const_iterator e, bool recursive) const;
+			virtual bool ContainsKey(const Data *that, KeyRef s) const;
+			virtual void EraseKey(Data *that, KeyRef key) const;
+			virtual VariantRef GetRefKey(Data *that, KeyRef s, Variant *def) const;
+			virtual const Variant *GetConstKey(const Data *that, KeyRef s, bool checked) const;
+			virtual Variant *GetKey(Data *that, KeyRef s, bool checked) const;
+			virtual Variant *SlotKey(Data *that, KeyRef s) const;
+			// The path functions take iterators of a Path or a CompiledPath
+			template<typename Iter>
+			VariantRef GetPathRef(Data *that, Iter b, Iter e, Variant *def) const;
+			template<typename Iter>
+			const Variant *GetPathConst(const Data *that, Iter b, Iter e, bool checked) const;
+			template<typename Iter>
+			void SetPath(Data *that, Iter b, Iter e, const Variant *other) const;
+			template<typename Iter>
+			void ErasePath(Data *that, Iter b, Iter e, bool recursive) const;
 			bool Comparable(const Data *that, const Data *other) const;
+			int CompareTypes(const Data *that, const Data *other) const;
 			virtual int Compare(const Data *that, const Data *other) const = 0;
+			virtual size_t Hash(const Data *that) const = 0;
 			virtual void Incr(Data *that) const;
 			virtual void Decr(Data *that) const;
 			virtual Variant Neg(const Data *that) const;
@@ -214,9 +680,9 @@ namespace libvariant {
 			virtual void Mul(Data *that, const Data *other) const;
 			virtual void Div(Data *that, const Data *other) const;
 			virtual void Rem(Data *that, const Data *other) const;
-			shared_ptr<RefData> EnsureRef(Data *that) const;
+			virtual RefData *EnsureRef(Data *that) const;
 			virtual void Destroy(Data *that) const;
-			virtual void Destruct(Data *that) const;
+			void Destruct(Data *that) const;
 			virtual Variant *Resolve(Data *that) const;
 			virtual const Variant *ResolveConst(const Data *that) const;
 			virtual Variant *ResolveDefault(Data *that, const Data *def) const;
@@ -237,6 +703,11 @@ namespace libvariant {
 
 		void StringInit(Data *that, const std::string &s);
 
+		void StringInit(Data *that, const char *s, size_t len);
+		void BorrowedStringInit(Data *that, const char *s, size_t len, ConstBlobPtr owner);
+		void InternedStringInit(Data *that, const InternedString *interned);
+		void InternedStringInit(Data *that, const char *s, size_t len);
+
 		void ListInit(Data *that, const Variant::List &l);
 
 		void MapInit(Data *that, const Variant::Map &m);
@@ -244,15 +715,42 @@ namespace libvariant {
 		void BlobInit(Data *that, BlobPtr blob);
 
 		void RefInit(Data *that, const Data *other);
+		/// Make that refer to the item of a small container for its mirror.
+		/// Unlike RefInit the item is left as it is, which matters as other
+		/// threads may be reading it, and it stays put until the container
+		/// is written to, which drops the mirror first.
+		void MirrorInit(Data *that, Data *item);
 
-		void ProxyInit(Data *that, Data *ref, Path::const_iterator b, Path::const_iterator e);
+		void ProxyInit(Data *that, Data *root, Path::const_iterator b, Path::const_iterator e);
+
+		void ProxyInit(Data *that, RefData *root, Path::const_iterator b, Path::const_iterator e);
 
 		//--------------------
 		// VTable 
 		//--------------------
 
+		/// Make that, or what it refers to, hold the value of other. The value
+		/// is taken from other, leaving it null, unless other is a reference
+		/// or is referred to, then it is shared like with Assign.
+		void MoveInit(Data *that, Data *other) {
+			if (other->kind == RefKind || other->kind == ProxyKind || (other->flags & HasRefData)) {
+				VT(other)->Assign(other, that);
+				return;
+			}
+			that = VTable::GetData(VT(that)->Resolve(that));
+			if (that == other) { return; }
+			// Take the value first, other may live in what that holds
+			Data value = *other;
+			other->kind = NullKind;
+			other->i = 0;
+			VT(that)->Destroy(that);
+			unsigned char flags = that->flags;
+			*that = value;
+			that->flags = flags;
+		}
+
 		void VTable::Assign(const Data *that, Data *other) const
-		{ that->vtable->Copy(that, VTable::GetData(other->vtable->Resolve(other))); }
+		{ VT(that)->Copy(that, VTable::GetData(VT(other)->Resolve(other))); }
 
 		void VTable::MakeRef(const Data *that, Data *ref) const {
 			RefInit(ref, that);
@@ -261,127 +759,162 @@ namespace libvariant {
 		{ ProxyInit(ref, that, b, e); }
 
 		bool VTable::AsBool(const Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a bool"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a bool"); }
 
 		long double VTable::AsLongDouble(const Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a float"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a float"); }
 
 		uintmax_t VTable::AsUnsigned(const Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a unsigned"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a unsigned"); }
 
 		intmax_t VTable::AsInt(const Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a int"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a int"); }
 
 		std::string VTable::AsString(const Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a string"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a string"); }
 
 		BlobPtr VTable::AsBlob(Data *that) const
-		{ throw UnexpectedTypeError(VariantDefines::BlobType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::BlobType, VT(that)->GetType(that)); }
 
 		ConstBlobPtr VTable::AsBlobConst(const Data *that) const
-		{ throw UnexpectedTypeError(VariantDefines::BlobType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::BlobType, VT(that)->GetType(that)); }
 
 		unsigned VTable::Size(const Data *that) const
-		{ throw InvalidOperationError(that->vtable->GetType(that), "Size"); }
+		{ throw InvalidOperationError(VT(that)->GetType(that), "Size"); }
 
 		bool VTable::Empty(const Data *that) const
-		{ throw InvalidOperationError(that->vtable->GetType(that), "Empty"); }
+		{ throw InvalidOperationError(VT(that)->GetType(that), "Empty"); }
 
 		void VTable::Clear(Data *that) const { NullInit(that); }
 
+		void VTable::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const
+		{ throw InvalidOperationError(VT(that)->GetType(that), "ForEach"); }
+
 		Variant::List &VTable::AsList(Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a list"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a list"); }
 
 		const Variant::List &VTable::AsListConst(const Data *that) const
-		{ throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
 
 		bool VTable::ContainsIndex(const Data *that, unsigned i) const
 		{ return false; }
 
 		unsigned VTable::Index(const Data *that, Variant o) const
-		{ throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
 
 		void VTable::EraseIndex(Data *that, unsigned i) const
-		{ throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
 
 		VariantRef VTable::GetRefIndex(Data *that, unsigned i, Variant *def) const
-		{ throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
 
 		const Variant *VTable::GetConstIndex(const Data *that, unsigned i, bool checked) const { 
 			if (!checked) { return 0; }
-			throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that));
+			throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that));
 		}
 
 		Variant *VTable::GetIndex(Data *that, unsigned i, bool checked) const { 
 			if (!checked) { return 0; }
-			throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that));
+			throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that));
 		}
 
-		void VTable::SetIndex(Data *that, unsigned i, const Data *other) const
-		{ throw UnexpectedTypeError(VariantDefines::ListType, that->vtable->GetType(that)); }
+		Variant *VTable::SlotIndex(Data *that, unsigned i) const
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
+
+		Variant *VTable::SlotBack(Data *that) const
+		{ throw UnexpectedTypeError(VariantDefines::ListType, VT(that)->GetType(that)); }
 
 		Variant::Map &VTable::AsMap(Data *that) const
-		{ throw UnableToConvertError(that->vtable->GetType(that), "a map"); }
+		{ throw UnableToConvertError(VT(that)->GetType(that), "a map"); }
 
 		const Variant::Map &VTable::AsMapConst(const Data *that) const
-		{ throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that)); }
+		{ throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that)); }
 
-		bool VTable::ContainsKey(const Data *that, const std::string &s) const
+		bool VTable::ContainsKey(const Data *that, KeyRef s) const
 		{ return false; }
 
-		void VTable::EraseKey(Data *that, const std::string &key) const
-		{ throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that)); }
+		void VTable::EraseKey(Data *that, KeyRef key) const
+		{ throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that)); }
 
-		VariantRef VTable::GetRefKey(Data *that, const std::string &s, Variant *def) const
-		{ throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that)); }
+		VariantRef VTable::GetRefKey(Data *that, KeyRef s, Variant *def) const
+		{ throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that)); }
 
-		const Variant *VTable::GetConstKey(const Data *that, const std::string &s, bool checked) const {
+		const Variant *VTable::GetConstKey(const Data *that, KeyRef s, bool checked) const {
 			if (!checked) { return 0; }
-			throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that));
+			throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that));
 		}
 
-		Variant *VTable::GetKey(Data *that, const std::string &s, bool checked) const {
+		Variant *VTable::GetKey(Data *that, KeyRef s, bool checked) const {
 			if (!checked) { return 0; }
-			throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that));
+			throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that));
 		}
 
-		void VTable::SetKey(Data *that, const std::string &s, const Data *other) const
-		{ throw UnexpectedTypeError(VariantDefines::MapType, that->vtable->GetType(that)); }
+		Variant *VTable::SlotKey(Data *that, KeyRef s) const
+		{ throw UnexpectedTypeError(VariantDefines::MapType, VT(that)->GetType(that)); }
+
+		static MapStorage *WritableMapOf(Data *that);
+		static Variant *FindKey(MapStorage *storage, KeyRef s, size_t hash);
+
+		static Variant *FindPathKey(MapStorage *storage, const PathElement &elem)
+		{ return FindKey(storage, elem.AsString(), elem.KeyHash()); }
+
+		static Variant *FindPathKey(MapStorage *storage, const StaticPathIterator &elem)
+		{ return FindKey(storage, KeyRef(elem.KeyData(), elem.KeyLength()), elem.KeyHash()); }
 
-		const Variant *GetPathElem(const Data *that, const PathElement &elem, bool checked) {
+		// A map is looked into directly so that the hash of the key in the
+		// path is used. Elem is a PathElement or a StaticPathIterator.
+
+		template<typename Elem>
+		const Variant *GetPathElem(const Data *that, const Elem &elem, bool checked) {
 			if (elem.IsString()) {
-				return that->vtable->GetConstKey(that, elem.AsString(), checked);
+				if (that->kind == MapKind) {
+					const Variant *entry = FindPathKey(MapOf(that), elem);
+					if (!entry && checked) { throw KeyError(elem.AsString()); }
+					return entry;
+				}
+				return VT(that)->GetConstKey(that, elem.AsString(), checked);
 			} else /* if (elem.IsNumber()) */ {
-				return that->vtable->GetConstIndex(that, elem.AsUnsigned(), checked);
+				return VT(that)->GetConstIndex(that, elem.AsUnsigned(), checked);
 			}
 		}
 
-		Variant *GetPathElem(Data *that, const PathElement &elem, bool checked) {
+		template<typename Elem>
+		Variant *GetPathElem(Data *that, const Elem &elem, bool checked) {
 			if (elem.IsString()) {
-				return that->vtable->GetKey(that, elem.AsString(), checked);
+				if (that->kind == MapKind) {
+					Variant *entry = FindPathKey(WritableMapOf(that), elem);
+					if (!entry && checked) { throw KeyError(elem.AsString()); }
+					return entry;
+				}
+				return VT(that)->GetKey(that, elem.AsString(), checked);
 			} else /* if (elem.IsNumber()) */ {
-				return that->vtable->GetIndex(that, elem.AsUnsigned(), checked);
+				return VT(that)->GetIndex(that, elem.AsUnsigned(), checked);
 			}
 		}
 
-		VariantRef GetRefPathElem(Data *that, const PathElement &elem, Variant *def) {
+		template<typename Elem>
+		VariantRef GetRefPathElem(Data *that, const Elem &elem, Variant *def) {
 			if (elem.IsString()) {
-				return that->vtable->GetRefKey(that, elem.AsString(), def);
+				return VT(that)->GetRefKey(that, elem.AsString(), def);
 			} else /* if (elem.IsNumber()) */ {
-				return that->vtable->GetRefIndex(that, elem.AsUnsigned(), def);
+				return VT(that)->GetRefIndex(that, elem.AsUnsigned(), def);
 			}
 		}
 
-		void SetPathElem(Data *that, const PathElement &elem, const Variant *other) {
+		template<typename Elem>
+		void SetPathElem(Data *that, const Elem &elem, const Variant *other) {
+			Variant *slot;
 			if (elem.IsString()) {
-				that->vtable->SetKey(that, elem.AsString(), VTable::GetData(other));
+				slot = VT(that)->SlotKey(that, elem.AsString());
 			} else /* if (elem.IsNumber()) */ {
-				that->vtable->SetIndex(that, elem.AsUnsigned(), VTable::GetData(other));
+				slot = VT(that)->SlotIndex(that, elem.AsUnsigned());
 			}
+			const Data *value = VTable::GetData(other);
+			VT(value)->Assign(value, VTable::GetData(slot));
 		}
 
-		VariantRef VTable::GetPathRef(Data *that, Path::const_iterator b,
-				Path::const_iterator e, Variant *def) const
+		template<typename Iter>
+		VariantRef VTable::GetPathRef(Data *that, Iter b, Iter e, Variant *def) const
 		{
 			if (b == e) { return VariantRef(*GetVar(that)); }
 			Variant *ref = 0;
@@ -395,20 +928,21 @@ namespace libvariant {
 				} else {
 					Variant null_value;
 					SetPathElem(that, *b, &null_value);
-					return that->vtable->GetPathRef(that, b, e, def);
+					return VT(that)->GetPathRef(that, b, e, def);
 				}
 			}
 			if (b + 1 == e) {
 				return VariantRef(*ref);
 			} else {
 				Data *ref_data = VTable::GetData(ref);
-				return ref_data->vtable->GetPathRef(ref_data, b + 1, e, def);
+				return VT(ref_data)->GetPathRef(ref_data, b + 1, e, def);
 			}
 		}
 
-		const Variant *VTable::GetPathConst(const Data *that, Path::const_iterator b, Path::const_iterator e, bool checked) const
+		template<typename Iter>
+		const Variant *VTable::GetPathConst(const Data *that, Iter b, Iter e, bool checked) const
 		{
-			if (b == e) { return that->vtable->ResolveConst(that); }
+			if (b == e) { return VT(that)->ResolveConst(that); }
 			const Variant *ref = 0;
 			ref = GetPathElem(that, *b, checked);
 			if (!ref) {
@@ -425,15 +959,16 @@ namespace libvariant {
 				return ref;
 			} else {
 				const Data *ref_data = VTable::GetData(ref);
-				return ref_data->vtable->GetPathConst(ref_data, b + 1, e, checked);
+				return VT(ref_data)->GetPathConst(ref_data, b + 1, e, checked);
 			}
 		}
 
-		void VTable::SetPath(Data *that, Path::const_iterator b, Path::const_iterator e, const Variant *other) const
+		template<typename Iter>
+		void VTable::SetPath(Data *that, Iter b, Iter e, const Variant *other) const
 	   	{
 			if (b == e) {
 				const Data *other_data = VTable::GetData(other);
-			   	other_data->vtable->Assign(other_data, that);
+			   	VT(other_data)->Assign(other_data, that);
 				return;
 		   	}
 			Variant *ref = 0;
@@ -445,23 +980,25 @@ namespace libvariant {
 				} else {
 					Variant null_value;
 					SetPathElem(that, *b, &null_value);
-					that->vtable->SetPath(that, b, e, other);
+					VT(that)->SetPath(that, b, e, other);
 					return;
 				}
 			}
 			Data *ref_data = VTable::GetData(ref);
-			ref_data->vtable->SetPath(ref_data, b + 1, e, other);
+			VT(ref_data)->SetPath(ref_data, b + 1, e, other);
 		}
 
-		void ErasePathElem(Data *that, const PathElement &elem) {
+		template<typename Elem>
+		void ErasePathElem(Data *that, const Elem &elem) {
 			if (elem.IsString()) {
-				return that->vtable->EraseKey(that, elem.AsString());
+				return VT(that)->EraseKey(that, elem.AsString());
 			} else /* if (elem.IsNumber()) */ {
-				return that->vtable->EraseIndex(that, elem.AsUnsigned());
+				return VT(that)->EraseIndex(that, elem.AsUnsigned());
 			}
 		}
 
-		void VTable::ErasePath(Data *that, Path::const_iterator b, Path::const_iterator e, bool remove_empty) const
+		template<typename Iter>
+		void VTable::ErasePath(Data *that, Iter b, Iter e, bool remove_empty) const
 		{
 			if (b == e) { return; }
 			if (b + 1 == e) {
@@ -472,14 +1009,14 @@ namespace libvariant {
 			ref = GetPathElem(that, *b, false);
 			if (!ref) { return; }
 			Data *ref_data = VTable::GetData(ref);
-			ref_data->vtable->ErasePath(ref_data, b + 1, e, remove_empty);
-			if (remove_empty && ref_data->vtable->Empty(ref_data)) {
+			VT(ref_data)->ErasePath(ref_data, b + 1, e, remove_empty);
+			if (remove_empty && VT(ref_data)->Empty(ref_data)) {
 				ErasePathElem(that, *b);
 			}
 		}
 
 		bool VTable::Comparable(const Data *that, const Data *other) const {
-			VariantDefines::Type_t ltype = that->vtable->GetType(that), otype = other->vtable->GetType(other);
+			VariantDefines::Type_t ltype = VT(that)->GetType(that), otype = VT(other)->GetType(other);
 			return ( ltype == otype )
 				|| (
 						( ltype == VariantDefines::IntegerType
@@ -491,49 +1028,68 @@ namespace libvariant {
 				   );
 		}
 
+		/// Rank of the types for ordering values that are not Comparable,
+		/// the number types share one.
+		static inline int TypeRank(VariantDefines::Type_t type) {
+			switch (type) {
+			case VariantDefines::UnsignedType:
+			case VariantDefines::FloatType:
+				return VariantDefines::IntegerType;
+			default:
+				return type;
+			}
+		}
+
+		int VTable::CompareTypes(const Data *that, const Data *other) const {
+			int lhs = TypeRank(VT(that)->GetType(that)), rhs = TypeRank(VT(other)->GetType(other));
+			if (lhs < rhs) { return -1; }
+			return lhs > rhs ? 1 : 0;
+		}
+
 		void VTable::Incr(Data *that) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Decr(Data *that) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		Variant VTable::Neg(const Data *that) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Add(Data *that, const Data *other) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Sub(Data *that, const Data *other) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Mul(Data *that, const Data *other) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Div(Data *that, const Data *other) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
 		void VTable::Rem(Data *that, const Data *other) const
-		{ throw NotNumericTypeError(that->vtable->GetType(that)); }
+		{ throw NotNumericTypeError(VT(that)->GetType(that)); }
 
-		shared_ptr<RefData> VTable::EnsureRef(Data *that) const {
-			if (!that->ref_data) {
-				that->ref_data.reset(new RefData());
-			}
-			return that->ref_data;
+		RefData *VTable::EnsureRef(Data *that) const {
+			// Already the value of a referenced node
+			if (that->flags & InBox) { return Retain(BoxOf(that)); }
+			RefData *ref = new RefData;
+			unsigned char flags = ref->value.flags;
+			ref->value = *that;
+			ref->value.flags = flags;
+			that->kind = RefKind;
+			that->flags |= HasRefData;
+			that->ref = ref;
+			return Retain(ref);
 		}
 
 		void VTable::Destroy(Data *that) const {
-			assert(that->vtable);
-			that->storage.reset();
-			that->vtable = 0;
+			that->kind = NullKind;
+			that->i = 0;
 		}
 
 		void VTable::Destruct(Data *that) const {
-			that->vtable->Destroy(that);
-			if (that->ref_data) {
-				that->ref_data->valid = false;
-				that->ref_data.reset();
-			}
+			VT(that)->Destroy(that);
 		}
 
 		Variant *VTable::Resolve(Data *that) const
@@ -553,7 +1109,6 @@ namespace libvariant {
 
 		class Null : public VTable {
 		public:
-			Null() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual bool AsBool(const Data *that) const;
@@ -564,27 +1119,25 @@ namespace libvariant {
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::List &AsList(Data *that) const;
 			virtual void EraseIndex(Data *that, unsigned i) const;
 			virtual VariantRef GetRefIndex(Data *that, unsigned i, Variant *def) const;
 			virtual const Variant *GetConstIndex(const Data *that, unsigned i, bool checked) const;
 			virtual Variant *GetIndex(Data *that, unsigned i, bool checked) const;
-			virtual void SetIndex(Data *that, unsigned i, const Data *other) const;
+			virtual Variant *SlotIndex(Data *that, unsigned i) const;
+			virtual Variant *SlotBack(Data *that) const;
 			virtual Variant::Map &AsMap(Data *that) const;
-			virtual void EraseKey(Data *that, const std::string &key) const;
-			virtual VariantRef GetRefKey(Data *that, const std::string &s, Variant *def) const;
-			virtual const Variant *GetConstKey(const Data *that, const std::string &s, bool checked) const;
-			virtual Variant *GetKey(Data *that, const std::string &s, bool checked) const;
-			virtual void SetKey(Data *that, const std::string &s, const Data *other) const;
+			virtual void EraseKey(Data *that, KeyRef key) const;
+			virtual VariantRef GetRefKey(Data *that, KeyRef s, Variant *def) const;
+			virtual const Variant *GetConstKey(const Data *that, KeyRef s, bool checked) const;
+			virtual Variant *GetKey(Data *that, KeyRef s, bool checked) const;
+			virtual Variant *SlotKey(Data *that, KeyRef s) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual Variant *ResolveDefault(Data *that, const Data *def) const;
 		};
 
-		const VTable *NullVTable() {
-			static const Null null_vtable;
-			return &null_vtable;
-		}
-
 		void Null::Copy(const Data *that, Data *other) const { NullInit(other); }
 
 		VariantDefines::Type_t Null::GetType(const Data *that) const
@@ -606,18 +1159,20 @@ namespace libvariant {
 
 		void Null::Clear(Data *that) const {}
 
+		void Null::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const {}
+
 		Variant::List &Null::AsList(Data *that) const {
 			ListInit(that, Variant::List());
-			return that->vtable->AsList(that);
+			return VT(that)->AsList(that);
 		}
 		void Null::EraseIndex(Data *that, unsigned i) const {}
 
 		VariantRef Null::GetRefIndex(Data *that, unsigned i, Variant *def) const {
 			if (def) {
 				ListInit(that, Variant::List());
-				return that->vtable->GetRefIndex(that, i, def);
+				return VT(that)->GetRefIndex(that, i, def);
 			}
-			return VariantRef(*that->vtable->Resolve(that), Path(1, i));
+			return VariantRef(*VT(that)->Resolve(that), Path(1, i));
 		}
 
 		const Variant *Null::GetConstIndex(const Data *that, unsigned i, bool checked) const { 
@@ -630,54 +1185,60 @@ namespace libvariant {
 			throw std::out_of_range("Variant::List index out of range.");
 		}
 
-		void Null::SetIndex(Data *that, unsigned i, const Data *other) const {
+		Variant *Null::SlotIndex(Data *that, unsigned i) const {
+			ListInit(that, Variant::List());
+			return VT(that)->SlotIndex(that, i);
+		}
+
+		Variant *Null::SlotBack(Data *that) const {
 			ListInit(that, Variant::List());
-			that->vtable->SetIndex(that, i, other);
+			return VT(that)->SlotBack(that);
 		}
 
 		Variant::Map &Null::AsMap(Data *that) const {
 			MapInit(that, Variant::Map());
-			return that->vtable->AsMap(that);
+			return VT(that)->AsMap(that);
 		}
 
 
-		void Null::EraseKey(Data *that, const std::string &) const {}
+		void Null::EraseKey(Data *that, KeyRef) const {}
 
-		VariantRef Null::GetRefKey(Data *that, const std::string &s, Variant *def) const {
+		VariantRef Null::GetRefKey(Data *that, KeyRef s, Variant *def) const {
 			if (def) {
 				MapInit(that, Variant::Map());
-				return that->vtable->GetRefKey(that, s, def);
+				return VT(that)->GetRefKey(that, s, def);
 			}
-			return VariantRef(*that->vtable->Resolve(that), Path(1, s));
+			return VariantRef(*VT(that)->Resolve(that), Path(1, s.str()));
 		}
 
-		const Variant *Null::GetConstKey(const Data *that, const std::string &s, bool checked) const {
+		const Variant *Null::GetConstKey(const Data *that, KeyRef s, bool checked) const {
 			if (!checked) { return 0; }
-			throw KeyError(s);
+			throw KeyError(s.str());
 		}
 
-		Variant *Null::GetKey(Data *that, const std::string &s, bool checked) const {
+		Variant *Null::GetKey(Data *that, KeyRef s, bool checked) const {
 			if (!checked) { return 0; }
-			throw KeyError(s);
+			throw KeyError(s.str());
 		}
 
-		void Null::SetKey(Data *that, const std::string &s, const Data *other) const {
+		Variant *Null::SlotKey(Data *that, KeyRef s) const {
 			MapInit(that, Variant::Map());
-			that->vtable->SetKey(that, s, other);
+			return VT(that)->SlotKey(that, s);
 		}
 
 		int Null::Compare(const Data *that, const Data *other) const {
-			return (Comparable(that, other) ? 0 : 1);
+			return (Comparable(that, other) ? 0 : CompareTypes(that, other));
 		}
 
+		size_t Null::Hash(const Data *that) const { return HashCombine(0, Variant::NullType); }
+
 		Variant *Null::ResolveDefault(Data *that, const Data *def) const {
-			def->vtable->Assign(def, that);
-			return that->vtable->Resolve(that);
+			VT(def)->Assign(def, that);
+			return VT(that)->Resolve(that);
 		}
 
 		void NullInit(Data *that) {
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = NullVTable();
+			VT(that)->Destroy(that);
 		}
 
 		//--------------------
@@ -686,7 +1247,6 @@ namespace libvariant {
 
 		class Bool : public VTable {
 		public:
-			Bool() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual bool AsBool(const Data *that) const;
@@ -695,6 +1255,7 @@ namespace libvariant {
 			virtual intmax_t AsInt(const Data *that) const;
 			virtual std::string AsString(const Data *that) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 		};
 
 		void Bool::Copy(const Data *that, Data *other) const
@@ -722,16 +1283,19 @@ namespace libvariant {
 
 		int Bool::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				other = VTable::GetData(other->vtable->ResolveConst(other));
-				return (that->b == other->b ? 0 : 1);
+				other = VTable::GetData(VT(other)->ResolveConst(other));
+				if (that->b == other->b) { return 0; }
+				return other->b ? -1 : 1;
 			}
-			return 1;
+			return CompareTypes(that, other);
 		}
 
+		size_t Bool::Hash(const Data *that) const
+		{ return HashCombine(HashCombine(0, Variant::BoolType), that->b); }
+
 		void BoolInit(Data *that, bool b) {
-			static const Bool bool_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &bool_vtable;
+			VT(that)->Destroy(that);
+			that->kind = BoolKind;
 			that->b = b;
 		}
 
@@ -742,6 +1306,7 @@ namespace libvariant {
 		class Numeric : public VTable {
 		public:
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Add(Data *that, const Data *other) const;
 			virtual void Sub(Data *that, const Data *other) const;
 			virtual void Mul(Data *that, const Data *other) const;
@@ -751,39 +1316,65 @@ namespace libvariant {
 
 		int Numeric::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				long double us = that->vtable->AsLongDouble(that);
-				long double o = other->vtable->AsLongDouble(other);
+				long double us = VT(that)->AsLongDouble(that);
+				long double o = VT(other)->AsLongDouble(other);
 				if (us < o) { return -1; }
 				else if (us > o) { return 1; }
-				else { return 0; }
+				else if (us == o) { return 0; }
+				// NaN is equal to NaN and less than every other number
+				bool us_nan = us != us, o_nan = o != o;
+				if (us_nan && o_nan) { return 0; }
+				return us_nan ? -1 : 1;
 			}
-			return 1;
+			return CompareTypes(that, other);
+		}
+
+		static inline size_t HashUnsigned(size_t h, uintmax_t u)
+		{ return HashCombine(HashCombine(h, size_t(u)), size_t(u >> 32)); }
+
+		size_t Numeric::Hash(const Data *that) const {
+			// Numbers that Compare equal must hash the same whatever their
+			// type, so hash the value the way Compare sees it.
+			size_t hash = HashCombine(0, Variant::FloatType);
+			long double v = AsLongDouble(that);
+			const long double limit = -static_cast<long double>(std::numeric_limits<intmax_t>::min());
+			if (v >= -limit && v < limit) {
+				intmax_t i = static_cast<intmax_t>(v);
+				if (static_cast<long double>(i) == v) { return HashUnsigned(hash, uintmax_t(i)); }
+			}
+			// Every NaN is equal
+			if (v != v) { return hash; }
+			if (fabsl(v) > std::numeric_limits<long double>::max()) { return HashCombine(hash, v < 0 ? 1 : 2); }
+			int exp = 0;
+			long double mantissa = frexpl(fabsl(v), &exp);
+			hash = HashUnsigned(hash, uintmax_t(ldexpl(mantissa, 63)));
+			return HashCombine(HashCombine(hash, size_t(exp)), v < 0);
 		}
 
 		template< template<typename T> class Op >
 		void NumericOperation(Data *that, const Data *other) {
-			VariantDefines::Type_t ntype = NumericUpcast(that->vtable->GetType(that),
-					other->vtable->GetType(other));
+			VariantDefines::Type_t ntype = NumericUpcast(VT(that)->GetType(that),
+					VT(other)->GetType(other));
 			switch (ntype) {
 			case VariantDefines::IntegerType:
 				{
 					Op<intmax_t> op;
 					IntegerInit(that, 
-							op(that->vtable->AsInt(that), other->vtable->AsInt(other)));
+							op(VT(that)->AsInt(that), VT(other)->AsInt(other)));
 				}
 				break;
 			case VariantDefines::UnsignedType:
 				{
 					Op<uintmax_t> op;
 					UnsignedInit(that, 
-							op(that->vtable->AsUnsigned(that), other->vtable->AsUnsigned(other)));
+							op(VT(that)->AsUnsigned(that), VT(other)->AsUnsigned(other)));
 				}
 				break;
 			case VariantDefines::FloatType:
 				{
 					Op<long double> op;
 					FloatInit(that, 
-							op(that->vtable->AsLongDouble(that), other->vtable->AsLongDouble(other)));
+							op(VT(that)->AsLongDouble(that), VT(other)->AsLongDouble(other)));
 				}
 				break;
 			default:
@@ -812,7 +1403,6 @@ namespace libvariant {
 
 		class Integer : public Numeric {
 		public:
-			Integer() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual bool AsBool(const Data *that) const;
@@ -844,9 +1434,8 @@ namespace libvariant {
 		{ return that->i; }
 
 		std::string Integer::AsString(const Data *that) const {
-			std::ostringstream oss;
-			oss << that->i;
-			return oss.str();
+			char buf[INTEGER_CHARS];
+			return std::string(buf, FormatInt(that->i, buf));
 		}
 
 		void Integer::Incr(Data *that) const
@@ -859,9 +1448,8 @@ namespace libvariant {
 		{ return Variant(-that->i); }
 
 		void IntegerInit(Data *that, intmax_t i) {
-			static const Integer integer_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &integer_vtable;
+			VT(that)->Destroy(that);
+			that->kind = IntegerKind;
 			that->i = i;
 		}
 
@@ -871,7 +1459,6 @@ namespace libvariant {
 
 		class Unsigned : public Numeric {
 		public:
-			Unsigned() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual bool AsBool(const Data *that) const;
@@ -903,9 +1490,8 @@ namespace libvariant {
 		{ return (intmax_t)that->u; }
 
 		std::string Unsigned::AsString(const Data *that) const {
-			std::ostringstream oss;
-			oss << that->u;
-			return oss.str();
+			char buf[INTEGER_CHARS];
+			return std::string(buf, FormatUnsigned(that->u, buf));
 		}
 
 		void Unsigned::Incr(Data *that) const
@@ -919,9 +1505,8 @@ namespace libvariant {
 		}
 
 		void UnsignedInit(Data *that, uintmax_t u) {
-			static const Unsigned unsigned_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &unsigned_vtable;
+			VT(that)->Destroy(that);
+			that->kind = UnsignedKind;
 			that->u = u;
 		}
 
@@ -931,7 +1516,6 @@ namespace libvariant {
 
 		class Float : public Numeric {
 		public:
-			Float() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual bool AsBool(const Data *that) const;
@@ -942,48 +1526,79 @@ namespace libvariant {
 			virtual void Incr(Data *that) const;
 			virtual void Decr(Data *that) const;
 			virtual Variant Neg(const Data *that) const;
+			virtual void Destroy(Data *that) const;
 		};
 
+		// Floats are stored inline as a double, values that would lose
+		// precision as a double are kept in a LongFloatStorage.
+		static inline long double FloatOf(const Data *that) {
+			if (that->kind == FloatKind) { return that->f; }
+			return static_cast<LongFloatStorage*>(that->storage)->f;
+		}
+
 		void Float::Copy(const Data *that, Data *other) const {
-			FloatInit(other, that->f);
+			FloatInit(other, FloatOf(that));
 		}
 
 		VariantDefines::Type_t Float::GetType(const Data *that) const
 		{ return VariantDefines::FloatType; }
 
 		bool Float::AsBool(const Data *that) const
-		{ return that->f != 0; }
+		{ return FloatOf(that) != 0; }
 
 		long double Float::AsLongDouble(const Data *that) const
-		{ return that->f; }
+		{ return FloatOf(that); }
 
 		uintmax_t Float::AsUnsigned(const Data *that) const
-		{ return (uintmax_t)that->f; }
+		{ return (uintmax_t)FloatOf(that); }
 
 		intmax_t Float::AsInt(const Data *that) const
-		{ return (intmax_t)that->f; }
+		{ return (intmax_t)FloatOf(that); }
 
 		std::string Float::AsString(const Data *that) const {
-			std::ostringstream oss;
-			oss << that->f;
-			return oss.str();
+			// What a default std::ostream writes
+			char buf[FLOAT_CHARS];
+			return std::string(buf, FormatFloat(FloatOf(that), 6, false, buf));
 		}
 
 		void Float::Incr(Data *that) const
-		{ ++that->f; }
+		{ FloatInit(that, FloatOf(that) + 1); }
 
 		void Float::Decr(Data *that) const
-		{ --that->f; }
+		{ FloatInit(that, FloatOf(that) - 1); }
 
 		Variant Float::Neg(const Data *that) const {
-			return Variant(-that->f);
+			return Variant(-FloatOf(that));
+		}
+
+		void Float::Destroy(Data *that) const {
+			if (that->kind == LongFloatKind) { Release(that->storage); }
+			VTable::Destroy(that);
 		}
 
 		void FloatInit(Data *that, long double f) {
-			static const Float float_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &float_vtable;
-			that->f = f;
+			double d = (double)f;
+			if ((long double)d == f || f != f) {
+				VT(that)->Destroy(that);
+				that->kind = FloatKind;
+				that->f = d;
+			} else {
+				Storage *storage = new LongFloatStorage(f);
+				VT(that)->Destroy(that);
+				that->kind = LongFloatKind;
+				that->storage = storage;
+			}
+		}
+
+		/// Make other share the storage of that. The storage is retained
+		/// before other is destroyed so that self assignment is safe.
+		static void ShareStorage(const Data *that, Data *other) {
+			Storage *storage = Retain(that->storage);
+			unsigned char kind = that->kind;
+			other = VTable::GetData(VT(other)->Resolve(other));
+			VT(other)->Destroy(other);
+			other->kind = kind;
+			other->storage = storage;
 		}
 
 		//--------------------
@@ -992,7 +1607,6 @@ namespace libvariant {
 
 		class String : public VTable {
 		public:
-			String() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
@@ -1005,101 +1619,178 @@ namespace libvariant {
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Destroy(Data *that) const;
 		};
 
-		const VTable *StringVTable() {
-			static const String string_vtable;
-			return &string_vtable;
+		static inline const char *StringChars(const Data *that) {
+			if (that->kind == ShortStringKind) { return SmallStringOf(that); }
+			if (that->kind == InternedStringKind) { return that->interned->str.data(); }
+			return StringOf(that)->Chars();
 		}
 
-		void String::Copy(const Data *that, Data *other) const
-		{ StringInit(other, *that->s); }
+		static inline size_t StringLength(const Data *that) {
+			if (that->kind == ShortStringKind) { return that->small_len; }
+			if (that->kind == InternedStringKind) { return that->interned->str.size(); }
+			return StringOf(that)->length;
+		}
+
+		/// Compare like std::string::compare
+		static inline int CompareChars(const char *lhs, size_t lhs_len, const char *rhs, size_t rhs_len) {
+			int res = memcmp(lhs, rhs, std::min(lhs_len, rhs_len));
+			if (res != 0) { return res; }
+			if (lhs_len < rhs_len) { return -1; }
+			return lhs_len > rhs_len ? 1 : 0;
+		}
+
+		static inline std::string StringValue(const Data *that)
+		{ return std::string(StringChars(that), StringLength(that)); }
+
+		void String::Copy(const Data *that, Data *other) const {
+			if (that->kind == InternedStringKind) {
+				InternedStringInit(other, that->interned);
+			} else {
+				StringInit(other, StringChars(that), StringLength(that));
+			}
+		}
 
 		void String::Assign(const Data *that, Data *other) const {
-			assert(that->vtable);
-			shared_ptr<Storage> storage = that->storage;
-			std::string *s = that->s;
-			if (other->vtable) { other = VTable::GetData(other->vtable->Resolve(other)); }
-			if (other->vtable) { other->vtable->Destroy(other); }
-			other->vtable = StringVTable();
-			other->s = s;
-			other->storage = storage;
+			if (that->kind == ShortStringKind) {
+				other = VTable::GetData(VT(other)->Resolve(other));
+				StringInit(other, SmallStringOf(that), that->small_len);
+			} else if (that->kind == InternedStringKind) {
+				InternedStringInit(VTable::GetData(VT(other)->Resolve(other)), that->interned);
+			} else {
+				ShareStorage(that, other);
+			}
 		}
 
 		VariantDefines::Type_t String::GetType(const Data *that) const
 		{ return VariantDefines::StringType; }
 
 		bool String::AsBool(const Data *that) const
-		{ return ParseBool(*that->s); }
+		{ return ParseBool(StringValue(that)); }
+
+		// Like reading from a std::istream, leading white space is skipped
+		// and anything after the number ignored.
 
 		long double String::AsLongDouble(const Data *that) const {
-			std::istringstream iss(*that->s);
+			const char *e = StringChars(that) + StringLength(that);
 			long double val = 0;
-			iss >> val;
-			if (iss.fail()) { throw UnableToConvertError(that->vtable->GetType(that), "a float"); }
+			if (ParseFloat(SkipSpace(StringChars(that), e), e, val) != NUMBER_OK) {
+				throw UnableToConvertError(VT(that)->GetType(that), "a float");
+			}
 			return val;
 		}
 
 		uintmax_t String::AsUnsigned(const Data *that) const {
-			std::istringstream iss(*that->s);
+			const char *e = StringChars(that) + StringLength(that);
 			uintmax_t val = 0;
-			iss >> val;
-			if (iss.fail()) { throw UnableToConvertError(that->vtable->GetType(that), "an unsigned"); }
+			if (ParseUnsigned(SkipSpace(StringChars(that), e), e, val) != NUMBER_OK) {
+				throw UnableToConvertError(VT(that)->GetType(that), "an unsigned");
+			}
 			return val;
 		}
 
 		intmax_t String::AsInt(const Data *that) const {
-			std::istringstream iss(*that->s);
+			const char *e = StringChars(that) + StringLength(that);
 			intmax_t val = 0;
-			iss >> val;
-			if (iss.fail()) { throw UnableToConvertError(that->vtable->GetType(that), "an int"); }
+			if (ParseInt(SkipSpace(StringChars(that), e), e, val) != NUMBER_OK) {
+				throw UnableToConvertError(VT(that)->GetType(that), "an int");
+			}
 			return val;
 		}
 
 		std::string String::AsString(const Data *that) const
-		{ return *that->s; }
+		{ return StringValue(that); }
 
-		unsigned String::Size(const Data *that) const { return that->s->size(); }
+		unsigned String::Size(const Data *that) const { return StringLength(that); }
 
-		bool String::Empty(const Data *that) const { return that->s->empty(); }
+		bool String::Empty(const Data *that) const { return StringLength(that) == 0; }
 
-		void String::Clear(Data *that) const { return that->s->clear(); }
+		void String::Clear(Data *that) const { StringInit(that, "", 0); }
 
 		int String::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				other = VTable::GetData(other->vtable->ResolveConst(other));
-				return that->s->compare(*other->s);
+				other = VTable::GetData(VT(other)->ResolveConst(other));
+				if (that->kind == InternedStringKind && other->kind == InternedStringKind
+						&& that->interned == other->interned) {
+					return 0;
+				}
+				return CompareChars(StringChars(that), StringLength(that),
+						StringChars(other), StringLength(other));
 			}
-			return 1;
+			return CompareTypes(that, other);
 		}
 
+		/// Hash of the characters, the same for every kind of string.
+		static inline size_t StringHash(const Data *that) {
+			if (that->kind == InternedStringKind) { return that->interned->hash; }
+			return HashChars(StringChars(that), StringLength(that));
+		}
+
+		size_t String::Hash(const Data *that) const
+		{ return HashCombine(HashCombine(0, Variant::StringType), StringHash(that)); }
+
 		void String::Destroy(Data *that) const {
+			if (that->kind == StringKind) { Release(that->storage); }
 			VTable::Destroy(that);
-			that->s = 0;
 		}
 
-		void StringInit(Data *that, const std::string &s) {
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = StringVTable();
-			shared_ptr<StringStorage> storage(new StringStorage(s));
-			that->s = &storage->str;
+		void StringInit(Data *that, const std::string &s)
+		{ StringInit(that, s.data(), s.size()); }
+
+		void StringInit(Data *that, const char *s, size_t len) {
+			if (len <= SmallStringCapacity) {
+				// s may point into that, so copy it out before destroying
+				char buf[SmallStringCapacity];
+				memcpy(buf, s, len);
+				VT(that)->Destroy(that);
+				that->kind = ShortStringKind;
+				that->small_len = len;
+				memcpy(SmallStringOf(that), buf, len);
+			} else {
+				Storage *storage = StringStorage::New(s, len);
+				VT(that)->Destroy(that);
+				that->kind = StringKind;
+				that->storage = storage;
+			}
+		}
+
+		void BorrowedStringInit(Data *that, const char *s, size_t len, ConstBlobPtr owner) {
+			// Too short to be worth a storage of its own
+			if (len <= SmallStringCapacity) {
+				StringInit(that, s, len);
+				return;
+			}
+			Storage *storage = new BorrowedStringStorage(s, len, owner);
+			VT(that)->Destroy(that);
+			that->kind = StringKind;
 			that->storage = storage;
 		}
 
+		void InternedStringInit(Data *that, const InternedString *interned) {
+			VT(that)->Destroy(that);
+			that->kind = InternedStringKind;
+			that->interned = interned;
+		}
+
+		void InternedStringInit(Data *that, const char *s, size_t len)
+		{ InternedStringInit(that, GetInternTable().Intern(s, len)); }
+
 		//--------------------
 		// ListVTable
 		//--------------------
 
 		class List : public VTable {
 		public:
-			List() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::List &AsList(Data *that) const;
 			virtual const Variant::List &AsListConst(const Data *that) const;
 			virtual bool ContainsIndex(const Data *that, unsigned i) const;
@@ -1108,80 +1799,367 @@ namespace libvariant {
 			virtual VariantRef GetRefIndex(Data *that, unsigned i, Variant *def) const;
 			virtual const Variant *GetConstIndex(const Data *that, unsigned i, bool checked) const;
 			virtual Variant *GetIndex(Data *that, unsigned i, bool checked) const;
-			virtual void SetIndex(Data *that, unsigned i, const Data *other) const;
+			virtual Variant *SlotIndex(Data *that, unsigned i) const;
+			virtual Variant *SlotBack(Data *that) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Destroy(Data *that) const;
 		};
 
-		const VTable *ListVTable() {
-			static const List list_vtable;
-			return &list_vtable;
+		static void MarkCopyOnWrite(const Data *that);
+
+		/// Get the cached hash of storage if it is still valid.
+		static bool GetCachedHash(const ContainerStorage *storage, size_t &hash) {
+			if (!storage->copy_on_write || storage->dirty || storage->exposed) { return false; }
+			MutexLock lock(GetMirrorMutex());
+			if (!storage->hash_cached) { return false; }
+			hash = storage->hash;
+			return true;
+		}
+
+		/// Remember the hash of storage if it can not change until the next
+		/// write to it.
+		static void SetCachedHash(ContainerStorage *storage, size_t hash) {
+			if (!storage->copy_on_write || storage->dirty || storage->exposed) { return; }
+			MutexLock lock(GetMirrorMutex());
+			storage->hash = hash;
+			storage->hash_cached = true;
+		}
+
+		/// Whether the hash of an element can only change by writing to the
+		/// container it is in. Not if a VariantRef to it is alive, or if it
+		/// is a container whose own hash could not be cached.
+		static bool HashIsStable(const Data *item) {
+			if (item->flags & HasRefData) {
+				if (item->ref->refcount.Get() > 1) { return false; }
+				item = &item->ref->value;
+			}
+			if (item->kind != ListKind && item->kind != MapKind) { return true; }
+			size_t hash;
+			return GetCachedHash(static_cast<const ContainerStorage*>(item->storage), hash);
 		}
 
-		void List::Copy(const Data *that, Data *other) const {
-			ListInit(other, Variant::List());
-			for (Variant::ConstListIterator i(that->l->list.begin()), e(that->l->list.end());
-					i != e; ++i) {
-				other->l->list.push_back(i->Copy());
+		/// Note that a pointer or reference to an element of that has been
+		/// handed out, so its hash is not cached any more.
+		static void MarkExposed(Data *that) {
+			if (that->kind == ListKind || that->kind == MapKind) {
+				static_cast<ContainerStorage*>(that->storage)->exposed = true;
+			}
+		}
+
+		static void MarkElementsCopyOnWrite(ListStorage *storage) {
+			// Packed elements are only numbers
+			if (storage->packed) { return; }
+			for (unsigned i = 0, size = storage->Size(); i < size; ++i) {
+				MarkCopyOnWrite(VTable::GetData(&storage->At(i)));
 			}
 		}
 
-		void List::Assign(const Data *that, Data *other) const {
-			assert(that->vtable);
-			shared_ptr<Storage> storage = that->storage;
-			ListStorage *l = that->l;
-			if (other->vtable) { other = VTable::GetData(other->vtable->Resolve(other)); }
-			if (other->vtable) { other->vtable->Destroy(other); }
-			other->vtable = ListVTable();
-			other->l = l;
+		static void MarkElementsCopyOnWrite(MapStorage *storage) {
+			if (storage->map) {
+				for (Variant::ConstMapIterator i(storage->map->begin()), e(storage->map->end());
+						i != e; ++i) {
+					MarkCopyOnWrite(VTable::GetData(&i->second));
+				}
+			} else {
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					MarkCopyOnWrite(VTable::GetData(&storage->values[i]));
+				}
+			}
+		}
+
+		/// Mark the containers in the tree at that as copy on write. Subtrees
+		/// that are already marked and have not been written to since are
+		/// skipped.
+		static void MarkCopyOnWrite(const Data *that) {
+			if (that->flags & HasRefData) { that = &that->ref->value; }
+			if (that->kind != ListKind && that->kind != MapKind) { return; }
+			Storage *storage = that->storage;
+			if (storage->copy_on_write && !storage->dirty) { return; }
+			storage->copy_on_write = true;
+			storage->dirty = false;
+			// The elements of a lazy container are marked when it is parsed
+			if (that->kind == ListKind) {
+				ListStorage *list = PeekListOf(that);
+				if (!list->raw.Load()) { MarkElementsCopyOnWrite(list); }
+			} else {
+				MapStorage *map = PeekMapOf(that);
+				if (!map->raw.Load()) { MarkElementsCopyOnWrite(map); }
+			}
+		}
+
+		/// Parse the text of a lazy list into storage, which is in use
+		/// through every node that shares it.
+		static void ParseRaw(ListStorage *storage) {
+			MutexLock lock(GetRawMutex());
+			RawJSON *raw = storage->raw.Load();
+			if (!raw) { return; }
+			Variant parsed = ParseRawJSON(*raw);
+			ListStorage *source = PeekListOf(VTable::GetData(&parsed));
+			std::swap(storage->list, source->list);
+			std::swap(storage->packed, source->packed);
+			for (unsigned i = 0; i < source->small_size; ++i) {
+				MoveData(VTable::GetData(&storage->items[i]), VTable::GetData(&source->items[i]));
+			}
+			storage->small_size = source->small_size;
+			source->small_size = 0;
+			storage->raw.Store(0);
+			delete raw;
+			if (storage->copy_on_write) { MarkElementsCopyOnWrite(storage); }
+		}
+
+		static void ParseRaw(MapStorage *storage) {
+			MutexLock lock(GetRawMutex());
+			RawJSON *raw = storage->raw.Load();
+			if (!raw) { return; }
+			Variant parsed = ParseRawJSON(*raw);
+			MapStorage *source = PeekMapOf(VTable::GetData(&parsed));
+			std::swap(storage->map, source->map);
+			for (unsigned i = 0; i < source->small_size; ++i) {
+				MoveData(VTable::GetData(&storage->keys[i]), VTable::GetData(&source->keys[i]));
+				MoveData(VTable::GetData(&storage->values[i]), VTable::GetData(&source->values[i]));
+			}
+			storage->small_size = source->small_size;
+			source->small_size = 0;
+			storage->raw.Store(0);
+			delete raw;
+			if (storage->copy_on_write) { MarkElementsCopyOnWrite(storage); }
+		}
+
+		Variant LazyJSON(const RawJSON &raw) {
+			Variant result;
+			Data *that = VTable::GetData(&result);
+			if (raw.Text()[0] == '[') {
+				ListStorage *storage = new ListStorage;
+				storage->raw.Store(new RawJSON(raw));
+				that->kind = ListKind;
+				that->storage = storage;
+			} else {
+				MapStorage *storage = MapStorage::New(true);
+				storage->raw.Store(new RawJSON(raw));
+				that->kind = MapKind;
+				that->storage = storage;
+			}
+			return result;
+		}
+
+		static RawJSON *CopyRaw(const AtomicPointer<RawJSON> &raw) {
+			if (!raw.Load()) { return 0; }
+			// Another thread may be parsing it
+			MutexLock lock(GetRawMutex());
+			const RawJSON *text = raw.Load();
+			return text ? new RawJSON(*text) : 0;
+		}
+
+		bool GetRawJSON(const Variant &v, RawJSON &raw) {
+			const Data *data = VTable::GetData(&v);
+			const Data *target = VTable::GetData(VT(data)->ResolveConst(data));
+			RawJSON *copy = 0;
+			if (target->kind == ListKind) {
+				copy = CopyRaw(PeekListOf(target)->raw);
+			} else if (target->kind == MapKind) {
+				copy = CopyRaw(PeekMapOf(target)->raw);
+			}
+			if (!copy) { return false; }
+			raw = *copy;
+			delete copy;
+			return true;
+		}
+
+		static Variant::List *NewUnpackedList(const PackedArray *packed) {
+			unsigned size = packed->Size();
+			Variant::List *list = new Variant::List;
+			list->reserve(size);
+			for (unsigned i = 0; i < size; ++i) { list->push_back(packed->Get(i)); }
+			return list;
+		}
+
+		/// Move the small items of storage into a std::vector, references to
+		/// them follow. A packed list is unpacked into it.
+		static Variant::List &UpgradeList(ListStorage *storage) {
+			if (storage->packed) {
+				Variant::List *list = storage->mirror;
+				storage->mirror = 0;
+				if (!list) { list = NewUnpackedList(storage->packed); }
+				delete storage->packed;
+				storage->packed = 0;
+				storage->list = list;
+			} else if (!storage->list) {
+				Variant::List *list = storage->mirror;
+				storage->mirror = 0;
+				if (!list) { list = new Variant::List(storage->small_size); }
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					Data *to = VTable::GetData(&(*list)[i]);
+					VT(to)->Destroy(to);
+					MoveData(to, VTable::GetData(&storage->items[i]));
+				}
+				storage->small_size = 0;
+				storage->list = list;
+			}
+			return *storage->list;
+		}
+
+		/// Return the list of that for writing, cloning it first if it is
+		/// copy on write and shared.
+		static ListStorage *WritableListOf(Data *that) {
+			ListStorage *storage = ListOf(that);
+			if (storage->copy_on_write) {
+				if (storage->refcount.Get() > 1) {
+					ListStorage *clone = new ListStorage(*storage);
+					clone->copy_on_write = true;
+					// The elements are now shared with the original
+					MarkElementsCopyOnWrite(clone);
+					Release(storage);
+					that->storage = storage = clone;
+				}
+				storage->dirty = true;
+				storage->hash_cached = false;
+			}
+			// Someone holds the mirror, make it the real list
+			if (storage->mirror || storage->packed) { UpgradeList(storage); }
+			return storage;
+		}
+
+		/// Grow the list to at least size elements.
+		static void GrowList(ListStorage *storage, unsigned size) {
+			if (storage->list) {
+				if (storage->list->size() < size) { storage->list->resize(size); }
+			} else if (size > ListStorage::SmallCapacity) {
+				UpgradeList(storage).resize(size);
+			} else if (storage->small_size < size) {
+				// Unused items are always null
+				storage->small_size = size;
+			}
+		}
+
+		void List::Copy(const Data *that, Data *other) const {
+			ListStorage *source = PeekListOf(that);
+			ListStorage *storage = new ListStorage;
+			if (RawJSON *raw = CopyRaw(source->raw)) {
+				// The text can be shared, it never changes
+				storage->raw.Store(raw);
+			} else if (source->packed) {
+				storage->packed = new PackedArray(*source->packed);
+			} else if (source->Size() > ListStorage::SmallCapacity) {
+				unsigned size = source->Size();
+				storage->list = new Variant::List;
+				storage->list->reserve(size);
+				for (unsigned i = 0; i < size; ++i) {
+					storage->list->push_back(source->At(i).Copy());
+				}
+			} else {
+				unsigned size = source->Size();
+				for (unsigned i = 0; i < size; ++i) {
+					storage->items[i] = source->At(i).Copy();
+				}
+				storage->small_size = size;
+			}
+			VT(other)->Destroy(other);
+			other->kind = ListKind;
 			other->storage = storage;
 		}
 
+		void List::Assign(const Data *that, Data *other) const
+		{ ShareStorage(that, other); }
+
 		VariantDefines::Type_t List::GetType(const Data *that) const { return VariantDefines::ListType; }
 
-		unsigned List::Size(const Data *that) const { return that->l->list.size(); }
+		unsigned List::Size(const Data *that) const { return ListOf(that)->Size(); }
+
+		bool List::Empty(const Data *that) const { return ListOf(that)->Size() == 0; }
 
-		bool List::Empty(const Data *that) const { return that->l->list.empty(); }
+		void List::Clear(Data *that) const {
+			ListStorage *storage = WritableListOf(that);
+			if (storage->list) {
+				storage->list->clear();
+			} else {
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					Data *item = VTable::GetData(&storage->items[i]);
+					VT(item)->Destruct(item);
+				}
+				storage->small_size = 0;
+			}
+		}
+
+		void List::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const {
+			ListStorage *storage = ListOf(that);
+			Variant scratch;
+			for (unsigned i = 0, size = storage->Size(); i < size; ++i) {
+				func(0, storage->Element(i, scratch), ctx);
+			}
+		}
 
-		void List::Clear(Data *that) const { return that->l->list.clear(); }
+		Variant::List &List::AsList(Data *that) const {
+			MarkExposed(that);
+			return UpgradeList(WritableListOf(that));
+		}
 
-		Variant::List &List::AsList(Data *that) const { return that->l->list; }
+		static const Variant::List &ListOrMirror(ListStorage *storage) {
+			if (storage->list) { return *storage->list; }
+			MutexLock lock(GetMirrorMutex());
+			if (!storage->mirror) {
+				if (storage->packed) {
+					storage->mirror = NewUnpackedList(storage->packed);
+				} else {
+					storage->mirror = new Variant::List(storage->small_size);
+					for (unsigned i = 0; i < storage->small_size; ++i) {
+						MirrorInit(VTable::GetData(&(*storage->mirror)[i]), VTable::GetData(&storage->items[i]));
+					}
+				}
+			}
+			return *storage->mirror;
+		}
 
-		const Variant::List &List::AsListConst(const Data *that) const { return that->l->list; }
+		const Variant::List &List::AsListConst(const Data *that) const
+		{ return ListOrMirror(ListOf(that)); }
 
-		bool List::ContainsIndex(const Data *that, unsigned i) const { return i < that->l->list.size(); }
+		bool List::ContainsIndex(const Data *that, unsigned i) const { return i < ListOf(that)->Size(); }
 
 		unsigned List::Index(const Data *that, Variant v) const {
-			Variant::ListIterator begin = that->l->list.begin(),
-				end = that->l->list.end();
-			return std::distance(begin, std::find(begin, end, v));
+			ListStorage *storage = ListOf(that);
+			unsigned size = storage->Size();
+			Variant scratch;
+			for (unsigned i = 0; i < size; ++i) {
+				if (storage->Element(i, scratch) == v) { return i; }
+			}
+			return size;
 		}
 
 		void List::EraseIndex(Data *that, unsigned i) const
 		{
-			unsigned size = that->l->list.size();
+			ListStorage *storage = WritableListOf(that);
+			unsigned size = storage->Size();
 			if (i + 1 < size) {
-				that->l->list.at(i).Assign(Variant::NullType);
+				storage->At(i).Assign(Variant::NullType);
 			} else if (i < size) {
-				that->l->list.pop_back();
+				if (storage->list) {
+					storage->list->pop_back();
+				} else {
+					Data *item = VTable::GetData(&storage->items[--storage->small_size]);
+					VT(item)->Destruct(item);
+				}
 			}
 		}
 
 		VariantRef List::GetRefIndex(Data *that, unsigned i, Variant *def) const {
-			if (i < that->l->list.size()) {
-				return VariantRef(that->l->list.at(i));
+			ListStorage *storage = WritableListOf(that);
+			if (i < storage->Size()) {
+				return VariantRef(storage->At(i));
 			} else if (def) {
-				that->l->list.resize(i + 1);
-				that->l->list.at(i) = *def;
-				return VariantRef(that->l->list.at(i));
+				GrowList(storage, i + 1);
+				storage->At(i) = *def;
+				return VariantRef(storage->At(i));
 			} else {
-				return VariantRef(*that->vtable->Resolve(that), Path(1, i));
+				return VariantRef(*VT(that)->Resolve(that), Path(1, i));
 			}
 		}
 
 		const Variant *List::GetConstIndex(const Data *that, unsigned i, bool checked) const {
-			if (i < that->l->list.size()) {
-				return &that->l->list.at(i);
+			ListStorage *storage = ListOf(that);
+			if (i < storage->Size()) {
+				// The element has to outlive the call
+				if (storage->packed) { return &ListOrMirror(storage)[i]; }
+				return &storage->At(i);
 			} else if (!checked) {
 				return 0;
 			} else {
@@ -1190,8 +2168,9 @@ namespace libvariant {
 		}
 
 		Variant *List::GetIndex(Data *that, unsigned i, bool checked) const {
-			if (i < that->l->list.size()) {
-				return &that->l->list.at(i);
+			ListStorage *storage = WritableListOf(that);
+			if (i < storage->Size()) {
+				return &storage->At(i);
 			} else if (!checked) {
 				return 0;
 			} else {
@@ -1199,31 +2178,87 @@ namespace libvariant {
 			}
 		}
 
-		void List::SetIndex(Data *that, unsigned i, const Data *other) const {
-			if ( ! (i < that->l->list.size()) ) {
-				that->l->list.resize(i + 1);
-			}
-			other->vtable->Assign(other, VTable::GetData(&that->l->list.at(i)));
+		Variant *List::SlotIndex(Data *that, unsigned i) const {
+			ListStorage *storage = WritableListOf(that);
+			GrowList(storage, i + 1);
+			return &storage->At(i);
+		}
+
+		Variant *List::SlotBack(Data *that) const {
+			ListStorage *storage = WritableListOf(that);
+			GrowList(storage, storage->Size() + 1);
+			return &storage->At(storage->Size() - 1);
 		}
 
 		int List::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				other = VTable::GetData(other->vtable->ResolveConst(other));
-				return (that->l->list != other->l->list ? 1 : 0);
+				other = VTable::GetData(VT(other)->ResolveConst(other));
+				ListStorage *lhs = ListOf(that);
+				ListStorage *rhs = ListOf(other);
+				if (lhs == rhs) { return 0; }
+				// Lexicographic like std::vector
+				unsigned lhs_size = lhs->Size(), rhs_size = rhs->Size();
+				Variant lhs_scratch, rhs_scratch;
+				for (unsigned i = 0; i < lhs_size && i < rhs_size; ++i) {
+					int res = lhs->Element(i, lhs_scratch).Compare(rhs->Element(i, rhs_scratch));
+					if (res != 0) { return res; }
+				}
+				if (lhs_size < rhs_size) { return -1; }
+				return lhs_size > rhs_size ? 1 : 0;
+			}
+			return CompareTypes(that, other);
+		}
+
+		size_t List::Hash(const Data *that) const {
+			ListStorage *storage = ListOf(that);
+			size_t hash;
+			if (GetCachedHash(storage, hash)) { return hash; }
+			unsigned size = storage->Size();
+			hash = HashCombine(HashCombine(0, Variant::ListType), size);
+			Variant scratch;
+			bool stable = true;
+			for (unsigned i = 0; i < size; ++i) {
+				const Data *item = VTable::GetData(&storage->Element(i, scratch));
+				hash = HashCombine(hash, VT(item)->Hash(item));
+				stable = stable && HashIsStable(item);
 			}
-			return 1;
+			if (stable) { SetCachedHash(storage, hash); }
+			return hash;
 		}
 
 		void List::Destroy(Data *that) const {
+			Release(that->storage);
 			VTable::Destroy(that);
-			that->l = 0;
 		}
 
 		void ListInit(Data *that, const Variant::List &l) {
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = ListVTable();
-			shared_ptr<ListStorage> storage(new ListStorage(l));
-			that->l = storage.get();
+			ListStorage *storage = new ListStorage;
+			if (l.size() > ListStorage::SmallCapacity) {
+				storage->list = new Variant::List(l);
+			} else {
+				std::copy(l.begin(), l.end(), storage->items);
+				storage->small_size = l.size();
+			}
+			VT(that)->Destroy(that);
+			that->kind = ListKind;
+			that->storage = storage;
+		}
+
+		/// Make that a list of the numbers in v, packed unless it is small.
+		template<typename T>
+		static void PackedListInit(Data *that, VariantDefines::Type_t type, const std::vector<T> &v,
+				std::vector<T> PackedArray::*elements)
+		{
+			ListStorage *storage = new ListStorage;
+			if (v.size() > ListStorage::SmallCapacity) {
+				storage->packed = new PackedArray(type);
+				storage->packed->*elements = v;
+			} else {
+				std::copy(v.begin(), v.end(), storage->items);
+				storage->small_size = v.size();
+			}
+			VT(that)->Destroy(that);
+			that->kind = ListKind;
 			that->storage = storage;
 		}
 
@@ -1233,123 +2268,413 @@ namespace libvariant {
 
 		class Map : public VTable {
 		public:
-			Map() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::Map &AsMap(Data *that) const;
 			virtual const Variant::Map &AsMapConst(const Data *that) const;
-			virtual bool ContainsKey(const Data *that, const std::string &s) const;
-			virtual void EraseKey(Data *that, const std::string &key) const;
-			virtual VariantRef GetRefKey(Data *that, const std::string &s, Variant *def) const;
-			virtual const Variant *GetConstKey(const Data *that, const std::string &s, bool checked) const;
-			virtual Variant *GetKey(Data *that, const std::string &s, bool checked) const;
-			virtual void SetKey(Data *that, const std::string &s, const Data *other) const;
+			virtual bool ContainsKey(const Data *that, KeyRef s) const;
+			virtual void EraseKey(Data *that, KeyRef key) const;
+			virtual VariantRef GetRefKey(Data *that, KeyRef s, Variant *def) const;
+			virtual const Variant *GetConstKey(const Data *that, KeyRef s, bool checked) const;
+			virtual Variant *GetKey(Data *that, KeyRef s, bool checked) const;
+			virtual Variant *SlotKey(Data *that, KeyRef s) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Destroy(Data *that) const;
 		};
 
-		const VTable *MapVTable() {
-			static const Map map_vtable;
-			return &map_vtable;
+		/// Look for s in the keys of a small map. Returns if it was found and
+		/// sets pos to where it is or would be inserted.
+		static bool FindSmallKey(const MapStorage *storage, const char *s, size_t len, unsigned *pos) {
+			for (unsigned i = 0; i < storage->small_size; ++i) {
+				const Data *key = VTable::GetData(&storage->keys[i]);
+				int res = CompareChars(StringChars(key), StringLength(key), s, len);
+				if (res >= 0) {
+					*pos = i;
+					return res == 0;
+				}
+			}
+			*pos = storage->small_size;
+			return false;
 		}
 
-		void Map::Copy(const Data *that, Data *other) const {
-			MapInit(other, Variant::Map());
-			for (Variant::ConstMapIterator i(that->m->map.begin()), e(that->m->map.end());
-					i != e; ++i) {
-				other->m->map.insert(std::make_pair(i->first, i->second.Copy()));
+		static bool FindSmallKey(const MapStorage *storage, KeyRef s, unsigned *pos)
+		{ return FindSmallKey(storage, s.data(), s.size(), pos); }
+
+		/// Move the small entries of storage into a Variant::Map, references
+		/// to the values follow.
+		static Variant::Map &UpgradeMap(MapStorage *storage) {
+			if (!storage->map) {
+				Variant::Map *map = storage->mirror;
+				storage->mirror = 0;
+				if (!map) { map = new Variant::Map; }
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					Data *to = VTable::GetData(&(*map)[storage->keys[i].AsString()]);
+					VT(to)->Destroy(to);
+					MoveData(to, VTable::GetData(&storage->values[i]));
+					NullInit(VTable::GetData(&storage->keys[i]));
+				}
+				storage->small_size = 0;
+				storage->map = map;
+			}
+			return *storage->map;
+		}
+
+		/// UpgradeMap for the map of that. Unless something else holds the
+		/// storage the map moves to storage without room for small entries.
+		static Variant::Map &UpgradeMap(Data *that, MapStorage *storage) {
+			if (storage->map || storage->refcount.Get() > 1) { return UpgradeMap(storage); }
+			MapStorage *big = MapStorage::New(false);
+			big->map = &UpgradeMap(storage);
+			storage->map = 0;
+			big->copy_on_write = storage->copy_on_write;
+			big->dirty = storage->dirty;
+			big->exposed = storage->exposed;
+			Release(storage);
+			that->storage = big;
+			return *big->map;
+		}
+
+		/// Return the map of that for writing, cloning it first if it is
+		/// copy on write and shared.
+		static MapStorage *WritableMapOf(Data *that) {
+			MapStorage *storage = MapOf(that);
+			if (storage->copy_on_write) {
+				if (storage->refcount.Get() > 1) {
+					MapStorage *clone = MapStorage::Clone(*storage);
+					clone->copy_on_write = true;
+					// The elements are now shared with the original
+					MarkElementsCopyOnWrite(clone);
+					Release(storage);
+					that->storage = storage = clone;
+				}
+				storage->dirty = true;
+				storage->hash_cached = false;
 			}
+			// Someone holds the mirror, make it the real map
+			if (storage->mirror) { UpgradeMap(storage); }
+			return storage;
+		}
+
+		/// The entry for s in a big map given the hash Variant::Map has for
+		/// it. Only a std::map needs s as a std::string.
+		static Variant::MapIterator FindEntry(Variant::Map &map, KeyRef s, size_t hash) {
+#ifdef LIBVARIANT_HASH_MAP
+			return map.find(s.data(), s.size(), hash);
+#else
+			return map.find(s.str());
+#endif
+		}
+
+		static size_t KeyHash(KeyRef s) {
+#ifdef LIBVARIANT_HASH_MAP
+			return HashMapHash<std::string>()(s.data(), s.size());
+#else
+			// Only a HashMap uses it
+			return 0;
+#endif
+		}
+
+		/// FindKey for when the hash Variant::Map has for s is known
+		static Variant *FindKey(MapStorage *storage, KeyRef s, size_t hash) {
+			if (storage->map) {
+				Variant::MapIterator entry = FindEntry(*storage->map, s, hash);
+				return entry == storage->map->end() ? 0 : &entry->second;
+			}
+			unsigned pos;
+			return FindSmallKey(storage, s, &pos) ? &storage->values[pos] : 0;
+		}
+
+		static Variant *FindKey(MapStorage *storage, KeyRef s) {
+			// A small map never needs the hash
+			return FindKey(storage, s, storage->map ? KeyHash(s) : 0);
 		}
 
-		void Map::Assign(const Data *that, Data *other) const {
-			assert(that->vtable);
-			shared_ptr<Storage> storage = that->storage;
-			MapStorage *m = that->m;
-			if (other->vtable) { other = VTable::GetData(other->vtable->Resolve(other)); }
-			if (other->vtable) { other->vtable->Destroy(other); }
-			other->vtable = MapVTable();
-			other->m = m;
+		/// Return the value for s, inserting a null value if it is missing.
+		static Variant *InsertKey(MapStorage *storage, KeyRef s) {
+			if (!storage->map) {
+				unsigned pos;
+				if (FindSmallKey(storage, s, &pos)) { return &storage->values[pos]; }
+				if (storage->small_size < MapStorage::SmallCapacity) {
+					for (unsigned i = storage->small_size; i > pos; --i) {
+						MoveData(VTable::GetData(&storage->keys[i]), VTable::GetData(&storage->keys[i - 1]));
+						MoveData(VTable::GetData(&storage->values[i]), VTable::GetData(&storage->values[i - 1]));
+					}
+					if (intern_keys) {
+						InternedStringInit(VTable::GetData(&storage->keys[pos]), s.data(), s.size());
+					} else {
+						StringInit(VTable::GetData(&storage->keys[pos]), s.data(), s.size());
+					}
+					++storage->small_size;
+					return &storage->values[pos];
+				}
+				UpgradeMap(storage);
+			}
+			Variant::MapIterator entry = FindEntry(*storage->map, s, KeyHash(s));
+			if (entry != storage->map->end()) { return &entry->second; }
+			return &(*storage->map)[s.str()];
+		}
+
+		/// InsertKey for the map of that, when it has to grow it may get
+		/// new storage.
+		static Variant *InsertKey(Data *that, KeyRef s) {
+			MapStorage *storage = WritableMapOf(that);
+			unsigned pos;
+			if (!storage->map && storage->small_size == MapStorage::SmallCapacity
+					&& !FindSmallKey(storage, s, &pos)) {
+				UpgradeMap(that, storage);
+				storage = PeekMapOf(that);
+			}
+			return InsertKey(storage, s);
+		}
+
+		void Map::Copy(const Data *that, Data *other) const {
+			MapStorage *source = PeekMapOf(that);
+			RawJSON *raw = CopyRaw(source->raw);
+			MapStorage *storage = MapStorage::New(raw || !source->map);
+			if (raw) {
+				// The text can be shared, it never changes
+				storage->raw.Store(raw);
+			} else if (source->map) {
+				storage->map = new Variant::Map;
+				for (Variant::ConstMapIterator i(source->map->begin()), e(source->map->end());
+						i != e; ++i) {
+					storage->map->insert(std::make_pair(i->first, i->second.Copy()));
+				}
+			} else {
+				for (unsigned i = 0; i < source->small_size; ++i) {
+					storage->keys[i] = source->keys[i].Copy();
+					storage->values[i] = source->values[i].Copy();
+				}
+				storage->small_size = source->small_size;
+			}
+			VT(other)->Destroy(other);
+			other->kind = MapKind;
 			other->storage = storage;
 		}
 
+		void Map::Assign(const Data *that, Data *other) const
+		{ ShareStorage(that, other); }
+
 		VariantDefines::Type_t Map::GetType(const Data *that) const { return VariantDefines::MapType; }
 
-		unsigned Map::Size(const Data *that) const { return that->m->map.size(); }
+		unsigned Map::Size(const Data *that) const { return MapOf(that)->Size(); }
 
-		bool Map::Empty(const Data *that) const { return that->m->map.empty(); }
+		bool Map::Empty(const Data *that) const { return MapOf(that)->Size() == 0; }
+
+		void Map::Clear(Data *that) const {
+			MapStorage *storage = WritableMapOf(that);
+			if (storage->map) {
+				storage->map->clear();
+			} else {
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					NullInit(VTable::GetData(&storage->keys[i]));
+					Data *value = VTable::GetData(&storage->values[i]);
+					VT(value)->Destruct(value);
+				}
+				storage->small_size = 0;
+			}
+		}
 
-		void Map::Clear(Data *that) const { return that->m->map.clear(); }
+		void Map::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const {
+			MapStorage *storage = MapOf(that);
+			if (storage->map) {
+				std::vector<const Variant::Map::value_type*> entries;
+				SortedEntries(*storage->map, entries);
+				for (unsigned i = 0; i < entries.size(); ++i) {
+					func(&entries[i]->first, entries[i]->second, ctx);
+				}
+			} else {
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					std::string key = storage->keys[i].AsString();
+					func(&key, storage->values[i], ctx);
+				}
+			}
+		}
 
-		Variant::Map &Map::AsMap(Data *that) const { return that->m->map; }
+		Variant::Map &Map::AsMap(Data *that) const {
+			MarkExposed(that);
+			return UpgradeMap(that, WritableMapOf(that));
+		}
 
-		const Variant::Map &Map::AsMapConst(const Data *that) const { return that->m->map; }
+		const Variant::Map &Map::AsMapConst(const Data *that) const {
+			MapStorage *storage = MapOf(that);
+			if (storage->map) { return *storage->map; }
+			MutexLock lock(GetMirrorMutex());
+			if (!storage->mirror) {
+				storage->mirror = new Variant::Map;
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					Variant &value = (*storage->mirror)[storage->keys[i].AsString()];
+					MirrorInit(VTable::GetData(&value), VTable::GetData(&storage->values[i]));
+				}
+			}
+			return *storage->mirror;
+		}
 
-		bool Map::ContainsKey(const Data *that, const std::string &s) const
-		{ return that->m->map.find(s) != that->m->map.end(); }
+		bool Map::ContainsKey(const Data *that, KeyRef s) const
+		{ return FindKey(MapOf(that), s) != 0; }
 
-		void Map::EraseKey(Data *that, const std::string &key) const { that->m->map.erase(key); }
+		void Map::EraseKey(Data *that, KeyRef key) const {
+			MapStorage *storage = WritableMapOf(that);
+			if (storage->map) {
+				Variant::MapIterator entry = FindEntry(*storage->map, key, KeyHash(key));
+				if (entry != storage->map->end()) { storage->map->erase(entry); }
+				return;
+			}
+			unsigned pos;
+			if (!FindSmallKey(storage, key, &pos)) { return; }
+			NullInit(VTable::GetData(&storage->keys[pos]));
+			Data *value = VTable::GetData(&storage->values[pos]);
+			VT(value)->Destruct(value);
+			for (unsigned i = pos + 1; i < storage->small_size; ++i) {
+				MoveData(VTable::GetData(&storage->keys[i - 1]), VTable::GetData(&storage->keys[i]));
+				MoveData(VTable::GetData(&storage->values[i - 1]), VTable::GetData(&storage->values[i]));
+			}
+			--storage->small_size;
+		}
 
-		VariantRef Map::GetRefKey(Data *that, const std::string &s, Variant *def) const {
-			Variant::MapIterator entry = that->m->map.find(s);
-			if (entry != that->m->map.end()) {
-				return VariantRef(entry->second);
+		VariantRef Map::GetRefKey(Data *that, KeyRef s, Variant *def) const {
+			MapStorage *storage = WritableMapOf(that);
+			Variant *entry = FindKey(storage, s);
+			if (entry) {
+				return VariantRef(*entry);
 			} else if (def) {
-				return VariantRef(that->m->map.insert(std::make_pair(s, *def)).first->second);
+				entry = InsertKey(that, s);
+				*entry = *def;
+				return VariantRef(*entry);
 			} else {
-				return VariantRef(*that->vtable->Resolve(that), Path(1, s));
+				return VariantRef(*VT(that)->Resolve(that), Path(1, s.str()));
 			}
 		}
 
-		const Variant *Map::GetConstKey(const Data *that, const std::string &s, bool checked) const {
-			Variant::MapIterator entry = that->m->map.find(s);
-			if (entry != that->m->map.end()) {
-				return &entry->second;
+		const Variant *Map::GetConstKey(const Data *that, KeyRef s, bool checked) const {
+			const Variant *entry = FindKey(MapOf(that), s);
+			if (entry) {
+				return entry;
 			} else if (!checked) {
 				return 0;
 			} else {
-				throw KeyError(s);
+				throw KeyError(s.str());
 			}
 		}
 
-		Variant *Map::GetKey(Data *that, const std::string &s, bool checked) const {
-			Variant::MapIterator entry = that->m->map.find(s);
-			if (entry != that->m->map.end()) {
-				return &entry->second;
+		Variant *Map::GetKey(Data *that, KeyRef s, bool checked) const {
+			Variant *entry = FindKey(WritableMapOf(that), s);
+			if (entry) {
+				return entry;
 			} else if (!checked) {
 				return 0;
 			} else {
-				throw KeyError(s);
+				throw KeyError(s.str());
 			}
 		}
 
-		void Map::SetKey(Data *that, const std::string &s, const Data *other) const {
-			Variant::MapIterator entry = that->m->map.insert(std::make_pair(s, Variant())).first;
-			other->vtable->Assign(other, VTable::GetData(&entry->second));
-		}
+		Variant *Map::SlotKey(Data *that, KeyRef s) const
+		{ return InsertKey(that, s); }
 
+		/// The entries of a map in key order, whether it is small or not.
+		class SortedMapEntries {
+		public:
+			explicit SortedMapEntries(const MapStorage *s) : storage(s) {
+				if (storage->map) { SortedEntries(*storage->map, entries); }
+			}
+			unsigned Size() const { return storage->Size(); }
+			int CompareKey(unsigned i, const SortedMapEntries &o, unsigned j) const {
+				const char *lhs, *rhs;
+				size_t lhs_len, rhs_len;
+				Key(i, lhs, lhs_len);
+				o.Key(j, rhs, rhs_len);
+				return CompareChars(lhs, lhs_len, rhs, rhs_len);
+			}
+			const Variant &Value(unsigned i) const
+			{ return storage->map ? entries[i]->second : storage->values[i]; }
+		private:
+			void Key(unsigned i, const char *&chars, size_t &len) const {
+				if (storage->map) {
+					chars = entries[i]->first.data();
+					len = entries[i]->first.size();
+				} else {
+					chars = StringChars(VTable::GetData(&storage->keys[i]));
+					len = StringLength(VTable::GetData(&storage->keys[i]));
+				}
+			}
+			const MapStorage *storage;
+			std::vector<const Variant::Map::value_type*> entries;
+		};
 
 		int Map::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				other = VTable::GetData(other->vtable->ResolveConst(other));
-				return (that->m->map != other->m->map ? 1 : 0);
+				other = VTable::GetData(VT(other)->ResolveConst(other));
+				MapStorage *lhs = MapOf(that);
+				MapStorage *rhs = MapOf(other);
+				if (lhs == rhs) { return 0; }
+				// Lexicographic over the (key, value) pairs in key order
+				// like std::map
+				SortedMapEntries lhs_entries(lhs), rhs_entries(rhs);
+				unsigned lhs_size = lhs->Size(), rhs_size = rhs->Size();
+				for (unsigned i = 0; i < lhs_size && i < rhs_size; ++i) {
+					int res = lhs_entries.CompareKey(i, rhs_entries, i);
+					if (res != 0) { return res; }
+					res = lhs_entries.Value(i).Compare(rhs_entries.Value(i));
+					if (res != 0) { return res; }
+				}
+				if (lhs_size < rhs_size) { return -1; }
+				return lhs_size > rhs_size ? 1 : 0;
 			}
-			return 1;
+			return CompareTypes(that, other);
+		}
+
+		/// Entries are summed so that the order they are stored in does not
+		/// matter.
+		static inline size_t HashEntry(size_t key_hash, const Variant &value) {
+			const Data *v = VTable::GetData(&value);
+			return HashFinish(HashCombine(key_hash, VT(v)->Hash(v)));
+		}
+
+		size_t Map::Hash(const Data *that) const {
+			MapStorage *storage = MapOf(that);
+			size_t hash;
+			if (GetCachedHash(storage, hash)) { return hash; }
+			hash = 0;
+			bool stable = true;
+			if (storage->map) {
+				for (Variant::ConstMapIterator i(storage->map->begin()), e(storage->map->end());
+						i != e; ++i) {
+					hash += HashEntry(HashChars(i->first.data(), i->first.size()), i->second);
+					stable = stable && HashIsStable(VTable::GetData(&i->second));
+				}
+			} else {
+				for (unsigned i = 0; i < storage->small_size; ++i) {
+					hash += HashEntry(StringHash(VTable::GetData(&storage->keys[i])), storage->values[i]);
+					stable = stable && HashIsStable(VTable::GetData(&storage->values[i]));
+				}
+			}
+			hash = HashCombine(HashCombine(HashCombine(0, Variant::MapType), storage->Size()), hash);
+			if (stable) { SetCachedHash(storage, hash); }
+			return hash;
 		}
 
 		void Map::Destroy(Data *that) const {
+			Release(that->storage);
 			VTable::Destroy(that);
-			that->m = 0;
 		}
 
 		void MapInit(Data *that, const Variant::Map &m) {
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = MapVTable();
-			shared_ptr<MapStorage> storage(new MapStorage(m));
-			that->m = storage.get();
+			MapStorage *storage = MapStorage::New(m.size() <= MapStorage::SmallCapacity);
+			if (!storage->keys) {
+				storage->map = new Variant::Map(m);
+			} else {
+				for (Variant::ConstMapIterator i(m.begin()), e(m.end()); i != e; ++i) {
+					*InsertKey(storage, i->first) = i->second;
+				}
+			}
+			VT(that)->Destroy(that);
+			that->kind = MapKind;
 			that->storage = storage;
 		}
 
@@ -1359,7 +2684,6 @@ namespace libvariant {
 
 		class Blob : public VTable {
 		public:
-			Blob() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual Variant::Type_t GetType(const Data *that) const;
@@ -1367,54 +2691,63 @@ namespace libvariant {
 			virtual ConstBlobPtr AsBlobConst(const Data *that) const;
 			virtual unsigned Size(const Data *that) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
+			virtual void Destroy(Data *that) const;
 		};
 
-		const VTable *BlobVTable() {
-			static const Blob blob_vtable;
-			return &blob_vtable;
-		}
-
 		void Blob::Copy(const Data *that, Data *other) const
-		{ BlobInit(other, ( (*that->blob) ? (*that->blob)->Copy() : BlobPtr() )); }
-
-		void Blob::Assign(const Data *that, Data *other) const {
-			assert(that->vtable);
-			shared_ptr<Storage> storage = that->storage;
-			BlobPtr *b = that->blob;
-			if (other->vtable) { other = VTable::GetData(other->vtable->Resolve(other)); }
-			if (other->vtable) { other->vtable->Destroy(other); }
-			other->vtable = BlobVTable();
-			other->blob = b;
-			other->storage = storage;
-		}
+		{ BlobInit(other, ( BlobOf(that) ? BlobOf(that)->Copy() : BlobPtr() )); }
+
+		void Blob::Assign(const Data *that, Data *other) const
+		{ ShareStorage(that, other); }
 
 		VariantDefines::Type_t Blob::GetType(const Data *that) const
 		{ return VariantDefines::BlobType; }
 
 		BlobPtr Blob::AsBlob(Data *that) const
-		{ return *(that->blob); }
+		{ return BlobOf(that); }
 
 		ConstBlobPtr Blob::AsBlobConst(const Data *that) const
-		{ return *(that->blob); }
+		{ return BlobOf(that); }
 
 		unsigned Blob::Size(const Data *that) const
-		{ return (*that->blob)->GetTotalLength(); }
+		{ return BlobOf(that)->GetTotalLength(); }
 
 		int Blob::Compare(const Data *that, const Data *other) const {
 			if (Comparable(that, other)) {
-				ConstBlobPtr us = (*that->blob);
-				ConstBlobPtr o = other->vtable->AsBlobConst(other);
+				ConstBlobPtr us = BlobOf(that);
+				ConstBlobPtr o = VT(other)->AsBlobConst(other);
 				if (us == o) { return 0; }
-				if (us && o) { return us->Compare(o); }
+				// No blob sorts first
+				if (!us || !o) { return us ? 1 : -1; }
+				int res = us->Compare(o);
+				if (res < 0) { return -1; }
+				return res > 0 ? 1 : 0;
 			}
-			return 1;
+			return CompareTypes(that, other);
+		}
+
+		size_t Blob::Hash(const Data *that) const {
+			size_t hash = HashCombine(0, Variant::BlobType);
+			ConstBlobPtr blob = BlobOf(that);
+			if (!blob) { return hash; }
+			// Hashed as one run of bytes, however they are split up
+			size_t chars = HashChars(0, 0);
+			for (unsigned i = 0; i < blob->GetNumBuffers(); ++i) {
+				chars = HashChars(static_cast<const char*>(blob->GetPtr(i)), blob->GetLength(i), chars);
+			}
+			return HashCombine(hash, chars);
+		}
+
+		void Blob::Destroy(Data *that) const {
+			Release(that->storage);
+			VTable::Destroy(that);
 		}
 
 		void BlobInit(Data *that, BlobPtr blob) {
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = BlobVTable();
-			shared_ptr<BlobStorage> storage(new BlobStorage(blob));
-			that->blob = &storage->blob;
+			Storage *storage = new BlobStorage(blob);
+			VT(that)->Destroy(that);
+			that->kind = BlobKind;
 			that->storage = storage;
 		}
 
@@ -1424,7 +2757,6 @@ namespace libvariant {
 
 		class Ref : public VTable {
 		public:
-			Ref() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual void MakeRef(const Data *that, Data *ref) const;
@@ -1440,6 +2772,7 @@ namespace libvariant {
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::List &AsList(Data *that) const;
 			virtual const Variant::List &AsListConst(const Data *that) const;
 			virtual bool ContainsIndex(const Data *that, unsigned i) const;
@@ -1448,16 +2781,18 @@ namespace libvariant {
 			virtual VariantRef GetRefIndex(Data *that, unsigned i, Variant *def) const;
 			virtual const Variant *GetConstIndex(const Data *that, unsigned i, bool checked) const;
 			virtual Variant *GetIndex(Data *that, unsigned i, bool checked) const;
-			virtual void SetIndex(Data *that, unsigned i, const Data *other) const;
+			virtual Variant *SlotIndex(Data *that, unsigned i) const;
+			virtual Variant *SlotBack(Data *that) const;
 			virtual Variant::Map &AsMap(Data *that) const;
 			virtual const Variant::Map &AsMapConst(const Data *that) const;
-			virtual bool ContainsKey(const Data *that, const std::string &s) const;
-			virtual void EraseKey(Data *that, const std::string &key) const;
-			virtual VariantRef GetRefKey(Data *that, const std::string &s, Variant *def) const;
-			virtual const Variant *GetConstKey(const Data *that, const std::string &s, bool checked) const;
-			virtual Variant *GetKey(Data *that, const std::string &s, bool checked) const;
-			virtual void SetKey(Data *that, const std::string &s, const Data *other) const;
+			virtual bool ContainsKey(const Data *that, KeyRef s) const;
+			virtual void EraseKey(Data *that, KeyRef key) const;
+			virtual VariantRef GetRefKey(Data *that, KeyRef s, Variant *def) const;
+			virtual const Variant *GetConstKey(const Data *that, KeyRef s, bool checked) const;
+			virtual Variant *GetKey(Data *that, KeyRef s, bool checked) const;
+			virtual Variant *SlotKey(Data *that, KeyRef s) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Incr(Data *that) const;
 			virtual void Decr(Data *that) const;
 			virtual Variant Neg(const Data *that) const;
@@ -1466,173 +2801,196 @@ namespace libvariant {
 			virtual void Mul(Data *that, const Data *other) const;
 			virtual void Div(Data *that, const Data *other) const;
 			virtual void Rem(Data *that, const Data *other) const;
+			virtual RefData *EnsureRef(Data *that) const;
 			virtual void Destroy(Data *that) const;
-			virtual void Destruct(Data *that) const;
 			virtual Variant *Resolve(Data *that) const;
 			virtual const Variant *ResolveConst(const Data *that) const;
 			virtual Variant *ResolveDefault(Data *that, const Data *def) const;
 			virtual bool Exists(const Data *that) const;
 		};
 
-		static inline void CheckRef(const Data *that) {
-			if (!that->ref_data || !that->ref_data->valid) {
+		static inline Data *Target(const Data *that) { return that->ref->target; }
+
+		static inline void CheckRef(const RefData *ref) {
+			if (!ref->valid) {
 				throw InvalidReferenceError("Error attempting to access an invalid VariantRef");
 			}
 		}
 
 		void Ref::Copy(const Data *that, Data *other) const
-		{ CheckRef(that); that->ref->vtable->Copy(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Copy(Target(that), other); }
 
 		void Ref::Assign(const Data *that, Data *other) const
-		{ CheckRef(that); that->ref->vtable->Assign(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Assign(Target(that), other); }
 
 		void Ref::MakeRef(const Data *that, Data *ref) const
-		{ CheckRef(that); that->ref->vtable->MakeRef(that->ref, ref); }
+		{ CheckRef(that->ref); VT(Target(that))->MakeRef(Target(that), ref); }
 
 		void Ref::MakeProxy(Data *that, Data *ref, Path::const_iterator b, Path::const_iterator e) const
-		{ CheckRef(that); that->ref->vtable->MakeProxy(that->ref, ref, b, e); }
+		{ CheckRef(that->ref); VT(Target(that))->MakeProxy(Target(that), ref, b, e); }
 
 		VariantDefines::Type_t Ref::GetType(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->GetType(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->GetType(Target(that)); }
 
 		bool Ref::AsBool(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsBool(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsBool(Target(that)); }
 
 		long double Ref::AsLongDouble(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsLongDouble(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsLongDouble(Target(that)); }
 
 		uintmax_t Ref::AsUnsigned(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsUnsigned(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsUnsigned(Target(that)); }
 
 		intmax_t Ref::AsInt(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsInt(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsInt(Target(that)); }
 
 		std::string Ref::AsString(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsString(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsString(Target(that)); }
 
 		BlobPtr Ref::AsBlob(Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsBlob(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsBlob(Target(that)); }
 
 		ConstBlobPtr Ref::AsBlobConst(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsBlobConst(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsBlobConst(Target(that)); }
 
 		unsigned Ref::Size(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->Size(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->Size(Target(that)); }
 
 		bool Ref::Empty(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->Empty(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->Empty(Target(that)); }
 
 		void Ref::Clear(Data *that) const
-		{ CheckRef(that); return that->ref->vtable->Clear(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->Clear(Target(that)); }
+
+		void Ref::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const
+		{ CheckRef(that->ref); VT(Target(that))->ForEach(Target(that), func, ctx); }
 
 		Variant::List &Ref::AsList(Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsList(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsList(Target(that)); }
 
 		const Variant::List &Ref::AsListConst(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsListConst(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsListConst(Target(that)); }
 
 		bool Ref::ContainsIndex(const Data *that, unsigned i) const
-		{ CheckRef(that); return that->ref->vtable->ContainsIndex(that->ref, i); }
+		{ CheckRef(that->ref); return VT(Target(that))->ContainsIndex(Target(that), i); }
 
 		unsigned Ref::Index(const Data *that, Variant v) const
-		{ CheckRef(that); return that->ref->vtable->Index(that->ref, v); }
+		{ CheckRef(that->ref); return VT(Target(that))->Index(Target(that), v); }
 
 		void Ref::EraseIndex(Data *that, unsigned i) const
-		{ CheckRef(that); return that->ref->vtable->EraseIndex(that->ref, i); }
+		{ CheckRef(that->ref); return VT(Target(that))->EraseIndex(Target(that), i); }
 
 		VariantRef Ref::GetRefIndex(Data *that, unsigned i, Variant *def) const
-		{ CheckRef(that); return that->ref->vtable->GetRefIndex(that->ref, i , def); }
+		{ CheckRef(that->ref); return VT(Target(that))->GetRefIndex(Target(that), i , def); }
 
 		const Variant *Ref::GetConstIndex(const Data *that, unsigned i, bool checked) const
-		{ CheckRef(that); return that->ref->vtable->GetConstIndex(that->ref, i, checked); }
+		{ CheckRef(that->ref); return VT(Target(that))->GetConstIndex(Target(that), i, checked); }
 
 		Variant *Ref::GetIndex(Data *that, unsigned i, bool checked) const
-		{ CheckRef(that); return that->ref->vtable->GetIndex(that->ref, i, checked); }
+		{ CheckRef(that->ref); return VT(Target(that))->GetIndex(Target(that), i, checked); }
+
+		Variant *Ref::SlotIndex(Data *that, unsigned i) const
+		{ CheckRef(that->ref); return VT(Target(that))->SlotIndex(Target(that), i); }
 
-		void Ref::SetIndex(Data *that, unsigned i, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->SetIndex(that->ref, i, other); }
+		Variant *Ref::SlotBack(Data *that) const
+		{ CheckRef(that->ref); return VT(Target(that))->SlotBack(Target(that)); }
 
 		Variant::Map &Ref::AsMap(Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsMap(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsMap(Target(that)); }
 
 		const Variant::Map &Ref::AsMapConst(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->AsMapConst(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->AsMapConst(Target(that)); }
 
-		bool Ref::ContainsKey(const Data *that, const std::string &s) const
-		{ CheckRef(that); return that->ref->vtable->ContainsKey(that->ref, s); }
+		bool Ref::ContainsKey(const Data *that, KeyRef s) const
+		{ CheckRef(that->ref); return VT(Target(that))->ContainsKey(Target(that), s); }
 
-		void Ref::EraseKey(Data *that, const std::string &key) const
-		{ CheckRef(that); return that->ref->vtable->EraseKey(that->ref, key); }
+		void Ref::EraseKey(Data *that, KeyRef key) const
+		{ CheckRef(that->ref); return VT(Target(that))->EraseKey(Target(that), key); }
 
-		VariantRef Ref::GetRefKey(Data *that, const std::string &s, Variant *def) const
-		{ CheckRef(that); return that->ref->vtable->GetRefKey(that->ref, s, def); }
+		VariantRef Ref::GetRefKey(Data *that, KeyRef s, Variant *def) const
+		{ CheckRef(that->ref); return VT(Target(that))->GetRefKey(Target(that), s, def); }
 
-		const Variant *Ref::GetConstKey(const Data *that, const std::string &s, bool checked) const
-		{ CheckRef(that); return that->ref->vtable->GetConstKey(that->ref, s, checked); }
+		const Variant *Ref::GetConstKey(const Data *that, KeyRef s, bool checked) const
+		{ CheckRef(that->ref); return VT(Target(that))->GetConstKey(Target(that), s, checked); }
 
-		Variant *Ref::GetKey(Data *that, const std::string &s, bool checked) const
-		{ CheckRef(that); return that->ref->vtable->GetKey(that->ref, s, checked); }
+		Variant *Ref::GetKey(Data *that, KeyRef s, bool checked) const
+		{ CheckRef(that->ref); return VT(Target(that))->GetKey(Target(that), s, checked); }
 
-		void Ref::SetKey(Data *that, const std::string &s, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->SetKey(that->ref, s, other); }
+		Variant *Ref::SlotKey(Data *that, KeyRef s) const
+		{ CheckRef(that->ref); return VT(Target(that))->SlotKey(Target(that), s); }
 
 		int Ref::Compare(const Data *that, const Data *other) const
-		{ CheckRef(that); return that->ref->vtable->Compare(that->ref, other); }
+		{ CheckRef(that->ref); return VT(Target(that))->Compare(Target(that), other); }
+
+		size_t Ref::Hash(const Data *that) const
+		{ CheckRef(that->ref); return VT(Target(that))->Hash(Target(that)); }
 
 		void Ref::Incr(Data *that) const
-		{ CheckRef(that); that->ref->vtable->Incr(that->ref); }
+		{ CheckRef(that->ref); VT(Target(that))->Incr(Target(that)); }
 
 		void Ref::Decr(Data *that) const
-		{ CheckRef(that); that->ref->vtable->Decr(that->ref); }
+		{ CheckRef(that->ref); VT(Target(that))->Decr(Target(that)); }
 
 		Variant Ref::Neg(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->Neg(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->Neg(Target(that)); }
 
 		void Ref::Add(Data *that, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->Add(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Add(Target(that), other); }
 
 		void Ref::Sub(Data *that, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->Sub(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Sub(Target(that), other); }
 
 		void Ref::Mul(Data *that, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->Mul(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Mul(Target(that), other); }
 
 		void Ref::Div(Data *that, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->Div(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Div(Target(that), other); }
 
 		void Ref::Rem(Data *that, const Data *other) const
-		{ CheckRef(that); that->ref->vtable->Rem(that->ref, other); }
+		{ CheckRef(that->ref); VT(Target(that))->Rem(Target(that), other); }
+
+		RefData *Ref::EnsureRef(Data *that) const
+		{ CheckRef(that->ref); return VT(Target(that))->EnsureRef(Target(that)); }
 
 		void Ref::Destroy(Data *that) const {
+			RefData *ref = that->ref;
+			if (that->flags & HasRefData) {
+				// The node owns the value, the references outlive it
+				that->flags &= ~HasRefData;
+				ref->valid = false;
+				VT(&ref->value)->Destroy(&ref->value);
+			}
+			Release(ref);
 			VTable::Destroy(that);
-			that->ref = 0;
-		}
-
-		void Ref::Destruct(Data *that) const {
-			Destroy(that);
-			that->ref_data.reset();
 		}
 
 		Variant *Ref::Resolve(Data *that) const
-	   	{ CheckRef(that); return that->ref->vtable->Resolve(that->ref); }
+	   	{ CheckRef(that->ref); return VT(Target(that))->Resolve(Target(that)); }
 
 		const Variant *Ref::ResolveConst(const Data *that) const
-		{ CheckRef(that); return that->ref->vtable->ResolveConst(that->ref); }
+		{ CheckRef(that->ref); return VT(Target(that))->ResolveConst(Target(that)); }
 
 		Variant *Ref::ResolveDefault(Data *that, const Data *def) const
-	   	{ CheckRef(that); return that->ref->vtable->ResolveDefault(that->ref, def); }
+	   	{ CheckRef(that->ref); return VT(Target(that))->ResolveDefault(Target(that), def); }
 
 		bool Ref::Exists(const Data *that) const {
-			return (that->ref != 0) && (that->ref_data->valid == true);
+			return that->ref->valid;
 		}
 
 		void RefInit(Data *that, const Data *other) {
-			static const Ref ref_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &ref_vtable;
 			// XXX: const cast.. double ICKY!
-			that->ref = const_cast<Data*>(other);
-			that->ref_data = that->ref->vtable->EnsureRef(that->ref);
+			Data *target = const_cast<Data*>(other);
+			RefData *ref = VT(target)->EnsureRef(target);
+			VT(that)->Destroy(that);
+			that->kind = RefKind;
+			that->ref = ref;
+		}
+
+		void MirrorInit(Data *that, Data *item) {
+			RefData *ref = new RefData(item);
+			VT(that)->Destroy(that);
+			that->kind = RefKind;
+			that->ref = ref;
 		}
 
 		//--------------------
@@ -1641,7 +2999,6 @@ namespace libvariant {
 
 		class Proxy : public VTable {
 		public:
-			Proxy() {}
 			virtual void Copy(const Data *that, Data *other) const;
 			virtual void Assign(const Data *that, Data *other) const;
 			virtual void MakeRef(const Data *that, Data *ref) const;
@@ -1657,6 +3014,7 @@ namespace libvariant {
 			virtual unsigned Size(const Data *that) const;
 			virtual bool Empty(const Data *that) const;
 			virtual void Clear(Data *that) const;
+			virtual void ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const;
 			virtual Variant::List &AsList(Data *that) const;
 			virtual const Variant::List &AsListConst(const Data *that) const;
 			virtual bool ContainsIndex(const Data *that, unsigned i) const;
@@ -1665,16 +3023,18 @@ namespace libvariant {
 			virtual VariantRef GetRefIndex(Data *that, unsigned i, Variant *def) const;
 			virtual const Variant *GetConstIndex(const Data *that, unsigned i, bool checked) const;
 			virtual Variant *GetIndex(Data *that, unsigned i, bool checked) const;
-			virtual void SetIndex(Data *that, unsigned i, const Data *other) const;
+			virtual Variant *SlotIndex(Data *that, unsigned i) const;
+			virtual Variant *SlotBack(Data *that) const;
 			virtual Variant::Map &AsMap(Data *that) const;
 			virtual const Variant::Map &AsMapConst(const Data *that) const;
-			virtual bool ContainsKey(const Data *that, const std::string &s) const;
-			virtual void EraseKey(Data *that, const std::string &key) const;
-			virtual VariantRef GetRefKey(Data *that, const std::string &s, Variant *def) const;
-			virtual const Variant *GetConstKey(const Data *that, const std::string &s, bool checked) const;
-			virtual Variant *GetKey(Data *that, const std::string &s, bool checked) const;
-			virtual void SetKey(Data *that, const std::string &s, const Data *other) const;
+			virtual bool ContainsKey(const Data *that, KeyRef s) const;
+			virtual void EraseKey(Data *that, KeyRef key) const;
+			virtual VariantRef GetRefKey(Data *that, KeyRef s, Variant *def) const;
+			virtual const Variant *GetConstKey(const Data *that, KeyRef s, bool checked) const;
+			virtual Variant *GetKey(Data *that, KeyRef s, bool checked) const;
+			virtual Variant *SlotKey(Data *that, KeyRef s) const;
 			virtual int Compare(const Data *that, const Data *other) const;
+			virtual size_t Hash(const Data *that) const;
 			virtual void Incr(Data *that) const;
 			virtual void Decr(Data *that) const;
 			virtual Variant Neg(const Data *that) const;
@@ -1684,7 +3044,6 @@ namespace libvariant {
 			virtual void Div(Data *that, const Data *other) const;
 			virtual void Rem(Data *that, const Data *other) const;
 			virtual void Destroy(Data *that) const;
-			virtual void Destruct(Data *that) const;
 			virtual Variant *Resolve(Data *that) const;
 			virtual const Variant *ResolveConst(const Data *that) const;
 			virtual Variant *ResolveDefault(Data *that, const Data *def) const;
@@ -1692,129 +3051,132 @@ namespace libvariant {
 		};
 
 		bool ProxyResolveCheck(const Data *that) {
-			CheckRef(that);
-			Data *ref = that->proxy->ref;
-			const Variant *result = ref->vtable->GetPathConst(ref, that->proxy->path.begin(),
-					that->proxy->path.end(), false);
+			CheckRef(ProxyOf(that)->ref);
+			Data *ref = ProxyOf(that)->ref->target;
+			const Variant *result = VT(ref)->GetPathConst(ref, ProxyOf(that)->path.begin(),
+					ProxyOf(that)->path.end(), false);
 			if (result) {
 				const Data *res = VTable::GetData(result);
 				// XXX: Const cast, ICKY! I don't know how to do this without making all of Data mutable...
-				res->vtable->MakeRef(res, const_cast<Data*>(that));
+				VT(res)->MakeRef(res, const_cast<Data*>(that));
 				return true;
 			}
 			return false;
 		}
 
 		void ProxyResolveThrow(const Data *that) {
-			CheckRef(that);
-			Data *ref = that->proxy->ref;
-			const Variant *result = ref->vtable->GetPathConst(ref, that->proxy->path.begin(),
-					that->proxy->path.end(), true);
+			CheckRef(ProxyOf(that)->ref);
+			Data *ref = ProxyOf(that)->ref->target;
+			const Variant *result = VT(ref)->GetPathConst(ref, ProxyOf(that)->path.begin(),
+					ProxyOf(that)->path.end(), true);
 			const Data *res = VTable::GetData(result);
 			// XXX: Const cast, ICKY! I don't know how to do this without making all of Data mutable...
-			res->vtable->MakeRef(res, const_cast<Data*>(that));
+			VT(res)->MakeRef(res, const_cast<Data*>(that));
 		}
 
 		void ProxyResolveCreate(Data *that) {
-			CheckRef(that);
+			CheckRef(ProxyOf(that)->ref);
 			Variant tmp_null;
-			Data *ref = that->proxy->ref;
-			VariantRef result = ref->vtable->GetPathRef(ref, that->proxy->path.begin(),
-					that->proxy->path.end(), &tmp_null);
+			Data *ref = ProxyOf(that)->ref->target;
+			VariantRef result = VT(ref)->GetPathRef(ref, ProxyOf(that)->path.begin(),
+					ProxyOf(that)->path.end(), &tmp_null);
 			Data *res = VTable::GetData(&result);
-			res->vtable->MakeRef(res, that);
+			VT(res)->MakeRef(res, that);
 		}
 
 
 		void Proxy::Copy(const Data *that, Data *other) const
-		{ ProxyResolveThrow(that); that->vtable->Copy(that, other); }
+		{ ProxyResolveThrow(that); VT(that)->Copy(that, other); }
 
 		void Proxy::Assign(const Data *that, Data *other) const
-		{ ProxyResolveThrow(that); that->vtable->Assign(that, other); }
+		{ ProxyResolveThrow(that); VT(that)->Assign(that, other); }
 
 		void Proxy::MakeRef(const Data *that, Data *ref) const {
-			CheckRef(that);
-			ProxyInit(ref, that->proxy->ref, that->proxy->path.begin(), that->proxy->path.end());
+			CheckRef(ProxyOf(that)->ref);
+			ProxyInit(ref, ProxyOf(that)->ref, ProxyOf(that)->path.begin(), ProxyOf(that)->path.end());
 		}
 
 		void Proxy::MakeProxy(Data *that, Data *ref, Path::const_iterator b, Path::const_iterator e) const
 		{
-			CheckRef(that);
-			Path newpath = that->proxy->path;
+			CheckRef(ProxyOf(that)->ref);
+			Path newpath = ProxyOf(that)->path;
 			newpath.insert(newpath.end(), b, e);
-			ProxyInit(ref, that->proxy->ref, newpath.begin(), newpath.end());
+			ProxyInit(ref, ProxyOf(that)->ref, newpath.begin(), newpath.end());
 		}
 
 		VariantDefines::Type_t Proxy::GetType(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->GetType(that); }
+		{ ProxyResolveThrow(that); return VT(that)->GetType(that); }
 
 		bool Proxy::AsBool(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsBool(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsBool(that); }
 
 		long double Proxy::AsLongDouble(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsLongDouble(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsLongDouble(that); }
 
 		uintmax_t Proxy::AsUnsigned(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsUnsigned(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsUnsigned(that); }
 
 		intmax_t Proxy::AsInt(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsInt(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsInt(that); }
 
 		std::string Proxy::AsString(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsString(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsString(that); }
 
 		BlobPtr Proxy::AsBlob(Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsBlob(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsBlob(that); }
 
 		ConstBlobPtr Proxy::AsBlobConst(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsBlobConst(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsBlobConst(that); }
 
 		unsigned Proxy::Size(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Size(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Size(that); }
 
 		bool Proxy::Empty(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Empty(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Empty(that); }
 
 		void Proxy::Clear(Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Clear(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Clear(that); }
+
+		void Proxy::ForEach(const Data *that, Variant::ForEachFunc func, void *ctx) const
+		{ ProxyResolveThrow(that); VT(that)->ForEach(that, func, ctx); }
 
 		Variant::List &Proxy::AsList(Data *that) const
-		{ ProxyResolveCreate(that); return that->vtable->AsList(that); }
+		{ ProxyResolveCreate(that); return VT(that)->AsList(that); }
 
 		const Variant::List &Proxy::AsListConst(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsListConst(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsListConst(that); }
 
 		bool Proxy::ContainsIndex(const Data *that, unsigned i) const
-		{ ProxyResolveThrow(that); return that->vtable->ContainsIndex(that, i); }
+		{ ProxyResolveThrow(that); return VT(that)->ContainsIndex(that, i); }
 
 		unsigned Proxy::Index(const Data *that, Variant v) const
-		{ ProxyResolveThrow(that); return that->vtable->Index(that, v); }
+		{ ProxyResolveThrow(that); return VT(that)->Index(that, v); }
 
 		void Proxy::EraseIndex(Data *that, unsigned i) const
-		{ ProxyResolveThrow(that); return that->vtable->EraseIndex(that, i); }
+		{ ProxyResolveThrow(that); return VT(that)->EraseIndex(that, i); }
 
 		VariantRef Proxy::GetRefIndex(Data *that, unsigned i, Variant *def) const
 		{ 
 			if (def) {
 				ProxyResolveCreate(that);
-				return that->vtable->GetRefIndex(that, i, def);
+				return VT(that)->GetRefIndex(that, i, def);
 			}
 			if (ProxyResolveCheck(that)) {
-				return that->vtable->GetRefIndex(that, i, def);
+				return VT(that)->GetRefIndex(that, i, def);
 		   	} else {
-				Path path = that->proxy->path;
+				Path path = ProxyOf(that)->path;
 				path.push_back(i);
-				return VariantRef(*VTable::GetVar(that->proxy->ref), path);
+				return VariantRef(*VTable::GetVar(ProxyOf(that)->ref->target), path);
 			}
 		}
 
 		const Variant *Proxy::GetConstIndex(const Data *that, unsigned i, bool checked) const
-		{ ProxyResolveThrow(that); return that->vtable->GetConstIndex(that, i, checked); }
+		{ ProxyResolveThrow(that); return VT(that)->GetConstIndex(that, i, checked); }
 
 		Variant *Proxy::GetIndex(Data *that, unsigned i, bool checked) const
 		{
 		   	if (ProxyResolveCheck(that)) {
-				return that->vtable->GetIndex(that, i, checked);
+				return VT(that)->GetIndex(that, i, checked);
 			} else if (checked)  {
 				throw std::out_of_range("Variant::List index out of range.");
 			} else {
@@ -1822,125 +3184,129 @@ namespace libvariant {
 			}
 	   	}
 
-		void Proxy::SetIndex(Data *that, unsigned i, const Data *other) const
-		{ ProxyResolveCreate(that); return that->vtable->SetIndex(that, i, other); }
+		Variant *Proxy::SlotIndex(Data *that, unsigned i) const
+		{ ProxyResolveCreate(that); return VT(that)->SlotIndex(that, i); }
+
+		Variant *Proxy::SlotBack(Data *that) const
+		{ ProxyResolveCreate(that); return VT(that)->SlotBack(that); }
 
 		Variant::Map &Proxy::AsMap(Data *that) const
-		{ ProxyResolveCreate(that); return that->vtable->AsMap(that); }
+		{ ProxyResolveCreate(that); return VT(that)->AsMap(that); }
 
 		const Variant::Map &Proxy::AsMapConst(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->AsMapConst(that); }
+		{ ProxyResolveThrow(that); return VT(that)->AsMapConst(that); }
 
-		bool Proxy::ContainsKey(const Data *that, const std::string &s) const
-		{ ProxyResolveThrow(that); return that->vtable->ContainsKey(that, s); }
+		bool Proxy::ContainsKey(const Data *that, KeyRef s) const
+		{ ProxyResolveThrow(that); return VT(that)->ContainsKey(that, s); }
 
-		void Proxy::EraseKey(Data *that, const std::string &key) const
-		{ ProxyResolveThrow(that); return that->vtable->EraseKey(that, key); }
+		void Proxy::EraseKey(Data *that, KeyRef key) const
+		{ ProxyResolveThrow(that); return VT(that)->EraseKey(that, key); }
 
-		VariantRef Proxy::GetRefKey(Data *that, const std::string &s, Variant *def) const
+		VariantRef Proxy::GetRefKey(Data *that, KeyRef s, Variant *def) const
 		{
 			if (def) {
 				ProxyResolveCreate(that);
-			   	return that->vtable->GetRefKey(that, s, def);
+			   	return VT(that)->GetRefKey(that, s, def);
 		   	}
 			if (ProxyResolveCheck(that)) {
-			   	return that->vtable->GetRefKey(that, s, def);
+			   	return VT(that)->GetRefKey(that, s, def);
 			} else {
-				Path path = that->proxy->path;
-				path.push_back(s);
-				return VariantRef(*VTable::GetVar(that->proxy->ref), path);
+				Path path = ProxyOf(that)->path;
+				path.push_back(s.str());
+				return VariantRef(*VTable::GetVar(ProxyOf(that)->ref->target), path);
 			}
 		}
 
-		const Variant *Proxy::GetConstKey(const Data *that, const std::string &s, bool checked) const
-		{ ProxyResolveThrow(that); return that->vtable->GetConstKey(that, s, checked); }
+		const Variant *Proxy::GetConstKey(const Data *that, KeyRef s, bool checked) const
+		{ ProxyResolveThrow(that); return VT(that)->GetConstKey(that, s, checked); }
 
-		Variant *Proxy::GetKey(Data *that, const std::string &s, bool checked) const
+		Variant *Proxy::GetKey(Data *that, KeyRef s, bool checked) const
 		{
 		   	if (ProxyResolveCheck(that)) {
-				return that->vtable->GetKey(that, s, checked);
+				return VT(that)->GetKey(that, s, checked);
 			} else if (checked) {
-				throw KeyError(s);
+				throw KeyError(s.str());
 			} else {
 				return 0;
 			}
 	   	}
 
-		void Proxy::SetKey(Data *that, const std::string &s, const Data *other) const
-		{ ProxyResolveCreate(that); return that->vtable->SetKey(that, s, other); }
+		Variant *Proxy::SlotKey(Data *that, KeyRef s) const
+		{ ProxyResolveCreate(that); return VT(that)->SlotKey(that, s); }
 
 		int Proxy::Compare(const Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Compare(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Compare(that, other); }
+
+		size_t Proxy::Hash(const Data *that) const
+		{ ProxyResolveThrow(that); return VT(that)->Hash(that); }
 
 		void Proxy::Incr(Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Incr(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Incr(that); }
 
 		void Proxy::Decr(Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Decr(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Decr(that); }
 
 		Variant Proxy::Neg(const Data *that) const
-		{ ProxyResolveThrow(that); return that->vtable->Neg(that); }
+		{ ProxyResolveThrow(that); return VT(that)->Neg(that); }
 
 		void Proxy::Add(Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Add(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Add(that, other); }
 
 		void Proxy::Sub(Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Sub(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Sub(that, other); }
 
 		void Proxy::Mul(Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Mul(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Mul(that, other); }
 
 		void Proxy::Div(Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Div(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Div(that, other); }
 
 		void Proxy::Rem(Data *that, const Data *other) const
-		{ ProxyResolveThrow(that); return that->vtable->Rem(that, other); }
+		{ ProxyResolveThrow(that); return VT(that)->Rem(that, other); }
 
 		void Proxy::Destroy(Data *that) const {
+			Release(that->storage);
 			VTable::Destroy(that);
-			that->proxy = 0;
-		}
-
-		void Proxy::Destruct(Data *that) const {
-			Destroy(that);
-			that->ref_data.reset();
 		}
 
 		Variant *Proxy::Resolve(Data *that) const {
 			ProxyResolveCreate(that);
-			return that->vtable->Resolve(that);
+			return VT(that)->Resolve(that);
 		}
 
 		const Variant *Proxy::ResolveConst(const Data *that) const {
 			ProxyResolveThrow(that);
-			return that->vtable->ResolveConst(that);
+			return VT(that)->ResolveConst(that);
 		}
 
 		Variant *Proxy::ResolveDefault(Data *that, const Data *def) const {
 			ProxyResolveCreate(that);
-			return that->vtable->ResolveDefault(that, def);
+			return VT(that)->ResolveDefault(that, def);
 		}
 
 		bool Proxy::Exists(const Data *that) const {
-			if (!that->ref_data || !that->ref_data->valid) {
+			if (!ProxyOf(that)->ref->valid) {
 				return false;
 			}
-			Data *ref = that->proxy->ref;
-			const Variant *result = ref->vtable->GetPathConst(ref, that->proxy->path.begin(),
-					that->proxy->path.end(), false);
+			Data *ref = ProxyOf(that)->ref->target;
+			const Variant *result = VT(ref)->GetPathConst(ref, ProxyOf(that)->path.begin(),
+					ProxyOf(that)->path.end(), false);
 			return result != 0;
 		}
 
-		void ProxyInit(Data *that, Data *ref, Path::const_iterator b, Path::const_iterator e) {
-			static const Proxy proxy_vtable;
-			if (that->vtable) that->vtable->Destroy(that);
-			that->vtable = &proxy_vtable;
-			that->ref_data = ref->vtable->EnsureRef(ref);
-			shared_ptr<ProxyStorage> storage(new ProxyStorage(ref, b, e));
-			that->proxy = storage.get();
+		void ProxyInit(Data *that, RefData *root, Path::const_iterator b, Path::const_iterator e) {
+			Storage *storage = new ProxyStorage(root, b, e);
+			VT(that)->Destroy(that);
+			that->kind = ProxyKind;
 			that->storage = storage;
 		}
 
+		void ProxyInit(Data *that, Data *root, Path::const_iterator b, Path::const_iterator e) {
+			RefData *ref = VT(root)->EnsureRef(root);
+			ProxyInit(that, ref, b, e);
+			Release(ref);
+		}
+
 
 		//-------------------
 
@@ -1976,7 +3342,39 @@ namespace libvariant {
 			}
 		}
 
-		Data::Data() : vtable(NullVTable()) {}
+		/// The VTable of each kind, indexed by Kind_t. They are function
+		/// local so that Variants with static lifetime in other translation
+		/// units can use them before this one is initialized.
+		const VTable *const *KindVTables() {
+			static const Null null_vtable;
+			static const Bool bool_vtable;
+			static const Integer integer_vtable;
+			static const Unsigned unsigned_vtable;
+			static const Float float_vtable;
+			static const String string_vtable;
+			static const List list_vtable;
+			static const Map map_vtable;
+			static const Blob blob_vtable;
+			static const Ref ref_vtable;
+			static const Proxy proxy_vtable;
+			static const VTable *const kind_vtables[NumKinds] = {
+				&null_vtable,
+				&bool_vtable,
+				&integer_vtable,
+				&unsigned_vtable,
+				&float_vtable,
+				&float_vtable,
+				&string_vtable,
+				&string_vtable,
+				&string_vtable,
+				&list_vtable,
+				&map_vtable,
+				&blob_vtable,
+				&ref_vtable,
+				&proxy_vtable
+			};
+			return kind_vtables;
+		}
 	}
 
 	//--------------------
@@ -1985,159 +3383,412 @@ namespace libvariant {
 
 	Variant::Variant(const RefTag &, const Variant &o)
 	{
-		o.vtable->MakeRef(&o, this);
+		VT(&o)->MakeRef(&o, this);
 	}
 
 	Variant::Variant(const RefTag &, Variant &o, Path::const_iterator b, Path::const_iterator e)
 	{
-		o.vtable->MakeProxy(&o, this, b, e);
+		VT(&o)->MakeProxy(&o, this, b, e);
+	}
+
+	Variant::Variant(const RefTag &, Variant &o, CompiledPath::const_iterator b, CompiledPath::const_iterator e)
+	{
+		// The proxy keeps its own copy of the path
+		Path path(b, e);
+		VT(&o)->MakeProxy(&o, this, path.begin(), path.end());
 	}
 
 	Variant::~Variant() {
-		vtable->Destruct(this);
+		VT(this)->Destruct(this);
 	}
 
-	VariantDefines::Type_t Variant::GetType() const
-	{ return vtable->GetType(this); }
+	VariantDefines::Type_t Variant::GetReferredType() const
+	{ return VT(this)->GetType(this); }
 
 	bool Variant::AsBool() const
-   	{ return vtable->AsBool(this); }
+   	{ return VT(this)->AsBool(this); }
 
 	long double Variant::AsLongDouble() const
-	{ return vtable->AsLongDouble(this); }
+	{ return VT(this)->AsLongDouble(this); }
 
 	uintmax_t Variant::AsUnsigned() const
-	{ return vtable->AsUnsigned(this); }
+	{ return VT(this)->AsUnsigned(this); }
 
 	intmax_t Variant::AsInt() const
-	{ return vtable->AsInt(this); }
+	{ return VT(this)->AsInt(this); }
 
 	std::string Variant::AsString() const
-	{ return vtable->AsString(this); }
+	{ return VT(this)->AsString(this); }
 
 	BlobPtr Variant::AsBlob()
-	{ return vtable->AsBlob(this); }
+	{ return VT(this)->AsBlob(this); }
 
 	ConstBlobPtr Variant::AsBlob() const
-	{ return vtable->AsBlobConst(this); }
+	{ return VT(this)->AsBlobConst(this); }
 
 	unsigned Variant::Size() const
-	{ return vtable->Size(this); }
+	{ return VT(this)->Size(this); }
 
 	bool Variant::Empty() const
-	{ return vtable->Empty(this); }
+	{ return VT(this)->Empty(this); }
 
 	void Variant::Clear()
-	{ vtable->Clear(this); }
+	{ VT(this)->Clear(this); }
+
+	void Variant::ForEach(ForEachFunc func, void *ctx) const
+	{ VT(this)->ForEach(this, func, ctx); }
 
 	Variant::List &Variant::AsList()
-   	{ return vtable->AsList(this); }
+   	{ return VT(this)->AsList(this); }
 
 	const Variant::List &Variant::AsList() const
-   	{ return vtable->AsListConst(this); }
+   	{ return VT(this)->AsListConst(this); }
 
 	VariantRef Variant::At(unsigned i)
-	{ return vtable->GetRefIndex(this, i, 0); }
+	{ return VT(this)->GetRefIndex(this, i, 0); }
 
 	VariantRef Variant::At(unsigned i, Variant def)
-	{ return vtable->GetRefIndex(this, i, &def); }
+	{ return VT(this)->GetRefIndex(this, i, &def); }
 
 	const Variant &Variant::At(unsigned i) const
-	{ return *vtable->GetConstIndex(this, i, true); }
+	{ return *VT(this)->GetConstIndex(this, i, true); }
 
 	Variant Variant::Get(unsigned i) const
-	{ return *vtable->GetConstIndex(this, i, true); }
+	{ return *VT(this)->GetConstIndex(this, i, true); }
 
 	Variant Variant::Get(unsigned i, Variant def) const {
-		const Variant *ret = vtable->GetConstIndex(this, i, false);
+		const Variant *ret = VT(this)->GetConstIndex(this, i, false);
 		if (ret) { return *ret; }
 		else { return def; }
 	}
 
 	Variant &Variant::Set(unsigned i, Variant v) {
-		vtable->SetIndex(this, i, &v);
+		Internal::MoveInit(VT(this)->SlotIndex(this, i), &v);
 		return *this;
 	}
 
+	Variant *Variant::Find(unsigned i) {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		Variant *found = VT(this)->GetIndex(this, i, false);
+		if (found) { Internal::MarkExposed(Internal::VTable::GetData(VT(this)->Resolve(this))); }
+		return found;
+	}
+
+	const Variant *Variant::Find(unsigned i) const {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		return VT(this)->GetConstIndex(this, i, false);
+	}
+
 	Variant &Variant::Append(Variant value) {
-		vtable->AsList(this).push_back(value);
+		Internal::MoveInit(VT(this)->SlotBack(this), &value);
 		return *this;
 	}
 
 	bool Variant::Contains(unsigned i) const
-	{ return vtable->ContainsIndex(this, i); }
+	{ return VT(this)->ContainsIndex(this, i); }
 
 	unsigned Variant::Index(Variant v) const
-	{ return vtable->Index(this, v); }
+	{ return VT(this)->Index(this, v); }
 
 	void Variant::Erase(unsigned i)
-	{ vtable->EraseIndex(this, i); }
+	{ VT(this)->EraseIndex(this, i); }
+
+	const void *Variant::PackedData(Type_t &type, unsigned &size) const {
+		const Data *target = VT(this)->ResolveConst(this);
+		if (target->kind != Internal::ListKind) { return 0; }
+		const Internal::PackedArray *packed = Internal::ListOf(target)->packed;
+		if (!packed) { return 0; }
+		type = packed->type;
+		size = packed->Size();
+		return packed->Elements();
+	}
+
+	namespace Internal {
+
+		const Data *VisitResolve(const Data *that)
+		{ return VTable::GetData(VT(that)->ResolveConst(that)); }
+
+		const char *VisitString(const Data *that, size_t &len) {
+			len = StringLength(that);
+			return StringChars(that);
+		}
+
+		void VisitList(const Data *that, VisitContainer &container) {
+			ListStorage *storage = ListOf(that);
+			if (storage->packed) {
+				container.packed = storage->packed->Elements();
+				container.packed_type = storage->packed->type;
+				container.size = storage->packed->Size();
+			} else if (storage->list) {
+				container.items = storage->list->empty() ? 0 : &(*storage->list)[0];
+				container.size = storage->list->size();
+			} else {
+				container.items = storage->items;
+				container.size = storage->small_size;
+			}
+		}
+
+		void VisitMap(const Data *that, VisitContainer &container) {
+			MapStorage *storage = MapOf(that);
+			if (storage->map) {
+				container.map = storage->map;
+			} else {
+				container.keys = storage->keys;
+				container.items = storage->values;
+				container.size = storage->small_size;
+			}
+		}
+	}
+
+	namespace Internal {
+
+		/// What that refers to, or null for a reference that is no longer
+		/// valid or a proxy for a path that does not exist.
+		static const Data *TryResolve(const Data *that) {
+			while (that->kind >= RefKind) {
+				if (!VT(that)->Exists(that)) { return 0; }
+				if (that->kind == RefKind) { that = Target(that); }
+				else { that = VTable::GetData(VT(that)->ResolveConst(that)); }
+			}
+			return that;
+		}
+
+		/// The value for the TryAs functions to convert, or null if there
+		/// is none or it is a container or blob, which never convert.
+		static const Data *TryScalar(const Data *that) {
+			that = TryResolve(that);
+			if (!that || that->kind == ListKind || that->kind == MapKind || that->kind == BlobKind) {
+				return 0;
+			}
+			return that;
+		}
+
+		static inline bool IsStringKind(unsigned char kind)
+		{ return kind == StringKind || kind == ShortStringKind || kind == InternedStringKind; }
+	}
+
+	// The numbers in a string are read as the As functions read them, only
+	// a failure returns false instead of throwing.
+
+	bool Variant::TryAsBool(bool &out) const {
+		const Internal::Data *that = Internal::TryScalar(this);
+		if (!that) { return false; }
+		out = VT(that)->AsBool(that);
+		return true;
+	}
+
+	bool Variant::TryAsLongDouble(long double &out) const {
+		const Internal::Data *that = Internal::TryScalar(this);
+		if (!that) { return false; }
+		if (Internal::IsStringKind(that->kind)) {
+			const char *b = Internal::StringChars(that), *e = b + Internal::StringLength(that);
+			long double val = 0;
+			if (ParseFloat(SkipSpace(b, e), e, val) != NUMBER_OK) { return false; }
+			out = val;
+		} else {
+			out = VT(that)->AsLongDouble(that);
+		}
+		return true;
+	}
+
+	bool Variant::TryAsUnsigned(uintmax_t &out) const {
+		const Internal::Data *that = Internal::TryScalar(this);
+		if (!that) { return false; }
+		if (Internal::IsStringKind(that->kind)) {
+			const char *b = Internal::StringChars(that), *e = b + Internal::StringLength(that);
+			uintmax_t val = 0;
+			if (ParseUnsigned(SkipSpace(b, e), e, val) != NUMBER_OK) { return false; }
+			out = val;
+		} else {
+			out = VT(that)->AsUnsigned(that);
+		}
+		return true;
+	}
+
+	bool Variant::TryAsInt(intmax_t &out) const {
+		const Internal::Data *that = Internal::TryScalar(this);
+		if (!that) { return false; }
+		if (Internal::IsStringKind(that->kind)) {
+			const char *b = Internal::StringChars(that), *e = b + Internal::StringLength(that);
+			intmax_t val = 0;
+			if (ParseInt(SkipSpace(b, e), e, val) != NUMBER_OK) { return false; }
+			out = val;
+		} else {
+			out = VT(that)->AsInt(that);
+		}
+		return true;
+	}
+
+	bool Variant::TryAsString(std::string &out) const {
+		const Internal::Data *that = Internal::TryScalar(this);
+		if (!that) { return false; }
+		out = VT(that)->AsString(that);
+		return true;
+	}
+
+	Variant &Variant::Sort() {
+		List &list = AsList();
+		std::sort(list.begin(), list.end());
+		return *this;
+	}
+
+	Variant &Variant::StableSort() {
+		List &list = AsList();
+		std::stable_sort(list.begin(), list.end());
+		return *this;
+	}
 
 	Variant::Map &Variant::AsMap()
-	{ return vtable->AsMap(this); }
+	{ return VT(this)->AsMap(this); }
 
 	const Variant::Map &Variant::AsMap() const
-	{ return vtable->AsMapConst(this); }
+	{ return VT(this)->AsMapConst(this); }
 
-	VariantRef Variant::At(const std::string &s)
-	{ return vtable->GetRefKey(this, s, 0); }
+	VariantRef Variant::At(KeyRef s)
+	{ return VT(this)->GetRefKey(this, s, 0); }
 
-	VariantRef Variant::At(const std::string &s, Variant def)
-	{ return vtable->GetRefKey(this, s, &def); }
+	VariantRef Variant::At(KeyRef s, Variant def)
+	{ return VT(this)->GetRefKey(this, s, &def); }
 
-	const Variant &Variant::At(const std::string &s) const
-	{ return *vtable->GetConstKey(this, s, true); }
+	const Variant &Variant::At(KeyRef s) const
+	{ return *VT(this)->GetConstKey(this, s, true); }
 
-	Variant Variant::Get(const std::string &s) const
-	{ return *vtable->GetConstKey(this, s, true); }
+	Variant Variant::Get(KeyRef s) const
+	{ return *VT(this)->GetConstKey(this, s, true); }
 
-	Variant Variant::Get(const std::string &s, Variant def) const {
-		const Variant *ret = vtable->GetConstKey(this, s, false);
+	Variant Variant::Get(KeyRef s, Variant def) const {
+		const Variant *ret = VT(this)->GetConstKey(this, s, false);
 		if (ret) { return *ret; }
 		else { return def; }
 	}
 
-	Variant &Variant::Set(const std::string &s, Variant v) {
-		vtable->SetKey(this, s, &v);
+	Variant &Variant::Set(KeyRef s, Variant v) {
+		Internal::MoveInit(VT(this)->SlotKey(this, s), &v);
 		return *this;
 	}
 
-	bool Variant::Contains(const std::string &s) const
-	{ return vtable->ContainsKey(this, s); }
+	Variant *Variant::Find(KeyRef s) {
+		// A proxy for a path that does not exist has nothing to find
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		Variant *found = VT(this)->GetKey(this, s, false);
+		if (found) { Internal::MarkExposed(Internal::VTable::GetData(VT(this)->Resolve(this))); }
+		return found;
+	}
+
+	const Variant *Variant::Find(KeyRef s) const {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		return VT(this)->GetConstKey(this, s, false);
+	}
 
-	void Variant::Erase(const std::string &key)
-	{ vtable->EraseKey(this, key); }
+	bool Variant::Contains(KeyRef s) const
+	{ return VT(this)->ContainsKey(this, s); }
+
+	void Variant::Erase(KeyRef key)
+	{ VT(this)->EraseKey(this, key); }
 
 	VariantRef Variant::AtPath(const Path &path)
-	{ return vtable->GetPathRef(this, path.begin(), path.end(), 0); }
+	{ return VT(this)->GetPathRef(this, path.begin(), path.end(), 0); }
 
 	VariantRef Variant::AtPath(const Path &path, Variant def)
-	{ return vtable->GetPathRef(this, path.begin(), path.end(), &def); }
+	{ return VT(this)->GetPathRef(this, path.begin(), path.end(), &def); }
 
 	const Variant &Variant::AtPath(const Path &path) const
-	{ return *vtable->GetPathConst(this, path.begin(), path.end(), true); }
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
 
 	Variant Variant::GetPath(const Path &path) const
-	{ return *vtable->GetPathConst(this, path.begin(), path.end(), true); }
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
 
 	Variant Variant::GetPath(const Path &path, Variant def) const {
-		const Variant *ret = vtable->GetPathConst(this, path.begin(), path.end(), false);
+		const Variant *ret = VT(this)->GetPathConst(this, path.begin(), path.end(), false);
 		if (ret) { return *ret; }
 		else { return def; }
 	}
 
 	Variant &Variant::SetPath(const Path &path, Variant val) {
-		vtable->SetPath(this, path.begin(), path.end(), &val);
+		VT(this)->SetPath(this, path.begin(), path.end(), &val);
 		return *this;
 	}
 
 	Variant &Variant::ErasePath(const Path &path, bool remove_empty) {
-		vtable->ErasePath(this, path.begin(), path.end(), remove_empty);
+		VT(this)->ErasePath(this, path.begin(), path.end(), remove_empty);
 		return *this;
 	}
 
 	bool Variant::HasPath(const Path &path) const {
-		return vtable->GetPathConst(this, path.begin(), path.end(), false) != 0;
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false) != 0;
+	}
+
+	VariantRef Variant::AtPath(const CompiledPath &path)
+	{ return VT(this)->GetPathRef(this, path.begin(), path.end(), 0); }
+
+	VariantRef Variant::AtPath(const CompiledPath &path, Variant def)
+	{ return VT(this)->GetPathRef(this, path.begin(), path.end(), &def); }
+
+	const Variant &Variant::AtPath(const CompiledPath &path) const
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
+
+	Variant Variant::GetPath(const CompiledPath &path) const
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
+
+	Variant Variant::GetPath(const CompiledPath &path, Variant def) const {
+		const Variant *ret = VT(this)->GetPathConst(this, path.begin(), path.end(), false);
+		if (ret) { return *ret; }
+		else { return def; }
+	}
+
+	Variant &Variant::SetPath(const CompiledPath &path, Variant val) {
+		VT(this)->SetPath(this, path.begin(), path.end(), &val);
+		return *this;
+	}
+
+	Variant &Variant::ErasePath(const CompiledPath &path, bool remove_empty) {
+		VT(this)->ErasePath(this, path.begin(), path.end(), remove_empty);
+		return *this;
+	}
+
+	bool Variant::HasPath(const CompiledPath &path) const {
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false) != 0;
+	}
+
+	const Variant &Variant::AtPath(const StaticPathView &path) const
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
+
+	Variant Variant::GetPath(const StaticPathView &path) const
+	{ return *VT(this)->GetPathConst(this, path.begin(), path.end(), true); }
+
+	Variant Variant::GetPath(const StaticPathView &path, Variant def) const {
+		const Variant *ret = VT(this)->GetPathConst(this, path.begin(), path.end(), false);
+		if (ret) { return *ret; }
+		else { return def; }
+	}
+
+	Variant &Variant::SetPath(const StaticPathView &path, Variant val) {
+		VT(this)->SetPath(this, path.begin(), path.end(), &val);
+		return *this;
+	}
+
+	Variant &Variant::ErasePath(const StaticPathView &path, bool remove_empty) {
+		VT(this)->ErasePath(this, path.begin(), path.end(), remove_empty);
+		return *this;
+	}
+
+	bool Variant::HasPath(const StaticPathView &path) const {
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false) != 0;
+	}
+
+	const Variant *Variant::FindPath(const Path &path) const {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false);
+	}
+
+	const Variant *Variant::FindPath(const CompiledPath &path) const {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false);
+	}
+
+	const Variant *Variant::FindPath(const StaticPathView &path) const {
+		if (kind == Internal::ProxyKind && !VT(this)->Exists(this)) { return 0; }
+		return VT(this)->GetPathConst(this, path.begin(), path.end(), false);
 	}
 
 	void Variant::Merge(Variant other) {
@@ -2147,41 +3798,44 @@ namespace libvariant {
 	}
 
 	int Variant::Compare(const Variant &other) const
-   	{ return vtable->Compare(this, &other); }
+   	{ return VT(this)->Compare(this, &other); }
 
 	bool Variant::Comparable(const Variant &other) const
-	{ return vtable->Comparable(this, &other); }
+	{ return VT(this)->Comparable(this, &other); }
+
+	size_t Variant::Hash() const
+	{ return VT(this)->Hash(this); }
 
 	void Variant::Incr() {
-		vtable->Incr(this);
+		VT(this)->Incr(this);
 	}
 
 	void Variant::Decr() {
-		vtable->Decr(this);
+		VT(this)->Decr(this);
 	}
 
 	void Variant::Add(const Variant &o){
-		vtable->Add(this, &o);
+		VT(this)->Add(this, &o);
 	}
 
 	void Variant::Sub(const Variant &o){
-		vtable->Sub(this, &o);
+		VT(this)->Sub(this, &o);
 	}
 
 	void Variant::Mul(const Variant &o){
-		vtable->Mul(this, &o);
+		VT(this)->Mul(this, &o);
 	}
 
 	void Variant::Div(const Variant &o){
-		vtable->Div(this, &o);
+		VT(this)->Div(this, &o);
 	}
 
 	void Variant::Rem(const Variant &o){
-		vtable->Rem(this, &o);
+		VT(this)->Rem(this, &o);
 	}
 
 	Variant Variant::Neg() const
-   	{ return vtable->Neg(this); }
+   	{ return VT(this)->Neg(this); }
 
 	VariantRef Variant::Ref() {
 		return VariantRef(*this);
@@ -2189,69 +3843,105 @@ namespace libvariant {
 
 	Variant Variant::Copy() const {
 		Variant result;
-		vtable->Copy(this, &result);
+		VT(this)->Copy(this, &result);
 		return result;
 	}
 
+	Variant Variant::Snapshot() const {
+		const Variant *target = VT(this)->ResolveConst(this);
+		Internal::MarkCopyOnWrite(target);
+		return *target;
+	}
+
+	void Variant::InternKeys(bool enable) { Internal::intern_keys = enable; }
+
+	bool Variant::InternKeys() { return Internal::intern_keys; }
+
 	Variant &Variant::Resolve() {
-		return *vtable->Resolve(this);
+		return *VT(this)->Resolve(this);
 	}
 
 	const Variant &Variant::Resolve() const {
-		return *vtable->ResolveConst(this);
+		return *VT(this)->ResolveConst(this);
 	}
 
 	Variant &Variant::Resolve(const Variant &def) {
-		return *vtable->ResolveDefault(this, &def);
+		return *VT(this)->ResolveDefault(this, &def);
 	}
 
 	bool Variant::Exists() const {
-		return vtable->Exists(this);
+		return VT(this)->Exists(this);
 	}
 
 	void Variant::Assign(const Variant &other)
-   	{ other.vtable->Assign(&other, this); }
+   	{ VT(&other)->Assign(&other, this); }
+
+#if __cplusplus >= 201103L
+	void Variant::Assign(Variant &&other)
+	{ Internal::MoveInit(this, &other); }
+#endif
 
 	void Variant::Assign(VariantDefines::Type_t type)
-   	{ DefaultInit(vtable->Resolve(this), type); }
+   	{ DefaultInit(VT(this)->Resolve(this), type); }
 
 	void Variant::Assign(bool v)
-   	{ Internal::BoolInit(vtable->Resolve(this), v); }
+   	{ Internal::BoolInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(int v)
-   	{ Internal::IntegerInit(vtable->Resolve(this), v); }
+   	{ Internal::IntegerInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(unsigned v)
-   	{ Internal::UnsignedInit(vtable->Resolve(this), v); }
+   	{ Internal::UnsignedInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(long v)
-   	{ Internal::IntegerInit(vtable->Resolve(this), v); }
+   	{ Internal::IntegerInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(unsigned long v)
-   	{ Internal::UnsignedInit(vtable->Resolve(this), v); }
+   	{ Internal::UnsignedInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(long long v)
-   	{ Internal::IntegerInit(vtable->Resolve(this), v); }
+   	{ Internal::IntegerInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(unsigned long long v)
-   	{ Internal::UnsignedInit(vtable->Resolve(this), v); }
+   	{ Internal::UnsignedInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(double v)
-	{ Internal::FloatInit(vtable->Resolve(this), v); }
+	{ Internal::FloatInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(long double v)
-	{ Internal::FloatInit(vtable->Resolve(this), v); }
+	{ Internal::FloatInit(VT(this)->Resolve(this), v); }
+
+	void Variant::Assign(const std::vector<double> &v) {
+		Internal::PackedListInit(VT(this)->Resolve(this), FloatType, v,
+				&Internal::PackedArray::floats);
+	}
+
+	void Variant::Assign(const std::vector<intmax_t> &v) {
+		Internal::PackedListInit(VT(this)->Resolve(this), IntegerType, v,
+				&Internal::PackedArray::ints);
+	}
+
+	void Variant::Assign(const std::vector<uintmax_t> &v) {
+		Internal::PackedListInit(VT(this)->Resolve(this), UnsignedType, v,
+				&Internal::PackedArray::unsigneds);
+	}
 
 	void Variant::Assign(BlobPtr b)
-	{ Internal::BlobInit(vtable->Resolve(this), b); }
+	{ Internal::BlobInit(VT(this)->Resolve(this), b); }
 
 	void Variant::Assign(const std::string &v)
-	{ Internal::StringInit(vtable->Resolve(this), v); }
+	{ Internal::StringInit(VT(this)->Resolve(this), v); }
 
 	void Variant::Assign(const char *v)
-	{ Internal::StringInit(vtable->Resolve(this), v); }
+	{ Internal::StringInit(VT(this)->Resolve(this), v, strlen(v)); }
+
+	void Variant::Assign(const char *v, size_t len)
+	{ Internal::StringInit(VT(this)->Resolve(this), v, len); }
+
+	void Variant::Assign(const char *v, size_t len, ConstBlobPtr owner)
+	{ Internal::BorrowedStringInit(VT(this)->Resolve(this), v, len, owner); }
 
 	void Variant::ReassignRef(const Variant &o) {
-		o.vtable->MakeRef(&o, this);
+		VT(&o)->MakeRef(&o, this);
 	}
 }
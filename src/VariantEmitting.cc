@@ -20,82 +20,114 @@
  */
 #include <Variant/Variant.h>
 #include <Variant/Emitter.h>
+#include <Variant/Visit.h>
+#include "RawJSON.h"
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
 
 namespace libvariant {
 
-	Emitter &operator<<(Emitter &e, const Variant &v) {
-		switch (v.GetType()) {
-		case Variant::NullType:
-			e.EmitNull();
-			break;
-		case Variant::BoolType:
-			if (v.AsBool()) {
-				e.EmitTrue();
-			} else {
-				e.EmitFalse();
-			}
-			break;
+	static void EmitPacked(Emitter &e, Variant::Type_t type, const void *data, unsigned size) {
+		switch (type) {
 		case Variant::IntegerType:
-			e.Emit(v.AsInt());
+			e.EmitList(static_cast<const intmax_t*>(data), size);
 			break;
 		case Variant::UnsignedType:
-			e.Emit(v.AsUnsigned());
-			break;
-		case Variant::FloatType:
-			e.Emit(v.AsDouble());
-			break;
-		case Variant::StringType:
-			e.Emit(v.AsString());
-			break;
-		case Variant::ListType:
-			e << v.AsList();
-			break;
-		case Variant::MapType:
-			e << v.AsMap();
-			break;
-		case Variant::BlobType:
-			e << v.AsBlob();
+			e.EmitList(static_cast<const uintmax_t*>(data), size);
 			break;
 		default:
-			throw UnknownTypeError(v.GetType());
+			e.EmitList(static_cast<const double*>(data), size);
+			break;
 		}
+	}
+
+	/// Hands every node of a Variant to an Emitter
+	class EmitVisitor : public VariantVisitor {
+	public:
+		EmitVisitor(Emitter &e) : e(e) {}
+
+		void Null() { e.EmitNull(); }
+		void Bool(bool b) { e.Emit(b); }
+		void Int(intmax_t i) { e.Emit(i); }
+		void Unsigned(uintmax_t u) { e.Emit(u); }
+		void Float(double f) { e.Emit(f); }
+		void String(const char *s, size_t len) {
+			scratch.assign(s, len);
+			e.Emit(scratch);
+		}
+		void Blob(ConstBlobPtr b) { e.Emit(b); }
+
+		bool BeginList(const Variant &v) {
+			if (EmitRaw(v)) { return false; }
+			Variant::Type_t type;
+			unsigned size;
+			const void *data = v.PackedData(type, size);
+			if (data) {
+				EmitPacked(e, type, data, size);
+				return false;
+			}
+			e.BeginList(v.Size());
+			return true;
+		}
+		void EndList() { e.EndList(); }
+
+		bool BeginMap(const Variant &v) {
+			if (EmitRaw(v)) { return false; }
+			e.BeginMap(v.Size());
+			return true;
+		}
+		void Key(const char *s, size_t len) { String(s, len); }
+		void EndMap() { e.EndMap(); }
+	private:
+		/// A list or map from DeserializeLazy that was never looked into
+		bool EmitRaw(const Variant &v) {
+			Internal::RawJSON raw;
+			return Internal::GetRawJSON(v, raw) && e.EmitJSON(raw.Text(), raw.length);
+		}
+
+		Emitter &e;
+		/// Reused for the strings so they do not each allocate
+		std::string scratch;
+	};
+
+	Emitter &operator<<(Emitter &e, const Variant &v) {
+		EmitVisitor visitor(e);
+		Visit(visitor, v);
 		return e;
 	}
 
-	std::string Serialize(Variant v, SerializeType type, Variant params) {
+	std::string Serialize(const Variant &v, SerializeType type, const Variant &params) {
 		std::ostringstream oss;
 		Serialize(oss.rdbuf(), v, type, params);
 		return oss.str();
 
 	}
 
-	void Serialize(const std::string &filename, Variant v, SerializeType type,
-		   	Variant params) {
+	void Serialize(const std::string &filename, const Variant &v, SerializeType type,
+		   	const Variant &params) {
 		Emitter emitter = CreateEmitter(CreateEmitterOutput(filename.c_str()), type, params);
 		emitter << v;
 		emitter.Close();
 	}
 
-	void Serialize(FILE *f, Variant v, SerializeType type,
-		   	Variant params) {
+	void Serialize(FILE *f, const Variant &v, SerializeType type,
+		   	const Variant &params) {
 		Emitter emitter = CreateEmitter(CreateEmitterOutput(f), type, params);
 		emitter << v;
 		emitter.Close();
 	}
 
-	void Serialize(std::streambuf *sb, Variant v, SerializeType type,
-		   	Variant params) {
+	void Serialize(std::streambuf *sb, const Variant &v, SerializeType type,
+		   	const Variant &params) {
 		Emitter emitter = CreateEmitter(CreateEmitterOutput(sb), type, params);
 		emitter << v;
 		emitter.Close();
 
 	}
 
-	unsigned Serialize(void *ptr, unsigned len, Variant v, SerializeType type,
-		   	Variant params) {
+	unsigned Serialize(void *ptr, unsigned len, const Variant &v, SerializeType type,
+		   	const Variant &params) {
 		unsigned out_len = 0;
 		Emitter emitter = CreateEmitter(CreateEmitterOutput(ptr, len, &out_len), type, params);
 		emitter << v;
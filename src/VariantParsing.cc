@@ -20,6 +20,8 @@
  */
 #include <Variant/Variant.h>
 #include <Variant/Parser.h>
+#include "JSONParser.h"
+#include "RawJSON.h"
 #include <stdexcept>
 #include <string>
 #include <string.h>
@@ -42,28 +44,18 @@ namespace libvariant {
 
 	typedef std::map<std::string, Variant> AnchorMap;
 
-	class ParserState {
+	/**
+	 * Builds the Variant for a document from the parser events. There is
+	 * one of these for the whole document, the lists and maps being built
+	 * are kept on a stack of frames that is reused from container to
+	 * container so that after the first few there is nothing to allocate
+	 * but the Variants themselves. Finished values are moved into their
+	 * parent rather than copied.
+	 */
+	class VariantDomBuilder : public ParserActions {
 	public:
-
-		ParserState()
-		{}
-
-		void Anchor(const char *anchor, Variant v) {
-			if (anchor) { anchors.insert(std::make_pair(std::string(anchor), v)); }
-		}
-
-		Variant Anchor(const char *anchor) {
-			return anchors.at(anchor);
-		}
-
-		AnchorMap anchors;
-		Variant result;
-	};
-
-	class VariantBaseParserActions : public ParserActions {
-	public:
-		VariantBaseParserActions(ParserState *s, VariantBaseParserActions *b)
-			: done(false), seen_begin_document(false), state(s), base(b)
+		VariantDomBuilder()
+			: done(false), offset(0), text_begin(0), text_end(0), seen_begin_document(false), depth(0)
 		{}
 
 		virtual void BeginDocument(ParserImpl *p) {
@@ -75,142 +67,333 @@ namespace libvariant {
 			Finish(p);
 		}
 
-		virtual void BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag);
-		virtual void BeginList(ParserImpl *p, int length, const char *anchor, const char *tag);
+		virtual void BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag) {
+			DBTRACE("BeginMap(" << ANCHOR << ", " << TAG << ")");
+			Begin(p, MapFrame, anchor);
+		}
+		virtual void EndMap(ParserImpl *p) {
+			DBTRACE("EndMap");
+			End(p);
+		}
+		virtual void BeginList(ParserImpl *p, int length, const char *anchor, const char *tag) {
+			DBTRACE("BeginList(" << ANCHOR << ", " << TAG << ")");
+			Begin(p, ListFrame, anchor);
+		}
+		virtual void EndList(ParserImpl *p) {
+			DBTRACE("EndList");
+			End(p);
+		}
 
 		virtual void Alias(ParserImpl *p, const char *anchor) {
 			DBTRACE("Alias (" << ANCHOR << ")");
-			SetValue(p, state->Anchor(anchor), 0);
+			Variant v = anchors.at(anchor);
+			SetValue(p, v, 0);
 		}
 		virtual void Scalar(ParserImpl *p, double v, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(" << v << ", " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, v, anchor);
+			Number(p, v, Variant::FloatType, &Frame::floats, anchor);
 		}
 		virtual void Scalar(ParserImpl *p, const char *str, unsigned length, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(" << std::string(str, length) << ", " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, std::string(str, length), anchor);
+			if (depth > 0 && Top().expect_key) {
+				// Straight into the key, keys take no anchors
+				Top().key.assign(str, length);
+				Top().expect_key = false;
+				return;
+			}
+			Variant v;
+			if (text && str >= text_begin && str + length <= text_end) {
+				v.Assign(str, length, text);
+			} else {
+				v.Assign(str, length);
+			}
+			SetValue(p, v, anchor);
 		}
 		virtual void Scalar(ParserImpl *p, bool v, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(" << v << ", " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, v, anchor);
+			Variant value(v);
+			SetValue(p, value, anchor);
 		}
 		virtual void Null(ParserImpl *p, const char *anchor, const char *tag) {
 			DBTRACE("Scalar( null, " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, Variant::NullType, anchor);
+			Variant value;
+			SetValue(p, value, anchor);
 		}
 		virtual void Scalar(ParserImpl *p, intmax_t v, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(" << v << ", " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, v, anchor);
+			Number(p, v, Variant::IntegerType, &Frame::ints, anchor);
 		}
 		virtual void Scalar(ParserImpl *p, uintmax_t v, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(" << v << ", " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, v, anchor);
+			Number(p, v, Variant::UnsignedType, &Frame::unsigneds, anchor);
 		}
 		virtual void Scalar(ParserImpl *p, BlobPtr b, const char *anchor, const char *tag) {
 			DBTRACE("Scalar(blob, " << ANCHOR << ", " << TAG << ")");
-			SetValue(p, b, anchor);
+			Variant value(b);
+			SetValue(p, value, anchor);
+		}
+
+		/// Lists and maps below the top level are skipped and made lazy
+		bool Lazy() const { return document.get() != 0; }
+
+		bool done;
+		Variant result;
+		/// When lazy, the document being parsed and where in it the
+		/// parser input starts
+		shared_ptr<const std::string> document;
+		unsigned offset;
+		/// When borrowing, strings the parser hands over from within
+		/// text_begin to text_end are left there, see DeserializeBorrowed
+		ConstBlobPtr text;
+		const char *text_begin;
+		const char *text_end;
+
+	private:
+		enum FrameKind_t { MapFrame, ListFrame, RawFrame };
+
+		/**
+		 * A list or map being built. Numbers are collected on the side for
+		 * as long as they all have the same type so that such a list can be
+		 * made a packed list at the end.
+		 */
+		struct Frame {
+			FrameKind_t kind;
+			Variant value;
+			/// The key for the next value of a map
+			std::string key;
+			/// Only ever set for a map
+			bool expect_key;
+			std::string anchor;
+			bool has_anchor;
+			bool packing;
+			Variant::Type_t packed_type;
+			std::vector<intmax_t> ints;
+			std::vector<uintmax_t> unsigneds;
+			std::vector<double> floats;
+			/// Where a skipped container starts in the document
+			unsigned start;
+		};
+
+		Frame &Top() { return frames[depth - 1]; }
+
+		int Level() const { return depth + 1; }
+
+		/// The start of a container that was just begun in the document
+		unsigned ContainerStart(ParserImpl *p) const {
+			return offset + static_cast<JSONParserImpl*>(p)->GetByteCount() - 1;
 		}
 
-		virtual void SetValue(ParserImpl *p, Variant v, const char *anchor) {
-			state->Anchor(anchor, v);
-			result = v;
-			if (anchor) { this->anchor = anchor; }
-			if (!seen_begin_document) {
-				Finish(p);
+		void Anchor(const char *anchor, const Variant &v) {
+			if (anchor) { anchors.insert(std::make_pair(std::string(anchor), v)); }
+		}
+
+		void Begin(ParserImpl *p, FrameKind_t kind, const char *anchor) {
+			if (Lazy() && depth > 0) {
+				// Skip the container and make it a lazy node at its end
+				static_cast<JSONParserImpl*>(p)->SkipContainer();
+				kind = RawFrame;
+			}
+			if (depth == frames.size()) { frames.resize(depth + 1); }
+			Frame &f = frames[depth++];
+			f.kind = kind;
+			f.has_anchor = (anchor != 0);
+			if (anchor) { f.anchor = anchor; }
+			f.expect_key = (kind == MapFrame);
+			switch (kind) {
+			case MapFrame:
+				f.value = Variant::MapType;
+				f.key.clear();
+				break;
+			case ListFrame:
+				f.value = Variant::ListType;
+				f.packing = true;
+				f.packed_type = Variant::NullType;
+				break;
+			case RawFrame:
+				f.start = ContainerStart(p);
+				break;
 			}
 		}
 
-		void Finish(ParserImpl *p) {
-			if (base) {
-				base->SetValue(p, result, (anchor.empty() ? 0 : anchor.c_str()));
-			} else {
-				state->result = result;
+		void End(ParserImpl *p) {
+			Frame &f = Top();
+			switch (f.kind) {
+			case ListFrame:
+				if (f.packing) {
+					switch (f.packed_type) {
+					case Variant::IntegerType: f.value = f.ints; break;
+					case Variant::UnsignedType: f.value = f.unsigneds; break;
+					case Variant::FloatType: f.value = f.floats; break;
+					default: break;
+					}
+					f.ints.clear();
+					f.unsigneds.clear();
+					f.floats.clear();
+				}
+				break;
+			case RawFrame:
+				{
+					unsigned end = ContainerStart(p) + 1;
+					f.value = Internal::LazyJSON(Internal::RawJSON(document, f.start, end - f.start));
+				}
+				break;
+			default:
+				break;
 			}
-			done = true;
-			p->PopAction();
+			--depth;
+			// f stays in frames, only a Begin can reuse it
+			SetValue(p, f.value, f.has_anchor ? f.anchor.c_str() : 0);
 		}
 
-		int Level() {
-			if (base) { return base->Level() + 1; }
-			else { return 1; }
+		/// A number goes straight into a list that is still packing
+		template<typename T>
+		void Number(ParserImpl *p, T v, Variant::Type_t type, std::vector<T> Frame::*collected, const char *anchor) {
+			if (depth > 0) {
+				Frame &f = Top();
+				if (f.kind == ListFrame && f.packing && (f.packed_type == Variant::NullType || f.packed_type == type)) {
+					if (anchor) { Anchor(anchor, Variant(v)); }
+					f.packed_type = type;
+					(f.*collected).push_back(v);
+					return;
+				}
+			}
+			Variant value(v);
+			SetValue(p, value, anchor);
 		}
 
-		Variant result;
-		bool done;
-		bool seen_begin_document;
-		ParserState *state;
-		VariantBaseParserActions *base;
-		std::string anchor;
-	};
+		/// Move v into its place, which leaves it null
+		void SetValue(ParserImpl *p, Variant &v, const char *anchor) {
+			if (depth == 0) {
+				Anchor(anchor, v);
+				Move(result, v);
+				if (!seen_begin_document) { Finish(p); }
+				return;
+			}
+			Frame &f = Top();
+			if (f.kind == MapFrame) {
+				if (f.expect_key) {
+					f.key = v.AsString();
+					f.expect_key = false;
+				} else {
+					Anchor(anchor, v);
+					Insert(f.value, f.key, v);
+					f.expect_key = true;
+				}
+				return;
+			}
+			Anchor(anchor, v);
+			if (f.packing) {
+				if (Collect(f, v)) { return; }
+				StopPacking(f);
+			}
+			Append(f.value, v);
+		}
 
-	class VariantMapParserActions : public VariantBaseParserActions {
-	public:
-		VariantMapParserActions(ParserState *s, VariantBaseParserActions *b)
-			: VariantBaseParserActions(s, b), expect_key(true)
-		{
-			result = Variant::MapType;
+		bool Collect(Frame &f, const Variant &v) {
+			Variant::Type_t type = v.GetType();
+			if (f.packed_type == Variant::NullType) {
+				if (!v.IsNumber()) { return false; }
+				f.packed_type = type;
+			} else if (type != f.packed_type) {
+				return false;
+			}
+			switch (type) {
+			case Variant::IntegerType: f.ints.push_back(v.AsInt()); break;
+			case Variant::UnsignedType: f.unsigneds.push_back(v.AsUnsigned()); break;
+			default: f.floats.push_back(v.AsDouble()); break;
+			}
+			return true;
 		}
 
-		virtual void EndMap(ParserImpl *p) {
-			DBTRACE("EndMap");
-		   	Finish(p);
-	   	}
+		/// Move what has been collected into the list
+		void StopPacking(Frame &f) {
+			f.packing = false;
+			for (unsigned i = 0; i < f.ints.size(); ++i) { f.value.Append(f.ints[i]); }
+			for (unsigned i = 0; i < f.unsigneds.size(); ++i) { f.value.Append(f.unsigneds[i]); }
+			for (unsigned i = 0; i < f.floats.size(); ++i) { f.value.Append(f.floats[i]); }
+			f.ints.clear();
+			f.unsigneds.clear();
+			f.floats.clear();
+		}
 
-		virtual void SetValue(ParserImpl *p, Variant v, const char *anchor) {
-			if (expect_key) {
-				key = v.AsString();
-				expect_key = false;
-			} else {
-				state->Anchor(anchor, v);
-				result[key] = v;
-				expect_key = true;
-			}
+#if __cplusplus >= 201103L
+		static void Move(Variant &to, Variant &from) { to = static_cast<Variant&&>(from); }
+		static void Insert(Variant &map, const std::string &key, Variant &v) { map.Set(key, static_cast<Variant&&>(v)); }
+		static void Append(Variant &list, Variant &v) { list.Append(static_cast<Variant&&>(v)); }
+#else
+		static void Move(Variant &to, Variant &from) { to = from; from = Variant::NullType; }
+		static void Insert(Variant &map, const std::string &key, Variant &v) { map.Set(key, v); v = Variant::NullType; }
+		static void Append(Variant &list, Variant &v) { list.Append(v); v = Variant::NullType; }
+#endif
+
+		void Finish(ParserImpl *p) {
+			done = true;
+			// Whoever pushed this holds on to it, popping does not free it
+			p->PopAction();
 		}
 
-		bool expect_key;
-		std::string key;
+		bool seen_begin_document;
+		AnchorMap anchors;
+		std::vector<Frame> frames;
+		/// The number of frames in use
+		unsigned depth;
 	};
 
-	void VariantBaseParserActions::BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag) {
-		DBTRACE("BeginMap(" << ANCHOR << ", " << TAG << ")");
-		shared_ptr<VariantMapParserActions> actions(new VariantMapParserActions(state, this));
-		if (anchor) { actions->anchor = anchor; }
-		p->PushAction(actions);
+	/// Run p until it has given the builder a whole document
+	static Variant Build(Parser &p, shared_ptr<VariantDomBuilder> builder) {
+		p.PushAction(builder);
+		while (p.Run() == 0 && !builder->done);
+		return builder->result;
 	}
 
-	class VariantListParserActions : public VariantBaseParserActions {
-	public:
-		VariantListParserActions(ParserState *s, VariantBaseParserActions *b)
-			: VariantBaseParserActions(s, b)
-		{
-			result = Variant::ListType;
-		}
+	Variant ParseVariant(Parser &p) {
+		return Build(p, shared_ptr<VariantDomBuilder>(new VariantDomBuilder));
+	}
 
-		virtual void EndList(ParserImpl *p) {
-		   	DBTRACE("EndList");
-		   	Finish(p);
-	   	}
+	Variant ParseVariant(Parser &p, const Arena &arena) {
+		ArenaScope scope(arena);
+		return ParseVariant(p);
+	}
 
-		virtual void SetValue(ParserImpl *p, Variant v, const char *anchor) {
-			state->Anchor(anchor, v);
-			result.Append(v);
-		}
+	/// Parse the length bytes at offset in document, leaving the lists
+	/// and maps below the top level unparsed.
+	static Variant ParseLazy(shared_ptr<const std::string> document, unsigned offset, unsigned length) {
+		shared_ptr<VariantDomBuilder> builder(new VariantDomBuilder);
+		builder->document = document;
+		builder->offset = offset;
+		Parser parser(shared_ptr<ParserImpl>(new JSONParserImpl(
+						CreateParserInput(document->data() + offset, length))));
+		return Build(parser, builder);
+	}
 
-	};
+	Variant Internal::ParseRawJSON(const Internal::RawJSON &raw) {
+		return ParseLazy(raw.document, raw.offset, raw.length);
+	}
 
-	void VariantBaseParserActions::BeginList(ParserImpl *p, int length, const char *anchor, const char *tag) {
-		DBTRACE("BeginList(" << ANCHOR << ", " << TAG << ")");
-		shared_ptr<VariantListParserActions> actions(new VariantListParserActions(state, this));
-		if (anchor) { actions->anchor = anchor; }
-		p->PushAction(actions);
+	Variant DeserializeLazy(const std::string &str) {
+		shared_ptr<const std::string> document(new std::string(str));
+		return ParseLazy(document, 0, document->size());
 	}
 
-	Variant ParseVariant(Parser &p) {
-		ParserState state;
-		shared_ptr<VariantBaseParserActions> actions(new VariantBaseParserActions(&state, 0));
-		p.PushAction(actions);
-		while (p.Run() == 0 && !actions->done);
-		return state.result;
+	Variant DeserializeLazy(const char *str) {
+		return DeserializeLazy(std::string(str));
+	}
+
+	Variant DeserializeLazy(const void *ptr, unsigned len) {
+		return DeserializeLazy(std::string(static_cast<const char*>(ptr), len));
+	}
+
+	Variant DeserializeBorrowed(ConstBlobPtr text, SerializeType type) {
+		if (text->GetNumBuffers() != 1) {
+			// Borrow from one contiguous copy
+			text = Blob::CreateCopy(text->GetIOVec(), text->GetNumBuffers());
+		}
+		shared_ptr<VariantDomBuilder> builder(new VariantDomBuilder);
+		builder->text = text;
+		builder->text_begin = static_cast<const char*>(text->GetPtr(0));
+		builder->text_end = builder->text_begin + text->GetLength(0);
+		Parser parser = CreateParser(CreateParserInput(text->GetPtr(0), text->GetLength(0)), type);
+		return Build(parser, builder);
 	}
 
 	Variant Deserialize(const std::string &str, SerializeType type) {
@@ -241,6 +424,34 @@ namespace libvariant {
 		return ParseVariant(parser);
 	}
 
+	Variant Deserialize(const std::string &str, SerializeType type, const Arena &arena) {
+		return Deserialize(str.c_str(), str.length(), type, arena);
+	}
+
+	Variant Deserialize(const char *str, SerializeType type, const Arena &arena) {
+		return Deserialize(str, strlen(str), type, arena);
+	}
+
+	Variant Deserialize(const void *ptr, unsigned len, SerializeType type, const Arena &arena) {
+		Parser parser = CreateParser(CreateParserInput(ptr, len), type);
+		return ParseVariant(parser, arena);
+	}
+
+	Variant DeserializeFile(const char *filename, SerializeType type, const Arena &arena) {
+		Parser parser = CreateParser(CreateParserInputFile(filename), type);
+		return ParseVariant(parser, arena);
+	}
+
+	Variant DeserializeFile(FILE *f, SerializeType type, const Arena &arena) {
+		Parser parser = CreateParser(CreateParserInputFile(f), type);
+		return ParseVariant(parser, arena);
+	}
+
+	Variant DeserializeFile(std::streambuf *sb, SerializeType type, const Arena &arena) {
+		Parser parser = CreateParser(CreateParserInputFile(sb), type);
+		return ParseVariant(parser, arena);
+	}
+
 	Variant DeserializeGuess(const std::string &str) {
 		return DeserializeGuess(str.c_str(), str.length());
 	}
@@ -26,6 +26,7 @@
 #include <limits>
 #include "XMLPLISTDefs.h"
 #include "Base64.h"
+#include "Numbers.h"
 
 namespace libvariant {
 
@@ -136,25 +137,25 @@ namespace libvariant {
 
 	void XMLPLISTEmitterImpl::Emit(intmax_t v) {
 		StartElement(INTEGER_NAME);
-		std::ostringstream oss;
-		oss << v;
-		WriteText(oss.str().c_str());
+		char buf[INTEGER_CHARS + 1];
+		buf[FormatInt(v, buf)] = 0;
+		WriteText(buf);
 		CloseElement();
 	}
 
 	void XMLPLISTEmitterImpl::Emit(uintmax_t v) {
 		StartElement(INTEGER_NAME);
-		std::ostringstream oss;
-		oss << v;
-		WriteText(oss.str().c_str());
+		char buf[INTEGER_CHARS + 1];
+		buf[FormatUnsigned(v, buf)] = 0;
+		WriteText(buf);
 		CloseElement();
 	}
 
 	void XMLPLISTEmitterImpl::Emit(double v) {
 		StartElement(FLOAT_NAME);
-		std::ostringstream oss;
-		oss << std::setprecision(precision) << std::showpoint << v;
-		WriteText(oss.str().c_str());
+		char buf[FLOAT_CHARS + 1];
+		buf[FormatFloat(v, precision, true, buf)] = 0;
+		WriteText(buf);
 		CloseElement();
 	}
 
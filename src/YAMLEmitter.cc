@@ -26,6 +26,7 @@
 #include <limits>
 #include <cmath>
 #include "Base64.h"
+#include "Numbers.h"
 
 namespace libvariant {
 
@@ -318,27 +319,27 @@ namespace libvariant {
 	}
 
 	void YAMLEmitterImpl::Emit(intmax_t v) {
-		std::ostringstream oss;
-		oss << v;
-		Emit(oss.str(), PLAIN_SCALAR_STYLE);
+		char buf[INTEGER_CHARS + 1];
+		buf[FormatInt(v, buf)] = 0;
+		Emit(buf, PLAIN_SCALAR_STYLE);
 	}
 
 	void YAMLEmitterImpl::Emit(uintmax_t v) {
-		std::ostringstream oss;
-		oss << v;
-		Emit(oss.str(), PLAIN_SCALAR_STYLE);
+		char buf[INTEGER_CHARS + 1];
+		buf[FormatUnsigned(v, buf)] = 0;
+		Emit(buf, PLAIN_SCALAR_STYLE);
 	}
 
 	void YAMLEmitterImpl::Emit(double v) {
-		std::ostringstream oss;
 		if (v != v) {
-			oss << ".nan";
+			Emit(".nan", PLAIN_SCALAR_STYLE);
 		} else if (std::abs(v) == std::numeric_limits<double>::infinity()) {
-			oss << (v < 0 ? "-" : "") << ".inf";
+			Emit(v < 0 ? "-.inf" : ".inf", PLAIN_SCALAR_STYLE);
 		} else {
-			oss << std::setprecision(conf.precision) << std::showpoint << v;
+			char buf[FLOAT_CHARS + 1];
+			buf[FormatFloat(v, conf.precision, true, buf)] = 0;
+			Emit(buf, PLAIN_SCALAR_STYLE);
 		}
-		Emit(oss.str(), PLAIN_SCALAR_STYLE);
 	}
 
 	void YAMLEmitterImpl::Emit(ConstBlobPtr b) {
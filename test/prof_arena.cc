@@ -0,0 +1,87 @@
+/** \file
+ * \author John Bridgman
+ * \brief Compare parsing and discarding documents with and without an Arena.
+ *
+ * Heap allocations are counted by replacing the global operator new for
+ * this executable.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Arena.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <new>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static size_t num_allocs = 0;
+
+void *operator new(size_t len) {
+	void *ptr = malloc(len);
+	if (!ptr) { throw std::bad_alloc(); }
+	++num_allocs;
+	return ptr;
+}
+
+void operator delete(void *p) throw() { free(p); }
+void *operator new[](size_t len) { return operator new(len); }
+void operator delete[](void *p) throw() { operator delete(p); }
+void operator delete(void *p, size_t) throw() { operator delete(p); }
+void operator delete[](void *p, size_t) throw() { operator delete(p); }
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_docs = 2000;
+
+static string MakeDocument() {
+	ostringstream oss;
+	oss << "{\"request\": \"a request identifier string\", \"items\": [";
+	for (unsigned i = 0; i < 50; ++i) {
+		if (i > 0) { oss << ", "; }
+		oss << "{\"id\": " << i << ", \"price\": " << i * 1.25
+			<< ", \"description\": \"item description number " << i << "\""
+			<< ", \"tags\": [\"a\", \"b\"]}";
+	}
+	oss << "]}";
+	return oss.str();
+}
+
+static void Measure(const char *name, const string &doc, bool use_arena) {
+	size_t start_allocs = num_allocs;
+	double start = getTime();
+	for (unsigned i = 0; i < num_docs; ++i) {
+		if (use_arena) {
+			Arena arena;
+			Variant v = Deserialize(doc, SERIALIZE_JSON, arena);
+		} else {
+			Variant v = Deserialize(doc, SERIALIZE_JSON);
+		}
+	}
+	double elapsed = getTime() - start;
+	cout << setw(10) << left << name
+		<< setw(12) << right << fixed << setprecision(1) << num_docs / elapsed
+		<< setw(14) << right << double(num_allocs - start_allocs) / num_docs << "\n";
+}
+
+int main(int argc, char **argv) {
+	string doc = MakeDocument();
+	cout << "Document of " << doc.size() << " bytes\n";
+	cout << setw(10) << left << "mode" << setw(12) << right << "docs/s"
+		<< setw(14) << "allocs/doc" << "\n";
+	Measure("heap", doc, false);
+	Measure("arena", doc, true);
+	return 0;
+}
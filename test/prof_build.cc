@@ -0,0 +1,78 @@
+/** \file
+ * \author John Bridgman
+ * \brief Measure building a large list with the Variant API.
+ */
+
+#include <Variant/Variant.h>
+#include <iostream>
+#include <iomanip>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_elements = 1000000;
+
+static void Report(const char *name, double start, const Variant &v) {
+	double elapsed = getTime() - start;
+	if (v.Size() != num_elements) {
+		throw std::runtime_error("Wrong size");
+	}
+	cout << setw(24) << left << name << setw(10) << right << fixed << setprecision(1)
+		<< num_elements / elapsed / 1e6 << " M elements/s\n";
+}
+
+int main(int argc, char **argv) {
+	{
+		double start = getTime();
+		Variant v = Variant::ListType;
+		for (unsigned i = 0; i < num_elements; ++i) { v.Append(int(i)); }
+		Report("integers", start, v);
+	}
+	{
+		double start = getTime();
+		Variant v = Variant::ListType;
+		std::string str = "a string too long to be stored inline";
+		for (unsigned i = 0; i < num_elements; ++i) { v.Append(str); }
+		Report("long strings", start, v);
+	}
+	{
+		double start = getTime();
+		Variant v = Variant::ListType;
+		for (unsigned i = 0; i < num_elements; ++i) {
+			Variant entry;
+			entry.Set("id", int(i));
+			entry.Set("name", "x");
+			v.Append(entry);
+		}
+		Report("small maps", start, v);
+	}
+	{
+		double start = getTime();
+		Variant v = Variant::ListType;
+		for (unsigned i = 0; i < num_elements; ++i) {
+			v.Append(Variant().Set("id", int(i)).Set("name", "x"));
+		}
+		Report("small maps, chained", start, v);
+	}
+	{
+		Variant v = Variant::ListType;
+		for (unsigned i = 0; i < num_elements; ++i) { v.Append(Variant::ListType); }
+		double start = getTime();
+		Variant copy;
+		for (unsigned i = 0; i < num_elements; ++i) { copy.Append(v.Get(i)); }
+		Report("copy out of a list", start, copy);
+	}
+	return 0;
+}
@@ -0,0 +1,170 @@
+/** \file
+ * \author John Bridgman
+ * \brief Throughput of the JSON parser and of the JSON_parser based one it
+ * replaced, streaming the events and building a Variant, and of the JSON
+ * parser reading a stream and reading from the index of text in memory, and
+ * building a Variant whose strings borrow from the text.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Parser.h>
+#include "JSONIndex.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_records = 2000;
+static const unsigned rounds = 10;
+
+/// Counts the events, so that only the parser is timed
+class CountActions : public ParserActions {
+public:
+	CountActions() : count(0) {}
+	virtual void BeginDocument(ParserImpl *p) {}
+	virtual void EndDocument(ParserImpl *p) {}
+	virtual void BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag) { ++count; }
+	virtual void EndMap(ParserImpl *p) { ++count; }
+	virtual void BeginList(ParserImpl *p, int length, const char *anchor, const char *tag) { ++count; }
+	virtual void EndList(ParserImpl *p) { ++count; }
+	virtual void Scalar(ParserImpl *p, double v, const char *anchor, const char *tag) { ++count; }
+	virtual void Scalar(ParserImpl *p, const char *str, unsigned length, const char *anchor, const char *tag) { ++count; }
+	virtual void Scalar(ParserImpl *p, bool v, const char *anchor, const char *tag) { ++count; }
+	virtual void Null(ParserImpl *p, const char *anchor, const char *tag) { ++count; }
+	virtual void Scalar(ParserImpl *p, intmax_t v, const char *anchor, const char *tag) { ++count; }
+	virtual void Scalar(ParserImpl *p, uintmax_t v, const char *anchor, const char *tag) { ++count; }
+	virtual void Scalar(ParserImpl *p, BlobPtr b, const char *anchor, const char *tag) { ++count; }
+	unsigned count;
+};
+
+static Parser OldParser(const string &text) { return LegacyJSONParser(CreateParserInput(text)); }
+
+/// Hands the text over a buffer at a time as a file would, so there is no index
+class StreamInput : public ParserStreamInput {
+public:
+	StreamInput(const string &t) : ParserStreamInput(8192), text(t), pos(0) {}
+	virtual unsigned Read(void *ptr, unsigned len) {
+		len = std::min<size_t>(len, text.size() - pos);
+		memcpy(ptr, text.data() + pos, len);
+		pos += len;
+		return len;
+	}
+private:
+	const string &text;
+	size_t pos;
+};
+
+static Parser StreamParser(const string &text) {
+	return JSONParser(shared_ptr<ParserInput>(new StreamInput(text)));
+}
+
+static Parser IndexedParser(const string &text) { return JSONParser(CreateParserInput(text)); }
+
+typedef Parser (*MakeParser)(const string &text);
+
+static unsigned CountEvents(MakeParser make, const string &text) {
+	Parser parser = make(text);
+	shared_ptr<CountActions> actions(new CountActions);
+	parser.PushAction(actions);
+	while (parser.Run() == 0);
+	return actions->count;
+}
+
+static void Time(const char *name, const string &text) {
+	MakeParser makers[] = { OldParser, StreamParser, IndexedParser };
+	const unsigned num_makers = sizeof(makers) / sizeof(makers[0]);
+	double mb = double(text.size()) * rounds / 1e6;
+	double rates[2 * num_makers];
+	unsigned counts[num_makers];
+	Variant results[num_makers];
+	for (unsigned m = 0; m < num_makers; ++m) {
+		double start = getTime();
+		for (unsigned r = 0; r < rounds; ++r) { counts[m] = CountEvents(makers[m], text); }
+		rates[m] = mb / (getTime() - start);
+		start = getTime();
+		for (unsigned r = 0; r < rounds; ++r) {
+			Parser parser = makers[m](text);
+			results[m] = ParseVariant(parser);
+		}
+		rates[num_makers + m] = mb / (getTime() - start);
+	}
+	std::vector<unsigned> index;
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { IndexJSON(text.data(), text.data() + text.size(), index); }
+	double index_rate = mb / (getTime() - start);
+	ConstBlobPtr blob = Blob::CreateReferenced(const_cast<char*>(text.data()), text.size());
+	Variant borrowed;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { borrowed = DeserializeJSONBorrowed(blob); }
+	double borrowed_rate = mb / (getTime() - start);
+
+	cout << setw(16) << left << name << fixed << setprecision(1);
+	for (unsigned i = 0; i < 2 * num_makers; ++i) { cout << setw(10) << right << rates[i]; }
+	cout << setw(10) << right << index_rate << setw(10) << right << borrowed_rate << "\n";
+	if (borrowed != results[0]) {
+		throw std::runtime_error("Borrowed strings differ");
+	}
+	for (unsigned m = 1; m < num_makers; ++m) {
+		if (counts[0] != counts[m] || results[0] != results[m]) {
+			throw std::runtime_error("Parsers disagree");
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	Variant doc;
+	for (unsigned i = 0; i < num_records; ++i) {
+		Variant record;
+		record["id"] = i;
+		record["name"] = "record";
+		record["description"] = "a string too long to be kept in the node, with \"quotes\"";
+		record["tags"].Append("a").Append("b").Append("c");
+		record["flags"].Append(true).Append(Variant()).Append(-1);
+		for (unsigned j = 0; j < 12; ++j) {
+			ostringstream key;
+			key << "field" << j;
+			record["fields"][key.str()] = i * 0.5 + j;
+		}
+		record["owner"]["first"] = "John";
+		record["owner"]["last"] = "Doe";
+		doc.Append(record);
+	}
+	Variant text_doc;
+	for (unsigned i = 0; i < num_records; ++i) {
+		text_doc.Append("Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+				"incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud");
+	}
+
+	Variant long_text_doc;
+	for (unsigned i = 0; i < num_records / 4; ++i) {
+		long_text_doc.Append(std::string(4000, 'a' + i % 26));
+	}
+
+	cout << "MB per second counting events, building a Variant, indexing, and\n"
+		"building a Variant borrowing the strings\n";
+	cout << setw(16) << left << "document";
+	for (unsigned i = 0; i < 2; ++i) {
+		cout << setw(10) << right << "old" << setw(10) << right << "stream"
+			<< setw(10) << right << "indexed";
+	}
+	cout << setw(10) << right << "index" << setw(10) << right << "borrowed" << "\n";
+	Time("records", SerializeJSON(doc));
+	Time("pretty records", Serialize(doc, SERIALIZE_JSON, Variant().Set("pretty", true)));
+	Time("strings", SerializeJSON(text_doc));
+	Time("long strings", SerializeJSON(long_text_doc));
+	return 0;
+}
@@ -0,0 +1,95 @@
+/** \file
+ * \author John Bridgman
+ * \brief Time to pick one value out of a large JSON document and to pass a
+ * document through, with DeserializeJSON and with DeserializeLazy.
+ */
+
+#include <Variant/Variant.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_records = 2000;
+static const unsigned rounds = 20;
+
+static void Report(const char *name, double eager_time, double lazy_time) {
+	cout << setw(16) << left << name << fixed << setprecision(2)
+		<< setw(12) << right << eager_time * 1000 / rounds
+		<< setw(12) << right << lazy_time * 1000 / rounds << "\n";
+}
+
+int main(int argc, char **argv) {
+	Variant doc;
+	doc["version"] = 3;
+	for (unsigned i = 0; i < num_records; ++i) {
+		Variant record;
+		record["id"] = i;
+		record["name"] = "record";
+		record["tags"].Append("a").Append("b").Append("c");
+		for (unsigned j = 0; j < 8; ++j) { record["values"].Append(i * 0.5 + j); }
+		record["owner"]["first"] = "John";
+		record["owner"]["last"] = "Doe";
+		doc["records"].Append(record);
+	}
+	string text = SerializeJSON(doc);
+	cout << "Document of " << text.size() << " bytes, milliseconds per round\n";
+	cout << setw(16) << left << "operation" << setw(12) << right << "eager"
+		<< setw(12) << right << "lazy" << "\n";
+
+	intmax_t check = 0;
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		check += DeserializeJSON(text)["records"][num_records / 2]["id"].AsInt();
+	}
+	double eager_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		check -= DeserializeLazy(text)["records"][num_records / 2]["id"].AsInt();
+	}
+	Report("one value", eager_time, getTime() - start);
+
+	size_t len = 0, hash = 0;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		len += SerializeJSON(DeserializeJSON(text)).size();
+	}
+	eager_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		len -= SerializeJSON(DeserializeLazy(text)).size();
+	}
+	Report("pass through", eager_time, getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		Variant v = DeserializeJSON(text);
+		hash += v.Hash();
+	}
+	eager_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		Variant v = DeserializeLazy(text);
+		hash -= v.Hash();
+	}
+	Report("whole document", eager_time, getTime() - start);
+
+	if (check != 0 || len != 0 || hash != 0) {
+		throw std::runtime_error("Lazy parse disagrees");
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+/** \file
+ * \author John Bridgman
+ * \brief Compare std::map and HashMap as the storage for Variant::Map.
+ *
+ * Measures insert, lookup and iteration throughput for maps with string
+ * keys and Variant values, for both implementations in the same binary
+ * regardless of which one the library was built with.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/HashMap.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned total_ops = 500000;
+
+static vector<string> MakeKeys(unsigned num_keys) {
+	vector<string> keys;
+	for (unsigned i = 0; i < num_keys; ++i) {
+		ostringstream oss;
+		oss << "property_" << i;
+		keys.push_back(oss.str());
+	}
+	return keys;
+}
+
+template<typename M>
+static void Measure(const char *name, const vector<string> &keys) {
+	unsigned rounds = total_ops / keys.size();
+	double insert_time = 0, lookup_time = 0, iterate_time = 0;
+	unsigned found = 0;
+	for (unsigned r = 0; r < rounds; ++r) {
+		M m;
+		double start = getTime();
+		for (unsigned i = 0; i < keys.size(); ++i) {
+			m.insert(typename M::value_type(keys[i], Variant(int(i))));
+		}
+		insert_time += getTime() - start;
+
+		start = getTime();
+		for (unsigned i = 0; i < keys.size(); ++i) {
+			found += m.find(keys[(i * 7) % keys.size()]) != m.end();
+		}
+		lookup_time += getTime() - start;
+
+		start = getTime();
+		for (typename M::const_iterator i(m.begin()), e(m.end()); i != e; ++i) {
+			found += i->second.IsInt();
+		}
+		iterate_time += getTime() - start;
+	}
+	if (found != 2 * rounds * keys.size()) {
+		throw std::runtime_error("Lookup failed");
+	}
+	double ops = double(rounds) * keys.size() / 1e6;
+	cout << setw(10) << left << name << setw(8) << right << keys.size()
+		<< fixed << setprecision(1)
+		<< setw(12) << ops / insert_time
+		<< setw(12) << ops / lookup_time
+		<< setw(12) << ops / iterate_time << "\n";
+}
+
+int main(int argc, char **argv) {
+	cout << "Million operations per second\n";
+	cout << setw(10) << left << "impl" << setw(8) << right << "keys"
+		<< setw(12) << "insert" << setw(12) << "lookup" << setw(12) << "iterate" << "\n";
+	unsigned sizes[] = { 4, 16, 256, 4096, 65536 };
+	for (unsigned i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+		vector<string> keys = MakeKeys(sizes[i]);
+		Measure< std::map<string, Variant> >("std::map", keys);
+		Measure< HashMap<string, Variant> >("HashMap", keys);
+	}
+	return 0;
+}
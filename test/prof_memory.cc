@@ -0,0 +1,135 @@
+/** \file
+ * \author John Bridgman
+ * \brief Report the memory cost per node of some common Variant shapes.
+ *
+ * Heap usage is measured by replacing the global operator new and delete
+ * for this executable, so the numbers include the container nodes and any
+ * reference count blocks the library allocates.
+ */
+
+#include <Variant/Variant.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <new>
+#include <stdlib.h>
+
+using namespace libvariant;
+using namespace std;
+
+// Each allocation is prefixed with a header holding its size so that the
+// matching delete can account for it.
+static const size_t header_len = 16;
+static size_t live_bytes = 0;
+static size_t live_allocs = 0;
+
+void *operator new(size_t len) {
+	char *ptr = (char*)malloc(len + header_len);
+	if (!ptr) { throw std::bad_alloc(); }
+	*(size_t*)ptr = len;
+	live_bytes += len;
+	++live_allocs;
+	return ptr + header_len;
+}
+
+void operator delete(void *p) throw() {
+	if (!p) { return; }
+	char *ptr = (char*)p - header_len;
+	live_bytes -= *(size_t*)ptr;
+	--live_allocs;
+	free(ptr);
+}
+
+void *operator new[](size_t len) { return operator new(len); }
+void operator delete[](void *p) throw() { operator delete(p); }
+void operator delete(void *p, size_t) throw() { operator delete(p); }
+void operator delete[](void *p, size_t) throw() { operator delete(p); }
+
+static const unsigned num_nodes = 100000;
+
+struct Measurement {
+	Measurement() : bytes(live_bytes), allocs(live_allocs) {}
+	size_t bytes;
+	size_t allocs;
+};
+
+static void Report(const char *name, const Measurement &start, unsigned nodes) {
+	double bytes = double(live_bytes - start.bytes) + sizeof(Variant);
+	double allocs = double(live_allocs - start.allocs);
+	cout << setw(28) << left << name
+		<< setw(12) << right << fixed << setprecision(1) << bytes / nodes << " bytes/node"
+		<< setw(10) << right << setprecision(2) << allocs / nodes << " allocs/node\n";
+}
+
+static string Key(unsigned i) {
+	ostringstream oss;
+	oss << "k" << i;
+	return oss.str();
+}
+
+int main(int argc, char **argv) {
+	cout << "sizeof(Variant): " << sizeof(Variant) << "\n";
+	{
+		Measurement m;
+		Variant v = Variant::ListType;
+		v.AsList().reserve(num_nodes);
+		for (unsigned i = 0; i < num_nodes; ++i) { v.Append(int(i)); }
+		Report("list of integers", m, num_nodes + 1);
+	}
+	{
+		Measurement m;
+		Variant v = Variant::ListType;
+		v.AsList().reserve(num_nodes);
+		for (unsigned i = 0; i < num_nodes; ++i) { v.Append(i * 0.5); }
+		Report("list of doubles", m, num_nodes + 1);
+	}
+	{
+		std::vector<double> values;
+		for (unsigned i = 0; i < num_nodes; ++i) { values.push_back(i * 0.5); }
+		Measurement m;
+		Variant v = values;
+		Report("packed list of doubles", m, num_nodes + 1);
+	}
+	{
+		Measurement m;
+		Variant v = Variant::ListType;
+		v.AsList().reserve(num_nodes);
+		for (unsigned i = 0; i < num_nodes; ++i) { v.Append(Key(i)); }
+		Report("list of short strings", m, num_nodes + 1);
+	}
+	{
+		Measurement m;
+		Variant v = Variant::MapType;
+		for (unsigned i = 0; i < num_nodes; ++i) { v.Set(Key(i), int(i)); }
+		Report("map of integers", m, num_nodes + 1);
+	}
+	{
+		Measurement m;
+		Variant v = Variant::ListType;
+		v.AsList().reserve(num_nodes / 4);
+		for (unsigned i = 0; i < num_nodes / 4; ++i) {
+			Variant entry;
+			entry.Set("id", int(i));
+			entry.Set("ok", true);
+			entry.Set("name", "x");
+			v.Append(entry);
+		}
+		Report("list of small maps", m, num_nodes + 1);
+	}
+	for (int intern = 0; intern < 2; ++intern) {
+		Variant::InternKeys(intern);
+		Measurement m;
+		Variant v = Variant::ListType;
+		v.AsList().reserve(num_nodes / 4);
+		for (unsigned i = 0; i < num_nodes / 4; ++i) {
+			Variant entry;
+			entry.Set("identifier", int(i));
+			entry.Set("last_modified_time", 1.5);
+			entry.Set("owner_display_name", "x");
+			v.Append(entry);
+		}
+		Report(intern ? "small maps, interned keys" : "small maps, long keys", m, num_nodes + 1);
+	}
+	Variant::InternKeys(false);
+	return 0;
+}
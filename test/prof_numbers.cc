@@ -0,0 +1,168 @@
+/** \file
+ * \author John Bridgman
+ * \brief Throughput of the conversions between numbers and strings.
+ *
+ * Each conversion is timed through the Variant API and, for comparison,
+ * with the string streams the library used to use for it.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Path.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_values = 1000;
+static const unsigned rounds = 200;
+
+static void Report(const char *name, double variant_time, double stream_time) {
+	double ops = double(num_values) * rounds / 1e6;
+	cout << setw(16) << left << name << fixed << setprecision(1)
+		<< setw(12) << right << ops / variant_time
+		<< setw(12) << right << ops / stream_time << "\n";
+}
+
+int main(int argc, char **argv) {
+	vector<Variant> int_strings, float_strings, ints, floats;
+	vector<string> paths;
+	srand(1);
+	for (unsigned i = 0; i < num_values; ++i) {
+		intmax_t n = intmax_t(rand()) * (rand() % 2 ? 1 : -1);
+		double f = double(rand()) / (rand() + 1) * (rand() % 2 ? 1 : -1);
+		ostringstream is, fs, ps;
+		is << n;
+		fs << setprecision(17) << f;
+		ps << "/items[" << rand() % 1000 << "]/value";
+		int_strings.push_back(is.str());
+		float_strings.push_back(fs.str());
+		ints.push_back(n);
+		floats.push_back(f);
+		paths.push_back(ps.str());
+	}
+	intmax_t isum = 0;
+	long double fsum = 0;
+	size_t len = 0;
+
+	cout << "Million conversions per second\n";
+	cout << setw(16) << left << "conversion" << setw(12) << right << "variant"
+		<< setw(12) << right << "stream" << "\n";
+
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) { isum += int_strings[i].AsInt(); }
+	}
+	double variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			istringstream iss(int_strings[i].AsString());
+			intmax_t v = 0;
+			iss >> v;
+			isum -= v;
+		}
+	}
+	Report("string to int", variant_time, getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) { fsum += float_strings[i].AsLongDouble(); }
+	}
+	variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			istringstream iss(float_strings[i].AsString());
+			long double v = 0;
+			iss >> v;
+			fsum -= v;
+		}
+	}
+	Report("string to float", variant_time, getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) { len += ints[i].AsString().size(); }
+	}
+	variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			ostringstream oss;
+			oss << ints[i].AsInt();
+			len -= oss.str().size();
+		}
+	}
+	Report("int to string", variant_time, getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) { len += floats[i].AsString().size(); }
+	}
+	variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			ostringstream oss;
+			oss << floats[i].AsLongDouble();
+			len -= oss.str().size();
+		}
+	}
+	Report("float to string", variant_time, getTime() - start);
+
+	// The JSON emitter writes floats with 17 digits and showpoint
+	Variant list(floats);
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { len += Serialize(list, SERIALIZE_JSON).size(); }
+	variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			ostringstream oss;
+			oss << setprecision(17) << showpoint << floats[i].AsDouble();
+			len += oss.str().size();
+		}
+	}
+	Report("emit JSON float", variant_time, getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) { len += ParsePath(paths[i]).size(); }
+	}
+	variant_time = getTime() - start;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_values; ++i) {
+			// Only the index, as ParsePath used to read it
+			size_t b = paths[i].find('[') + 1;
+			istringstream iss(paths[i].substr(b, paths[i].find(']') - b));
+			unsigned long long index = 0;
+			iss >> index;
+			len += index;
+		}
+	}
+	Report("path index", variant_time, getTime() - start);
+
+	// Float sums only cancel up to rounding, the integers must agree exactly
+	if (isum != 0 || len == 0) {
+		throw std::runtime_error("Conversions disagree");
+	}
+	cout << "Checksum " << setprecision(3) << fsum << endl;
+	return 0;
+}
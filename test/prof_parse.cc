@@ -0,0 +1,229 @@
+/** \file
+ * \author John Bridgman
+ * \brief Time to build a Variant from parser events, with the builder the
+ * library uses and with the stack of actions it used to push for every list
+ * and map.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Parser.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_records = 2000;
+static const unsigned num_chains = 100;
+static const unsigned chain_depth = 100;
+static const unsigned rounds = 10;
+
+static void Report(const char *name, double stack_time, double builder_time) {
+	cout << setw(16) << left << name << fixed << setprecision(2)
+		<< setw(12) << right << stack_time * 1000 / rounds
+		<< setw(12) << right << builder_time * 1000 / rounds << "\n";
+}
+
+/// The actions ParseVariant used to push, one for each list and map, that
+/// hand each finished value to the one below by value.
+class StackParserActions : public ParserActions {
+public:
+	StackParserActions(StackParserActions *b) : done(false), seen_begin_document(false), base(b) {}
+
+	virtual void BeginDocument(ParserImpl *p) { seen_begin_document = true; }
+	virtual void EndDocument(ParserImpl *p) { Finish(p); }
+	virtual void BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag);
+	virtual void BeginList(ParserImpl *p, int length, const char *anchor, const char *tag);
+	virtual void Scalar(ParserImpl *p, double v, const char *anchor, const char *tag)
+	{ SetValue(p, v); }
+	virtual void Scalar(ParserImpl *p, const char *str, unsigned length, const char *anchor, const char *tag)
+	{ SetValue(p, std::string(str, length)); }
+	virtual void Scalar(ParserImpl *p, bool v, const char *anchor, const char *tag)
+	{ SetValue(p, v); }
+	virtual void Null(ParserImpl *p, const char *anchor, const char *tag)
+	{ SetValue(p, Variant::NullType); }
+	virtual void Scalar(ParserImpl *p, intmax_t v, const char *anchor, const char *tag)
+	{ SetValue(p, v); }
+	virtual void Scalar(ParserImpl *p, uintmax_t v, const char *anchor, const char *tag)
+	{ SetValue(p, v); }
+	virtual void Scalar(ParserImpl *p, BlobPtr b, const char *anchor, const char *tag)
+	{ SetValue(p, b); }
+
+	virtual void SetValue(ParserImpl *p, Variant v) {
+		result = v;
+		if (!seen_begin_document) { Finish(p); }
+	}
+
+	void Finish(ParserImpl *p) {
+		done = true;
+		if (base) { base->SetValue(p, result); }
+		// Keep this alive until it returns
+		shared_ptr<ParserActions> self = p->PopAction();
+	}
+
+	Variant result;
+	bool done;
+	bool seen_begin_document;
+	StackParserActions *base;
+};
+
+class StackMapParserActions : public StackParserActions {
+public:
+	StackMapParserActions(StackParserActions *b) : StackParserActions(b), expect_key(true)
+	{ result = Variant::MapType; }
+
+	virtual void EndMap(ParserImpl *p) { Finish(p); }
+
+	virtual void SetValue(ParserImpl *p, Variant v) {
+		if (expect_key) {
+			key = v.AsString();
+		} else {
+			result.Set(key, v);
+		}
+		expect_key = !expect_key;
+	}
+
+	bool expect_key;
+	std::string key;
+};
+
+class StackListParserActions : public StackParserActions {
+public:
+	StackListParserActions(StackParserActions *b) : StackParserActions(b), packing(true), packed_type(Variant::NullType)
+	{ result = Variant::ListType; }
+
+	virtual void EndList(ParserImpl *p) {
+		if (packing) {
+			switch (packed_type) {
+			case Variant::IntegerType: result = ints; break;
+			case Variant::UnsignedType: result = unsigneds; break;
+			case Variant::FloatType: result = floats; break;
+			default: break;
+			}
+		}
+		Finish(p);
+	}
+
+	virtual void SetValue(ParserImpl *p, Variant v) {
+		if (packing) {
+			if (Collect(v)) { return; }
+			packing = false;
+			for (unsigned i = 0; i < ints.size(); ++i) { result.Append(ints[i]); }
+			for (unsigned i = 0; i < unsigneds.size(); ++i) { result.Append(unsigneds[i]); }
+			for (unsigned i = 0; i < floats.size(); ++i) { result.Append(floats[i]); }
+		}
+		result.Append(v);
+	}
+
+	bool Collect(const Variant &v) {
+		Variant::Type_t type = v.GetType();
+		if (packed_type == Variant::NullType) {
+			if (!v.IsNumber()) { return false; }
+			packed_type = type;
+		} else if (type != packed_type) {
+			return false;
+		}
+		switch (type) {
+		case Variant::IntegerType: ints.push_back(v.AsInt()); break;
+		case Variant::UnsignedType: unsigneds.push_back(v.AsUnsigned()); break;
+		default: floats.push_back(v.AsDouble()); break;
+		}
+		return true;
+	}
+
+	bool packing;
+	Variant::Type_t packed_type;
+	std::vector<intmax_t> ints;
+	std::vector<uintmax_t> unsigneds;
+	std::vector<double> floats;
+};
+
+void StackParserActions::BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag) {
+	p->PushAction(shared_ptr<ParserActions>(new StackMapParserActions(this)));
+}
+
+void StackParserActions::BeginList(ParserImpl *p, int length, const char *anchor, const char *tag) {
+	p->PushAction(shared_ptr<ParserActions>(new StackListParserActions(this)));
+}
+
+static Variant ParseStack(const std::string &text, SerializeType type) {
+	Parser p = CreateParser(CreateParserInput(text), type);
+	shared_ptr<StackParserActions> actions(new StackParserActions(0));
+	p.PushAction(actions);
+	while (p.Run() == 0 && !actions->done);
+	return actions->result;
+}
+
+static void Time(const char *name, const Variant &doc, SerializeType type) {
+	string text = Serialize(doc, type);
+	Variant stack_result;
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { stack_result = ParseStack(text, type); }
+	double stack_time = getTime() - start;
+	Variant builder_result;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { builder_result = Deserialize(text, type); }
+	Report(name, stack_time, getTime() - start);
+	if (stack_result != builder_result) {
+		throw std::runtime_error("Parses disagree");
+	}
+}
+
+int main(int argc, char **argv) {
+	Variant wide;
+	for (unsigned i = 0; i < num_records; ++i) {
+		Variant record;
+		record["id"] = i;
+		record["name"] = "record";
+		record["description"] = "a string too long to be kept in the node";
+		record["tags"].Append("a").Append("b").Append("c");
+		record["flags"].Append(true).Append(Variant()).Append(-1);
+		for (unsigned j = 0; j < 12; ++j) {
+			ostringstream key;
+			key << "field" << j;
+			record["fields"][key.str()] = i * 0.5 + j;
+		}
+		record["owner"]["first"] = "John";
+		record["owner"]["last"] = "Doe";
+		wide.Append(record);
+	}
+	Variant deep;
+	for (unsigned i = 0; i < num_chains; ++i) {
+		Variant chain = Variant::MapType;
+		for (unsigned j = 0; j < chain_depth; ++j) {
+			Variant link;
+			link["level"] = j;
+			link["next"].Append(chain);
+			chain = link;
+		}
+		deep.Append(chain);
+	}
+
+	cout << "Milliseconds per round\n";
+	cout << setw(16) << left << "document" << setw(12) << right << "actions"
+		<< setw(12) << right << "builder" << "\n";
+	Time("wide JSON", wide, SERIALIZE_JSON);
+	Time("deep JSON", deep, SERIALIZE_JSON);
+#ifdef ENABLE_YAML
+	Time("wide YAML", wide, SERIALIZE_YAML);
+	Time("deep YAML", deep, SERIALIZE_YAML);
+#endif
+#ifdef ENABLE_MSGPACK
+	Time("wide MsgPack", wide, SERIALIZE_MSGPACK);
+	Time("deep MsgPack", deep, SERIALIZE_MSGPACK);
+#endif
+	return 0;
+}
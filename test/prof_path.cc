@@ -0,0 +1,102 @@
+/** \file
+ * \author John Bridgman
+ * \brief Lookups per second of the same few paths, by string, by a Path
+ * parsed each time and by a CompiledPath.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Path.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_paths = 12;
+static const unsigned rounds = 100000;
+
+static void Report(const char *name, double t) {
+	cout << setw(16) << left << name << fixed << setprecision(2)
+		<< setw(12) << right << double(num_paths) * rounds / t / 1e6 << "\n";
+}
+
+int main(int argc, char **argv) {
+	Variant doc;
+	vector<string> paths;
+	vector<CompiledPath> compiled;
+	for (unsigned i = 0; i < num_paths; ++i) {
+		ostringstream oss;
+		oss << "/config/section" << i << "/items[" << i % 3 << "]/value";
+		paths.push_back(oss.str());
+		compiled.push_back(CompiledPath(oss.str()));
+		doc.SetPath(oss.str(), i);
+		for (unsigned j = 0; j < 20; ++j) {
+			ostringstream other;
+			other << "/config/section" << i << "/other" << j;
+			doc.SetPath(other.str(), j);
+		}
+	}
+	intmax_t check = 0;
+	cout << "Million lookups per second\n";
+
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check += doc.GetPath(ParsePath(paths[i])).AsInt(); }
+	}
+	Report("ParsePath", getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check -= doc.GetPath(paths[i]).AsInt(); }
+	}
+	Report("string", getTime() - start);
+
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check += doc.GetPath(compiled[i]).AsInt(); }
+	}
+	Report("CompiledPath", getTime() - start);
+
+	// No copy of the value or reference to it
+	const Variant &cdoc = doc;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check -= cdoc.AtPath(compiled[i]).AsInt(); }
+	}
+	Report("const AtPath", getTime() - start);
+
+#if __cplusplus >= 201402L
+	// One path known at compile time against the same path compiled
+	static constexpr auto literal = VARIANT_PATH("/config/section7/items[1]/value");
+	CompiledPath same("/config/section7/items[1]/value");
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check += cdoc.AtPath(same).AsInt(); }
+	}
+	Report("one compiled", getTime() - start);
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		for (unsigned i = 0; i < num_paths; ++i) { check -= cdoc.AtPath(literal).AsInt(); }
+	}
+	Report("VARIANT_PATH", getTime() - start);
+#endif
+
+	if (check != 0) {
+		throw std::runtime_error("Lookups disagree");
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+/** \file
+ * \author John Bridgman
+ * \brief Time to stream the events of a JSON document to a consumer through
+ * the virtual ParserActions and through a handler given to ParseJSON.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Parser.h>
+#include <Variant/SAX.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_records = 2000;
+static const unsigned rounds = 10;
+
+struct Counts {
+	Counts() : nodes(0), sum(0), chars(0) {}
+	unsigned nodes;
+	intmax_t sum;
+	size_t chars;
+};
+
+/// Pick out the ids, what a streaming extractor would do
+class CountActions : public ParserActions {
+public:
+	virtual void BeginDocument(ParserImpl *p) {}
+	virtual void EndDocument(ParserImpl *p) { p->PopAction(); }
+	virtual void BeginMap(ParserImpl *p, int length, const char *anchor, const char *tag) { ++counts.nodes; }
+	virtual void EndMap(ParserImpl *p) {}
+	virtual void BeginList(ParserImpl *p, int length, const char *anchor, const char *tag) { ++counts.nodes; }
+	virtual void EndList(ParserImpl *p) {}
+	virtual void Scalar(ParserImpl *p, double v, const char *anchor, const char *tag) { ++counts.nodes; }
+	virtual void Scalar(ParserImpl *p, const char *str, unsigned length, const char *anchor, const char *tag)
+	{ ++counts.nodes; counts.chars += length; }
+	virtual void Scalar(ParserImpl *p, bool v, const char *anchor, const char *tag) { ++counts.nodes; }
+	virtual void Null(ParserImpl *p, const char *anchor, const char *tag) { ++counts.nodes; }
+	virtual void Scalar(ParserImpl *p, intmax_t v, const char *anchor, const char *tag)
+	{ ++counts.nodes; counts.sum += v; }
+	virtual void Scalar(ParserImpl *p, uintmax_t v, const char *anchor, const char *tag)
+	{ ++counts.nodes; counts.sum += v; }
+	Counts counts;
+};
+
+struct CountHandler : public SAXHandler {
+	void Null() { ++counts.nodes; }
+	void Bool(bool) { ++counts.nodes; }
+	void Int(intmax_t i) { ++counts.nodes; counts.sum += i; }
+	void Unsigned(uintmax_t u) { ++counts.nodes; counts.sum += u; }
+	void Float(double) { ++counts.nodes; }
+	void String(const char *, size_t len) { ++counts.nodes; counts.chars += len; }
+	void BeginList() { ++counts.nodes; }
+	void BeginMap() { ++counts.nodes; }
+	void Key(const char *, size_t len) { ++counts.nodes; counts.chars += len; }
+	Counts counts;
+};
+
+int main(int argc, char **argv) {
+	Variant doc;
+	for (unsigned i = 0; i < num_records; ++i) {
+		Variant record;
+		record["id"] = i;
+		record["name"] = "record";
+		record["tags"].Append("a").Append("b").Append("c");
+		record["flags"].Append(true).Append(Variant()).Append(-1);
+		for (unsigned j = 0; j < 12; ++j) {
+			ostringstream key;
+			key << "field" << j;
+			record["fields"][key.str()] = i * 16 + j;
+		}
+		doc.Append(record);
+	}
+	string text = SerializeJSON(doc);
+
+	shared_ptr<CountActions> actions(new CountActions);
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) {
+		Parser parser = JSONParser(CreateParserInput(text));
+		parser.PushAction(actions);
+		while (parser.Run() == 0);
+	}
+	double actions_time = getTime() - start;
+	CountHandler handler;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { ParseJSON(text, handler); }
+	double handler_time = getTime() - start;
+
+	cout << "Milliseconds per round\n";
+	cout << setw(16) << left << "consumer" << setw(12) << right << "actions"
+		<< setw(12) << right << "ParseJSON" << "\n";
+	cout << setw(16) << left << "count events" << fixed << setprecision(2)
+		<< setw(12) << right << actions_time * 1000 / rounds
+		<< setw(12) << right << handler_time * 1000 / rounds << "\n";
+	if (actions->counts.nodes != handler.counts.nodes || actions->counts.sum != handler.counts.sum
+			|| actions->counts.chars != handler.counts.chars) {
+		throw std::runtime_error("Consumers disagree");
+	}
+	return 0;
+}
@@ -0,0 +1,190 @@
+/** \file
+ * \author John Bridgman
+ * \brief Time to walk and to serialize a document with Visit and with the
+ * GetType and As* calls the emitters used to make at every node.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Emitter.h>
+#include <Variant/Visit.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+#include <string.h>
+#include <stdexcept>
+#include <errno.h>
+
+using namespace libvariant;
+using namespace std;
+
+static double getTime() {
+	timeval tv;
+	if (gettimeofday(&tv, 0) != 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return static_cast<double>(tv.tv_sec) + 1e-6 * static_cast<double>(tv.tv_usec);
+}
+
+static const unsigned num_records = 2000;
+static const unsigned rounds = 20;
+
+static void Report(const char *name, double virtual_time, double visit_time) {
+	cout << setw(16) << left << name << fixed << setprecision(2)
+		<< setw(12) << right << virtual_time * 1000 / rounds
+		<< setw(12) << right << visit_time * 1000 / rounds << "\n";
+}
+
+struct Counts {
+	Counts() : nodes(0), sum(0), chars(0) {}
+	unsigned nodes;
+	intmax_t sum;
+	size_t chars;
+};
+
+static void CountElement(const std::string *key, const Variant &value, void *ctx);
+
+static void CountVirtual(const Variant &v, Counts &counts) {
+	++counts.nodes;
+	switch (v.GetType()) {
+	case Variant::IntegerType:
+		counts.sum += v.AsInt();
+		break;
+	case Variant::UnsignedType:
+		counts.sum += v.AsUnsigned();
+		break;
+	case Variant::StringType:
+		counts.chars += v.AsString().size();
+		break;
+	case Variant::ListType:
+	case Variant::MapType:
+		v.ForEach(CountElement, &counts);
+		break;
+	default:
+		break;
+	}
+}
+
+static void CountElement(const std::string *key, const Variant &value, void *ctx) {
+	Counts &counts = *static_cast<Counts*>(ctx);
+	if (key) { counts.chars += key->size(); }
+	CountVirtual(value, counts);
+}
+
+struct CountVisitor : public VariantVisitor {
+	void Null() { ++counts.nodes; }
+	void Bool(bool) { ++counts.nodes; }
+	void Int(intmax_t i) { ++counts.nodes; counts.sum += i; }
+	void Unsigned(uintmax_t u) { ++counts.nodes; counts.sum += u; }
+	void Float(double) { ++counts.nodes; }
+	void String(const char *, size_t len) { ++counts.nodes; counts.chars += len; }
+	bool BeginList(const Variant &) { ++counts.nodes; return true; }
+	bool BeginMap(const Variant &) { ++counts.nodes; return true; }
+	void Key(const char *, size_t len) { counts.chars += len; }
+	Counts counts;
+};
+
+static void EmitElement(const std::string *key, const Variant &value, void *ctx);
+
+/// The emitting operator<< as it was before it used Visit
+static void EmitVirtual(Emitter &e, const Variant &v) {
+	switch (v.GetType()) {
+	case Variant::NullType:
+		e.EmitNull();
+		break;
+	case Variant::BoolType:
+		e.Emit(v.AsBool());
+		break;
+	case Variant::IntegerType:
+		e.Emit(v.AsInt());
+		break;
+	case Variant::UnsignedType:
+		e.Emit(v.AsUnsigned());
+		break;
+	case Variant::FloatType:
+		e.Emit(v.AsDouble());
+		break;
+	case Variant::StringType:
+		e.Emit(v.AsString());
+		break;
+	case Variant::ListType:
+		e.BeginList(v.Size());
+		v.ForEach(EmitElement, &e);
+		e.EndList();
+		break;
+	case Variant::MapType:
+		e.BeginMap(v.Size());
+		v.ForEach(EmitElement, &e);
+		e.EndMap();
+		break;
+	default:
+		e << v.AsBlob();
+		break;
+	}
+}
+
+static void EmitElement(const std::string *key, const Variant &value, void *ctx) {
+	Emitter &e = *static_cast<Emitter*>(ctx);
+	if (key) { e.Emit(*key); }
+	EmitVirtual(e, value);
+}
+
+int main(int argc, char **argv) {
+	Variant doc;
+	doc["version"] = 3;
+	for (unsigned i = 0; i < num_records; ++i) {
+		Variant record;
+		record["id"] = i;
+		record["name"] = "record";
+		record["description"] = "a string too long to be kept in the node";
+		record["tags"].Append("a").Append("b").Append("c");
+		record["flags"].Append(true).Append(Variant()).Append(-1);
+		for (unsigned j = 0; j < 12; ++j) {
+			ostringstream key;
+			key << "field" << j;
+			record["fields"][key.str()] = i * 0.5 + j;
+		}
+		record["owner"]["first"] = "John";
+		record["owner"]["last"] = "Doe";
+		doc["records"].Append(record);
+	}
+	cout << "Milliseconds per round\n";
+	cout << setw(16) << left << "operation" << setw(12) << right << "GetType"
+		<< setw(12) << right << "Visit" << "\n";
+
+	Counts virtual_counts;
+	double start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { CountVirtual(doc, virtual_counts); }
+	double virtual_time = getTime() - start;
+	CountVisitor visitor;
+	start = getTime();
+	for (unsigned r = 0; r < rounds; ++r) { Visit(visitor, doc); }
+	Report("count nodes", virtual_time, getTime() - start);
+	if (virtual_counts.nodes != visitor.counts.nodes || virtual_counts.sum != visitor.counts.sum
+			|| virtual_counts.chars != visitor.counts.chars) {
+		throw std::runtime_error("Walks disagree");
+	}
+
+	SerializeType types[] = { SERIALIZE_JSON, SERIALIZE_YAML };
+	const char *names[] = { "serialize JSON", "serialize YAML" };
+	for (unsigned t = 0; t < sizeof(types) / sizeof(types[0]); ++t) {
+		string virtual_text;
+		start = getTime();
+		for (unsigned r = 0; r < rounds; ++r) {
+			ostringstream oss;
+			Emitter e = CreateEmitter(CreateEmitterOutput(oss.rdbuf()), types[t]);
+			EmitVirtual(e, doc);
+			e.Close();
+			virtual_text = oss.str();
+		}
+		virtual_time = getTime() - start;
+		string visit_text;
+		start = getTime();
+		for (unsigned r = 0; r < rounds; ++r) { visit_text = Serialize(doc, types[t]); }
+		Report(names[t], virtual_time, getTime() - start);
+		if (virtual_text != visit_text) {
+			throw std::runtime_error("Serializations disagree");
+		}
+	}
+	return 0;
+}
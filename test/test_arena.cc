@@ -0,0 +1,92 @@
+/** \file
+ * \author John Bridgman
+ * \brief Check documents parsed into an Arena.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/Arena.h>
+#include "TestAssert.h"
+#include <iostream>
+#include <string>
+
+using namespace libvariant;
+using namespace std;
+
+static const char *doc =
+	"{\"name\": \"a string too long to be stored inline\", \"id\": 42,"
+	" \"tags\": [\"x\", \"y\", \"z\", 1, 2, 3, 4.5, true, null],"
+	" \"nested\": {\"a\": {\"b\": {\"c\": [1, [2, [3]]]}}}}";
+
+static void TestParse() {
+	cout << "Testing parsing into an arena\n";
+	Variant expected = Deserialize(doc, SERIALIZE_JSON);
+	Variant copy;
+	{
+		Arena arena;
+		Variant v = Deserialize(doc, SERIALIZE_JSON, arena);
+		ASSERT(arena.BytesUsed() > 0);
+		ASSERT(v == expected);
+		ASSERT(v.Get("name").AsString() == "a string too long to be stored inline");
+		v.SetPath("nested/a/b/d", "another string too long to be stored inline");
+		v["tags"].Append(5);
+		ASSERT(v.GetPath("tags[9]") == 5);
+		{
+			ArenaScope scope(arena);
+			v.Set("a key too long to be stored inline", 6);
+		}
+		// A copy made outside of an ArenaScope does not use the arena
+		size_t used = arena.BytesUsed();
+		copy = v.Copy();
+		ASSERT(arena.BytesUsed() == used);
+		v.Erase("nested");
+		// Destructed before the arena
+	}
+	ASSERT(copy.GetPath("nested/a/b/d") == "another string too long to be stored inline");
+	ASSERT(copy.GetPath("nested/a/b/c[1][1][0]") == 3);
+	ASSERT(copy.Get("a key too long to be stored inline") == 6);
+}
+
+static void TestScope() {
+	cout << "Testing ArenaScope\n";
+	Arena arena(256);
+	Arena other = arena;
+	{
+		Variant outer;
+		{
+			ArenaScope scope(arena);
+			for (int i = 0; i < 100; ++i) {
+				outer.Append(Variant().Set("key", "a string too long to be stored inline"));
+			}
+			{
+				Arena inner;
+				ArenaScope inner_scope(inner);
+				Variant list = Variant::ListType;
+				ASSERT(inner.BytesUsed() > 0);
+			}
+			size_t used = arena.BytesUsed();
+			outer.Append(Variant::MapType);
+			ASSERT(arena.BytesUsed() > used);
+		}
+		size_t used = arena.BytesUsed();
+		Variant heap = Variant::ListType;
+		ASSERT(arena.BytesUsed() == used);
+		ASSERT(outer.Size() == 101);
+		ASSERT(outer.GetPath("[99]/key") == "a string too long to be stored inline");
+		// Handles share the arena, the blocks stay until the last is gone
+		arena = Arena();
+		ASSERT(other.BytesUsed() == used);
+		ASSERT(arena.BytesUsed() == 0);
+		ASSERT(outer.GetPath("[99]/key") == "a string too long to be stored inline");
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		TestParse();
+		TestScope();
+	} catch (const std::exception &e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+/** \file
+ * \author John Bridgman
+ * \brief Check HashMap against std::map under random inserts and erases.
+ */
+
+#include <Variant/Variant.h>
+#include <Variant/HashMap.h>
+#include "TestAssert.h"
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+
+using namespace libvariant;
+using namespace std;
+
+typedef HashMap<string, int> IntHashMap;
+
+static string Key(unsigned i) {
+	ostringstream oss;
+	oss << "key" << i;
+	return oss.str();
+}
+
+static void Check(const IntHashMap &h, const map<string, int> &m) {
+	ASSERT(h.size() == m.size());
+	ASSERT(h.empty() == m.empty());
+	for (map<string, int>::const_iterator i(m.begin()), e(m.end()); i != e; ++i) {
+		IntHashMap::const_iterator j = h.find(i->first);
+		ASSERT(j != h.end());
+		ASSERT(j->second == i->second);
+	}
+	unsigned count = 0;
+	for (IntHashMap::const_iterator i(h.begin()), e(h.end()); i != e; ++i) {
+		ASSERT(m.count(i->first) == 1);
+		++count;
+	}
+	ASSERT(count == m.size());
+	vector<const IntHashMap::value_type*> sorted;
+	SortedEntries(h, sorted);
+	ASSERT(sorted.size() == m.size());
+	map<string, int>::const_iterator mi = m.begin();
+	for (unsigned i = 0; i < sorted.size(); ++i, ++mi) {
+		ASSERT(sorted[i]->first == mi->first);
+	}
+}
+
+static void TestRandom() {
+	cout << "Testing random inserts and erases\n";
+	IntHashMap h;
+	map<string, int> m;
+	srand(42);
+	for (unsigned i = 0; i < 20000; ++i) {
+		string key = Key(rand() % 2000);
+		switch (rand() % 4) {
+		case 0:
+			ASSERT(h.erase(key) == m.erase(key));
+			break;
+		case 1:
+			h[key] = i;
+			m[key] = i;
+			break;
+		default:
+			ASSERT(h.insert(make_pair(key, int(i))).second == m.insert(make_pair(key, int(i))).second);
+			break;
+		}
+		if (i % 1000 == 0) { Check(h, m); }
+	}
+	Check(h, m);
+	IntHashMap copy(h);
+	Check(copy, m);
+	ASSERT(copy == h);
+	copy.begin()->second += 1;
+	ASSERT(copy != h);
+	IntHashMap other;
+	other.swap(copy);
+	ASSERT(copy.empty());
+	ASSERT(other.size() == m.size());
+	h.clear();
+	m.clear();
+	Check(h, m);
+}
+
+static void TestOrder() {
+	cout << "Testing insertion order and stable entries\n";
+	IntHashMap h;
+	vector<int*> values;
+	for (unsigned i = 0; i < 100; ++i) {
+		values.push_back(&h[Key(99 - i)]);
+		*values.back() = i;
+	}
+	IntHashMap::iterator it = h.begin();
+	for (unsigned i = 0; i < 100; ++i, ++it) {
+		ASSERT(it->first == Key(99 - i));
+		// Growing the table must not move the entries
+		ASSERT(&it->second == values[i]);
+	}
+	ASSERT(it == h.end());
+	--it;
+	ASSERT(it->first == Key(0));
+	h.erase(h.find(Key(50)));
+	ASSERT(h.find(Key(50)) == h.end());
+	ASSERT(h.size() == 99);
+}
+
+int main(int argc, char **argv) {
+	try {
+		TestRandom();
+		TestOrder();
+	} catch (const std::exception &e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -3,8 +3,12 @@
  * \brief 
  */
 #include <Variant/Parser.h>
+#include <Variant/SAX.h>
 #include <limits>
+#include <string.h>
+#include <stdlib.h>
 #include "TestCommon.h"
+#include "JSONIndex.h"
 
 using namespace libvariant;
 
@@ -40,6 +44,215 @@ void ExpectedEvents(Emitter e) {
 	e.EndDocument();
 }
 
+/// Hands out the text a few bytes at a time, as a stream might
+class ChunkInput : public ParserInput {
+public:
+	ChunkInput(const std::string &t, unsigned n) : text(t), pos(0), chunk(n) {}
+	virtual const void *GetPtr(unsigned &len) {
+		if (pos == text.size()) { return 0; }
+		len = std::min<unsigned>(chunk, text.size() - pos);
+		return text.data() + pos;
+	}
+	virtual void Release(unsigned len) { pos += len; }
+private:
+	std::string text;
+	unsigned pos;
+	unsigned chunk;
+};
+
+static const unsigned chunk_sizes[] = { 0, 1, 2, 3, 7, 16 };
+
+static shared_ptr<ParserInput> Input(const char *doc, unsigned chunk) {
+	if (chunk == 0) { return CreateParserInput(doc); }
+	return shared_ptr<ParserInput>(new ChunkInput(doc, chunk));
+}
+
+/// JSONParser must give the same events as the parser it replaced, however
+/// the text is cut up
+static bool SameAsLegacy(const char *doc) {
+	shared_ptr<EventBuffer> expected(new EventBuffer);
+	expected->Fill(LegacyJSONParser(CreateParserInput(doc)));
+	for (unsigned i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++i) {
+		shared_ptr<EventBuffer> result(new EventBuffer);
+		result->Fill(JSONParser(Input(doc, chunk_sizes[i])));
+		if (!ErrorCheckEventBuffer(expected, result)) {
+			std::cout << "Parsing " << doc << " in chunks of " << chunk_sizes[i] << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Throws(Parser p) {
+	try {
+		shared_ptr<EventBuffer> result(new EventBuffer);
+		result->Fill(p);
+	} catch (const std::runtime_error &) {
+		return true;
+	}
+	return false;
+}
+
+static bool BothReject(const char *doc) {
+	if (!Throws(LegacyJSONParser(CreateParserInput(doc)))) {
+		std::cout << "The legacy parser accepted " << doc << "\n";
+		return false;
+	}
+	for (unsigned i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++i) {
+		if (!Throws(JSONParser(Input(doc, chunk_sizes[i])))) {
+			std::cout << "Accepted " << doc << " in chunks of " << chunk_sizes[i] << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+static const char *same_documents[] = {
+	input_document,
+	"[\"esc \\\" \\\\ \\/ \\b\\f\\n\\r\\t \\u00e9 \\u20ac \\ud83d\\ude00 end\", \"\"]",
+	"[-0, 0, 1., 2.e1, 0.5e-3, 1E+2, -1.25E-2, 12345678901234567890, -123456789012345678, true, false, null]",
+	"[[], {}, [[]], {\"\": {}}, [{\"a\": [1, {\"b\": \"a string longer than eight\"}]}]]",
+	"/* a */ [ /* b */ 1 /* c */, /* d * / ** */ 2 ]",
+	"\n\t{\r\n  \"key\" : \"value\" ,\n        \"list\" :  [ 1 ,2,  3 ]\n}  ",
+	"{\"utf8 \xc3\xa9\": \"\xe2\x82\xac\"}",
+};
+
+static const char *rejected_documents[] = {
+	"", "  ", "1", "\"a\"", "[1,]", "[01]", "[-]", "[.5]", "[1e]", "[+1]",
+	"{\"a\" 1}", "{\"a\": 1,}", "{1: 2}", "[tru]", "[truex]", "[nul]", "[1 2]",
+	"[\"\\x\"]", "[\"a\nb\"]", "[\"\\ud800\"]", "[\"\\udc00\"]", "[\"\\u12\"]",
+	"{\"a\": 1]", "[1}", "[1", "{\"a\"", "[\"abc", "[1 /* open", "[1 / 2]",
+};
+
+/// The message a parser throws, or an empty string
+static std::string ErrorMessage(Parser p) {
+	try {
+		shared_ptr<EventBuffer> result(new EventBuffer);
+		result->Fill(p);
+	} catch (const std::runtime_error &e) {
+		return e.what();
+	}
+	return std::string();
+}
+
+/// Reading from the index must find the same errors in the same places as
+/// reading every byte
+static bool SameError(const char *doc) {
+	std::string indexed = ErrorMessage(JSONParser(CreateParserInput(doc)));
+	std::string streamed = ErrorMessage(JSONParser(Input(doc, 1)));
+	if (indexed.empty() || indexed != streamed) {
+		std::cout << "Parsing " << doc << " gave \"" << indexed << "\" and \"" << streamed << "\"\n";
+		return false;
+	}
+	return true;
+}
+
+static const char *error_documents[] = {
+	"[1,\n 2,\n x]", "{\n\"a\":\n\n [1\n 2]}", "[\"a\", \"b\"\n\n", "\n\n[\"\\q\"]",
+	"[1, 2}", "[\n1.5e]", "\n  {\"a\": true, \"b\": nul}",
+};
+
+/// What IndexJSON should find, a byte at a time
+static bool ReferenceIndex(const std::string &text, std::vector<unsigned> &index) {
+	bool in_string = false, escape = false, after_token = true, ok = true;
+	for (unsigned i = 0; i < text.size(); ++i) {
+		char c = text[i];
+		bool quote = (c == '"' && !escape);
+		escape = (c == '\\' && !escape);
+		bool op = (c != 0 && strchr("{}[]:,", c) != 0);
+		bool token_end = op || (c != 0 && strchr(" \t\n\r\"", c) != 0);
+		if (in_string) {
+			if (quote) {
+				in_string = false;
+				index.push_back(i);
+			} else if ((unsigned char)c < 0x20) {
+				ok = false;
+			}
+		} else if (quote) {
+			in_string = true;
+			index.push_back(i);
+		} else if (c == '/') {
+			ok = false;
+		} else if (op || (!token_end && after_token)) {
+			index.push_back(i);
+		}
+		after_token = token_end;
+	}
+	return ok && !in_string;
+}
+
+/// Each kernel must find what the reference does, wherever the 64 byte
+/// blocks fall
+static bool IndexTest() {
+	static const char alphabet[] = "\"\"\"\\\\\\{}[]:,/  \n\ta1-.e\x01\xc3";
+	static const JSONIndexKernel_t kernels[] = {
+		JSON_INDEX_BEST, JSON_INDEX_SCALAR, JSON_INDEX_SSE2, JSON_INDEX_AVX2
+	};
+	srand(1);
+	for (unsigned n = 0; n < 2000; ++n) {
+		std::string text;
+		unsigned len = rand() % 300;
+		for (unsigned i = 0; i < len; ++i) {
+			// Mostly letters so that strings run across blocks
+			if (rand() % 4) { text += 'x'; }
+			else { text += alphabet[rand() % (sizeof(alphabet) - 1)]; }
+		}
+		std::vector<unsigned> expected;
+		bool expected_ok = ReferenceIndex(text, expected);
+		for (unsigned k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+			if (!JSONIndexSupported(kernels[k])) { continue; }
+			std::vector<unsigned> index;
+			bool ok = IndexJSON(text.data(), text.data() + text.size(), index, kernels[k]);
+			if (ok != expected_ok || (ok && index != expected)) {
+				std::cout << "Kernel " << kernels[k] << " got the index of \"" << text << "\" wrong\n";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/// Strings with runs of backslashes and quotes falling on each side of
+/// the block boundaries
+static bool BlockBoundaryTest() {
+	for (unsigned pad = 0; pad < 140; ++pad) {
+		Variant doc;
+		doc.Append(std::string(pad, 'x'));
+		doc.Append("a\\\\\\\"b\\");
+		doc.Append("\\");
+		doc.Append(Variant().Set("key \"\\", -1.5));
+		doc.Append(12345);
+		doc.Append(true);
+		std::string text = SerializeJSON(doc);
+		if (!SameAsLegacy(text.c_str())) { return false; }
+		text = Serialize(doc, SERIALIZE_JSON, Variant().Set("pretty", true));
+		if (!SameAsLegacy(text.c_str())) { return false; }
+		shared_ptr<EventBuffer> expected(new EventBuffer);
+		expected->Fill(LegacyJSONParser(CreateParserInput(text)));
+		shared_ptr<EventBuffer> result(new EventBuffer);
+		result->Fill(JSONParser(shared_ptr<ParserInput>(new ParserStringInput(text))));
+		if (!ErrorCheckEventBuffer(expected, result)) { return false; }
+	}
+	return true;
+}
+
+/// Emits what ParseJSON hands it
+struct EmitHandler : public SAXHandler {
+	EmitHandler(Emitter e_) : e(e_) {}
+	void Null() { e.EmitNull(); }
+	void Bool(bool b) { e.Emit(b); }
+	void Int(intmax_t i) { e.Emit(i); }
+	void Unsigned(uintmax_t u) { e.Emit(u); }
+	void Float(double f) { e.Emit(f); }
+	void String(const char *s, size_t len) { e.Emit(std::string(s, len)); }
+	void BeginList() { e.BeginList(); }
+	void EndList() { e.EndList(); }
+	void BeginMap() { e.BeginMap(); }
+	void Key(const char *s, size_t len) { e.Emit(std::string(s, len)); }
+	void EndMap() { e.EndMap(); }
+	Emitter e;
+};
+
 int main(int argc, char **argv) {
 	Parser parser = JSONParser(CreateParserInput(input_document));
 	shared_ptr<EventBuffer> expected(new EventBuffer);
@@ -51,5 +264,49 @@ int main(int argc, char **argv) {
 	if (!ErrorCheckEventBuffer(expected, result)) {
 		return 1;
 	}
+
+	shared_ptr<EventBuffer> sax_result(new EventBuffer);
+	EmitHandler handler((Emitter(sax_result)));
+	handler.e.BeginDocument();
+	ParseJSON(input_document, handler);
+	handler.e.EndDocument();
+	if (!ErrorCheckEventBuffer(expected, sax_result)) {
+		return 1;
+	}
+
+	if (!IndexTest()) { return 1; }
+	for (unsigned i = 0; i < sizeof(same_documents) / sizeof(same_documents[0]); ++i) {
+		if (!SameAsLegacy(same_documents[i])) { return 1; }
+	}
+	for (unsigned i = 0; i < sizeof(rejected_documents) / sizeof(rejected_documents[0]); ++i) {
+		if (!BothReject(rejected_documents[i])) { return 1; }
+	}
+
+	for (unsigned i = 0; i < sizeof(rejected_documents) / sizeof(rejected_documents[0]); ++i) {
+		if (!SameError(rejected_documents[i])) { return 1; }
+	}
+	for (unsigned i = 0; i < sizeof(error_documents) / sizeof(error_documents[0]); ++i) {
+		if (!SameError(error_documents[i])) { return 1; }
+	}
+	if (!BlockBoundaryTest()) { return 1; }
+
+	Variant blob = Variant().Append(Blob::CreateCopy("blob\0data", 9)).Append("x");
+	if (DeserializeJSON(SerializeJSON(blob)) != blob) {
+		std::cout << "A blob did not make it through JSON\n";
+		return 1;
+	}
+
+	try {
+		SAXHandler ignore;
+		ParseJSON("{\"a\": [1, 2}", ignore);
+		std::cout << "ParseJSON did not throw on a syntax error\n";
+		return 1;
+	} catch (const std::runtime_error &) {}
+	try {
+		SAXHandler ignore;
+		ParseJSON("{\"a\": [1, 2]", ignore);
+		std::cout << "ParseJSON did not throw on a document that ended early\n";
+		return 1;
+	} catch (const std::runtime_error &) {}
 	return 0;
 }
@@ -0,0 +1,199 @@
+/** \file
+ * \author John Bridgman
+ * \brief Check the number conversions against printf and strtod.
+ */
+
+#include "Numbers.h"
+#include "TestAssert.h"
+#include <Variant/Variant.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace libvariant;
+using namespace std;
+
+static string Format(long double v, unsigned precision, bool showpoint) {
+	char buf[FLOAT_CHARS];
+	return string(buf, FormatFloat(v, precision, showpoint, buf));
+}
+
+static string Printf(long double v, unsigned precision, bool showpoint) {
+	char buf[256];
+	snprintf(buf, sizeof(buf), showpoint ? "%#.*Lg" : "%.*Lg", int(precision), v);
+	return buf;
+}
+
+static double RandomDouble() {
+	uint64_t bits = 0;
+	for (unsigned i = 0; i < 4; ++i) { bits = (bits << 16) ^ (rand() & 0xffff); }
+	double v;
+	memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+static void TestIntegers() {
+	cout << "Testing integers\n";
+	const intmax_t ints[] = { 0, 1, -1, 9, 10, 99, 100, -12345, 1234567890,
+		numeric_limits<intmax_t>::max(), numeric_limits<intmax_t>::min() };
+	for (unsigned i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+		ostringstream oss;
+		oss << ints[i];
+		char buf[INTEGER_CHARS];
+		ASSERT(string(buf, FormatInt(ints[i], buf)) == oss.str());
+		intmax_t v = 0;
+		ASSERT(ParseInt(oss.str().data(), oss.str().data() + oss.str().size(), v) == NUMBER_OK);
+		ASSERT(v == ints[i]);
+	}
+	char buf[INTEGER_CHARS];
+	ASSERT(string(buf, FormatUnsigned(numeric_limits<uintmax_t>::max(), buf)) == "18446744073709551615");
+
+	const char *text = "+42abc";
+	const char *end = 0;
+	intmax_t v = 0;
+	ASSERT(ParseInt(text, text + strlen(text), v, &end) == NUMBER_OK);
+	ASSERT(v == 42 && end == text + 3);
+	text = "-x";
+	ASSERT(ParseInt(text, text + strlen(text), v, &end) == NUMBER_INVALID);
+	ASSERT(end == text);
+	text = "9223372036854775808";
+	ASSERT(ParseInt(text, text + strlen(text), v) == NUMBER_RANGE);
+	ASSERT(v == numeric_limits<intmax_t>::max());
+	text = "-9223372036854775809";
+	ASSERT(ParseInt(text, text + strlen(text), v) == NUMBER_RANGE);
+	ASSERT(v == numeric_limits<intmax_t>::min());
+	uintmax_t u = 0;
+	text = "18446744073709551616";
+	ASSERT(ParseUnsigned(text, text + strlen(text), u) == NUMBER_RANGE);
+	ASSERT(u == numeric_limits<uintmax_t>::max());
+	text = "ff";
+	ASSERT(ParseUnsigned(text, text + strlen(text), u, 0, 16) == NUMBER_OK && u == 255);
+	text = "-1";
+	ASSERT(ParseUnsigned(text, text + strlen(text), u) == NUMBER_OK);
+	ASSERT(u == numeric_limits<uintmax_t>::max());
+}
+
+static void TestFormatFloat() {
+	cout << "Testing float formatting\n";
+	const long double values[] = { 0.0L, -0.0L, 1.0L, 0.1L, 100.0L, 123456.0L, 1234567.0L,
+		0.0001L, 0.00001L, 9.9999995L, 0.99999999L, 1e300L, -2.5e-300L, 1e4000L,
+		numeric_limits<double>::min(), numeric_limits<double>::denorm_min(),
+		numeric_limits<double>::infinity(), -numeric_limits<double>::infinity() };
+	const unsigned precisions[] = { 0, 1, 2, 6, 17, 21, 40 };
+	for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+		for (unsigned j = 0; j < sizeof(precisions) / sizeof(precisions[0]); ++j) {
+			ASSERT(Format(values[i], precisions[j], false) == Printf(values[i], precisions[j], false));
+			ASSERT(Format(values[i], precisions[j], true) == Printf(values[i], precisions[j], true));
+		}
+	}
+	srand(42);
+	for (unsigned i = 0; i < 100000; ++i) {
+		double v = RandomDouble();
+		if (v != v) { continue; }
+		ASSERT(Format(v, 17, true) == Printf(v, 17, true));
+		ASSERT(Format(v, 6, false) == Printf(v, 6, false));
+	}
+	ASSERT(Format(numeric_limits<double>::quiet_NaN(), 6, false) == "nan");
+	// What the emitters write, with the stream that used to write it
+	ostringstream oss;
+	oss << setprecision(17) << showpoint << 0.1;
+	ASSERT(Format(0.1, 17, true) == oss.str());
+}
+
+static void TestParseFloat() {
+	cout << "Testing float parsing\n";
+	srand(7);
+	char buf[64];
+	for (unsigned i = 0; i < 100000; ++i) {
+		double v = RandomDouble();
+		if (v != v || v - v != 0) { continue; }
+		int len = snprintf(buf, sizeof(buf), (i & 1) ? "%.17g" : "%.6g", v);
+		double expected = strtod(buf, 0);
+		double parsed = 0;
+		ASSERT(ParseFloat(buf, buf + len, parsed) == NUMBER_OK);
+		ASSERT(parsed == expected);
+		long double lparsed = 0;
+		ASSERT(ParseFloat(buf, buf + len, lparsed) == NUMBER_OK);
+		ASSERT(lparsed == strtold(buf, 0));
+	}
+	const char *text = "1.5e";
+	const char *end = 0;
+	double v = 0;
+	ASSERT(ParseFloat(text, text + strlen(text), v, &end) == NUMBER_OK);
+	ASSERT(v == 1.5 && end == text + 3);
+	text = "+.25";
+	ASSERT(ParseFloat(text, text + strlen(text), v) == NUMBER_OK && v == 0.25);
+	text = ".e5";
+	ASSERT(ParseFloat(text, text + strlen(text), v) == NUMBER_INVALID);
+	text = "nan";
+	ASSERT(ParseFloat(text, text + strlen(text), v) == NUMBER_INVALID);
+	text = "1e400";
+	ASSERT(ParseFloat(text, text + strlen(text), v) == NUMBER_RANGE);
+	ASSERT(v == numeric_limits<double>::infinity());
+	text = "-1e-400";
+	ASSERT(ParseFloat(text, text + strlen(text), v) == NUMBER_RANGE);
+	ASSERT(v == 0);
+}
+
+static void TestLocale() {
+	cout << "Testing independence from the locale\n";
+	const char *locales[] = { "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "C.UTF-8" };
+	for (unsigned i = 0; i < sizeof(locales) / sizeof(locales[0]); ++i) {
+		if (!setlocale(LC_ALL, locales[i])) { continue; }
+		ASSERT(Format(1.5, 6, false) == "1.5");
+		double v = 0;
+		const char *text = "2.75";
+		ASSERT(ParseFloat(text, text + 4, v) == NUMBER_OK && v == 2.75);
+		ASSERT(Variant("  3.5xyz").AsDouble() == 3.5);
+		ASSERT(Variant(0.25).AsString() == "0.25");
+	}
+	setlocale(LC_ALL, "C");
+}
+
+static void TestVariant() {
+	cout << "Testing Variant conversions\n";
+	ASSERT(Variant(" 42").AsInt() == 42);
+	ASSERT(Variant("-7 apples").AsInt() == -7);
+	ASSERT(Variant("12").AsUnsigned() == 12u);
+	ASSERT(Variant("1e3").AsDouble() == 1000.0);
+	ASSERT(Variant(-3).AsString() == "-3");
+	ASSERT(Variant(1.0 / 3).AsString() == "0.333333");
+	ASSERT(Variant(1e20).AsString() == "1e+20");
+	const char *bad[] = { "", "abc", "-", "99999999999999999999" };
+	for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+		bool threw = false;
+		try {
+			Variant(bad[i]).AsInt();
+		} catch (const UnableToConvertError &) {
+			threw = true;
+		}
+		ASSERT(threw);
+	}
+	ASSERT(Variant().SetPath("a[ 2]", 1).GetPath("a").Size() == 3);
+	ASSERT(Serialize(Variant(0.5), SERIALIZE_JSON) == "0.50000000000000000");
+#ifdef ENABLE_YAML
+	// Through GuessScalar
+	ASSERT(Deserialize("x: 0x1f\ny: -12\nz: 2.5e1\nw: 18446744073709551615", SERIALIZE_YAML)
+			== Variant().Set("x", 31).Set("y", -12).Set("z", 25.0).Set("w", numeric_limits<uintmax_t>::max()));
+#endif
+}
+
+int main(int argc, char **argv) {
+	try {
+		TestIntegers();
+		TestFormatFloat();
+		TestParseFloat();
+		TestLocale();
+		TestVariant();
+	} catch (const std::exception &e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -8,6 +8,8 @@
 #include <Variant/Path.h>
 #include <iostream>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 using namespace libvariant;
 using namespace std;
@@ -208,9 +210,104 @@ void TestTwo() {
 	} catch (const std::runtime_error &) {}
 }
 
+void TestCompiled() {
+	Variant v;
+	v.SetPath("/a/b[1]/c", 1).SetPath("/a/d", "x");
+	CompiledPath c("/a/b[1]/c");
+	ASSERT(c.size() == 4 && c[0].AsString() == "a" && c[2].AsUnsigned() == 1);
+	ASSERT(c == CompiledPath(ParsePath("a/b[1]/c/")));
+	ASSERT(c != CompiledPath("/a/b[1]/d") && c != CompiledPath("/a/b"));
+	ASSERT(CompiledPath("/").empty() && CompiledPath() == CompiledPath(""));
+	ASSERT(PathString(c) == "/a/b[1]/c");
+	ASSERT(PathString(CompiledPath()) == "/");
+
+	ASSERT(v.GetPath(c) == 1 && v.HasPath(c));
+	ASSERT(v.AtPath(CompiledPath("a/d")) == "x");
+	ASSERT(v.GetPath(CompiledPath("/a/e"), 5) == 5 && !v.HasPath(CompiledPath("/a/e")));
+	CompiledPath e("/a/e/f");
+	v.SetPath(e, true);
+	ASSERT(v.GetPath(e).IsTrue());
+	v.ErasePath(e, true);
+	ASSERT(!v.HasPath("/a/e"));
+	int i = 0;
+	v.GetPathInto(i, c);
+	ASSERT(i == 1);
+
+	// A proxy for a path that does not exist yet
+	VariantRef r = v.AtPath(CompiledPath("/g/h"));
+	ASSERT(!v.HasPath("/g"));
+	r = 2;
+	ASSERT(v.GetPath("/g/h") == 2);
+	VariantRef q(v, CompiledPath("/a/d"));
+	ASSERT(q == "x");
+
+	// The cache gives the same elements back
+	ASSERT(CompilePath("/a/b[1]/c") == c);
+	ASSERT(CompilePath("/a/b[1]/c").begin() == CompilePath("/a/b[1]/c").begin());
+	for (unsigned n = 0; n < 2000; ++n) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "/k%u[%u]", n, n);
+		ASSERT(CompilePath(buf)[1].AsUnsigned() == n);
+	}
+	ASSERT(v.GetPath("/a/b[1]/c") == 1);
+}
+
+#if __cplusplus >= 201402L
+void TestStatic() {
+	static constexpr auto c = VARIANT_PATH("/a/b[1]/c");
+	static constexpr auto escaped = VARIANT_PATH("/x\\/y/\\[z\\][ 12]");
+	static constexpr auto root = VARIANT_PATH("/");
+	static_assert(c.size() == 4 && escaped.size() == 3 && root.size() == 0, "static path sizes");
+	ASSERT(PathString(c) == "/a/b[1]/c");
+	ASSERT(PathString(escaped) == "/x\\/y/\\[z\\][12]");
+	ASSERT(PathString(root) == "/");
+	ASSERT(CompiledPath(PathString(escaped)) == CompiledPath("/x\\/y/\\[z\\][12]"));
+	StaticPathView view = c;
+	ASSERT(view.begin()->AsString() == "a" && (view.begin() + 2)->AsUnsigned() == 1);
+	ASSERT((view.begin() + 1)->KeyHash() == CompiledPath("b")[0].KeyHash());
+
+	Variant v;
+	v.SetPath(c, 1).SetPath(VARIANT_PATH("a/d"), "x");
+	ASSERT(v.GetPath("/a/b[1]/c") == 1);
+	ASSERT(v.GetPath(c) == 1 && v.HasPath(c) && v.AtPath(c) == 1);
+	ASSERT(v.GetPath(VARIANT_PATH("/a/d")) == "x");
+	ASSERT(v.GetPath(VARIANT_PATH("/a/e"), 5) == 5 && !v.HasPath(VARIANT_PATH("/a/e")));
+	ASSERT(v.GetPath(root) == v);
+	v.SetPath(escaped, 3);
+	ASSERT(v.GetPath(CompiledPath("/x\\/y/\\[z\\][12]")) == 3);
+	v.ErasePath(escaped, true);
+	ASSERT(!v.HasPath(escaped) && v.HasPath(VARIANT_PATH("/x\\/y/\\[z\\]")));
+	try {
+		v.GetPath(VARIANT_PATH("/a/nope"));
+		ASSERT(false);
+	} catch (const KeyError &) {}
+
+	// A map too big to be kept small
+	for (unsigned n = 0; n < 100; ++n) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "/big/k%u", n);
+		v.SetPath(buf, n);
+	}
+	ASSERT(v.GetPath(VARIANT_PATH("/big/k42")) == 42 && !v.HasPath(VARIANT_PATH("/big/k100")));
+
+	// The checks that fail compilation for a malformed literal
+	const char *bad[] = { "/a[x]", "/a[1", "/a\\", "[99999999999]", "[]" };
+	for (unsigned n = 0; n < sizeof(bad) / sizeof(bad[0]); ++n) {
+		try {
+			Internal::ParseStaticPath(bad[n], strlen(bad[n]), false, 0, 0);
+			ASSERT(false);
+		} catch (const BadPathError &) {}
+	}
+}
+#endif
+
 int main(int argc, char **argv) {
 	TestOne();
 	TestTwo();
+	TestCompiled();
+#if __cplusplus >= 201402L
+	TestStatic();
+#endif
 
 	Variant v;
 	Variant b = v.AtPath("abc/123", Variant::MapType);
@@ -106,6 +106,16 @@ void TestEmit() {
 	params.Set("payload_length", 5);
 	SerializeWithPayload(cout.rdbuf(), v, SERIALIZE_JSON, params);
 	cout << "\n\n";
+
+	// Settings of the wrong type are errors, not defaults
+	params.Set("ignore_payload", Variant::MapType);
+	bool thrown = false;
+	try {
+		SerializeWithPayload(cout.rdbuf(), v, SERIALIZE_JSON, params);
+	} catch (const std::exception &) {
+		thrown = true;
+	}
+	ASSERT(thrown);
 }
 
 int main(int argc, char **argv) {
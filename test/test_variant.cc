@@ -21,6 +21,7 @@
 #include <Variant/Variant.h>
 #include <Variant/Emitter.h>
 #include <Variant/Parser.h>
+#include <Variant/Visit.h>
 #include "TestCommon.h"
 #include "TestAssert.h"
 #include <iostream>
@@ -28,6 +29,10 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <limits>
+#include <set>
+#if __cplusplus >= 201103L
+#include <thread>
+#endif
 
 using namespace libvariant;
 using namespace std;
@@ -353,6 +358,818 @@ void TestCopy() {
 	ASSERT(v1 != v2);
 }
 
+void TestStrings() {
+	cout << "Testing short and long strings\n";
+	for (unsigned len = 0; len < 40; ++len) {
+		std::string str(len, 'a');
+		if (len > 0) { str[len - 1] = 'z'; }
+		Variant v = str;
+		ASSERT(v.IsString());
+		ASSERT(v.Size() == len);
+		ASSERT(v.Empty() == (len == 0));
+		ASSERT(v.AsString() == str);
+		Variant copy = v.Copy();
+		ASSERT(copy == v);
+		Variant shared = v;
+		ASSERT(shared.AsString() == str);
+		v = v;
+		ASSERT(v.AsString() == str);
+		Variant longer = str + "a";
+		ASSERT(v < longer);
+		ASSERT(longer > v);
+		v.Clear();
+		ASSERT(v.IsString() && v.Empty());
+	}
+	Variant embedded = std::string("a\0b", 3);
+	ASSERT(embedded.Size() == 3);
+	ASSERT(embedded.AsString() == std::string("a\0b", 3));
+	ASSERT(embedded != "a");
+	Variant num = "12345";
+	ASSERT(num.AsInt() == 12345);
+	ASSERT(Variant("true").AsBool());
+}
+
+void TestSnapshot() {
+	cout << "Testing Snapshot\n";
+	Variant v1;
+	v1.SetPath("a/b", 1);
+	v1.SetPath("a/c", "two");
+	v1.SetPath("list[0]/x", 3);
+	Variant alias = v1;
+	Variant snap = v1.Snapshot();
+	ASSERT(snap == v1);
+	v1.SetPath("a/b", 10);
+	ASSERT(v1.GetPath("a/b") == 10);
+	ASSERT(snap.GetPath("a/b") == 1);
+	// Variants already sharing the tree become copies as well
+	ASSERT(alias.GetPath("a/b") == 1);
+	snap.SetPath("list[0]/x", 30);
+	ASSERT(v1.GetPath("list[0]/x") == 3);
+	ASSERT(snap.GetPath("list[0]/x") == 30);
+	// Elements read out of a snapshotted tree are copy on write as well
+	const Variant &cv1 = v1;
+	Variant elem = cv1.Get("a");
+	elem.Set("d", 4);
+	ASSERT(!v1.HasPath("a/d"));
+	ASSERT(!snap.HasPath("a/d"));
+	// Containers added after a snapshot are covered by the next one
+	v1.Set("m", Variant().Set("k", 1));
+	Variant snap2 = v1.Snapshot();
+	v1.AsMap()["m"].Set("k", 2);
+	v1["list"].AsList().push_back(5);
+	ASSERT(snap2.GetPath("m/k") == 1);
+	ASSERT(v1.GetPath("m/k") == 2);
+	ASSERT(snap2.Get("list").Size() == 1);
+	ASSERT(v1.Get("list").Size() == 2);
+	ASSERT(snap.GetPath("a/b") == 1);
+}
+
+static void CollectKey(const std::string *key, const Variant &, void *ctx) {
+	static_cast<std::vector<std::string>*>(ctx)->push_back(*key);
+}
+
+void TestSmallContainers() {
+	cout << "Testing small lists and maps\n";
+	Variant list;
+	for (int i = 0; i < 10; ++i) {
+		list.Append(i);
+		ASSERT(list.Size() == unsigned(i + 1));
+		for (int j = 0; j <= i; ++j) { ASSERT(list.Get(j) == j); }
+	}
+	Variant map;
+	VariantRef last = map["k9"];
+	last = 9;
+	for (int i = 0; i < 20; ++i) {
+		std::ostringstream oss;
+		oss << "k" << (19 - i) % 10 << i;
+		map.Set(oss.str(), i);
+		ASSERT(map.Size() == unsigned(i + 2));
+		ASSERT(map.Get(oss.str()) == i);
+		// References follow entries shifted by inserts and the upgrade
+		ASSERT(last == 9);
+	}
+	last = 10;
+	ASSERT(map.Get("k9") == 10);
+	std::vector<std::string> keys;
+	map.ForEach(CollectKey, &keys);
+	ASSERT(keys.size() == map.Size());
+	for (unsigned i = 1; i < keys.size(); ++i) { ASSERT(keys[i - 1] < keys[i]); }
+
+	// Growing a map that is shared, or that a snapshot was taken of
+	Variant full;
+	for (int i = 0; i < 8; ++i) { full.Set(std::string(1, char('a' + i)), i); }
+	Variant alias = full;
+	VariantRef first = full["a"];
+	full.Set("z", 25);
+	ASSERT(alias.Size() == 9 && alias.Get("z") == 25);
+	first = 26;
+	ASSERT(alias.Get("a") == 26);
+	full.Erase("z");
+	Variant snap = full.Snapshot();
+	full.Set("y", 24);
+	ASSERT(full.Size() == 9 && snap.Size() == 8 && !snap.Contains("y"));
+	snap.Set("x", 23);
+	ASSERT(snap.Size() == 9 && !full.Contains("x") && snap.Get("a") == 26);
+	Variant grown = snap.Copy();
+	grown.Erase("x");
+	grown.Set("w", 22);
+	ASSERT(grown.Size() == 9 && grown.Get("w") == 22 && !snap.Contains("w"));
+	ASSERT(grown.AsMap().size() == 9);
+
+	Variant small;
+	small.Set("c", 3).Set("a", 1).Set("b", 2);
+	VariantRef c = small["c"];
+	small.Erase("a");
+	ASSERT(small.Size() == 2 && !small.Contains("a"));
+	ASSERT(c == 3);
+	ASSERT(Serialize(small, SERIALIZE_JSON) == "{\"b\": 2,\"c\": 3}");
+	Variant other;
+	other.Set("b", 2).Set("c", 3);
+	ASSERT(small == other);
+	other.Set("c", 4);
+	ASSERT(small != other);
+	// A const view of a small map stays valid through later writes
+	const Variant::Map &view = static_cast<const Variant&>(small).AsMap();
+	ASSERT(view.size() == 2);
+	small.Set("d", 4);
+	ASSERT(view.size() == 3);
+	ASSERT(view.find("d")->second == 4);
+	small.Clear();
+	ASSERT(small.IsMap() && small.Empty());
+
+	// Writes through pointers and references taken before a const view
+	// show in it
+	Variant m;
+	m.Set("a", 1).Set("b", 2);
+	const Variant &cm = m;
+	Variant *pa = m.Find("a");
+	VariantRef rb = m["b"];
+	const Variant::Map &mview = cm.AsMap();
+	*pa = 9;
+	rb = 8;
+	ASSERT(mview.find("a")->second == 9 && cm.Get("a") == 9);
+	ASSERT(mview.find("b")->second == 8);
+	ASSERT(SerializeJSON(m) == "{\"a\": 9,\"b\": 8}");
+	Variant copied = mview.find("a")->second;
+	*pa = 7;
+	ASSERT(copied == 9 && mview.find("a")->second == 7);
+	m.Set("c", 3);
+	ASSERT(mview.size() == 3 && mview.find("a")->second == 7 && rb == 8);
+
+	Variant l;
+	l.Append(1).Append(2);
+	const Variant &cl = l;
+	Variant *p0 = l.Find(0);
+	VariantRef r1 = l.At(1);
+	const Variant::List &lview = cl.AsList();
+	*p0 = 9;
+	r1 = 8;
+	ASSERT(lview[0] == 9 && lview[1] == 8 && cl.Get(0) == 9);
+	ASSERT(SerializeJSON(l) == "[9,8]");
+	l.Append(3);
+	ASSERT(lview.size() == 3 && lview[0] == 9 && lview[1] == 8);
+}
+
+void TestInternKeys() {
+	cout << "Testing interned map keys\n";
+	const char *doc = "{\"a_rather_long_key_name\": 1, \"another_long_key_name\": [2, 3], \"k\": \"v\"}";
+	Variant plain = Deserialize(doc, SERIALIZE_JSON);
+	Variant::InternKeys(true);
+	ASSERT(Variant::InternKeys());
+	Variant v1 = Deserialize(doc, SERIALIZE_JSON);
+	Variant v2 = Deserialize(doc, SERIALIZE_JSON);
+	ASSERT(v1 == v2);
+	ASSERT(v1 == plain);
+	ASSERT(v1.Get("a_rather_long_key_name") == 1);
+	ASSERT(Serialize(v1, SERIALIZE_JSON) == Serialize(plain, SERIALIZE_JSON));
+	Variant copy = v1.Copy();
+	copy.Set("another_long_key_name", 4);
+	ASSERT(copy != v1);
+	copy.Erase("a_rather_long_key_name");
+	ASSERT(copy.Size() == 2 && !copy.Contains("a_rather_long_key_name"));
+	for (int i = 0; i < 10; ++i) {
+		std::ostringstream oss;
+		oss << "an_interned_key_" << i;
+		v1.Set(oss.str(), i);
+	}
+	ASSERT(v1.Size() == 13);
+	ASSERT(v1.Get("an_interned_key_9") == 9);
+	ASSERT(v1.AsMap().count("a_rather_long_key_name") == 1);
+	Variant::InternKeys(false);
+}
+
+void TestMove() {
+#if __cplusplus >= 201103L
+	cout << "Testing move\n";
+	Variant v1;
+	v1.SetPath("a/b", "a string too long to be stored inline");
+	Variant v2(std::move(v1));
+	ASSERT(v1.IsNull());
+	ASSERT(v2.GetPath("a/b") == "a string too long to be stored inline");
+	v1 = std::move(v2);
+	ASSERT(v2.IsNull());
+	ASSERT(v1.GetPath("a/b") == "a string too long to be stored inline");
+	// Moving into a reference assigns to what it refers to
+	VariantRef ref = v1["a"]["b"];
+	Variant str = "short";
+	ref = std::move(str);
+	ASSERT(v1.GetPath("a/b") == "short");
+	// Something referred to is shared instead of moved
+	Variant target = 5;
+	VariantRef target_ref = target.Ref();
+	Variant moved(std::move(target));
+	ASSERT(moved == 5);
+	ASSERT(target_ref == 5);
+	// Moving an element out of the container it replaces
+	Variant list;
+	list.Append(Variant().Append(1).Append(2));
+	list = std::move(list.AsList()[0]);
+	ASSERT(list.Size() == 2 && list.Get(1) == 2);
+	list.Append(Variant().Set("k", 3));
+	ASSERT(list.GetPath("[2]/k") == 3);
+#endif
+}
+
+void TestHash() {
+	cout << "Testing hashing\n";
+	// Numbers that compare equal hash the same
+	ASSERT(Variant(1).Hash() == Variant(1u).Hash());
+	ASSERT(Variant(1).Hash() == Variant(1.0).Hash());
+	ASSERT(Variant(-0.0).Hash() == Variant(0).Hash());
+	ASSERT(Variant(0.5).Hash() == Variant(0.5f).Hash());
+	ASSERT(Variant(1).Hash() != Variant("1").Hash());
+	ASSERT(Variant("a string too long to be stored inline").Hash()
+			== Variant(std::string("a string too long to be stored inline")).Hash());
+	ASSERT(Variant().Hash() == Variant(Variant::NullType).Hash());
+	ASSERT(Variant(true).Hash() != Variant(false).Hash());
+
+	// Maps hash the same whatever order the keys were added in, small or not
+	Variant m1, m2;
+	for (int i = 0; i < 20; ++i) {
+		std::ostringstream k1, k2;
+		k1 << "key" << i;
+		k2 << "key" << (19 - i);
+		m1.Set(k1.str(), i);
+		m2.Set(k2.str(), 19 - i);
+		ASSERT(m1.Size() != m2.Size() || (m1 == m2) == (i == 19));
+	}
+	ASSERT(m1 == m2);
+	ASSERT(m1.Hash() == m2.Hash());
+	Variant small;
+	small.Set("b", 2).Set("a", 1.0);
+	Variant large;
+	large.Set("a", 1).Set("b", 2u);
+	large.AsMap();
+	ASSERT(small == large);
+	ASSERT(small.Hash() == large.Hash());
+	Variant list;
+	list.Append(1).Append(2);
+	Variant reversed;
+	reversed.Append(2).Append(1);
+	ASSERT(list.Hash() != reversed.Hash());
+
+	// The cached hash of a snapshot goes away when it is written to
+	Variant doc;
+	doc.SetPath("a/b", 1);
+	doc.SetPath("a/c", Variant().Append("x"));
+	Variant snap = doc.Snapshot();
+	size_t hash = doc.Hash();
+	ASSERT(snap.Hash() == hash);
+	doc.SetPath("a/c[0]", "y");
+	ASSERT(doc.Hash() != hash);
+	ASSERT(snap.Hash() == hash);
+	ASSERT(doc != snap);
+	snap = Variant();
+	VariantRef c = doc["a"]["c"];
+	c.Append("z");
+	ASSERT(doc.GetPath("a/c").Size() == 2);
+	size_t hash2 = doc.Hash();
+	ASSERT(hash2 != hash);
+	doc.Snapshot();
+	ASSERT(doc.Hash() == hash2);
+	doc["a"].Set("d", 4);
+	ASSERT(doc.Hash() != hash2);
+
+	// Nor does it miss writes through references and pointers from before
+	// the snapshot
+	Variant v;
+	v.SetPath("a/b", 1).SetPath("l[1]", 2).SetPath("c/d", 3);
+	VariantRef b = v["a"]["b"];
+	Variant *l1 = v.Find("l")->Find(1u);
+	Variant shared_c = v.Get("c");
+	Variant *d = shared_c.Find("d");
+	v.Snapshot();
+	v.Hash();
+	b = 5;
+	Variant w;
+	w.SetPath("a/b", 5).SetPath("l[1]", 2).SetPath("c/d", 3);
+	ASSERT(v == w && v.Hash() == w.Hash());
+	*l1 = 7;
+	w.SetPath("l[1]", 7);
+	ASSERT(v == w && v.Hash() == w.Hash());
+	*d = 9;
+	w.SetPath("c/d", 9);
+	ASSERT(v == w && v.Hash() == w.Hash());
+
+	// Blobs equal up to the shorter length are not equal
+	Variant b1 = Blob::CreateCopy("abc", 3);
+	Variant b2 = Blob::CreateCopy("ab", 2);
+	ASSERT(b1 != b2);
+	ASSERT(b1 == Variant(Blob::CreateCopy("abc", 3)));
+	ASSERT(b1.Hash() == Variant(Blob::CreateCopy("abc", 3)).Hash());
+}
+
+void TestOrdering() {
+	cout << "Testing ordering\n";
+	// Across types by rank, numbers by value
+	Variant list;
+	list.Append(Blob::CreateCopy("b", 1)).Append(Variant().Set("a", 1)).Append(Variant().Append(1))
+		.Append("s").Append(2.5).Append(1u).Append(false).Append(Variant()).Append(true).Append(-3);
+	list.Sort();
+	ASSERT(list.Get(0).IsNull());
+	ASSERT(list.Get(1) == false && list.Get(2) == true);
+	ASSERT(list.Get(3) == -3 && list.Get(4) == 1 && list.Get(5) == 2.5);
+	ASSERT(list.Get(6) == "s");
+	ASSERT(list.Get(7).IsList() && list.Get(8).IsMap() && list.Get(9).IsBlob());
+	for (unsigned i = 1; i < list.Size(); ++i) {
+		ASSERT(list.Get(i - 1) < list.Get(i));
+		ASSERT(list.Get(i) > list.Get(i - 1));
+	}
+
+	// Lists and maps are lexicographic
+	Variant l1, l2, l3;
+	l1.Append(1).Append(2);
+	l2.Append(1).Append(2).Append(0);
+	l3.Append(1).Append(3);
+	ASSERT(l1 < l2 && l2 < l3 && l1 < l3);
+	ASSERT(l1.Compare(l1.Copy()) == 0);
+	Variant m1, m2, m3;
+	m1.Set("a", 1).Set("b", 2);
+	m2.Set("a", 1).Set("c", 0);
+	m3.Set("a", 2);
+	ASSERT(m1 < m2 && m2 < m3 && m1 < m3);
+	Variant large;
+	for (int i = 0; i < 20; ++i) {
+		std::ostringstream oss;
+		oss << "k" << i;
+		large.Set(oss.str(), i);
+	}
+	Variant larger = large.Copy();
+	larger.Set("k9", 10);
+	ASSERT(large < larger && larger > large);
+	ASSERT(large == large.Copy());
+	ASSERT(large > m1);
+
+	// NaN equals only NaN
+	Variant nan = std::numeric_limits<double>::quiet_NaN();
+	ASSERT(nan == Variant(std::numeric_limits<double>::quiet_NaN()));
+	ASSERT(nan != 0 && nan < -1e300);
+	ASSERT(nan.Hash() == Variant(std::numeric_limits<double>::quiet_NaN()).Hash());
+
+	// Usable as keys of ordered containers
+	std::set<Variant> set;
+	set.insert(l1);
+	set.insert(l1.Copy());
+	set.insert(m1);
+	set.insert(1);
+	set.insert(1.0);
+	ASSERT(set.size() == 3);
+	ASSERT(set.count(Variant().Append(1).Append(2)) == 1);
+
+	// Stable sort keeps equal numbers in order
+	Variant nums;
+	nums.Append(2).Append(1u).Append(1.0).Append(1).Append(0);
+	nums.StableSort();
+	ASSERT(nums.Get(0) == 0);
+	ASSERT(nums.Get(1).IsUnsigned() && nums.Get(2).IsFloat() && nums.Get(3).IsInt());
+	ASSERT(nums.Get(4) == 2);
+	ASSERT(std::binary_search(nums.ListBegin(), nums.ListEnd(), Variant(2)));
+}
+
+void TestPacked() {
+	cout << "Testing packed lists\n";
+	Variant::Type_t type;
+	unsigned size;
+	Variant floats = DeserializeJSON("[1.5, 2.5, 3.5, 4.5, 5.5, 6.5]");
+	ASSERT(floats.PackedData(type, size) != 0);
+	ASSERT(type == Variant::FloatType && size == 6);
+	ASSERT(floats.IsList() && floats.Size() == 6 && floats[2] == 3.5 && floats[2].IsFloat());
+	ASSERT(SerializeJSON(floats) == "[1.5000000000000000,2.5000000000000000,3.5000000000000000,"
+			"4.5000000000000000,5.5000000000000000,6.5000000000000000]");
+	std::vector<double> dv = variant_cast< std::vector<double> >(floats);
+	ASSERT(dv.size() == 6 && dv[5] == 6.5);
+	std::vector<int> iv = variant_cast< std::vector<int> >(floats);
+	ASSERT(iv.size() == 6 && iv[0] == 1);
+
+	// Mixed types or small lists are not packed
+	ASSERT(DeserializeJSON("[1, 2, 3, 4, 5, 6.5]").PackedData(type, size) == 0);
+	ASSERT(DeserializeJSON("[1, 2, 3]").PackedData(type, size) == 0);
+	Variant ints = DeserializeJSON("[1, -2, 3, 4, 5, 6, \"x\"]");
+	ASSERT(ints.PackedData(type, size) == 0);
+	ASSERT(ints.Size() == 7 && ints[1] == -2 && ints[6] == "x");
+
+	// Same as an unpacked list
+	Variant plain;
+	for (unsigned i = 0; i < 6; ++i) { plain.Append(1.5 + i); }
+	ASSERT(plain.PackedData(type, size) == 0);
+	ASSERT(plain == floats && plain.Hash() == floats.Hash());
+	ASSERT(floats.Index(4.5) == 3);
+	ASSERT(floats.AsList().size() == 6);
+
+	// Written to through a shared reference
+	std::vector<intmax_t> numbers;
+	for (intmax_t i = 0; i < 10; ++i) { numbers.push_back(i * i); }
+	Variant packed = numbers;
+	ASSERT(packed.PackedData(type, size) != 0 && type == Variant::IntegerType);
+	Variant shared = packed;
+	Variant copy = packed.Copy();
+	shared[3] = "nine";
+	ASSERT(packed.PackedData(type, size) == 0);
+	ASSERT(packed[3] == "nine" && packed[4] == 16);
+	ASSERT(copy.Get(3) == 9);
+	packed.Append(100);
+	ASSERT(packed.Size() == 11 && shared.Size() == 11);
+	Variant snapshot = copy.Snapshot();
+	copy[3] = 0;
+
+	// Const access keeps it packed
+	const Variant &cpacked = snapshot;
+	ASSERT(cpacked[3] == 9);
+	ASSERT(cpacked.At(9) == 81 && cpacked.Get(0) == 0);
+	ASSERT(cpacked.PackedData(type, size) != 0);
+	ASSERT(variant_cast< std::vector<uintmax_t> >(cpacked)[2] == 4u);
+}
+
+void TestLazy() {
+	cout << "Testing lazy JSON\n";
+	const char *text = "{\"a\": {\"x\" : [1, 2 ], \"y\": \"]}\\\"\"}, \"b\": [ 3 ,4], \"c\": 5 /* [ */}";
+	Variant doc = DeserializeLazy(text);
+	ASSERT(doc.IsMap() && doc.Size() == 3 && doc["c"] == 5);
+	// Untouched containers are copied as they were
+	ASSERT(SerializeJSON(doc) == "{\"a\": {\"x\" : [1, 2 ], \"y\": \"]}\\\"\"},\"b\": [ 3 ,4],\"c\": 5}");
+	ASSERT(DeserializeLazy(text) == DeserializeJSON(text));
+	ASSERT(DeserializeLazy(text).Hash() == DeserializeJSON(text).Hash());
+
+	Variant shared = doc["a"];
+	Variant copy = doc.Copy();
+	ASSERT(doc["a"]["y"] == "]}\"");
+	ASSERT(SerializeJSON(doc) == "{\"a\": {\"x\": [1, 2 ],\"y\": \"]}\\\"\"},\"b\": [ 3 ,4],\"c\": 5}");
+	shared["x"].Append(3);
+	ASSERT(doc.GetPath("a/x").Size() == 3 && doc.GetPath("a/x[2]") == 3);
+	ASSERT(SerializeJSON(copy) == "{\"a\": {\"x\" : [1, 2 ], \"y\": \"]}\\\"\"},\"b\": [ 3 ,4],\"c\": 5}");
+	ASSERT(copy.GetPath("a/x").Size() == 2);
+
+	// A snapshot does not see later writes
+	Variant snapshot = copy.Snapshot();
+	copy["b"][0] = 30;
+	ASSERT(snapshot.GetPath("b[0]") == 3 && copy.GetPath("b[0]") == 30);
+
+	// Same as a regular parse once everything is looked at
+	Variant deep = DeserializeLazy("[[1, [2, [3, {\"k\": [4.5, 5.5, 6.5, 7.5, 8.5]}]]], []]");
+	ASSERT(deep == DeserializeJSON("[[1, [2, [3, {\"k\": [4.5, 5.5, 6.5, 7.5, 8.5]}]]], []]"));
+	ASSERT(deep.GetPath("[0][1][1][1]/k[4]") == 8.5 && deep[1].Empty());
+
+	// Errors inside are found when the container is parsed
+	Variant bad = DeserializeLazy("{\"ok\": 1, \"bad\": [1, , 2]}");
+	ASSERT(bad["ok"] == 1);
+	bool thrown = false;
+	try { bad["bad"].Size(); } catch (const std::exception &) { thrown = true; }
+	ASSERT(thrown);
+
+#if __cplusplus >= 201103L
+	// Threads may read one document while it is parsed
+	std::string array = "[";
+	for (unsigned i = 0; i < 50; ++i) {
+		array += (i ? ", " : "");
+		array += "{\"a\": [1, [2, {\"b\": [3]}]], \"c\": {\"d\": [4, 5]}}";
+	}
+	array += "]";
+	Variant expected = DeserializeJSON(array);
+	for (unsigned round = 0; round < 20; ++round) {
+		const Variant shared_doc = DeserializeLazy(array);
+		std::string serialized;
+		Variant copied;
+		std::thread emit([&]() { serialized = SerializeJSON(shared_doc); });
+		std::thread copy([&]() { copied = shared_doc.Copy(); });
+		ASSERT(shared_doc == expected);
+		emit.join();
+		copy.join();
+		ASSERT(DeserializeJSON(serialized) == expected && copied == expected);
+	}
+#endif
+}
+
+/// Writes each call as a short token
+struct TraceVisitor : public VariantVisitor {
+	TraceVisitor() : skip_lists(false) {}
+	void Null() { oss << "n "; }
+	void Bool(bool b) { oss << (b ? "t " : "f "); }
+	void Int(intmax_t i) { oss << "i" << i << " "; }
+	void Unsigned(uintmax_t u) { oss << "u" << u << " "; }
+	void Float(double f) { oss << "d" << f << " "; }
+	void String(const char *s, size_t len) { oss << "s" << string(s, len) << " "; }
+	void Blob(ConstBlobPtr b) { oss << "b" << b->GetTotalLength() << " "; }
+	bool BeginList(const Variant &list) {
+		oss << "[" << list.Size() << " ";
+		return !skip_lists;
+	}
+	void EndList() { oss << "] "; }
+	bool BeginMap(const Variant &map) { oss << "{ "; return true; }
+	void Key(const char *s, size_t len) { oss << string(s, len) << ": "; }
+	void EndMap() { oss << "} "; }
+	bool skip_lists;
+	ostringstream oss;
+};
+
+void TestVisit() {
+	cout << "Testing Visit\n";
+	Variant v;
+	v["b"] = true;
+	v["a"].Append(Variant()).Append(-1).Append(2u).Append("short").Append(string(40, 'x'));
+	v["c"] = DeserializeJSON("[1.5, 2.5, 3.5, 4.5, 5.5]");
+	TraceVisitor trace;
+	Visit(trace, v);
+	ASSERT(trace.oss.str() == "{ a: [5 n i-1 u2 sshort s" + string(40, 'x') + " ] b: t c: [5 d1.5 d2.5 d3.5 d4.5 d5.5 ] } ");
+
+	TraceVisitor skip;
+	skip.skip_lists = true;
+	Visit(skip, v);
+	ASSERT(skip.oss.str() == "{ a: [5 b: t c: [5 } ");
+
+	// Big maps in key order, references and proxies to what they refer to
+	Variant big;
+	ostringstream expected;
+	expected << "{ ";
+	for (unsigned i = 10; i < 30; ++i) {
+		ostringstream key;
+		key << "k" << i;
+		big[key.str()] = i;
+		expected << key.str() << ": u" << i << " ";
+	}
+	expected << "} ";
+	TraceVisitor big_trace;
+	Visit(big_trace, VariantRef(big));
+	ASSERT(big_trace.oss.str() == expected.str());
+	TraceVisitor ref_trace;
+	Visit(ref_trace, v.AtPath("a[1]"));
+	ASSERT(ref_trace.oss.str() == "i-1 ");
+
+	// Lazy documents are visited like parsed ones
+	TraceVisitor lazy_trace;
+	Visit(lazy_trace, DeserializeLazy("{\"x\": [1, {\"y\": null}]}"));
+	ASSERT(lazy_trace.oss.str() == "{ x: [2 u1 { y: n } ] } ");
+}
+
+void TestTypes() {
+	cout << "Testing type checks\n";
+	Variant values[] = { Variant(), true, -1, 1u, 1.5, (long double)1.5, "short",
+		std::string(40, 'x'), Variant::ListType, Variant::MapType, Blob::CreateCopy("ab", 2) };
+	Variant::Type_t types[] = { Variant::NullType, Variant::BoolType, Variant::IntegerType,
+		Variant::UnsignedType, Variant::FloatType, Variant::FloatType, Variant::StringType,
+		Variant::StringType, Variant::ListType, Variant::MapType, Variant::BlobType };
+	Variant list = Variant::ListType;
+	for (unsigned i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+		ASSERT(values[i].GetType() == types[i]);
+		ASSERT(values[i].IsNumber() == (types[i] == Variant::IntegerType
+					|| types[i] == Variant::UnsignedType || types[i] == Variant::FloatType));
+		list.Append(values[i]);
+		// References and proxies have the type of what they refer to
+		ASSERT(VariantRef(values[i]).GetType() == types[i]);
+		ASSERT(list.AtPath(Path(1, i)).GetType() == types[i]);
+	}
+	ASSERT(Variant(true).IsTrue() && Variant(false).IsFalse() && !Variant(1).IsTrue());
+	ASSERT(VariantRef(list).At(1).IsTrue() && !Variant("true").IsTrue());
+}
+
+void TestFind() {
+	cout << "Testing Find\n";
+	Variant v;
+	v.SetPath("a/b", 1).SetPath("a/c[1]", "x");
+	const Variant &cv = v;
+	ASSERT(cv.Find("a") && cv.Find("a")->IsMap());
+	ASSERT(!cv.Find("missing") && !v.Find("missing"));
+	// A miss must not add the key
+	ASSERT(!v.Contains("missing") && v["a"].Size() == 2);
+	ASSERT(cv.FindPath("a/b") && *cv.FindPath("a/b") == 1);
+	ASSERT(cv.FindPath(CompilePath("/a/c[1]"))->AsString() == "x");
+#if __cplusplus >= 201402L
+	ASSERT(cv.FindPath(VARIANT_PATH("/a/c[1]"))->AsString() == "x");
+#endif
+	ASSERT(!cv.FindPath("a/c[2]") && !cv.FindPath("a/b/d") && !cv.FindPath("x/y"));
+	ASSERT(v.FindPath("a/c")->Find(0u)->IsNull() && !v.FindPath("a/c")->Find(2u));
+	// Not a container
+	ASSERT(!Variant(1).Find("a") && !Variant("ab").Find(0u));
+	// Writes through the pointer land in the container
+	*v.Find("a")->Find("b") = 2;
+	ASSERT(v.GetPath("a/b") == 2);
+	// A proxy to a path that does not exist finds nothing
+	VariantRef proxy = v["a"]["d"];
+	ASSERT(!proxy.Find("e") && !proxy.Find(0u) && !v.Contains("d"));
+	VariantRef ref = v["a"];
+	ASSERT(ref.Find("b") == v.Find("a")->Find("b"));
+}
+
+void TestTry() {
+	cout << "Testing TryAs and TryGet\n";
+	Variant v;
+	v.SetPath("a/n", 5).SetPath("a/s", " 12").SetPath("a/bad", "x1").SetPath("a/f", 2.5)
+		.SetPath("a/l[1]", 3).SetPath("a/t", true);
+	int i = -1;
+	ASSERT(v.TryGetPath("a/n", i) && i == 5);
+	ASSERT(v.TryGetPath("a/s", i) && i == 12);
+	// Failures leave the value alone
+	i = -1;
+	ASSERT(!v.TryGetPath("a/bad", i) && i == -1);
+	ASSERT(!v.TryGetPath("a/missing", i) && !v.TryGetPath("a/l", i) && i == -1);
+	ASSERT(!v.TryGetPath(CompilePath("/a/l[2]"), i) && v.TryGetPath(CompilePath("/a/l[1]"), i) && i == 3);
+#if __cplusplus >= 201402L
+	i = -1;
+	ASSERT(!v.TryGetPath(VARIANT_PATH("/a/l[2]"), i) && v.TryGetPath(VARIANT_PATH("/a/l[1]"), i) && i == 3);
+#endif
+	double d = 0;
+	ASSERT(v["a"].TryGet("f", d) && d == 2.5 && !v["a"].TryGet("bad", d) && d == 2.5);
+	unsigned u = 0;
+	ASSERT(v.Get("a").TryGet("l", u) == false && v.Get("a").Get("l").TryGet(1u, u) && u == 3);
+	bool b = false;
+	ASSERT(v.TryGetPath("a/t", b) && b);
+	std::string s;
+	ASSERT(v.TryGetPath("a/n", s) && s == "5" && !v.TryGetPath("a/l", s) && s == "5");
+	std::vector<int> list;
+	ASSERT(v.TryGetPath("a/l", list) && list.size() == 2 && list[0] == 0 && list[1] == 3);
+	ASSERT(!v.TryGetPath("a/n", list) && list.size() == 2);
+	Variant bad_list = Variant::ListType;
+	bad_list.Append(1).Append("x");
+	ASSERT(!bad_list.TryAs(list) && list.size() == 2);
+	std::map<std::string, std::string> m;
+	ASSERT(v.TryGet("a", m) == false && v.Get("a").Get("l").TryAs(list));
+	// Types without a non throwing caster fall back on catching
+	std::complex<double> c;
+	ASSERT(Variant(1.5).TryAs(c) && c.real() == 1.5 && !Variant("x").TryAs(c));
+	// A proxy for a path that does not exist converts to nothing
+	ASSERT(!v["a"]["x"].TryAs(i) && !v["a"].Contains("x"));
+	ASSERT(!Variant(Variant::MapType).TryAs(i) && Variant().TryAs(i) && i == 0);
+}
+
+void TestKeyRef() {
+	cout << "Testing KeyRef lookups\n";
+	// Small and big maps, the big one past what is kept in the node
+	for (unsigned n = 2; n < 40; n += 30) {
+		Variant v = Variant::MapType;
+		for (unsigned i = 0; i < n; ++i) {
+			char key[64];
+			sprintf(key, "a key too long for short strings %u", i);
+			v[key] = i;
+		}
+		const char *key = "a key too long for short strings 1";
+		ASSERT(v.Contains(key) && v.Get(key) == 1 && *v.Find(key) == 1);
+		ASSERT(v.At(key) == 1 && static_cast<const Variant&>(v)[key] == 1);
+		ASSERT(!v.Contains(KeyRef(key, 10)) && !v.Find("missing"));
+		// Only the given characters are the key
+		std::string with_nul("k\0ey", 4);
+		v.Set(KeyRef(with_nul.data(), with_nul.size()), "nul");
+		ASSERT(v.Get(with_nul) == "nul" && !v.Contains("k") && v.Size() == n + 1);
+		v.Set(key, 5);
+		ASSERT(v.Size() == n + 1 && v[std::string(key)] == 5);
+		v.Erase(key);
+		ASSERT(!v.Contains(key) && v.Size() == n);
+		v.Erase(with_nul);
+		ASSERT(v.Size() == n - 1);
+#if __cplusplus >= 201703L
+		std::string_view view("a key too long for short strings 0");
+		ASSERT(v.Contains(view) && v[view] == 0);
+#endif
+	}
+}
+
+void TestBuilder() {
+	cout << "Testing building documents from parser events\n";
+
+	// Frames are reused between maps and lists at the same depth
+	Variant v = DeserializeJSON("[{\"a\": {\"b\": 1}}, [\"x\", \"y\"], {\"c\": [1, 2]}, [{\"d\": \"e\"}]]");
+	ASSERT(v.Size() == 4);
+	ASSERT(v[0]["a"]["b"] == 1);
+	ASSERT(v[1].IsList() && v[1].Size() == 2 && v[1][0] == "x" && v[1][1] == "y");
+	ASSERT(v[2]["c"].Size() == 2 && v[2]["c"][1] == 2);
+	ASSERT(v[3][0]["d"] == "e");
+	ASSERT(DeserializeJSON("[]").IsList() && DeserializeJSON("{}").IsMap());
+
+	// A list stops packing at the first value that does not fit
+	v = DeserializeJSON("[1, 2, [3], 4, {\"k\": 5}]");
+	ASSERT(v.Size() == 5 && v[0] == 1 && v[2][0] == 3 && v[3] == 4 && v[4]["k"] == 5);
+
+	std::string deep;
+	for (unsigned i = 0; i < 200; ++i) { deep += "{\"k\": ["; }
+	deep += "1";
+	for (unsigned i = 0; i < 200; ++i) { deep += "]}"; }
+	v = DeserializeJSON(deep);
+	for (unsigned i = 0; i < 200; ++i) { v = v["k"][0]; }
+	ASSERT(v == 1);
+
+#ifdef ENABLE_YAML
+	v = Deserialize("a: &x [1, 2]\nb: *x\nc: &y {d: e}\nf: *y\n1: g\n", SERIALIZE_YAML);
+	ASSERT(v["b"].Size() == 2 && v["b"][1] == 2);
+	ASSERT(v["f"]["d"] == "e");
+	ASSERT(v["1"] == "g");
+	unsigned docs = 0;
+	for (LoadAllIterator i = DeserializeAll("--- [1]\n--- {a: b}\n", SERIALIZE_YAML); i != LoadAllIterator(); ++i) {
+		++docs;
+	}
+	ASSERT(docs == 2);
+#endif
+}
+
+/// Counts the strings whose characters are within [begin, end)
+struct BorrowVisitor : public VariantVisitor {
+	BorrowVisitor(const char *b, const char *e) : begin(b), end(e), inside(0), outside(0) {}
+	void String(const char *s, size_t len) {
+		if (s >= begin && s + len <= end) { ++inside; }
+		else { ++outside; }
+	}
+	const char *begin, *end;
+	unsigned inside, outside;
+};
+
+static void CountFree(void *ptr, void *ctx) {
+	++*static_cast<unsigned*>(ctx);
+	free(ptr);
+}
+
+void TestBorrowed() {
+	cout << "Testing strings borrowed from the parser input\n";
+
+	std::string long_string(100, 'x');
+	std::string text = "{\"long\": \"" + long_string + "\", \"short\": \"abc\","
+		" \"escaped\": \"a string with an \\\"escape\\\" in it\","
+		" \"list\": [\"" + long_string + "\", 1, \"" + long_string + "\"],"
+		" \"a key long enough to be stored apart\": null}";
+	Variant expected = DeserializeJSON(text);
+
+	unsigned freed = 0;
+	char *buffer = static_cast<char*>(malloc(text.size()));
+	memcpy(buffer, text.data(), text.size());
+	BlobPtr blob = Blob::Create(buffer, text.size(), CountFree, &freed);
+	Variant v = DeserializeJSONBorrowed(blob);
+	ASSERT(v == expected);
+	BorrowVisitor borrowed(buffer, buffer + text.size());
+	Visit(borrowed, v);
+	// The three long strings, not the short or escaped ones
+	ASSERT(borrowed.inside == 3 && borrowed.outside == 2);
+
+	// The strings keep the text alive
+	blob.reset();
+	ASSERT(freed == 0);
+	Variant shared = v["list"];
+	v = Variant();
+	ASSERT(freed == 0);
+	ASSERT(shared[0] == long_string && shared[2] == long_string);
+	// A copy holds its own characters
+	Variant copy = shared[0].Copy();
+	shared = Variant();
+	ASSERT(freed == 1);
+	ASSERT(copy == long_string);
+
+	// Changing a borrowed string leaves the text alone
+	std::string modified = text;
+	blob = Blob::CreateCopy(modified.data(), modified.size());
+	v = DeserializeJSONBorrowed(blob);
+	v["long"] = v["long"].AsString() + "y";
+	v["list"][0] = "other";
+	ASSERT(v["list"][2] == long_string);
+	ASSERT(memcmp(blob->GetPtr(0), text.data(), text.size()) == 0);
+
+	// Text in several buffers is put together first
+	struct iovec iov[2];
+	iov[0].iov_base = const_cast<char*>(text.data());
+	iov[0].iov_len = 20;
+	iov[1].iov_base = const_cast<char*>(text.data()) + 20;
+	iov[1].iov_len = text.size() - 20;
+	v = DeserializeJSONBorrowed(Blob::CreateReferenced(iov, 2));
+	ASSERT(v == expected);
+	BorrowVisitor split(text.data(), text.data() + text.size());
+	Visit(split, v);
+	ASSERT(split.inside == 0);
+
+#ifdef ENABLE_YAML
+	// Other formats copy
+	v = DeserializeBorrowed(Blob::CreateCopy(text.data(), text.size()), SERIALIZE_YAML);
+	ASSERT(v == expected);
+#endif
+
+	// Assigning directly, short strings are copied
+	blob = Blob::CreateCopy(text.data(), text.size());
+	const char *chars = static_cast<const char*>(blob->GetPtr(0));
+	v.Assign(chars, 40, blob);
+	ASSERT(v == text.substr(0, 40));
+	BorrowVisitor direct(chars, chars + text.size());
+	Visit(direct, v);
+	ASSERT(direct.inside == 1);
+	v.Assign(chars, 4, blob);
+	ASSERT(v == text.substr(0, 4));
+	direct.inside = 0;
+	Visit(direct, v);
+	ASSERT(direct.inside == 0);
+}
+
 void TestRefReassign() {
 	cout << "Testing VariantRef reassign\n";
 
@@ -374,6 +1191,24 @@ void TestRefReassign() {
 	ASSERT(!v1.HasPath("foo"));
 	ASSERT(!v1.HasPath("foo/bar"));
 
+	// References follow a node as it is moved around its container and
+	// stop working once it is gone
+	Variant m;
+	m.Set("c", Variant().Set("x", 1));
+	VariantRef rc = m["c"];
+	VariantRef again = rc;
+	m.Set("a", 0).Set("b", 0);
+	ASSERT(rc.GetPath("x") == 1 && again.GetPath("x") == 1);
+	for (int i = 0; i < 3; ++i) { rc["y"] = i; }
+	ASSERT(m.GetPath("c/y") == 2 && again.GetPath("y") == 2);
+	for (int i = 0; i < 10; ++i) { m.Set(std::string(1, 'd' + i), i); }
+	again = 5;
+	ASSERT(m.Get("c") == 5 && rc == 5);
+	m.Erase("c");
+	try {
+		rc.GetType();
+		abort();
+	} catch (const InvalidReferenceError &) {}
 }
 
 void TestProxy() {
@@ -717,6 +1552,22 @@ void TestVariantEmitParseRandom(int verbose, int numtests, Parser (*Parser_t)(sh
 int main(int argv, char** argc) {
 	VariantTest();
 	TestCopy();
+	TestStrings();
+	TestSnapshot();
+	TestSmallContainers();
+	TestInternKeys();
+	TestMove();
+	TestHash();
+	TestOrdering();
+	TestPacked();
+	TestLazy();
+	TestVisit();
+	TestTypes();
+	TestFind();
+	TestTry();
+	TestKeyRef();
+	TestBuilder();
+	TestBorrowed();
 	TestRefReassign();
 	TestProxy();
 	VariantTestJSONParsing();